@@ -0,0 +1,297 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common/belt.h"
+#include "common/common.h"
+#include "common/sem_wrapper.h"
+
+/**
+ * @file bench_belt.c
+ * @brief Belt Benchmark - Push/Pop Cost as a Function of Belt Capacity K.
+ *
+ * For every K a private shared memory segment of @ref shared_state_size(K) and
+ * a private semaphore set are created, so the benchmark never touches a running
+ * simulation. The belt is kept half full while batches of pushes and pops are
+ * timed, which walks `head` and `tail` around the whole ring. A flat ns/op
+ * column shows that the cost of an operation does not depend on K.
+ *
+ * Packages are moved in batches of B (@ref belt_push_batch,
+ * @ref belt_pop_batch_to_truck), the cost is still reported per package. The
+ * default run adds a second table with growing B at a fixed K, which shows how
+ * throughput scales with the batch size.
+ *
+ * A third table measures contention: @ref LANE_PRODUCERS producer threads push
+ * single packages at the same time, producer `i` to lane `i % lanes`
+ * (@ref belt_lane_of), while one consumer thread drains all lanes. The
+ * aggregate push rate is reported for 1, 2, 4 and 8 lanes, 1 lane is the
+ * single ring every producer shares.
+ *
+ * Usage: `belt_bench [--batch=B] [K...]` (default: 100 1000 10000 32767, plus
+ * 100000 and 1000000 in the lock-free build, B = 1; then B = 1..256 at K = 10000;
+ * then 1..8 lanes at K = 1024).
+ *
+ * @author Mikołaj Kosiorek
+ */
+
+#define BATCH 1024
+#define MIN_OPS 200000L
+#define SWEEP_K 10000
+#define LANE_K 1024
+#define LANE_PRODUCERS 8
+#define LANE_OPS 100000L
+
+static long long now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void push_n(SharedState *shm, int semid, int n, int B, int *next_id) {
+  Package pkgs[MAX_BELT_BATCH];
+
+  for (int i = 0; i < n; i += B) {
+    int count = n - i < B ? n - i : B;
+    for (int j = 0; j < count; ++j) {
+      Package pkg = {.id = (*next_id)++, .type = PKG_A, .weight_g = 1000, .volume_cm3 = 19456};
+      pkgs[j] = pkg;
+    }
+
+    int pushed;
+    if (belt_push_batch(shm, semid, 0, pkgs, count, &pushed) != BELT_OK) {
+      fprintf(stderr, "Belt bench: push failed\n");
+      exit(1);
+    }
+  }
+}
+
+static void pop_n(SharedState *shm, int semid, int n, int B) {
+  Package out[MAX_BELT_BATCH];
+
+  for (int i = 0; i < n; ) {
+    int popped;
+    if (belt_pop_batch_to_truck(shm, semid, 0, out, n - i < B ? n - i : B, &popped) != BELT_OK) {
+      fprintf(stderr, "Belt bench: pop failed\n");
+      exit(1);
+    }
+    i += popped;
+  }
+}
+
+// Private segment and semaphore set of a belt with K slots split into `lanes`
+static SharedState *belt_create(int K, int lanes, int *semid) {
+  size_t size = shared_state_size(K);
+
+  int shmid = shmget(IPC_PRIVATE, size, 0600|IPC_CREAT);
+  if (shmid == -1) {
+    perror("Belt bench: shmget error");
+    exit(1);
+  }
+  SharedState *shm = shmat(shmid, NULL, 0);
+  if (shm == (void *)-1) {
+    perror("Belt bench: shmat error");
+    exit(1);
+  }
+  shmctl(shmid, IPC_RMID, NULL); // Removed on detach
+
+  *semid = semget(IPC_PRIVATE, belt_sem_count(lanes), 0600|IPC_CREAT);
+  if (*semid == -1) {
+    perror("Belt bench: semget error");
+    exit(1);
+  }
+
+  // No weight or truck limits, only the ring itself is measured
+  shm->segment_size = size;
+  shm->max_items_K = K;
+  shm->max_belt_weight_M = UNITS_MAX;
+  shm->truck_capacity_W = UNITS_MAX;
+  shm->truck_volume_V = UNITS_MAX;
+  shm->docks_D = 1;
+  shm->belt_lanes = lanes;
+  belt_init(shm);
+
+  for (int l = 0; l < shm->belt_lanes; ++l) {
+    sem_set(*semid, belt_lane_sem(l, SEM_MUTEX), SETVAL, 1);
+#ifndef BELT_LOCKFREE
+    sem_set(*semid, belt_lane_sem(l, SEM_EMPTY), SETVAL, shm->lanes[l].slots);
+#endif
+    sem_set(*semid, belt_lane_sem(l, SEM_FULL), SETVAL, 0);
+  }
+  sem_set(*semid, SEM_DOCK, SETVAL, 1);
+  return shm;
+}
+
+static void belt_destroy(SharedState *shm, int semid) {
+  semctl(semid, 0, IPC_RMID);
+  shmdt(shm);
+}
+
+static void bench_capacity(int K, int B) {
+  int semid;
+  SharedState *shm = belt_create(K, 1, &semid);
+  size_t size = shm->segment_size;
+
+  int batch = K / 2 < BATCH ? (K / 2 > 0 ? K / 2 : 1) : BATCH;
+  int next_id = 0;
+
+  // Half full belt, batches never block
+  push_n(shm, semid, (K - batch) / 2, B, &next_id);
+
+  // Warm-up lap faults in all pages of the segment
+  long laps = (K + batch - 1) / batch;
+  for (long i = 0; i < laps; ++i) {
+    push_n(shm, semid, batch, B, &next_id);
+    pop_n(shm, semid, batch, B);
+  }
+
+  // Measured laps cover the ring at least twice
+  long ops = 2L * K > MIN_OPS ? 2L * K : MIN_OPS;
+  laps = (ops + batch - 1) / batch;
+
+  long long push_ns = 0, pop_ns = 0;
+  for (long i = 0; i < laps; ++i) {
+    long long t0 = now_ns();
+    push_n(shm, semid, batch, B, &next_id);
+    long long t1 = now_ns();
+    pop_n(shm, semid, batch, B);
+    long long t2 = now_ns();
+
+    push_ns += t1 - t0;
+    pop_ns += t2 - t1;
+  }
+
+  double n = (double)laps * batch;
+  printf("%10d %6d %12.2f %12.1f %12.1f\n", K, B, size / (1024.0 * 1024.0), push_ns / n, pop_ns / n);
+  fflush(stdout);
+
+  belt_destroy(shm, semid);
+}
+
+/**
+ * @brief Belt shared by the threads of one lane measurement.
+ */
+typedef struct {
+  SharedState *shm;
+  int semid;
+  int producer; /**< Producer number, selects the lane. */
+} LaneBench;
+
+static void *lane_producer(void *arg) {
+  LaneBench *b = arg;
+  int lane = belt_lane_of(b->shm, b->producer);
+  Package pkg = {.id = b->producer, .type = PKG_A, .weight_g = 1000, .volume_cm3 = 19456};
+
+  for (long i = 0; i < LANE_OPS; ++i) {
+    int pushed;
+    if (belt_push_batch(b->shm, b->semid, lane, &pkg, 1, &pushed) != BELT_OK) {
+      fprintf(stderr, "Belt bench: lane push failed\n");
+      exit(1);
+    }
+  }
+  return NULL;
+}
+
+static void *lane_consumer(void *arg) {
+  LaneBench *b = arg;
+  Package out[MAX_BELT_BATCH];
+  long total = LANE_OPS * LANE_PRODUCERS;
+
+  for (long done = 0; done < total; ) {
+    unsigned int seen = belt_doorbell(b->shm);
+    int popped;
+    if (belt_pop_batch_to_truck(b->shm, b->semid, 0, out, MAX_BELT_BATCH, &popped) == BELT_OK) {
+      done += popped;
+    }
+    else {
+      belt_wait_package(b->shm, seen);
+    }
+  }
+  return NULL;
+}
+
+static void bench_lanes(int lanes) {
+  int semid;
+  SharedState *shm = belt_create(LANE_K, lanes, &semid);
+  LaneBench consumer = {shm, semid, 0};
+  LaneBench producers[LANE_PRODUCERS];
+  pthread_t consumer_thread, producer_threads[LANE_PRODUCERS];
+
+  long long t0 = now_ns();
+  pthread_create(&consumer_thread, NULL, lane_consumer, &consumer);
+  for (int i = 0; i < LANE_PRODUCERS; ++i) {
+    producers[i] = (LaneBench){shm, semid, i};
+    pthread_create(&producer_threads[i], NULL, lane_producer, &producers[i]);
+  }
+  for (int i = 0; i < LANE_PRODUCERS; ++i) pthread_join(producer_threads[i], NULL);
+  long long t_push = now_ns() - t0;
+  pthread_join(consumer_thread, NULL);
+
+  double n = (double)LANE_OPS * LANE_PRODUCERS;
+  printf("%10d %6d %12d %12.1f %12.2f\n", LANE_K, shm->belt_lanes, LANE_PRODUCERS, t_push / n, n / (t_push / 1e9) / 1e6);
+  fflush(stdout);
+
+  belt_destroy(shm, semid);
+}
+
+int main(int argc, char *argv[]) {
+  int default_k[] = {
+    100, 1000, 10000, SEM_BELT_MAX_CAPACITY,
+#ifdef BELT_LOCKFREE
+    100000, 1000000,
+#endif
+  };
+  int default_count = sizeof(default_k) / sizeof(default_k[0]);
+  int sweep_b[] = {1, 2, 4, 8, 16, 32, 64, 128, 256};
+  int sweep_count = sizeof(sweep_b) / sizeof(sweep_b[0]);
+  int B = 1;
+  int first_k = 1;
+
+  if (argc > 1 && strncmp(argv[1], "--batch=", 8) == 0) {
+    B = atoi(argv[1] + 8);
+    if (B < 1 || B > MAX_BELT_BATCH) {
+      fprintf(stderr, "Batch size must be between 1 and %d\n", MAX_BELT_BATCH);
+      exit(1);
+    }
+    first_k = 2;
+  }
+
+#ifdef BELT_LOCKFREE
+  printf("Belt: lock-free MPMC ring\n");
+#else
+  printf("Belt: semaphore guarded buffer\n");
+#endif
+  printf("%10s %6s %12s %12s %12s\n", "K", "B", "segment MB", "push ns/pkg", "pop ns/pkg");
+
+  if (argc > first_k) {
+    for (int i = first_k; i < argc; ++i) {
+      int K = atoi(argv[i]);
+#ifndef BELT_LOCKFREE
+      if (K > SEM_BELT_MAX_CAPACITY) {
+	fprintf(stderr, "K=%d skipped, semaphore belt limit is %d\n", K, SEM_BELT_MAX_CAPACITY);
+	continue;
+      }
+#endif
+      if (K <= 0) {
+	fprintf(stderr, "K must be a positive number\n");
+	exit(1);
+      }
+      bench_capacity(K, B > K ? K : B);
+    }
+  }
+  else {
+    for (int i = 0; i < default_count; ++i) bench_capacity(default_k[i], B);
+
+    // Batch size sweep at fixed K
+    printf("\n");
+    for (int i = 0; i < sweep_count; ++i) bench_capacity(SWEEP_K, sweep_b[i]);
+
+    // Lane sweep, concurrent producers
+    int sweep_lanes[] = {1, 2, 4, 8};
+    printf("\n%10s %6s %12s %12s %12s\n", "K", "lanes", "producers", "push ns/pkg", "Mpkg/s");
+    for (size_t i = 0; i < sizeof(sweep_lanes) / sizeof(sweep_lanes[0]); ++i) bench_lanes(sweep_lanes[i]);
+  }
+
+  return 0;
+}
@@ -0,0 +1,327 @@
+#define _GNU_SOURCE
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/belt.h"
+#include "common/common.h"
+#include "common/sem_wrapper.h"
+#include "common/utils.h"
+
+/**
+ * @file bench_layout.c
+ * @brief Layout Benchmark - Cache Misses of the Shared State Layout.
+ *
+ * Counts cache misses (`perf_event_open`, user space only, all threads of the
+ * benchmark) of three workloads. The first two run the old and the new layout
+ * side by side, so one run shows before and after:
+ * - **hot words:** a producer thread and a consumer thread each bump their own
+ * ring position, once packed into one cache line (the old `BeltLane`), once
+ * on separate lines (the current @ref BeltLane). Packed words bounce their
+ * line between the cores on every operation (false sharing).
+ * - **capacity scan:** the heaviest package that fits into a truck among K
+ * slots, once over an array of @ref Package (the old belt), once over the
+ * weight and volume columns of @ref BeltSlots.
+ * - **belt:** one producer and one consumer thread move packages through the
+ * real belt (@ref belt_push_batch, @ref belt_pop_batch_to_truck) of the
+ * current build.
+ *
+ * Without hardware counters (virtual machines, `perf_event_paranoid` > 2) the
+ * miss columns read `n/a` and only the times are reported. False sharing
+ * needs the threads on different cores, on a single CPU both hot word layouts
+ * cost the same.
+ *
+ * Usage: `layout_bench [OPS] [K]` (default: 10000000 increments per thread,
+ * 1000000 scanned slots, belt runs OPS / 10 packages).
+ *
+ * @author Mikołaj Kosiorek
+ */
+
+#define DEFAULT_OPS 10000000L
+#define DEFAULT_SCAN_K 1000000
+#define SCAN_ROUNDS 10
+#define BELT_K 1024
+
+static long long now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// --- Counters ---
+
+/**
+ * @brief Cache miss counters of the benchmark process, -1 when not available.
+ */
+typedef struct {
+  int llc;  /**< Last level cache misses (PERF_COUNT_HW_CACHE_MISSES). */
+  int l1d;  /**< L1 data cache read misses. */
+} MissCounters;
+
+static int counter_open(unsigned int type, unsigned long long config) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.inherit = 1; // Threads started while counting are counted as well
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static MissCounters counters_start(void) {
+  MissCounters c;
+  c.llc = counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  c.l1d = counter_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+  if (c.llc != -1) ioctl(c.llc, PERF_EVENT_IOC_ENABLE, 0);
+  if (c.l1d != -1) ioctl(c.l1d, PERF_EVENT_IOC_ENABLE, 0);
+  return c;
+}
+
+// Count of one counter, -1 if it could not be opened. Closes it
+static long long counter_stop(int fd) {
+  if (fd == -1) return -1;
+
+  long long value = -1;
+  ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+  if (read(fd, &value, sizeof(value)) != sizeof(value)) value = -1;
+  close(fd);
+  return value;
+}
+
+// Misses per operation, or n/a
+static void print_misses(long long misses, double ops) {
+  if (misses < 0) printf(" %12s", "n/a");
+  else printf(" %12.3f", misses / ops);
+}
+
+static void print_row(const char *workload, const char *layout, double ops, long long ns, MissCounters c) {
+  long long llc = counter_stop(c.llc);
+  long long l1d = counter_stop(c.l1d);
+
+  printf("%-14s %-8s %12.2f", workload, layout, ns / ops);
+  print_misses(l1d, ops);
+  print_misses(llc, ops);
+  printf("\n");
+  fflush(stdout);
+}
+
+// --- Hot words ---
+
+/** @brief Old lane layout, ring positions of both sides on one line. */
+typedef struct {
+  unsigned long tail;
+  unsigned long head;
+} __attribute__((aligned(CACHE_LINE_SIZE))) PackedWords;
+
+/** @brief New lane layout, every side owns a line. */
+typedef struct {
+  unsigned long tail __attribute__((aligned(CACHE_LINE_SIZE)));
+  unsigned long head __attribute__((aligned(CACHE_LINE_SIZE)));
+} SplitWords;
+
+typedef struct {
+  unsigned long *word;
+  long ops;
+} WordBench;
+
+static void *bump_word(void *arg) {
+  WordBench *b = arg;
+  for (long i = 0; i < b->ops; ++i) __atomic_add_fetch(b->word, 1, __ATOMIC_RELAXED);
+  return NULL;
+}
+
+static void bench_words(const char *layout, unsigned long *tail, unsigned long *head, long ops) {
+  WordBench producer = {tail, ops}, consumer = {head, ops};
+  pthread_t threads[2];
+
+  MissCounters c = counters_start();
+  long long t0 = now_ns();
+  pthread_create(&threads[0], NULL, bump_word, &producer);
+  pthread_create(&threads[1], NULL, bump_word, &consumer);
+  pthread_join(threads[0], NULL);
+  pthread_join(threads[1], NULL);
+  long long ns = now_ns() - t0;
+
+  print_row("hot words", layout, 2.0 * ops, ns, c);
+}
+
+// --- Capacity scan ---
+
+// Heaviest package that fits, reading whole packages
+static int scan_packages(const Package *belt, int K, int W, int V) {
+  int best = -1;
+  for (int i = 0; i < K; ++i) {
+    if (belt[i].weight_g > W || belt[i].volume_cm3 > V) continue;
+    if (best == -1 || belt[i].weight_g > belt[best].weight_g) best = i;
+  }
+  return best;
+}
+
+// Heaviest package that fits, reading the weight and volume columns only
+static int scan_columns(const BeltSlots *belt, int K, int W, int V) {
+  int best = -1;
+  for (int i = 0; i < K; ++i) {
+    if (belt->weight_g[i] > W || belt->volume_cm3[i] > V) continue;
+    if (best == -1 || belt->weight_g[i] > belt->weight_g[best]) best = i;
+  }
+  return best;
+}
+
+static void bench_scan(int K) {
+  Package *packages = malloc(sizeof(Package) * K);
+  void *block = aligned_alloc(CACHE_LINE_SIZE, belt_slots_size(K));
+  if (!packages || !block) {
+    perror("Layout bench: malloc error");
+    exit(1);
+  }
+  BeltSlots columns = belt_slots_layout(block, K);
+
+  srand(1);
+  for (int i = 0; i < K; ++i) {
+    PackageType type = (PackageType)(rand() % PKG_END);
+    Package pkg = {.id = i, .type = type, .weight_g = 100 + (rand() % 249) * 100, .volume_cm3 = get_volume_cm3(type)};
+    packages[i] = pkg;
+    belt_slot_put(&columns, i, &pkg, 0);
+  }
+
+  // Same answer from both layouts, the sink keeps the scans alive
+  volatile int sink = 0;
+  if (scan_packages(packages, K, 12000, 1000000) != scan_columns(&columns, K, 12000, 1000000)) {
+    fprintf(stderr, "Layout bench: scans disagree\n");
+    exit(1);
+  }
+
+  MissCounters c = counters_start();
+  long long t0 = now_ns();
+  for (int r = 0; r < SCAN_ROUNDS; ++r) sink += scan_packages(packages, K, 12000 + r * 1000, 1000000);
+  print_row("capacity scan", "AoS", (double)K * SCAN_ROUNDS, now_ns() - t0, c);
+
+  c = counters_start();
+  t0 = now_ns();
+  for (int r = 0; r < SCAN_ROUNDS; ++r) sink += scan_columns(&columns, K, 12000 + r * 1000, 1000000);
+  print_row("capacity scan", "SoA", (double)K * SCAN_ROUNDS, now_ns() - t0, c);
+
+  (void)sink;
+  free(block);
+  free(packages);
+}
+
+// --- Belt ---
+
+typedef struct {
+  SharedState *shm;
+  int semid;
+  long ops;
+} BeltBench;
+
+static void *belt_producer(void *arg) {
+  BeltBench *b = arg;
+  Package pkg = {.id = 0, .type = PKG_A, .weight_g = 1000, .volume_cm3 = 19456};
+
+  for (long i = 0; i < b->ops; ++i) {
+    int pushed;
+    pkg.id = (int)i;
+    if (belt_push_batch(b->shm, b->semid, 0, &pkg, 1, &pushed) != BELT_OK) {
+      fprintf(stderr, "Layout bench: push failed\n");
+      exit(1);
+    }
+  }
+  return NULL;
+}
+
+static void *belt_consumer(void *arg) {
+  BeltBench *b = arg;
+  Package out;
+
+  for (long done = 0; done < b->ops; ) {
+    unsigned int seen = belt_doorbell(b->shm);
+    int popped;
+    if (belt_pop_batch_to_truck(b->shm, b->semid, 0, &out, 1, &popped) == BELT_OK) done += popped;
+    else belt_wait_package(b->shm, seen);
+  }
+  return NULL;
+}
+
+static void bench_belt(long ops) {
+  size_t size = shared_state_size(BELT_K);
+  SharedState *shm = NULL;
+  if (posix_memalign((void **)&shm, CACHE_LINE_SIZE, size) != 0) {
+    perror("Layout bench: posix_memalign error");
+    exit(1);
+  }
+  memset(shm, 0, size);
+
+  int semid = semget(IPC_PRIVATE, SEM_NUM, 0600|IPC_CREAT);
+  if (semid == -1) {
+    perror("Layout bench: semget error");
+    exit(1);
+  }
+
+  // No weight or truck limits, only the belt itself is measured
+  shm->segment_size = size;
+  shm->max_items_K = BELT_K;
+  shm->max_belt_weight_M = UNITS_MAX;
+  shm->truck_capacity_W = UNITS_MAX;
+  shm->truck_volume_V = UNITS_MAX;
+  shm->docks_D = 1;
+  shm->belt_lanes = 1;
+  belt_init(shm);
+  sem_set(semid, SEM_MUTEX, SETVAL, 1);
+#ifndef BELT_LOCKFREE
+  sem_set(semid, SEM_EMPTY, SETVAL, BELT_K);
+#endif
+  sem_set(semid, SEM_FULL, SETVAL, 0);
+  sem_set(semid, SEM_DOCK, SETVAL, 1);
+
+  BeltBench b = {shm, semid, ops};
+  pthread_t producer, consumer;
+
+  MissCounters c = counters_start();
+  long long t0 = now_ns();
+  pthread_create(&consumer, NULL, belt_consumer, &b);
+  pthread_create(&producer, NULL, belt_producer, &b);
+  pthread_join(producer, NULL);
+  pthread_join(consumer, NULL);
+  long long ns = now_ns() - t0;
+
+#ifdef BELT_LOCKFREE
+  print_row("belt", "lockfree", (double)ops, ns, c);
+#else
+  print_row("belt", "sem", (double)ops, ns, c);
+#endif
+
+  semctl(semid, 0, IPC_RMID);
+  free(shm);
+}
+
+int main(int argc, char *argv[]) {
+  long ops = argc > 1 ? atol(argv[1]) : DEFAULT_OPS;
+  int K = argc > 2 ? atoi(argv[2]) : DEFAULT_SCAN_K;
+  if (ops < 10 || K < 1) {
+    fprintf(stderr, "Usage: %s [OPS] [K]\n", argv[0]);
+    exit(1);
+  }
+
+  printf("CPUs: %ld, SharedState: %zu bytes\n", sysconf(_SC_NPROCESSORS_ONLN), sizeof(SharedState));
+  printf("%-14s %-8s %12s %12s %12s\n", "workload", "layout", "ns/op", "L1D miss/op", "LLC miss/op");
+
+  PackedWords packed = {0, 0};
+  SplitWords split = {0, 0};
+  bench_words("packed", &packed.tail, &packed.head, ops);
+  bench_words("split", &split.tail, &split.head, ops);
+
+  bench_scan(K);
+  bench_belt(ops / 10);
+
+  return 0;
+}
@@ -0,0 +1,601 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/belt.h"
+#include "common/common.h"
+#include "common/sem_wrapper.h"
+#include "common/shm_wrapper.h"
+#include "common/utils.h"
+
+/**
+ * @file bench_warehouse.c
+ * @brief Warehouse Benchmark Suite - Microbenchmarks and End-to-End Scenarios.
+ *
+ * The suite has two parts, both reported as one JSON document on stdout:
+ * - **micro**: cost of the building blocks used on every package, `sem_op`
+ * (P/V pair on a private semaphore), `attach_memory_block` (attach & detach
+ * of an existing segment), `generate_weight_g`, single package belt push/pop and
+ * pop with lookahead over a full belt of K = 1024 (`belt_pop_lookahead`) and
+ * the time from pushing a package onto the empty belt until a consumer
+ * sleeping on the belt doorbell popped it (`belt_wake_to_pop`), the arrival to
+ * load latency of a docked truck.
+ * - **scenarios**: the real `warehouse_dispatcher`, `worker_std`,
+ * `worker_express` and `truck` binaries run headless (`--headless`,
+ * `--no-sleep`) until a fixed number of packages was loaded from the belt.
+ * The `result` of every scenario is the Dispatcher's `--report=json` object:
+ * packages per second, p50/p99 belt dwell time (ns) and average truck fill
+ * ratio among others, plus the latency of every other package stage.
+ * `*_threads` scenarios repeat a scenario with the roles running as threads of
+ * the Dispatcher (`--threads`), for a direct comparison of both architectures.
+ * `small_trucks*` load trucks close to the package size, where the lookahead
+ * window (`--lookahead`) shows in the truck fill ratio. `fanout*` run 8
+ * workers per type (`--workers`) on one belt lane and on four (`--lanes`).
+ * `big_belt*` run a belt of K = 32000 on normal pages and on huge pages
+ * locked in RAM (`--huge-pages`, `--mlock`). Every scenario reports the minor
+ * and major page faults of the Dispatcher and its roles (`getrusage`) and
+ * their data TLB load misses (`perf_event_open`, `null` without hardware
+ * counters). Huge pages need pages reserved in `/proc/sys/vm/nr_hugepages`,
+ * without them the run falls back to normal pages. `*_pin_*` scenarios pin
+ * the roles with an automatic layout (`--pin=l3`, `--pin=spread`), their
+ * `speedup` is the throughput relative to the unpinned `baseline` scenario.
+ * `startup_n*` start 10, 1000 and 10000 truck processes, their `result.startup`
+ * holds the time to spawn every role (`spawn_ms`), until all of them waited at
+ * the start barrier (`ready_ms`) and from the start to the first package
+ * loaded (`first_package_ms`). The largest one needs a process limit
+ * (`ulimit -u`) above 10000. `*_fleet` run the trucks of a scenario as one
+ * fleet role (`--fleet`), their `speedup` is relative to one process per truck.
+ *
+ * Scenarios are started in the directory of the simulation binaries (their IPC
+ * keys derive from it), `simulation.log` there is overwritten. Do not run the
+ * suite while a simulation runs from the same directory.
+ *
+ * Usage: `warehouse_bench [--micro] [--e2e] [--packages=<n>] [--bin-dir=<dir>]`
+ * (default: both parts, 20000 packages per scenario).
+ *
+ * @author Mikołaj Kosiorek
+ */
+
+#define DEFAULT_PACKAGES 20000L
+#define BENCH_KEY_ID_SHM 'b'
+#define MICRO_BELT_K 1024
+#define SEM_OPS 200000L
+#define ATTACH_OPS 20000L
+#define WEIGHT_OPS 10000000L
+#define BELT_OPS 1000000L
+#define WAKE_OPS 1000L
+
+#ifndef WAREHOUSE_BIN_DIR
+#define WAREHOUSE_BIN_DIR "../src"
+#endif
+
+/**
+ * @brief End-to-end scenario, parameters of one Dispatcher run.
+ */
+typedef struct {
+  const char *name; /**< Scenario name in the report. */
+  int N;            /**< Number of trucks. */
+  int K;            /**< Belt capacity. */
+  double M;         /**< Max belt weight (kg). */
+  double W;         /**< Truck weight capacity (kg). */
+  double V;         /**< Truck volume capacity (m3). */
+  int D;            /**< Number of docks. */
+  int B;            /**< Belt batch size. */
+  int threads;      /**< Roles run as threads of the Dispatcher (`--threads`). */
+  int L;            /**< Loading lookahead window (`--lookahead`). */
+  int workers;      /**< Standard workers per package type (`--workers`). */
+  int lanes;        /**< Belt lanes (`--lanes`). */
+  int mem;          /**< SHM_BLOCK_* options of the state segment (`--huge-pages`, `--mlock`). */
+  const char *pin;  /**< CPU placement (`--pin`), NULL for none. */
+  const char *baseline; /**< Earlier scenario the throughput is compared to, NULL for none. */
+  int fleet;        /**< Trucks as one fleet role (`--fleet`). */
+} Scenario;
+
+static const Scenario scenarios[] = {
+  {"single_dock",                3, 10,    500.0,    100.0, 50.0, 1, 1,  0, 1, 1, 1, 0, NULL, NULL, 0},
+  {"four_docks",                 8, 100,   1000.0,   100.0, 50.0, 4, 1,  0, 1, 1, 1, 0, NULL, NULL, 0},
+  {"four_docks_batch16",         8, 100,   1000.0,   100.0, 50.0, 4, 16, 0, 1, 1, 1, 0, NULL, NULL, 0},
+  {"four_docks_threads",         8, 100,   1000.0,   100.0, 50.0, 4, 1,  1, 1, 1, 1, 0, NULL, NULL, 0},
+  {"four_docks_batch16_threads", 8, 100,   1000.0,   100.0, 50.0, 4, 16, 1, 1, 1, 1, 0, NULL, NULL, 0},
+  {"four_docks_batch16_pin_l3",  8, 100,   1000.0,   100.0, 50.0, 4, 16, 0, 1, 1, 1, 0, "l3", "four_docks_batch16", 0},
+  {"four_docks_batch16_pin_spread", 8, 100, 1000.0, 100.0, 50.0, 4, 16, 0, 1, 1, 1, 0, "spread", "four_docks_batch16", 0},
+  {"small_trucks",               8, 100,   1000.0,   30.0,  20.0, 4, 4,  0, 1, 1, 1, 0, NULL, NULL, 0},
+  {"small_trucks_lookahead8",    8, 100,   1000.0,   30.0,  20.0, 4, 4,  0, 8, 1, 1, 0, NULL, NULL, 0},
+  {"fanout8",                    8, 100,   1000.0,   100.0, 50.0, 4, 1,  0, 1, 8, 1, 0, NULL, NULL, 0},
+  {"fanout8_lanes4",             8, 100,   1000.0,   100.0, 50.0, 4, 1,  0, 1, 8, 4, 0, NULL, NULL, 0},
+  {"fanout8_lanes4_threads",     8, 100,   1000.0,   100.0, 50.0, 4, 1,  1, 1, 8, 4, 0, NULL, NULL, 0},
+  {"fanout8_lanes4_pin_l3",      8, 100,   1000.0,   100.0, 50.0, 4, 1,  0, 1, 8, 4, 0, "l3", "fanout8_lanes4", 0},
+  {"big_belt",                   8, 32000, 100000.0, 100.0, 50.0, 4, 16, 0, 1, 1, 1, 0, NULL, NULL, 0},
+  {"big_belt_huge_mlock",        8, 32000, 100000.0, 100.0, 50.0, 4, 16, 0, 1, 1, 1, SHM_BLOCK_HUGE|SHM_BLOCK_LOCK, NULL, NULL, 0},
+  {"startup_n10",                10, 100,  1000.0,   100.0, 50.0, 4, 1,  0, 1, 1, 1, 0, NULL, NULL, 0},
+  {"startup_n1000",              1000, 100, 1000.0,   100.0, 50.0, 4, 1,  0, 1, 1, 1, 0, NULL, NULL, 0},
+  {"startup_n10000",             10000, 100, 1000.0,  100.0, 50.0, 4, 1,  0, 1, 1, 1, 0, NULL, NULL, 0},
+  {"single_dock_fleet",          3, 10,    500.0,    100.0, 50.0, 1, 1,  0, 1, 1, 1, 0, NULL, "single_dock", 1},
+  {"four_docks_fleet",           8, 100,   1000.0,   100.0, 50.0, 4, 1,  0, 1, 1, 1, 0, NULL, "four_docks", 1},
+};
+
+static long long now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void report_micro(const char *name, long ops, long long ns, int *first) {
+  printf("%s\n    {\"name\":\"%s\",\"ops\":%ld,\"ns_per_op\":%.1f}", *first ? "" : ",", name, ops, (double)ns / ops);
+  *first = 0;
+}
+
+// --- Microbenchmarks ---
+
+static void micro_sem_op(int *first) {
+  int semid = semget(IPC_PRIVATE, 1, 0600|IPC_CREAT);
+  if (semid == -1) {
+    perror("Warehouse bench: semget error");
+    exit(1);
+  }
+  sem_set(semid, 0, SETVAL, 1);
+
+  long long t0 = now_ns();
+  for (long i = 0; i < SEM_OPS; ++i) {
+    sem_op(semid, 0, -1);
+    sem_op(semid, 0, 1);
+  }
+  long long t1 = now_ns();
+
+  semctl(semid, 0, IPC_RMID);
+  report_micro("sem_op", 2 * SEM_OPS, t1 - t0, first);
+}
+
+static void micro_attach(int *first) {
+  // Segment of a default run (K=10), attached the same way children do
+  void *seg = attach_memory_block(KEY_PATH, BENCH_KEY_ID_SHM, shared_state_size(10));
+
+  long long t0 = now_ns();
+  for (long i = 0; i < ATTACH_OPS; ++i) {
+    detach_memory_block(attach_memory_block(KEY_PATH, BENCH_KEY_ID_SHM, 0));
+  }
+  long long t1 = now_ns();
+
+  detach_memory_block(seg);
+  destroy_memory_block(KEY_PATH, BENCH_KEY_ID_SHM);
+  report_micro("attach_memory_block", ATTACH_OPS, t1 - t0, first);
+}
+
+static void micro_generate_weight(int *first) {
+  volatile long sink = 0;
+
+  long long t0 = now_ns();
+  for (long i = 0; i < WEIGHT_OPS; ++i) sink += generate_weight_g((PackageType)(i % PKG_END));
+  long long t1 = now_ns();
+
+  (void)sink;
+  report_micro("generate_weight_g", WEIGHT_OPS, t1 - t0, first);
+}
+
+static void micro_belt(int *first) {
+  int K = MICRO_BELT_K;
+  size_t size = shared_state_size(K);
+
+  int shmid = shmget(IPC_PRIVATE, size, 0600|IPC_CREAT);
+  if (shmid == -1) {
+    perror("Warehouse bench: shmget error");
+    exit(1);
+  }
+  SharedState *shm = shmat(shmid, NULL, 0);
+  if (shm == (void *)-1) {
+    perror("Warehouse bench: shmat error");
+    exit(1);
+  }
+  shmctl(shmid, IPC_RMID, NULL); // Removed on detach
+
+  int semid = semget(IPC_PRIVATE, SEM_NUM, 0600|IPC_CREAT);
+  if (semid == -1) {
+    perror("Warehouse bench: semget error");
+    exit(1);
+  }
+
+  // No weight or truck limits, one package pushed and popped in turn
+  shm->segment_size = size;
+  shm->max_items_K = K;
+  shm->max_belt_weight_M = UNITS_MAX;
+  shm->truck_capacity_W = UNITS_MAX;
+  shm->truck_volume_V = UNITS_MAX;
+  shm->docks_D = 1;
+  belt_init(shm);
+
+  sem_set(semid, SEM_MUTEX, SETVAL, 1);
+#ifndef BELT_LOCKFREE
+  sem_set(semid, SEM_EMPTY, SETVAL, K);
+#endif
+  sem_set(semid, SEM_FULL, SETVAL, 0);
+  sem_set(semid, SEM_DOCK, SETVAL, 1);
+
+  Package pkg = {.id = 0, .type = PKG_A, .weight_g = 1000, .volume_cm3 = 19456};
+  Package out;
+  long long push_ns = 0, pop_ns = 0;
+
+  for (long i = 0; i < BELT_OPS; ++i) {
+    pkg.id = (int)i;
+
+    long long t0 = now_ns();
+    if (belt_push(shm, semid, &pkg) != BELT_OK) {
+      fprintf(stderr, "Warehouse bench: push failed\n");
+      exit(1);
+    }
+    long long t1 = now_ns();
+    if (belt_pop_to_truck(shm, semid, 0, &out) != BELT_OK) {
+      fprintf(stderr, "Warehouse bench: pop failed\n");
+      exit(1);
+    }
+    long long t2 = now_ns();
+
+    push_ns += t1 - t0;
+    pop_ns += t2 - t1;
+  }
+
+  // Lookahead over the whole belt: fill it with random packages, then drain it,
+  // every pop takes the heaviest package left anywhere on the belt
+  shm->lookahead_L = K;
+  long long lookahead_ns = 0;
+  long lookahead_ops = 0;
+
+  for (int round = 0; round < BELT_OPS / K; ++round) {
+    for (int i = 0; i < K; ++i) {
+      pkg.type = (PackageType)(i % PKG_END);
+      pkg.weight_g = generate_weight_g(pkg.type);
+      if (belt_push(shm, semid, &pkg) != BELT_OK) {
+	fprintf(stderr, "Warehouse bench: push failed\n");
+	exit(1);
+      }
+    }
+
+    long long t0 = now_ns();
+    for (int i = 0; i < K; ++i) {
+      if (belt_pop_to_truck(shm, semid, 0, &out) != BELT_OK) {
+	fprintf(stderr, "Warehouse bench: lookahead pop failed\n");
+	exit(1);
+      }
+    }
+    lookahead_ns += now_ns() - t0;
+    lookahead_ops += K;
+  }
+
+  semctl(semid, 0, IPC_RMID);
+  shmdt(shm);
+
+  report_micro("belt_push", BELT_OPS, push_ns, first);
+  report_micro("belt_pop", BELT_OPS, pop_ns, first);
+  report_micro("belt_pop_lookahead", lookahead_ops, lookahead_ns, first);
+}
+
+typedef struct {
+  SharedState *shm;
+  int semid;
+  long popped; /**< Packages taken by the consumer. */
+} WakeBench;
+
+// Consumer of micro_belt_wake, sleeps on the doorbell like a docked truck
+static void *wake_consumer(void *arg) {
+  WakeBench *b = arg;
+  Package out;
+
+  while (__atomic_load_n(&b->popped, __ATOMIC_ACQUIRE) < WAKE_OPS) {
+    unsigned int seen = belt_doorbell(b->shm);
+    if (belt_pop_to_truck(b->shm, b->semid, 0, &out) == BELT_OK) __atomic_add_fetch(&b->popped, 1, __ATOMIC_RELEASE);
+    else belt_wait_package(b->shm, seen);
+  }
+  return NULL;
+}
+
+static void micro_belt_wake(int *first) {
+  int K = MICRO_BELT_K;
+  size_t size = shared_state_size(K);
+  SharedState *shm = NULL;
+  if (posix_memalign((void **)&shm, CACHE_LINE_SIZE, size) != 0) {
+    perror("Warehouse bench: posix_memalign error");
+    exit(1);
+  }
+  memset(shm, 0, size);
+
+  int semid = semget(IPC_PRIVATE, SEM_NUM, 0600|IPC_CREAT);
+  if (semid == -1) {
+    perror("Warehouse bench: semget error");
+    exit(1);
+  }
+
+  shm->segment_size = size;
+  shm->max_items_K = K;
+  shm->max_belt_weight_M = UNITS_MAX;
+  shm->truck_capacity_W = UNITS_MAX;
+  shm->truck_volume_V = UNITS_MAX;
+  shm->docks_D = 1;
+  belt_init(shm);
+
+  sem_set(semid, SEM_MUTEX, SETVAL, 1);
+#ifndef BELT_LOCKFREE
+  sem_set(semid, SEM_EMPTY, SETVAL, K);
+#endif
+  sem_set(semid, SEM_FULL, SETVAL, 0);
+  sem_set(semid, SEM_DOCK, SETVAL, 1);
+
+  WakeBench b = {shm, semid, 0};
+  pthread_t consumer;
+  pthread_create(&consumer, NULL, wake_consumer, &b);
+
+  Package pkg = {.id = 0, .type = PKG_A, .weight_g = 1000, .volume_cm3 = 19456};
+  long long wake_ns = 0;
+
+  for (long i = 0; i < WAKE_OPS; ++i) {
+    // Pushed only once the consumer sleeps, the wake-up is what is measured
+    while (__atomic_load_n(&shm->belt_pop_waiters, __ATOMIC_SEQ_CST) == 0) sched_yield();
+
+    pkg.id = (int)i;
+    long long t0 = now_ns();
+    if (belt_push(shm, semid, &pkg) != BELT_OK) {
+      fprintf(stderr, "Warehouse bench: push failed\n");
+      exit(1);
+    }
+    // Yielding so the consumer runs on a single core
+    while (__atomic_load_n(&b.popped, __ATOMIC_ACQUIRE) == i) sched_yield();
+    wake_ns += now_ns() - t0;
+  }
+
+  pthread_join(consumer, NULL);
+  semctl(semid, 0, IPC_RMID);
+  free(shm);
+
+  report_micro("belt_wake_to_pop", WAKE_OPS, wake_ns, first);
+}
+
+// --- End-to-end scenarios ---
+
+/**
+ * @brief Memory cost of a scenario, summed over the Dispatcher and all roles.
+ */
+typedef struct {
+  long minor_faults;    /**< Page faults served without I/O (first touch, page table fills). */
+  long major_faults;    /**< Page faults that needed I/O. */
+  long long dtlb_misses; /**< Data TLB load misses in user space, -1 without hardware counters. */
+} ScenarioCost;
+
+// Data TLB load miss counter of this process and the children it starts from now on, -1 if not available
+static int dtlb_counter_open(void) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.inherit = 1; // Children add their count when they exit
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long long dtlb_counter_close(int fd) {
+  if (fd == -1) return -1;
+
+  long long value = -1;
+  if (read(fd, &value, sizeof(value)) != sizeof(value)) value = -1;
+  close(fd);
+  return value;
+}
+
+// Runs the Dispatcher headless and returns its JSON report line (malloc'd), NULL on failure
+static char *run_dispatcher(const Scenario *sc, long packages, const char *bin_dir, ScenarioCost *cost) {
+  char arg_headless[32], arg_docks[32], arg_batch[32], arg_lookahead[32], arg_workers[32], arg_lanes[32];
+  char arg_n[16], arg_k[16], arg_m[32], arg_w[32], arg_v[32], arg_pin[64];
+
+  snprintf(arg_headless, sizeof(arg_headless), "--headless=%ld", packages);
+  snprintf(arg_docks, sizeof(arg_docks), "--docks=%d", sc->D);
+  snprintf(arg_batch, sizeof(arg_batch), "--batch=%d", sc->B);
+  snprintf(arg_lookahead, sizeof(arg_lookahead), "--lookahead=%d", sc->L);
+  snprintf(arg_workers, sizeof(arg_workers), "--workers=%d", sc->workers);
+  snprintf(arg_lanes, sizeof(arg_lanes), "--lanes=%d", sc->lanes);
+  snprintf(arg_n, sizeof(arg_n), "%d", sc->N);
+  snprintf(arg_k, sizeof(arg_k), "%d", sc->K);
+  snprintf(arg_m, sizeof(arg_m), "%.2f", sc->M);
+  snprintf(arg_w, sizeof(arg_w), "%.2f", sc->W);
+  snprintf(arg_v, sizeof(arg_v), "%.2f", sc->V);
+  snprintf(arg_pin, sizeof(arg_pin), "--pin=%s", sc->pin ? sc->pin : "");
+
+  int fds[2];
+  if (pipe(fds) == -1) {
+    perror("Warehouse bench: pipe error");
+    exit(1);
+  }
+
+  // Children of the Dispatcher are reaped by it and counted with it
+  struct rusage before;
+  getrusage(RUSAGE_CHILDREN, &before);
+  int dtlb = dtlb_counter_open();
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    // Dispatcher output goes to the pipe, its stdin is never read in headless mode
+    int null_fd = open("/dev/null", O_RDONLY);
+    if (null_fd == -1 || dup2(null_fd, STDIN_FILENO) == -1 || dup2(fds[1], STDOUT_FILENO) == -1) {
+      perror("Warehouse bench: dup2 error");
+      exit(1);
+    }
+    close(fds[0]);
+    close(fds[1]);
+
+    if (chdir(bin_dir) == -1) {
+      perror("Warehouse bench: bin dir");
+      exit(1);
+    }
+
+    char *args[20] = {"warehouse_dispatcher", arg_headless, "--no-sleep", "--report=json", "--log-level=error",
+		      arg_docks, arg_batch, arg_lookahead, arg_workers, arg_lanes};
+    int argn = 10;
+    // Modes go before the positional parameters
+    if (sc->threads) args[argn++] = "--threads";
+    if (sc->fleet) args[argn++] = "--fleet";
+    if (sc->mem & SHM_BLOCK_HUGE) args[argn++] = "--huge-pages";
+    if (sc->mem & SHM_BLOCK_LOCK) args[argn++] = "--mlock";
+    if (sc->pin) args[argn++] = arg_pin;
+    args[argn++] = arg_n;
+    args[argn++] = arg_k;
+    args[argn++] = arg_m;
+    args[argn++] = arg_w;
+    args[argn++] = arg_v;
+    execv("./warehouse_dispatcher", args);
+    perror("Warehouse bench: exec dispatcher");
+    exit(1);
+  }
+  else if (pid == -1) {
+    perror("Warehouse bench: fork error");
+    exit(1);
+  }
+  close(fds[1]);
+
+  // Whole output is kept, the report is the line starting with '{'
+  size_t cap = 4096, len = 0;
+  char *buf = malloc(cap);
+  ssize_t r;
+  while (buf && (r = read(fds[0], buf + len, cap - len - 1)) > 0) {
+    len += r;
+    if (cap - len < 512) buf = realloc(buf, cap *= 2);
+  }
+  close(fds[0]);
+  if (!buf) {
+    perror("Warehouse bench: malloc error");
+    exit(1);
+  }
+  buf[len] = '\0';
+
+  int status;
+  waitpid(pid, &status, 0);
+
+  struct rusage after;
+  getrusage(RUSAGE_CHILDREN, &after);
+  cost->minor_faults = after.ru_minflt - before.ru_minflt;
+  cost->major_faults = after.ru_majflt - before.ru_majflt;
+  cost->dtlb_misses = dtlb_counter_close(dtlb);
+
+  char *line = NULL;
+  if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+    for (char *p = buf; p && *p; p = strchr(p, '\n') ? strchr(p, '\n') + 1 : NULL) {
+      if (*p == '{') {
+	size_t n = strcspn(p, "\n");
+	line = strndup(p, n);
+	break;
+      }
+    }
+  }
+
+  if (!line) fprintf(stderr, "Warehouse bench: scenario %s failed, dispatcher output:\n%s\n", sc->name, buf);
+
+  free(buf);
+  return line;
+}
+
+// Throughput of a report line, 0 when missing
+static double packages_per_s(const char *result) {
+  const char *key = result ? strstr(result, "\"packages_per_s\":") : NULL;
+  return key ? strtod(key + strlen("\"packages_per_s\":"), NULL) : 0.0;
+}
+
+static int run_scenarios(long packages, const char *bin_dir) {
+  int count = sizeof(scenarios) / sizeof(scenarios[0]);
+  int failed = 0;
+  double rates[sizeof(scenarios) / sizeof(scenarios[0])];
+
+  for (int i = 0; i < count; ++i) {
+    const Scenario *sc = &scenarios[i];
+    ScenarioCost cost;
+    char *result = run_dispatcher(sc, packages, bin_dir, &cost);
+    if (!result) failed++;
+    rates[i] = packages_per_s(result);
+
+    char dtlb[32] = "null";
+    if (cost.dtlb_misses >= 0) snprintf(dtlb, sizeof(dtlb), "%lld", cost.dtlb_misses);
+
+    // Pinned scenarios name the unpinned run they are measured against
+    char pin[64] = "null", speedup[32] = "null";
+    if (sc->pin) snprintf(pin, sizeof(pin), "\"%s\"", sc->pin);
+    for (int b = 0; sc->baseline && b < i; ++b) {
+      if (strcmp(scenarios[b].name, sc->baseline) == 0 && rates[b] > 0.0 && rates[i] > 0.0) {
+	snprintf(speedup, sizeof(speedup), "%.3f", rates[i] / rates[b]);
+      }
+    }
+
+    printf("%s\n    {\"name\":\"%s\",\"N\":%d,\"K\":%d,\"M\":%.2f,\"W\":%.2f,\"V\":%.2f,\"D\":%d,\"B\":%d,\"L\":%d,"
+	   "\"workers\":%d,\"lanes\":%d,\"fleet\":%d,\"huge_pages\":%d,\"mlock\":%d,\"pin\":%s,\"packages\":%ld,"
+	   "\"minor_faults\":%ld,\"major_faults\":%ld,\"dtlb_misses\":%s,\"baseline\":%s%s%s,"
+	   "\"speedup\":%s,\"result\":%s}",
+	   i ? "," : "", sc->name, sc->N, sc->K, sc->M, sc->W, sc->V, sc->D, sc->B, sc->L,
+	   sc->workers, sc->lanes, sc->fleet, !!(sc->mem & SHM_BLOCK_HUGE), !!(sc->mem & SHM_BLOCK_LOCK), pin, packages,
+	   cost.minor_faults, cost.major_faults, dtlb, sc->baseline ? "\"" : "", sc->baseline ? sc->baseline : "null",
+	   sc->baseline ? "\"" : "", speedup, result ? result : "null");
+    fflush(stdout);
+    free(result);
+  }
+
+  return failed;
+}
+
+int main(int argc, char *argv[]) {
+  int micro = 0, e2e = 0;
+  long packages = DEFAULT_PACKAGES;
+  const char *bin_dir = WAREHOUSE_BIN_DIR;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--micro") == 0) micro = 1;
+    else if (strcmp(argv[i], "--e2e") == 0) e2e = 1;
+    else if (strncmp(argv[i], "--packages=", 11) == 0) packages = atol(argv[i] + 11);
+    else if (strncmp(argv[i], "--bin-dir=", 10) == 0) bin_dir = argv[i] + 10;
+    else {
+      fprintf(stderr, "Usage: %s [--micro] [--e2e] [--packages=<n>] [--bin-dir=<dir>]\n", argv[0]);
+      exit(1);
+    }
+  }
+
+  if (!micro && !e2e) micro = e2e = 1;
+
+  if (packages <= 0) {
+    fprintf(stderr, "Package count must be a positive number\n");
+    exit(1);
+  }
+
+  printf("{\n  \"belt\": \"%s\",\n",
+#ifdef BELT_LOCKFREE
+	 "lockfree"
+#else
+	 "semaphore"
+#endif
+	 );
+
+  printf("  \"micro\": [");
+  if (micro) {
+    int first = 1;
+    micro_sem_op(&first);
+    micro_attach(&first);
+    micro_generate_weight(&first);
+    micro_belt(&first);
+    micro_belt_wake(&first);
+    printf("\n  ");
+  }
+  printf("],\n");
+  fflush(stdout);
+
+  int failed = 0;
+  printf("  \"scenarios\": [");
+  if (e2e) {
+    failed = run_scenarios(packages, bin_dir);
+    printf("\n  ");
+  }
+  printf("]\n}\n");
+
+  return failed ? 1 : 0;
+}
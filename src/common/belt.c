@@ -0,0 +1,634 @@
+#include "belt.h"
+#include "belt_index.h"
+#include "futex_wrapper.h"
+#include "sem_wrapper.h"
+#include "utils.h"
+
+#include <limits.h>
+#include <string.h>
+
+// --- Truck doorbell (shared by both implementations) ---
+//
+// Every push bumps belt_not_empty, the futex syscall is only made when some
+// truck announced that it sleeps (belt_pop_waiters > 0).
+
+static void notify_consumers(SharedState *shm) {
+  __atomic_add_fetch(&shm->belt_not_empty, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&shm->belt_pop_waiters, __ATOMIC_SEQ_CST) > 0) {
+    futex_wake(&shm->belt_not_empty, INT_MAX);
+  }
+}
+
+unsigned int belt_doorbell(SharedState *shm) {
+  return __atomic_load_n(&shm->belt_not_empty, __ATOMIC_SEQ_CST);
+}
+
+void belt_wait_package(SharedState *shm, unsigned int seen) {
+  __atomic_add_fetch(&shm->belt_pop_waiters, 1, __ATOMIC_SEQ_CST);
+  futex_wait(&shm->belt_not_empty, seen);
+  __atomic_sub_fetch(&shm->belt_pop_waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+void belt_wait_package_timeout(SharedState *shm, unsigned int seen, uint64_t timeout_ns) {
+  __atomic_add_fetch(&shm->belt_pop_waiters, 1, __ATOMIC_SEQ_CST);
+  futex_wait_timeout(&shm->belt_not_empty, seen, timeout_ns);
+  __atomic_sub_fetch(&shm->belt_pop_waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+void belt_kick(SharedState *shm) {
+  notify_consumers(shm);
+}
+
+// Smallest lane, batches and lookahead windows must fit into every lane
+static int min_lane_slots(const SharedState *shm) {
+  int lanes = shm->belt_lanes > 0 ? shm->belt_lanes : 1;
+  return shm->max_items_K / lanes;
+}
+
+int belt_batch_size(const SharedState *shm) {
+  int B = shm->batch_B;
+  if (B < 1) B = 1;
+  if (B > MAX_BELT_BATCH) B = MAX_BELT_BATCH;
+  if (B > min_lane_slots(shm)) B = min_lane_slots(shm);
+  return B;
+}
+
+int belt_lookahead(const SharedState *shm) {
+  int L = shm->lookahead_L;
+  if (L < 1) L = 1;
+  if (L > min_lane_slots(shm)) L = min_lane_slots(shm);
+#ifdef BELT_LOCKFREE
+  if (L > MAX_BELT_LOOKAHEAD) L = MAX_BELT_LOOKAHEAD; // Window is scanned slot by slot
+  if (min_lane_slots(shm) < 3) L = 1; // Hole state pos + 2 would equal a free slot (pos + K)
+#endif
+  return L;
+}
+
+int belt_lane_of(const SharedState *shm, int producer) {
+  if (producer < 0) producer = -producer;
+  return producer % shm->belt_lanes;
+}
+
+// Reserves weight of the first packages that fit under limit M with one CAS,
+// returns how many packages got their weight reserved. Lanes share the limit
+static int reserve_weight(SharedState *shm, const Package *pkgs, int n) {
+  int64_t cur = __atomic_load_n(&shm->current_belt_weight, __ATOMIC_RELAXED);
+  int64_t next;
+  int m;
+  do {
+    next = cur;
+    for (m = 0; m < n && next + pkgs[m].weight_g <= shm->max_belt_weight_M; ++m) {
+      next += pkgs[m].weight_g;
+    }
+    if (m == 0) return 0;
+  } while (!__atomic_compare_exchange_n(&shm->current_belt_weight, &cur, next, 1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+  return m;
+}
+
+// Gives back belt weight of packages that left the belt or never got on it
+static void release_weight(SharedState *shm, int64_t w) {
+  __atomic_sub_fetch(&shm->current_belt_weight, w, __ATOMIC_ACQ_REL);
+}
+
+// Reserves `add` of a truck limit with one CAS, fails if it would exceed `limit`
+static int reserve_capacity(int64_t *used, int64_t add, int64_t limit) {
+  int64_t cur = __atomic_load_n(used, __ATOMIC_RELAXED);
+  do {
+    if (cur + add > limit) return 0;
+  } while (!__atomic_compare_exchange_n(used, &cur, cur + add, 1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+  return 1;
+}
+
+int truck_try_load(SharedState *shm, int dock, int64_t w, int64_t v) {
+  DockState *d = &shm->docks[dock];
+
+  if (!reserve_capacity(&d->current_truck_load, w, shm->truck_capacity_W)) return 0;
+  if (!reserve_capacity(&d->current_truck_vol, v, shm->truck_volume_V)) {
+    __atomic_sub_fetch(&d->current_truck_load, w, __ATOMIC_ACQ_REL); // Roll back weight reservation
+    return 0;
+  }
+  return 1;
+}
+
+#ifdef BELT_LOCKFREE
+// Gives back truck capacity reserved for a package another consumer took
+static void truck_unload(SharedState *shm, int dock, int64_t w, int64_t v) {
+  __atomic_sub_fetch(&shm->docks[dock].current_truck_load, w, __ATOMIC_ACQ_REL);
+  __atomic_sub_fetch(&shm->docks[dock].current_truck_vol, v, __ATOMIC_ACQ_REL);
+}
+#endif
+
+BeltStatus belt_push(SharedState *shm, int semid, const Package *pkg) {
+  int pushed;
+  return belt_push_batch(shm, semid, 0, pkg, 1, &pushed);
+}
+
+BeltStatus belt_pop_to_truck(SharedState *shm, int semid, int dock, Package *out) {
+  int popped;
+  return belt_pop_batch_to_truck(shm, semid, dock, out, 1, &popped);
+}
+
+// Splits K slots into the lanes, the first K % lanes lanes get one slot more
+static void init_lanes(SharedState *shm) {
+  int K = shm->max_items_K;
+  int lanes = shm->belt_lanes;
+  if (lanes < 1) lanes = 1;
+  if (lanes > MAX_BELT_LANES) lanes = MAX_BELT_LANES;
+  if (lanes > K) lanes = K;
+  shm->belt_lanes = lanes;
+
+  int first = 0;
+  for (int l = 0; l < lanes; ++l) {
+    BeltLane *lane = &shm->lanes[l];
+    memset(lane, 0, sizeof(*lane));
+    lane->first = first;
+    lane->slots = K / lanes + (l < K % lanes);
+    first += lane->slots;
+  }
+
+  shm->current_count = 0;
+  shm->current_belt_weight = 0;
+  shm->belt_not_empty = 0;
+  shm->belt_pop_waiters = 0;
+}
+
+// Lane the truck at `dock` tries first, the others follow in order
+static int first_lane(SharedState *shm, int dock) {
+  int lanes = shm->belt_lanes;
+
+  if (shm->lane_policy == LANE_ROUND_ROBIN) {
+    // Only the docked truck moves the cursor of its dock
+    return shm->docks[dock].lane_cursor++ % lanes;
+  }
+
+  int best = 0, best_count = -1;
+  for (int l = 0; l < lanes; ++l) {
+    int count = __atomic_load_n(&shm->lanes[l].count, __ATOMIC_RELAXED);
+    if (count > best_count) {
+      best = l;
+      best_count = count;
+    }
+  }
+  return best;
+}
+
+static BeltStatus lane_pop(SharedState *shm, int semid, int lane, int dock, Package *out, int max, int *popped);
+
+BeltStatus belt_pop_batch_to_truck(SharedState *shm, int semid, int dock, Package *out, int max, int *popped) {
+  *popped = 0;
+
+  int lanes = shm->belt_lanes;
+  if (lanes == 1) return lane_pop(shm, semid, 0, dock, out, max, popped);
+
+  // Packages come from a single lane per call, a lane that is empty or whose
+  // packages do not fit passes the truck on to the next one
+  int start = first_lane(shm, dock);
+  int no_fit = 0;
+  for (int i = 0; i < lanes; ++i) {
+    BeltStatus status = lane_pop(shm, semid, (start + i) % lanes, dock, out, max, popped);
+    if (status == BELT_OK) return BELT_OK;
+    if (status == BELT_NO_FIT) no_fit = 1;
+  }
+  return no_fit ? BELT_NO_FIT : BELT_EMPTY;
+}
+
+#ifdef BELT_LOCKFREE
+
+// --- Lock-free bounded MPMC ring per lane ---
+//
+// Every slot carries a sequence number. For a monotonic position `pos`
+// mapped to slot `pos % K` of the lane (K = lane slots):
+// - seq == pos       -> slot is free for the producer holding position pos
+// - seq == pos + 1   -> slot holds a package for the consumer at position pos
+// - seq == pos + K   -> slot was consumed, free for the producer at pos + K
+// A producer/consumer claims its position with a single CAS on tail/head.
+//
+// Sequence numbers live right behind the slot columns of SharedState::belt,
+// lane slots are a contiguous run of every column and of the sequence numbers.
+
+static unsigned long *lane_seq(SharedState *shm, const BeltLane *lane) {
+  return (unsigned long *)belt_slot_meta(shm) + lane->first;
+}
+
+// Claims a run of up to n free slots with one CAS on tail and fills it,
+// returns number of packages pushed (0 if lane is full)
+static int ring_try_push(SharedState *shm, BeltLane *lane, const Package *pkgs, int n, uint64_t now) {
+  unsigned long K = (unsigned long)lane->slots;
+  unsigned long *seqs = lane_seq(shm, lane);
+  BeltSlots belt = belt_slots_at(belt_slots(shm), lane->first);
+  unsigned long pos = __atomic_load_n(&lane->tail, __ATOMIC_RELAXED);
+
+  while (1) {
+    // Count free slots in a row from pos
+    int m = 0;
+    long diff = 0;
+    while (m < n) {
+      diff = (long)(__atomic_load_n(&seqs[(pos + m) % K], __ATOMIC_ACQUIRE) - (pos + m));
+      if (diff != 0) break;
+      m++;
+    }
+
+    if (m > 0) {
+      // Slots free, try to claim positions pos..pos+m-1
+      if (__atomic_compare_exchange_n(&lane->tail, &pos, pos + m, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	for (int i = 0; i < m; ++i) {
+	  belt_slot_put(&belt, (int)((pos + i) % K), &pkgs[i], now);
+	  __atomic_store_n(&seqs[(pos + i) % K], pos + i + 1, __ATOMIC_RELEASE); // Publish package
+	}
+	return m;
+      }
+      // CAS failure reloaded pos, retry
+    }
+    else if (diff < 0) {
+      return 0; // Slot still holds previous lap package, lane full
+    }
+    else {
+      pos = __atomic_load_n(&lane->tail, __ATOMIC_RELAXED); // Other producer moved on
+    }
+  }
+}
+
+void belt_init(SharedState *shm) {
+  init_lanes(shm);
+
+  for (int l = 0; l < shm->belt_lanes; ++l) {
+    BeltLane *lane = &shm->lanes[l];
+    unsigned long *seqs = lane_seq(shm, lane);
+    for (int i = 0; i < lane->slots; ++i) {
+      seqs[i] = (unsigned long)i;
+    }
+  }
+  shm->belt_not_full = 0;
+  shm->belt_push_waiters = 0;
+}
+
+BeltStatus belt_push_batch(SharedState *shm, int semid, int lane_id, const Package *pkgs, int n, int *pushed) {
+  (void)semid;
+  *pushed = 0;
+
+  if (__atomic_load_n(&shm->shutdown, __ATOMIC_RELAXED)) return BELT_SHUTDOWN;
+
+  BeltLane *lane = &shm->lanes[lane_id % shm->belt_lanes];
+  if (n > lane->slots) n = lane->slots;
+
+  // Weight is reserved before the slots, so M is never exceeded
+  int m = reserve_weight(shm, pkgs, n);
+  if (m == 0) return BELT_OVERWEIGHT;
+
+  int done = 0;
+  while (done < m) {
+    // Dwell time on the belt starts here
+    uint64_t now = monotonic_ns();
+    int k = ring_try_push(shm, lane, pkgs + done, m - done, now);
+
+    if (k == 0) {
+      // Lane full, announce ourselves and sleep until a truck frees a slot
+      unsigned int ev = __atomic_load_n(&shm->belt_not_full, __ATOMIC_SEQ_CST);
+      __atomic_add_fetch(&shm->belt_push_waiters, 1, __ATOMIC_SEQ_CST);
+
+      k = ring_try_push(shm, lane, pkgs + done, m - done, now);
+
+      if (k == 0 && __atomic_load_n(&shm->shutdown, __ATOMIC_RELAXED)) {
+	__atomic_sub_fetch(&shm->belt_push_waiters, 1, __ATOMIC_SEQ_CST);
+	// Give back weight of packages that did not make it onto the belt
+	release_weight(shm, package_weight_sum(pkgs + done, m - done));
+	*pushed = done;
+	return BELT_SHUTDOWN;
+      }
+
+      if (k == 0) futex_wait(&shm->belt_not_full, ev);
+      __atomic_sub_fetch(&shm->belt_push_waiters, 1, __ATOMIC_SEQ_CST);
+    }
+
+    if (k > 0) {
+      done += k;
+      __atomic_add_fetch(&lane->count, k, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&shm->current_count, k, __ATOMIC_RELEASE);
+      notify_consumers(shm);
+    }
+  }
+
+  *pushed = m;
+  return m == n ? BELT_OK : BELT_OVERWEIGHT;
+}
+
+void belt_release_producers(SharedState *shm, int semid, int producers) {
+  (void)semid;
+  (void)producers;
+  __atomic_add_fetch(&shm->belt_not_full, 1, __ATOMIC_SEQ_CST);
+  futex_wake(&shm->belt_not_full, INT_MAX);
+}
+
+// Wakes producers sleeping on a full lane, kernel is only entered if some
+// producer is actually sleeping
+static void notify_producers(SharedState *shm) {
+  if (__atomic_load_n(&shm->belt_push_waiters, __ATOMIC_SEQ_CST) > 0) {
+    __atomic_add_fetch(&shm->belt_not_full, 1, __ATOMIC_SEQ_CST);
+    futex_wake(&shm->belt_not_full, INT_MAX);
+  }
+}
+
+// Lookahead pop. A package is claimed anywhere in the window with a CAS on its
+// slot (seq pos + 1 -> pos + 2, a hole), head stays where it is. Whoever moves
+// head over a hole hands the slot to the next lap producer (seq pos + K).
+static BeltStatus ring_pop_lookahead(SharedState *shm, BeltLane *lane, int dock, Package *out, int max, int L, int *popped) {
+  unsigned long K = (unsigned long)lane->slots;
+  unsigned long *seqs = lane_seq(shm, lane);
+  BeltSlots belt = belt_slots_at(belt_slots(shm), lane->first);
+  DockState *d = &shm->docks[dock];
+  int m = 0;
+  int seen = 0; // A package was in the window, but did not fit
+  int64_t w = 0;
+
+  while (m < max) {
+    unsigned long pos = __atomic_load_n(&lane->head, __ATOMIC_ACQUIRE);
+    unsigned long best = 0;
+    int found = 0, stale = 0;
+    int best_w = 0;
+    Package pkg;
+    int64_t load = __atomic_load_n(&d->current_truck_load, __ATOMIC_RELAXED);
+    int64_t vol = __atomic_load_n(&d->current_truck_vol, __ATOMIC_RELAXED);
+
+    for (int i = 0; i < L; ++i) {
+      unsigned long p = pos + i;
+      long diff = (long)(__atomic_load_n(&seqs[p % K], __ATOMIC_ACQUIRE) - (p + 1));
+      if (diff == 1) continue;   // Hole
+      if (diff < 0) break;       // Not published yet, end of the lane
+      if (diff > 1) {            // Head moved on and the slot was reused
+	stale = 1;
+	break;
+      }
+
+      // Only the weight and volume columns are read while scanning
+      int w_p = belt.weight_g[p % K];
+      seen = 1;
+      if (load + w_p > shm->truck_capacity_W || vol + belt.volume_cm3[p % K] > shm->truck_volume_V) continue;
+      if (!found || w_p > best_w) {
+	best_w = w_p;
+	best = p;
+	found = 1;
+      }
+    }
+
+    if (stale) continue;
+    if (!found) break;
+
+    // Copied before the claim, a failed CAS below means the copy may be torn
+    belt_slot_get(&belt, (int)(best % K), &pkg);
+
+    // Capacity first, P4 may load into the same truck meanwhile
+    if (!truck_try_load(shm, dock, pkg.weight_g, pkg.volume_cm3)) continue;
+
+    unsigned long expected = best + 1;
+    if (!__atomic_compare_exchange_n(&seqs[best % K], &expected, best + 2, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+      // Another truck was faster or the slot was reused, pick again
+      truck_unload(shm, dock, pkg.weight_g, pkg.volume_cm3);
+      continue;
+    }
+    out[m++] = pkg;
+    w += pkg.weight_g;
+
+    // Moving head over holes
+    int freed = 0;
+    unsigned long h = __atomic_load_n(&lane->head, __ATOMIC_ACQUIRE);
+    while (__atomic_load_n(&seqs[h % K], __ATOMIC_ACQUIRE) == h + 2) {
+      if (__atomic_compare_exchange_n(&lane->head, &h, h + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+	__atomic_store_n(&seqs[h % K], h + K, __ATOMIC_RELEASE); // Hand slot to next lap producer
+	h++;
+	freed++;
+      }
+      // CAS failure reloaded h
+    }
+
+    __atomic_sub_fetch(&lane->count, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&shm->current_count, 1, __ATOMIC_RELEASE);
+    if (freed > 0) notify_producers(shm);
+  }
+
+  release_weight(shm, w);
+
+  *popped = m;
+  if (m > 0) return BELT_OK;
+  return seen ? BELT_NO_FIT : BELT_EMPTY;
+}
+
+static BeltStatus lane_pop(SharedState *shm, int semid, int lane_id, int dock, Package *out, int max, int *popped) {
+  (void)semid;
+  *popped = 0;
+
+  BeltLane *lane = &shm->lanes[lane_id];
+  int L = belt_lookahead(shm);
+  if (L > 1) return ring_pop_lookahead(shm, lane, dock, out, max, L, popped);
+
+  unsigned long K = (unsigned long)lane->slots;
+  unsigned long *seqs = lane_seq(shm, lane);
+  BeltSlots belt = belt_slots_at(belt_slots(shm), lane->first);
+  unsigned long pos = __atomic_load_n(&lane->head, __ATOMIC_RELAXED);
+  int m;
+  int64_t w, v;
+
+  while (1) {
+    // Peek & Check packages in a row. Capacity is reserved before the packages
+    // are claimed and given back if another consumer wins the CAS
+    int no_fit = 0;
+    long diff = 0;
+    m = 0;
+    w = 0;
+    v = 0;
+
+    while (m < max) {
+      diff = (long)(__atomic_load_n(&seqs[(pos + m) % K], __ATOMIC_ACQUIRE) - (pos + m + 1));
+      if (diff != 0) break;
+
+      int slot = (int)((pos + m) % K);
+      if (!truck_try_load(shm, dock, belt.weight_g[slot], belt.volume_cm3[slot])) {
+	no_fit = 1;
+	break;
+      }
+      belt_slot_get(&belt, slot, &out[m]);
+      w += out[m].weight_g;
+      v += out[m].volume_cm3;
+      m++;
+    }
+
+    if (m > 0) {
+      if (__atomic_compare_exchange_n(&lane->head, &pos, pos + m, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	for (int i = 0; i < m; ++i) {
+	  __atomic_store_n(&seqs[(pos + i) % K], pos + i + K, __ATOMIC_RELEASE); // Hand slot to next lap producer
+	}
+	break;
+      }
+
+      truck_unload(shm, dock, w, v);
+    }
+    else if (no_fit) {
+      return BELT_NO_FIT;
+    }
+    else if (diff < 0) {
+      return BELT_EMPTY;
+    }
+    else {
+      pos = __atomic_load_n(&lane->head, __ATOMIC_RELAXED);
+    }
+  }
+
+  __atomic_sub_fetch(&lane->count, m, __ATOMIC_RELAXED);
+  __atomic_sub_fetch(&shm->current_count, m, __ATOMIC_RELEASE);
+  release_weight(shm, w);
+
+  notify_producers(shm);
+
+  *popped = m;
+  return BELT_OK;
+}
+
+#else // Semaphore based belt
+
+// Bucket links of the belt index live right behind the slot columns of SharedState::belt
+static BeltIndexLink *lane_links(SharedState *shm, const BeltLane *lane) {
+  return (BeltIndexLink *)belt_slot_meta(shm) + lane->first;
+}
+
+void belt_init(SharedState *shm) {
+  init_lanes(shm);
+
+  for (int l = 0; l < shm->belt_lanes; ++l) {
+    belt_index_init(&shm->lanes[l].index);
+  }
+}
+
+BeltStatus belt_push_batch(SharedState *shm, int semid, int lane_id, const Package *pkgs, int n, int *pushed) {
+  lane_id %= shm->belt_lanes;
+  BeltLane *lane = &shm->lanes[lane_id];
+  BeltSlots belt = belt_slots_at(belt_slots(shm), lane->first);
+  int K = lane->slots;
+  *pushed = 0;
+
+  if (n > K) n = K;
+
+  // Wating for space in the lane, whole batch is reserved with a single semop
+  sem_count_op(semid, belt_lane_sem(lane_id, SEM_EMPTY), -n);
+
+  // Dwell time on the belt starts here, clock is read outside the critical section
+  uint64_t now = monotonic_ns();
+
+  // Critical section of the lane
+  SEM_P(semid, belt_lane_sem(lane_id, SEM_MUTEX));
+
+  if (shm->shutdown) {
+    SEM_V(semid, belt_lane_sem(lane_id, SEM_MUTEX));
+    return BELT_SHUTDOWN;
+  }
+
+  // Checking weight limit shared by all lanes, first package over M ends the batch
+  int m = reserve_weight(shm, pkgs, n);
+
+  // Placing packages in the lane as one contiguous run of every column, wrapping at the end of the ring
+  for (int i = 0; i < m; ++i) {
+    int slot = (lane->tail + i) % K;
+    belt_slot_put(&belt, slot, &pkgs[i], now);
+    belt_index_insert(&lane->index, lane_links(shm, lane), &belt, slot);
+  }
+  lane->tail = (lane->tail + m) % K;
+  __atomic_add_fetch(&lane->count, m, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&shm->current_count, m, __ATOMIC_RELAXED);
+
+  // Unlock access
+  SEM_V(semid, belt_lane_sem(lane_id, SEM_MUTEX));
+
+  // Cannot place rest of the batch, releasing its slots
+  if (m < n) sem_count_op(semid, belt_lane_sem(lane_id, SEM_EMPTY), n - m);
+
+  if (m > 0) {
+    sem_count_op(semid, belt_lane_sem(lane_id, SEM_FULL), m);
+    notify_consumers(shm);
+  }
+
+  *pushed = m;
+  return m == n ? BELT_OK : BELT_OVERWEIGHT;
+}
+
+void belt_release_producers(SharedState *shm, int semid, int producers) {
+  // A blocked worker waits for at most a whole batch, in any lane
+  for (int l = 0; l < shm->belt_lanes; ++l) {
+    sem_count_op(semid, belt_lane_sem(l, SEM_EMPTY), producers * MAX_BELT_BATCH);
+  }
+}
+
+static BeltStatus lane_pop(SharedState *shm, int semid, int lane_id, int dock, Package *out, int max, int *popped) {
+  BeltLane *lane = &shm->lanes[lane_id];
+  BeltSlots belt = belt_slots_at(belt_slots(shm), lane->first);
+  int sem_full = belt_lane_sem(lane_id, SEM_FULL);
+  *popped = 0;
+
+  // Non-blocking reservation of up to max packages with a single semop, caller
+  // sleeps on the doorbell if belt is empty. Another truck may take some of the
+  // counted packages first, then the reservation is retried with a fresh count
+  int n = 1;
+  while (1) {
+    if (max > 1) {
+      n = sem_get(semid, sem_full);
+      if (n > max) n = max;
+      if (n < 1) n = 1;
+    }
+    if (sem_count_try(semid, sem_full, -n)) break;
+    if (n == 1) return BELT_EMPTY;
+  }
+
+  // Packages Available
+  SEM_P(semid, belt_lane_sem(lane_id, SEM_MUTEX));
+
+  // Peek & Check the head package (L = 1), or ask the index for the best
+  // fitting package of the first L slots. Loading stops when none fits
+  DockState *d = &shm->docks[dock];
+  int K = lane->slots;
+  int L = belt_lookahead(shm);
+  int m = 0;
+  int freed = 0;
+  int64_t weight = 0;
+  while (m < n) {
+    int64_t load = __atomic_load_n(&d->current_truck_load, __ATOMIC_RELAXED);
+    int64_t vol = __atomic_load_n(&d->current_truck_vol, __ATOMIC_RELAXED);
+
+    int slot = lane->head;
+    if (L > 1) {
+      slot = belt_index_best_fit(&lane->index, &belt, K, lane->head, L, load, vol,
+				 shm->truck_capacity_W, shm->truck_volume_V);
+    }
+    else if (load + belt.weight_g[slot] > shm->truck_capacity_W ||
+	     vol + belt.volume_cm3[slot] > shm->truck_volume_V) {
+      slot = -1;
+    }
+
+    // Reached Truck Load Limits Check (P4 may have loaded meanwhile)
+    if (slot == -1 || !truck_try_load(shm, dock, belt.weight_g[slot], belt.volume_cm3[slot])) break;
+
+    belt_slot_get(&belt, slot, &out[m]);
+    weight += out[m++].weight_g;
+
+    belt_index_remove(&lane->index, lane_links(shm, lane), &belt, slot);
+    belt.type[slot] = BELT_HOLE;
+    lane->holes++;
+
+    // Moving head over holes, slots behind it are free again
+    while (lane->holes > 0 && belt.type[lane->head] == BELT_HOLE) {
+      lane->head = (lane->head + 1) % K;
+      lane->holes--;
+      freed++;
+    }
+  }
+
+  __atomic_sub_fetch(&lane->count, m, __ATOMIC_RELAXED);
+  __atomic_sub_fetch(&shm->current_count, m, __ATOMIC_RELAXED);
+  release_weight(shm, weight);
+
+  SEM_V(semid, belt_lane_sem(lane_id, SEM_MUTEX));
+
+  if (m < n) sem_count_op(semid, sem_full, n - m); // Packages not loaded are still on belt
+  if (freed > 0) sem_count_op(semid, belt_lane_sem(lane_id, SEM_EMPTY), freed);
+
+  *popped = m;
+  return m > 0 ? BELT_OK : BELT_NO_FIT;
+}
+
+#endif // BELT_LOCKFREE
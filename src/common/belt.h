@@ -0,0 +1,262 @@
+#ifndef BELT_H
+#define BELT_H
+
+#include "common.h"
+
+/**
+ * @file belt.h
+ * @brief Conveyor belt (circular buffer) push/pop operations.
+ *
+ * All access to @ref SharedState::belt goes through this interface, so workers
+ * and trucks do not depend on how the belt is synchronized.
+ *
+ * Two implementations are available, selected at build time:
+ * - **Default:** The classic Producer-Consumer scheme guarded by @ref SEM_MUTEX,
+ * with @ref SEM_EMPTY / @ref SEM_FULL counting free and occupied slots.
+ * - **BELT_LOCKFREE:** A bounded multi-producer/multi-consumer ring with per-slot
+ * sequence numbers. Push and pop are a single CAS on `tail` / `head`; producers
+ * fall back to a futex sleep only when the ring is actually full.
+ * Enable with `cmake .. -DBELT_LOCKFREE=ON`.
+ *
+ * Both variants enforce the same rules: at most K packages (capacity limit) and
+ * at most M kg (weight limit) on the belt at any time.
+ *
+ * Packages can be moved in batches (@ref belt_push_batch,
+ * @ref belt_pop_batch_to_truck). A batch costs the same synchronization as a
+ * single package: one reservation of B slots and one critical section that
+ * copies a contiguous run of the ring and updates the counters once.
+ *
+ * **Lookahead loading** (@ref SharedState::lookahead_L, `--lookahead`): instead
+ * of the head package only, a truck inspects the first L slots and takes the
+ * heaviest package that still fits (best fit), so small packages behind a big
+ * one fill the truck instead of sending it away half empty. Packages taken out
+ * of order leave holes in the ring, nothing is shifted. The head skips holes
+ * when it reaches them, and only then the slots return to the producers:
+ * - **Default:** Every push and pop also updates the belt index
+ * (belt_index.h), which finds the best fit with a few bit scans, so the time
+ * @ref SEM_MUTEX is held does not grow with L or K. The slot is marked with
+ * @ref BELT_HOLE.
+ * - **BELT_LOCKFREE:** A third sequence state (`seq == pos + 2`) is claimed
+ * with a CAS on the slot, whoever moves `head` over it hands it to producers.
+ *
+ * **Belt lanes** (@ref SharedState::belt_lanes, `--lanes`): the K slots are
+ * split into independent lanes (@ref BeltLane), each one a ring of its own with
+ * its own semaphores (@ref belt_lane_sem) or its own `head` / `tail`. Workers
+ * push to the lane picked by @ref belt_lane_of, so producers of different lanes
+ * never contend. A truck drains one lane per call, starting with the fullest
+ * lane or the next one in round-robin order (@ref SharedState::lane_policy) and
+ * moving on when a lane is empty or its packages do not fit. Capacity K is
+ * enforced per lane, weight limit M stays global. Package order is kept within
+ * a lane only.
+ */
+
+/**
+ * @brief Package type marking a slot emptied out of order by lookahead loading.
+ */
+#define BELT_HOLE PKG_END
+
+/**
+ * @brief Result codes of belt operations.
+ */
+typedef enum {
+  BELT_OK,         /**< Package was pushed / popped. */
+  BELT_OVERWEIGHT, /**< Push rejected, package would exceed max belt weight M. */
+  BELT_EMPTY,      /**< Pop found no package on the belt. */
+  BELT_NO_FIT,     /**< Head package does not fit into the remaining truck capacity. */
+  BELT_SHUTDOWN    /**< Simulation shutdown was requested. */
+} BeltStatus;
+
+/**
+ * @brief Resets belt indices and counters.
+ *
+ * Must be called once after @ref SharedState::max_items_K is set and before any
+ * process starts pushing or popping.
+ *
+ * @param shm Pointer to the attached SharedState structure.
+ */
+void belt_init(SharedState *shm);
+
+/**
+ * @brief Places a package at the tail of lane 0.
+ *
+ * Blocks while the lane is full. Rejects the package without
+ * blocking if it would exceed the belt weight limit M.
+ *
+ * @param shm   Pointer to the attached SharedState structure.
+ * @param semid The semaphore set identifier.
+ * @param pkg   Package to place on the belt.
+ * @return BELT_OK, BELT_OVERWEIGHT or BELT_SHUTDOWN.
+ */
+BeltStatus belt_push(SharedState *shm, int semid, const Package *pkg);
+
+/**
+ * @brief Places up to n packages at the tail of a belt lane in one operation.
+ *
+ * Packages are placed in order. Blocks until there is room for the whole batch
+ * (semaphore belt: one `semop` of -n on the lane's @ref SEM_EMPTY) or until at
+ * least one slot is free (BELT_LOCKFREE, the rest is pushed as slots get free).
+ * The first package that would exceed the belt weight limit M ends the batch,
+ * it and all following packages are not placed. At most the lane's number of
+ * slots is taken.
+ *
+ * @param shm    Pointer to the attached SharedState structure.
+ * @param semid  The semaphore set identifier.
+ * @param lane   Lane to push to, usually @ref belt_lane_of the worker.
+ * @param pkgs   Packages to place on the belt.
+ * @param n      Number of packages in `pkgs`.
+ * @param pushed Receives the number of packages placed on the belt.
+ * @return BELT_OK if all packages were placed, BELT_OVERWEIGHT or BELT_SHUTDOWN.
+ */
+BeltStatus belt_push_batch(SharedState *shm, int semid, int lane, const Package *pkgs, int n, int *pushed);
+
+/**
+ * @brief Lane a producer pushes to.
+ *
+ * Producers are spread evenly, producer `i` uses lane `i % lanes`.
+ *
+ * @param shm      Pointer to the attached SharedState structure.
+ * @param producer Producer number (worker ID - 1).
+ * @return Lane index 0..@ref SharedState::belt_lanes - 1.
+ */
+int belt_lane_of(const SharedState *shm, int producer);
+
+/**
+ * @brief Moves the head package into the truck docked at `dock` if it fits.
+ *
+ * Never blocks, use @ref belt_wait_package to sleep on an empty belt.
+ * "Peek & Check": the head package is compared with the remaining truck
+ * capacity (@ref SharedState::truck_capacity_W, @ref SharedState::truck_volume_V).
+ * If it fits, it is removed from the belt and added to the dock's
+ * @ref DockState::current_truck_load / @ref DockState::current_truck_vol in
+ * the same step. Otherwise it stays on the belt and BELT_NO_FIT is returned.
+ * Trucks at different docks may call it concurrently.
+ *
+ * @param shm   Pointer to the attached SharedState structure.
+ * @param semid The semaphore set identifier.
+ * @param dock  Index of the dock the truck occupies.
+ * @param out   Receives the loaded package on BELT_OK.
+ * @return BELT_OK, BELT_EMPTY or BELT_NO_FIT.
+ */
+BeltStatus belt_pop_to_truck(SharedState *shm, int semid, int dock, Package *out);
+
+/**
+ * @brief Moves up to `max` head packages into the truck docked at `dock`.
+ *
+ * Batch variant of @ref belt_pop_to_truck, never blocks. Packages are checked
+ * in belt order, loading stops at the first one that does not fit into the
+ * truck or when the belt runs empty. With lookahead (@ref belt_lookahead > 1)
+ * every pick takes the best fitting package of the first L slots, loading
+ * stops when none of them fits. With several lanes the packages come from the
+ * first lane (in @ref SharedState::lane_policy order) that has one that fits.
+ *
+ * @param shm    Pointer to the attached SharedState structure.
+ * @param semid  The semaphore set identifier.
+ * @param dock   Index of the dock the truck occupies.
+ * @param out    Receives the loaded packages, room for `max` packages.
+ * @param max    Largest number of packages to load.
+ * @param popped Receives the number of loaded packages.
+ * @return BELT_OK (at least one package loaded), BELT_EMPTY (every lane empty)
+ * or BELT_NO_FIT.
+ */
+BeltStatus belt_pop_batch_to_truck(SharedState *shm, int semid, int dock, Package *out, int max, int *popped);
+
+/**
+ * @brief Batch size B used by workers and trucks.
+ *
+ * Reads @ref SharedState::batch_B set by the Dispatcher (`--batch`). Returns 1
+ * when it is not set and never more than the slots of a lane or
+ * @ref MAX_BELT_BATCH.
+ *
+ * @param shm Pointer to the attached SharedState structure.
+ * @return Batch size (1 means package by package).
+ */
+int belt_batch_size(const SharedState *shm);
+
+/**
+ * @brief Lookahead window L used by truck loading.
+ *
+ * @ref SharedState::lookahead_L limited to the slots of a lane, the window is
+ * per lane. The lock-free ring scans the window slot by slot and limits it to
+ * @ref MAX_BELT_LOOKAHEAD, it also needs 3 slots per lane to tell holes from
+ * free slots, below that loading is head-only.
+ *
+ * @param shm Pointer to the attached SharedState structure.
+ * @return Slots inspected per pick (1 means head only).
+ */
+int belt_lookahead(const SharedState *shm);
+
+/**
+ * @brief Reads the belt doorbell.
+ *
+ * The value must be read **before** checking wake conditions (forced departure,
+ * shutdown, empty belt) and passed to @ref belt_wait_package afterwards, so a
+ * package or wake request arriving in between is never missed.
+ *
+ * @param shm Pointer to the attached SharedState structure.
+ * @return Current doorbell value.
+ */
+unsigned int belt_doorbell(SharedState *shm);
+
+/**
+ * @brief Sleeps until a package is pushed or trucks are kicked.
+ *
+ * Blocks in the kernel (futex) with zero CPU usage. Returns immediately if the
+ * doorbell changed since `seen` was read. Also returns early when the process
+ * is interrupted by a signal, so the caller must re-check its state in a loop.
+ *
+ * @param shm  Pointer to the attached SharedState structure.
+ * @param seen Doorbell value returned by @ref belt_doorbell.
+ */
+void belt_wait_package(SharedState *shm, unsigned int seen);
+
+/**
+ * @brief @ref belt_wait_package that also returns after a timeout.
+ *
+ * Used by consumers that have timers to serve as well (@ref fleet_run).
+ *
+ * @param shm        Pointer to the attached SharedState structure.
+ * @param seen       Doorbell value returned by @ref belt_doorbell.
+ * @param timeout_ns Longest sleep in nanoseconds.
+ */
+void belt_wait_package_timeout(SharedState *shm, unsigned int seen, uint64_t timeout_ns);
+
+/**
+ * @brief Wakes all trucks sleeping in @ref belt_wait_package.
+ *
+ * Used by the Dispatcher for forced departure and shutdown, when trucks must
+ * re-check their state even though no package arrived.
+ *
+ * @param shm Pointer to the attached SharedState structure.
+ */
+void belt_kick(SharedState *shm);
+
+/**
+ * @brief Wakes workers blocked in @ref belt_push_batch after shutdown was set.
+ *
+ * In process mode workers are simply terminated with SIGTERM. Threads must
+ * return on their own (`--threads`), so the Dispatcher gives every one of them
+ * enough free slots in every lane (semaphore belt) or rings the producer futex (lock-free
+ * belt). They find @ref SharedState::shutdown set and return @ref BELT_SHUTDOWN.
+ *
+ * @param shm       Pointer to the attached SharedState structure.
+ * @param semid     Semaphore set ID.
+ * @param producers Number of workers that may be blocked.
+ */
+void belt_release_producers(SharedState *shm, int semid, int producers);
+
+/**
+ * @brief Adds a package directly to the truck docked at `dock` if it fits.
+ *
+ * Used by the Express Worker, which bypasses the belt. The capacity is reserved
+ * atomically, trucks popping from different lanes and the Express Worker may
+ * load into the same truck concurrently.
+ *
+ * @param shm  Pointer to the attached SharedState structure.
+ * @param dock Index of the dock.
+ * @param w    Package weight (g).
+ * @param v    Package volume (cm3).
+ * @return 1 if the package was loaded, 0 if truck limits would be exceeded.
+ */
+int truck_try_load(SharedState *shm, int dock, int64_t w, int64_t v);
+
+#endif // BELT_H
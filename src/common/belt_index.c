@@ -0,0 +1,79 @@
+#include "belt_index.h"
+
+int belt_index_class(int64_t weight_g) {
+  if (weight_g <= 0) return 0;
+
+  int64_t c = weight_g / BELT_INDEX_CLASS_G;
+  return c < BELT_INDEX_CLASSES - 1 ? (int)c : BELT_INDEX_CLASSES - 1;
+}
+
+void belt_index_init(BeltIndex *idx) {
+  for (int t = 0; t < PKG_END; ++t) {
+    idx->occupied[t] = 0;
+    for (int c = 0; c < BELT_INDEX_CLASSES; ++c) {
+      idx->first[t][c] = -1;
+      idx->last[t][c] = -1;
+    }
+  }
+}
+
+void belt_index_insert(BeltIndex *idx, BeltIndexLink *links, const BeltSlots *belt, int slot) {
+  int t = belt->type[slot];
+  int c = belt_index_class(belt->weight_g[slot]);
+  int last = idx->last[t][c];
+
+  links[slot].prev = last;
+  links[slot].next = -1;
+  if (last == -1) idx->first[t][c] = slot;
+  else links[last].next = slot;
+  idx->last[t][c] = slot;
+
+  idx->occupied[t] |= 1ULL << c;
+}
+
+void belt_index_remove(BeltIndex *idx, BeltIndexLink *links, const BeltSlots *belt, int slot) {
+  int t = belt->type[slot];
+  int c = belt_index_class(belt->weight_g[slot]);
+  int prev = links[slot].prev;
+  int next = links[slot].next;
+
+  if (prev == -1) idx->first[t][c] = next;
+  else links[prev].next = next;
+  if (next == -1) idx->last[t][c] = prev;
+  else links[next].prev = prev;
+
+  if (idx->first[t][c] == -1) idx->occupied[t] &= ~(1ULL << c);
+}
+
+int belt_index_best_fit(const BeltIndex *idx, const BeltSlots *belt, int K, int head, int L,
+			int64_t load, int64_t vol, int64_t W, int64_t V) {
+  if (load > W) return -1;
+
+  // Classes above the remaining capacity hold no package that fits
+  int top = belt_index_class(W - load);
+  uint64_t mask = top == BELT_INDEX_CLASSES - 1 ? ~0ULL : (1ULL << (top + 1)) - 1;
+
+  int best = -1, best_dist = 0;
+  for (int t = 0; t < PKG_END; ++t) {
+    uint64_t bits = idx->occupied[t] & mask;
+
+    // Heaviest class first. The oldest package of a class is the first one to
+    // enter the window, younger ones are outside too when it is
+    while (bits) {
+      int c = 63 - __builtin_clzll(bits);
+      bits &= ~(1ULL << c);
+
+      int slot = idx->first[t][c];
+      int dist = (slot - head + K) % K;
+      int w = belt->weight_g[slot];
+      if (dist >= L || load + w > W || vol + belt->volume_cm3[slot] > V) continue;
+
+      if (best == -1 || w > belt->weight_g[best] || (w == belt->weight_g[best] && dist < best_dist)) {
+	best = slot;
+	best_dist = dist;
+      }
+      break;
+    }
+  }
+  return best;
+}
@@ -0,0 +1,88 @@
+#ifndef BELT_INDEX_H
+#define BELT_INDEX_H
+
+#include "common.h"
+
+/**
+ * @file belt_index.h
+ * @brief Weight-bucketed index over the belt for constant time fit queries.
+ *
+ * Every package on the belt sits in the bucket of its type and weight class
+ * (@ref BELT_INDEX_CLASS_G wide). Buckets are doubly linked lists of belt
+ * slots in belt order, so insert and remove are O(1) and a bucket's first slot
+ * is its oldest package. A 64-bit occupancy word per type marks the non-empty
+ * classes.
+ *
+ * A fit query masks off the classes above the remaining truck capacity and
+ * takes the highest set bit, per type a couple of bit scans independent of K.
+ * The oldest package of the heaviest class that fits wins, so the pick is the
+ * heaviest package that fits within one weight class.
+ *
+ * The index holds no pointers, it works in shared memory attached at any
+ * address and in private memory (virtual-time mode) alike. Queries read only
+ * the weight and volume columns of the belt (@ref BeltSlots). It is not
+ * synchronized, the semaphore belt updates it under @ref SEM_MUTEX.
+ */
+
+/**
+ * @brief Weight class of a package.
+ *
+ * @param weight_g Package weight in grams.
+ * @return Class 0..@ref BELT_INDEX_CLASSES - 1.
+ */
+int belt_index_class(int64_t weight_g);
+
+/**
+ * @brief Empties the index.
+ *
+ * @param idx Index.
+ */
+void belt_index_init(BeltIndex *idx);
+
+/**
+ * @brief Adds the package in a belt slot, as youngest of its bucket.
+ *
+ * Slots must be inserted in belt order.
+ *
+ * @param idx   Index.
+ * @param links Bucket links, one per belt slot.
+ * @param belt  Belt columns.
+ * @param slot  Slot of the new package.
+ */
+void belt_index_insert(BeltIndex *idx, BeltIndexLink *links, const BeltSlots *belt, int slot);
+
+/**
+ * @brief Removes the package in a belt slot.
+ *
+ * Must be called while the slot still holds the package (type and weight).
+ *
+ * @param idx   Index.
+ * @param links Bucket links, one per belt slot.
+ * @param belt  Belt columns.
+ * @param slot  Slot of the package.
+ */
+void belt_index_remove(BeltIndex *idx, BeltIndexLink *links, const BeltSlots *belt, int slot);
+
+/**
+ * @brief Heaviest package that fits into a truck, within a lookahead window.
+ *
+ * Only packages in the first L slots from `head` are considered. Per type the
+ * classes are tried from the heaviest one that can fit downwards, the oldest
+ * package of a class stands for it. Among types the heavier package wins, the
+ * one closer to the head on a tie.
+ *
+ * @param idx  Index.
+ * @param belt Belt columns.
+ * @param K    Number of belt slots.
+ * @param head Slot of the belt head.
+ * @param L    Window size in slots.
+ * @param load Current truck load (g).
+ * @param vol  Current truck volume (cm3).
+ * @param W    Truck weight capacity (g).
+ * @param V    Truck volume capacity (cm3).
+ * @return Slot of the chosen package, -1 if none fits.
+ */
+int belt_index_best_fit(const BeltIndex *idx, const BeltSlots *belt, int K, int head, int L,
+			int64_t load, int64_t vol, int64_t W, int64_t V);
+
+#endif // BELT_INDEX_H
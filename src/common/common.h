@@ -2,6 +2,8 @@
 #define COMMON_H
 
 #include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/ipc.h>
@@ -9,6 +11,10 @@
 #include <sys/shm.h>
 #include <sys/types.h>
 
+#include "delay.h"
+#include "histogram.h"
+#include "mailbox.h"
+
 /**
  * @file common.h
  * @brief Common definitions, IPC structures, and helper functions
@@ -43,14 +49,69 @@
 #define KEY_PATH "."
 #define KEY_ID_SHM 65
 #define KEY_ID_SEM 66
+#define KEY_ID_TRACE 67
+#define KEY_ID_METRICS 68
 /** @} */
 
 /**
  * @name Constraints
  * @{
  */
-/** @brief Physical hard limit for the belt array size. Logical limit is passed via arguments. */
-#define MAX_BELT_CAPACITY 100
+/**
+ * @brief Largest belt capacity K of the semaphore guarded belt.
+ *
+ * SEM_EMPTY counts free slots and System V semaphores cannot exceed SEMVMX
+ * (32767). The lock-free belt does not use the semaphores and is only limited
+ * by the shared memory size the system allows.
+ */
+#define SEM_BELT_MAX_CAPACITY 32767
+/** @brief Largest batch size B moved by one belt operation (`--batch`). */
+#define MAX_BELT_BATCH 256
+/** @brief Largest lookahead window L of the lock-free belt (`--lookahead`), bounds the slots scanned per pick. */
+#define MAX_BELT_LOOKAHEAD 64
+/** @brief Physical hard limit for the number of loading docks. Logical limit D is passed via arguments. */
+#define MAX_DOCKS 32
+/** @brief Largest number of belt lanes (`--lanes`), every lane is a ring with its own lock. */
+#define MAX_BELT_LANES 16
+/** @brief Largest number of express packages one express load command asks for. */
+#define MAX_EXPRESS_BATCH 64
+/** @brief Largest production rate of a standard worker set over the control channel (packages/s). */
+#define MAX_WORKER_RATE 1000000
+/** @brief Largest number of standard workers per package type (`--workers`). */
+#define MAX_WORKERS_PER_TYPE 32
+/** @brief Size of a cache line, structures written by different processes start on their own line. */
+#define CACHE_LINE_SIZE 64
+/** @brief Longest path of a recorded or replayed workload file (`--record`, `--replay`), terminator included. */
+#define WORKLOAD_PATH_MAX 256
+/** @} */
+
+/**
+ * @name Units
+ * Weights and volumes are integers: grams and cubic centimetres. Sums over
+ * any number of packages are exact, so belt weight and truck load never drift
+ * and runs with the same seed give the same numbers. Command line, control
+ * channel and reports keep kg and m3, converted at the boundary (utils.h).
+ * @{
+ */
+#define GRAMS_PER_KG 1000    /**< Grams in a kilogram. */
+#define CM3_PER_M3   1000000 /**< Cubic centimetres in a cubic metre. */
+/** @brief Largest limit (M, W, V) in g or cm3, a limit plus any package still fits into int64_t. */
+#define UNITS_MAX    (INT64_MAX / 4)
+/** @} */
+
+/**
+ * @name Simulated Timings
+ * Default delays modeling physical work. Shared by the process model and the
+ * virtual-time engine, so both follow the same rules. A run may replace them
+ * (@ref delay.h).
+ * @{
+ */
+#define WORKER_MIN_DELAY_US      200000  /**< Minimal work time of a standard worker between packages. */
+#define WORKER_RAND_DELAY_US     500000  /**< Random part of standard worker work time (0..value). */
+#define WORKER_OVERWEIGHT_US     100000  /**< Back-off after a package was rejected by belt weight limit. */
+#define TRUCK_LOAD_TIME_US       100000  /**< Time needed to load a single package into a truck. */
+#define TRUCK_DELIVERY_TIME_S    5       /**< Delivery time of a loaded truck. */
+#define TRUCK_RETURN_TIME_S      1       /**< Drive back to queue after an empty forced departure. */
 /** @} */
 
 /**
@@ -61,16 +122,40 @@
 #define SEM_MUTEX 0    /**< Binary Semaphore: Protects critical sections in Shared Memory. */
 #define SEM_EMPTY 1    /**< Counting Semaphore: Tracks available empty slots on the belt. */
 #define SEM_FULL  2    /**< Counting Semaphore: Tracks number of items currently on the belt. */
-#define SEM_DOCK  3    /**< Binary Semaphore: 1 if Loading Dock is free, 0 if occupied. */
-#define SEM_NUM   4    /**< Total number of semaphores in the set. */
+#define SEM_DOCK  3    /**< Counting Semaphore: Number of free Loading Docks (D when all are free). */
+#define SEM_NUM   4    /**< Total number of semaphores in the set (single lane belt). */
 /** @} */
 
+/**
+ * @brief Semaphore of a belt lane.
+ *
+ * Lane 0 uses @ref SEM_MUTEX, @ref SEM_EMPTY and @ref SEM_FULL. Every further
+ * lane has its own three semaphores behind @ref SEM_NUM, in the same order.
+ *
+ * @param lane Lane index.
+ * @param sem  @ref SEM_MUTEX, @ref SEM_EMPTY or @ref SEM_FULL.
+ * @return Index of the semaphore in the set.
+ */
+static inline int belt_lane_sem(int lane, int sem) {
+  return lane == 0 ? sem : SEM_NUM + 3 * (lane - 1) + sem;
+}
+
+/**
+ * @brief Size of the semaphore set for a belt of `lanes` lanes.
+ *
+ * @param lanes Number of belt lanes.
+ * @return Number of semaphores.
+ */
+static inline int belt_sem_count(int lanes) {
+  return SEM_NUM + 3 * (lanes - 1);
+}
+
 /**
  * @brief Defines the types of packages available in the simulation.
  * * Dimensions and Volumes:
- * - Type A: 64x38x8  cm -> 0.019 m3
- * - Type B: 64x38x19 cm -> 0.046 m3
- * - Type C: 64x38x41 cm -> 0.099 m3
+ * - Type A: 64x38x8  cm -> 19456 cm3 (0.019 m3)
+ * - Type B: 64x38x19 cm -> 46208 cm3 (0.046 m3)
+ * - Type C: 64x38x41 cm -> 99712 cm3 (0.099 m3)
  */
 typedef enum {
   PKG_A, /**< Small package (0.019 m3) */
@@ -85,40 +170,377 @@ typedef enum {
 typedef struct {
     int id;             /**< Unique identifier for the package. */
     PackageType type;   /**< Type of the package (A, B, or C). */
-    double weight;      /**< Weight of the package in kg. */
-    double volume;      /**< Volume of the package in m3. */
+    int weight_g;       /**< Weight of the package in grams. */
+    int volume_cm3;     /**< Volume of the package in cm3. */
+    uint64_t t_gen_ns;  /**< CLOCK_MONOTONIC time the worker generated the package (ns). */
+    uint64_t t_belt_ns; /**< Time the package was placed on the belt (set by the belt, ns). */
+    uint64_t t_load_ns; /**< Time the package was loaded into a truck (ns). */
 } Package;
 
+/**
+ * @brief Belt slots as a structure of arrays, one column per package field.
+ *
+ * Slot i of the belt is entry i of every column. Capacity checks (Peek & Check,
+ * lookahead windows, the belt index) read only the weight and volume columns,
+ * 8 bytes per slot instead of a whole @ref Package. The columns are views of
+ * one block laid out by @ref belt_slots_layout, every column starts on its own
+ * cache line.
+ */
+typedef struct {
+  int *weight_g;       /**< Weight of the package in grams. */
+  int *volume_cm3;     /**< Volume of the package in cm3. */
+  int *type;           /**< @ref PackageType, BELT_HOLE for a slot emptied out of order. */
+  int *id;             /**< Unique identifier of the package. */
+  uint64_t *t_gen_ns;  /**< Time the worker generated the package (ns). */
+  uint64_t *t_belt_ns; /**< Time the package was placed on the belt (ns). */
+} BeltSlots;
+
+/**
+ * @brief Bytes of one belt column, rounded up to whole cache lines.
+ *
+ * @param K    Belt capacity (slots).
+ * @param elem Size of one entry.
+ * @return Column size in bytes.
+ */
+static inline size_t belt_column_size(int K, size_t elem) {
+  size_t size = (size_t)K * elem;
+  return (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+}
+
+/**
+ * @brief Size of the block holding the columns of K belt slots.
+ *
+ * @param K Belt capacity (slots).
+ * @return Block size in bytes.
+ */
+static inline size_t belt_slots_size(int K) {
+  return 4 * belt_column_size(K, sizeof(int)) + 2 * belt_column_size(K, sizeof(uint64_t));
+}
+
+/**
+ * @brief Column views of a block of @ref belt_slots_size(K) bytes.
+ *
+ * @param block Cache line aligned block.
+ * @param K     Belt capacity (slots).
+ * @return Columns of the K slots.
+ */
+static inline BeltSlots belt_slots_layout(void *block, int K) {
+  unsigned char *p = (unsigned char *)block;
+  BeltSlots s;
+  s.weight_g = (int *)p;
+  p += belt_column_size(K, sizeof(int));
+  s.volume_cm3 = (int *)p;
+  p += belt_column_size(K, sizeof(int));
+  s.type = (int *)p;
+  p += belt_column_size(K, sizeof(int));
+  s.id = (int *)p;
+  p += belt_column_size(K, sizeof(int));
+  s.t_gen_ns = (uint64_t *)p;
+  p += belt_column_size(K, sizeof(uint64_t));
+  s.t_belt_ns = (uint64_t *)p;
+  return s;
+}
+
+/**
+ * @brief Columns starting at slot `first`, e.g. the slots of a belt lane.
+ *
+ * @param s     Belt columns.
+ * @param first First slot of the view.
+ * @return Columns shifted by `first` slots.
+ */
+static inline BeltSlots belt_slots_at(BeltSlots s, int first) {
+  s.weight_g += first;
+  s.volume_cm3 += first;
+  s.type += first;
+  s.id += first;
+  s.t_gen_ns += first;
+  s.t_belt_ns += first;
+  return s;
+}
+
+/**
+ * @brief Stores a package in a belt slot.
+ *
+ * @param s         Belt columns.
+ * @param slot      Slot index.
+ * @param pkg       Package to store.
+ * @param t_belt_ns Time the package is placed on the belt (ns).
+ */
+static inline void belt_slot_put(const BeltSlots *s, int slot, const Package *pkg, uint64_t t_belt_ns) {
+  s->weight_g[slot] = pkg->weight_g;
+  s->volume_cm3[slot] = pkg->volume_cm3;
+  s->type[slot] = pkg->type;
+  s->id[slot] = pkg->id;
+  s->t_gen_ns[slot] = pkg->t_gen_ns;
+  s->t_belt_ns[slot] = t_belt_ns;
+}
+
+/**
+ * @brief Reads the package of a belt slot, not loaded yet (`t_load_ns` 0).
+ *
+ * @param s    Belt columns.
+ * @param slot Slot index.
+ * @param pkg  Receives the package.
+ */
+static inline void belt_slot_get(const BeltSlots *s, int slot, Package *pkg) {
+  pkg->id = s->id[slot];
+  pkg->type = (PackageType)s->type[slot];
+  pkg->weight_g = s->weight_g[slot];
+  pkg->volume_cm3 = s->volume_cm3[slot];
+  pkg->t_gen_ns = s->t_gen_ns[slot];
+  pkg->t_belt_ns = s->t_belt_ns[slot];
+  pkg->t_load_ns = 0;
+}
+
+/**
+ * @name Belt Index
+ * Weight classes of the belt index (@ref BeltIndex).
+ * @{
+ */
+#define BELT_INDEX_CLASSES  64   /**< Weight classes per package type, one bit of a 64-bit occupancy word each. */
+#define BELT_INDEX_CLASS_G  400  /**< Width of a weight class in grams, the last class takes everything above. */
+/** @} */
+
+/**
+ * @brief Secondary index over the packages on the semaphore belt.
+ *
+ * Packages are kept in buckets by type and weight class. A bucket is a list of
+ * belt slots in belt order, linked through @ref BeltIndexLink entries stored
+ * next to the slots. Bit c of @ref occupied [type] is set while bucket c of the
+ * type holds a package. Maintained under @ref SEM_MUTEX (see belt_index.h).
+ */
+typedef struct {
+  uint64_t occupied[PKG_END];             /**< Occupancy bitmap of the weight classes per type. */
+  int first[PKG_END][BELT_INDEX_CLASSES]; /**< Oldest slot of every bucket, -1 when empty. */
+  int last[PKG_END][BELT_INDEX_CLASSES];  /**< Youngest slot of every bucket, -1 when empty. */
+} BeltIndex;
+
+/**
+ * @brief Links a belt slot to its neighbours in the same index bucket.
+ */
+typedef struct {
+  int next; /**< Next (younger) slot of the bucket, -1 at the end. */
+  int prev; /**< Previous (older) slot of the bucket, -1 at the start. */
+} BeltIndexLink;
+
+/**
+ * @brief State of a single loading dock.
+ *
+ * Written by the docked truck, read by the Dispatcher (forced departure) and
+ * the Express Worker (direct loading). Protected by @ref SEM_MUTEX. Commands
+ * for the docked truck arrive in @ref SharedState::dock_mail. Every dock has
+ * its own cache line, trucks at different docks never write the same one.
+ */
+typedef struct {
+  pid_t current_truck_pid;   /**< PID of currently docked truck */
+  int current_truck_id;      /**< Id of currently docked truck, selects its thread with `--threads` */
+  int truck_docked;          /**< Flag for checking if truck is docked */
+  int64_t current_truck_load; /**< Current truck load (g), updated atomically */
+  int64_t current_truck_vol;  /**< Current truck volume (cm3), updated atomically */
+  int lane_cursor;           /**< Next lane to drain with round-robin lane policy */
+} __attribute__((aligned(CACHE_LINE_SIZE))) DockState;
+
+/**
+ * @brief Order in which trucks drain the belt lanes.
+ */
+typedef enum {
+  LANE_FULLEST,     /**< Start at the lane holding most packages (steal from the fullest). */
+  LANE_ROUND_ROBIN  /**< Every dock walks the lanes in turn. */
+} BeltLanePolicy;
+
+/**
+ * @brief One lane of the belt, a ring over its own share of @ref SharedState::belt.
+ *
+ * Producers push into the lane they hash to, so producers of different lanes
+ * never take the same lock (or CAS the same tail). Every lane starts on its
+ * own cache line. Within a lane the words written by producers (`tail`), by
+ * consumers (`head`) and by both (`count`) sit on separate lines, the slot
+ * range read by everyone on a fourth one that stays clean.
+ */
+typedef struct {
+  int first;            /**< First slot of the lane in @ref SharedState::belt, fixed by belt_init() */
+  int slots;            /**< Number of slots of the lane, fixed by belt_init() */
+#ifdef BELT_LOCKFREE
+  unsigned long tail __attribute__((aligned(CACHE_LINE_SIZE))); /**< Monotonic push position, slot index is tail % slots */
+  unsigned long head __attribute__((aligned(CACHE_LINE_SIZE))); /**< Monotonic pop position, slot index is head % slots */
+  int count __attribute__((aligned(CACHE_LINE_SIZE)));          /**< Packages in the lane, updated atomically */
+#else
+  int tail __attribute__((aligned(CACHE_LINE_SIZE))); /**< Index to place items into the lane (push) */
+  int head __attribute__((aligned(CACHE_LINE_SIZE))); /**< Index to pop from the lane */
+  int holes;            /**< Slots between head and tail emptied out of order (lookahead loading) */
+  int count __attribute__((aligned(CACHE_LINE_SIZE))); /**< Packages in the lane, updated atomically */
+  BeltIndex index;      /**< Packages of the lane by type and weight class (lookahead loading), updated by both sides */
+#endif
+} __attribute__((aligned(CACHE_LINE_SIZE))) BeltLane;
+
+/**
+ * @brief Stages of a package's way through the warehouse, timed per package.
+ *
+ * Express packages skip the belt and are not timed.
+ */
+typedef enum {
+  LAT_GEN_TO_BELT,      /**< Generation by a worker until placed on the belt. */
+  LAT_BELT_DWELL,       /**< Placed on the belt until loaded into a truck. */
+  LAT_LOAD_TO_DELIVERY, /**< Loaded into a truck until delivered. */
+  LAT_END_TO_END,       /**< Generation until delivery. */
+  LAT_STAGE_END         /**< Number of stages. */
+} LatencyStage;
+
+/**
+ * @brief End-of-run statistics.
+ *
+ * Collected in Shared Memory by workers and trucks, or directly by the
+ * virtual-time engine. Printed at the end of both simulation modes. Counters
+ * of the workers and of the trucks start on separate cache lines.
+ */
+typedef struct {
+  long produced[PKG_END];   /**< Packages placed on the belt, per type. */
+  long rejected_overweight; /**< Push attempts rejected by belt weight limit M. */
+  long loaded __attribute__((aligned(CACHE_LINE_SIZE))); /**< Packages moved from the belt into trucks. */
+  long express_loaded;      /**< Express packages loaded directly by P4. */
+  long deliveries;          /**< Truck departures with a non-empty load. */
+  long forced_departures;   /**< Departures forced by the dispatcher. */
+  int64_t delivered_weight; /**< Total weight of delivered packages (g). */
+  double fill_ratio_sum;    /**< Sum of load/W over all deliveries. */
+  uint64_t first_load_ns;   /**< CLOCK_MONOTONIC time the first package was loaded from the belt, 0 before. */
+  Histogram latency_ns[LAT_STAGE_END][PKG_END]; /**< Package latency per stage and type (ns). */
+  Histogram dock_time_ns;   /**< Time a truck stood at a dock per visit (ns). */
+  Histogram command_ns[CMD_END]; /**< Dispatcher command posted until executed, per command type (ns). */
+  int started_roles;        /**< Roles released by the start barrier, 0 in virtual-time mode. */
+  uint64_t spawn_ns;        /**< Time the Dispatcher took to start all roles (ns). */
+  uint64_t ready_ns;        /**< Time until every role waited at the start barrier, spawning included (ns). */
+  uint64_t t_go_ns;         /**< CLOCK_MONOTONIC time the start barrier opened. */
+} SimStats;
+
 /**
  * @brief Main Shared Memory structure.
  * * This structure acts as the central data store for the simulation, containing
  * configuration, the circular buffer for the belt, and synchronization flags.
+ *
+ * Fields are grouped by who writes them, every group starts on its own cache
+ * line, so a push and a pop on different cores do not bounce lines they do
+ * not share:
+ * - **Configuration:** read on every operation, written at startup and by rare
+ * control commands.
+ * - **Producer side:** words the workers write on every push.
+ * - **Consumer side:** words the trucks write when they wait or free slots.
+ * - **Belt counters:** count and weight of the whole belt, written by both.
+ *
+ * The belt slots follow the header as a structure of arrays (@ref BeltSlots),
+ * sized at startup, so the segment is larger than `sizeof(SharedState)`. Its
+ * real size is @ref shared_state_size of @ref max_items_K, also stored in
+ * @ref segment_size. Processes attaching to an existing segment learn K from
+ * this header.
  */
 typedef struct {
-  /* Configuration set by main process */
+  /* Configuration set by main process (read-mostly) */
+  size_t segment_size;  /**< Size of the whole segment in bytes, belt included */
   int max_items_K;      /**< Max number of items that can be placed on belt */
-  double max_belt_weight_M; /**< Max weight that belt can handle */
-  double truck_capacity_W;  /**< Specifies load weight that truck can handle */
-  double truck_volume_V;    /**< Specifies trucks volume capacity */
+  int64_t max_belt_weight_M; /**< Max weight that belt can handle (g), changed by control `resize belt` */
+  int64_t truck_capacity_W;  /**< Specifies load weight that truck can handle (g), changed by control `resize truck` */
+  int64_t truck_volume_V;    /**< Specifies trucks volume capacity (cm3), changed by control `resize truck` */
+  int batch_B;              /**< Packages moved per belt operation by workers and trucks */
+  int lookahead_L;          /**< Belt slots a truck inspects for the best fitting package, 1 = head only */
+  int belt_lanes;           /**< Number of belt lanes (1..MAX_BELT_LANES), normalized by belt_init() */
+  int lane_policy;          /**< Order trucks drain the lanes in (@ref BeltLanePolicy) */
+  int docks_D;              /**< Number of loading docks in use (1..MAX_DOCKS) */
+  int std_workers;          /**< Number of standard workers, the express worker is number std_workers + 1 */
+  int log_level;            /**< Most verbose log level written by child processes (LOG_LEVEL_*) */
+  int no_sleep;             /**< Skip simulated work, loading and delivery times (`--no-sleep`) */
+  int mem_flags;            /**< SHM_BLOCK_* options granted to this segment (`--huge-pages`, `--mlock`), attaching roles lock it too */
+  int trace_rings;          /**< Rings in the event-trace segment (KEY_ID_TRACE), 0 when tracing is off */
+  int metrics_trucks;       /**< Truck entries in the metrics segment (KEY_ID_METRICS), 0 when metrics are off */
+  int workload_mode;        /**< What standard workers do with the workload file (@ref WorkloadMode) */
+  uint64_t workload_t0_ns;  /**< Start of the replay, CLOCK_MONOTONIC in ns, arrival times are relative to it */
+  char workload_path[WORKLOAD_PATH_MAX]; /**< Workload file recorded or replayed (`--record`, `--replay`) */
+  unsigned int worker_rate; /**< Packages per second of every standard worker, 0 = simulated work time (control `set-rate`) */
+  SimDelay delays[DELAY_END]; /**< Simulated delays drawn by the roles (`--delay`, control `set-delay`), see @ref delay.h */
 
-  /* System State */
+  /* System State (read-mostly) */
   int shutdown;         /**< Flag to signal all process to terminate. */
   pid_t p4_pid;         /**< Express worker (P4) pid */
+  unsigned int roles_expected; /**< Roles the start barrier waits for, set before they are started */
+  unsigned int roles_ready;    /**< Roles attached and waiting at the start barrier, futex word of the Dispatcher */
+  unsigned int start_gate;     /**< Futex word of the start barrier, 0 closed, 1 open (see role_env_ready()) */
+
+  /* Producer side */
+  unsigned int belt_not_empty __attribute__((aligned(CACHE_LINE_SIZE))); /**< Futex word (doorbell), bumped on every push and on truck wake requests */
+#ifdef BELT_LOCKFREE
+  unsigned int belt_push_waiters; /**< Number of producers sleeping on a full belt */
+#endif
+
+  /* Consumer side */
+  unsigned int belt_pop_waiters __attribute__((aligned(CACHE_LINE_SIZE))); /**< Number of trucks sleeping on an empty belt */
+#ifdef BELT_LOCKFREE
+  unsigned int belt_not_full;     /**< Futex word, bumped when a slot is freed while producers sleep */
+#endif
+
+  /* Belt counters */
+  int current_count __attribute__((aligned(CACHE_LINE_SIZE))); /**< Number of all packages currently on a belt (all lanes) */
+  int64_t current_belt_weight; /**< Current belt weight (all lanes, g), updated atomically */
 
   /* Belt State */
-  Package belt[MAX_BELT_CAPACITY];
-  int head;             /**< Index to pop from belt */
-  int tail;             /**< Index to place intems into from belt (push) */
-  int current_count;    /**< Number of all packages currently on a belt */
-  double current_belt_weight; /**< Current belt weight */
+  BeltLane lanes[MAX_BELT_LANES]; /**< Ring state of every lane */
 
   /* Truck Interface */
-  pid_t current_truck_pid; /**< PID of currently docked truck, so dispatcher can send signal to It */
-  int truck_docked;        /**< Flag for checking if truck is docked */
-  double current_truck_load; /**< Current truck load */
-  double current_truck_vol;  /**< Current truck volume */
-  //int force_departure;  /**< Flag for early truck departure */
+  DockState docks[MAX_DOCKS]; /**< Per-dock truck state */
+
+  /* Command Mailboxes */
+  Mailbox dock_mail[MAX_DOCKS]; /**< Commands for the truck at a dock (forced departure) */
+  Mailbox express_mail;         /**< Commands for the express worker (express load) */
+
+  /* Statistics */
+  SimStats stats;          /**< End-of-run statistics */
+
+  /* Belt Slots (columns of K slots, see belt_slots(), followed by K sequence numbers in lock-free build or K index links) */
+  unsigned char belt[] __attribute__((aligned(CACHE_LINE_SIZE)));
 
 } SharedState;
 
+/**
+ * @brief Columns of the belt slots in a segment.
+ *
+ * @param shm Pointer to the attached SharedState structure.
+ * @return Columns of all @ref SharedState::max_items_K slots.
+ */
+static inline BeltSlots belt_slots(SharedState *shm) {
+  return belt_slots_layout(shm->belt, shm->max_items_K);
+}
+
+/**
+ * @brief Per-slot data of the belt implementation, behind the columns.
+ *
+ * K sequence numbers (`unsigned long`) in the lock-free build, K
+ * @ref BeltIndexLink entries in the semaphore build.
+ *
+ * @param shm Pointer to the attached SharedState structure.
+ * @return Start of the K entries.
+ */
+static inline void *belt_slot_meta(SharedState *shm) {
+  return shm->belt + belt_slots_size(shm->max_items_K);
+}
+
+/**
+ * @brief Number of the express worker (P4 with the default three standard workers).
+ *
+ * @param shm Pointer to the attached SharedState structure.
+ * @return Worker number, one above the last standard worker.
+ */
+static inline int express_worker_id(const SharedState *shm) {
+  return (shm->std_workers > 0 ? shm->std_workers : PKG_END) + 1;
+}
+
+/**
+ * @brief Size of a shared memory segment holding a belt of K slots.
+ *
+ * @param K Belt capacity (slots).
+ * @return Segment size in bytes.
+ */
+static inline size_t shared_state_size(int K) {
+#ifdef BELT_LOCKFREE
+  return sizeof(SharedState) + belt_slots_size(K) + (size_t)K * sizeof(unsigned long);
+#else
+  return sizeof(SharedState) + belt_slots_size(K) + (size_t)K * sizeof(BeltIndexLink);
+#endif
+}
 #endif // COMMON_H
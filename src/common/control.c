@@ -0,0 +1,303 @@
+#define _GNU_SOURCE // ppoll, accept4
+#include "control.h"
+#include "common.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/** @brief Longest answer line, newline included. */
+#define CONTROL_REPLY_MAX 1024
+/** @brief Words of a command line looked at, more are an error. */
+#define CONTROL_MAX_WORDS 4
+
+static void conn_reset(ControlConn *conn, int fd, FILE *out) {
+  conn->fd = fd;
+  conn->out = out;
+  conn->skip = 0;
+  conn->len = 0;
+}
+
+static void conn_close(ControlConn *conn) {
+  if (conn->fd != -1 && !conn->out) close(conn->fd); // The terminal stays open
+  conn->fd = -1;
+  conn->len = 0;
+}
+
+int control_open(ControlServer *srv, const char *path, int input_fd) {
+  memset(srv, 0, sizeof(*srv));
+  srv->listen_fd = -1;
+  conn_reset(&srv->input, input_fd, stdout);
+  for (int i = 0; i < CONTROL_MAX_CLIENTS; ++i) conn_reset(&srv->conns[i], -1, NULL);
+
+  if (!path) return 0;
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  // Not inherited by the roles, accept never blocks the event loop
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd == -1) return -1;
+
+  unlink(path); // Stale socket of a previous run
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(fd, CONTROL_MAX_CLIENTS) == -1) {
+    int err = errno;
+    close(fd);
+    errno = err;
+    return -1;
+  }
+
+  srv->listen_fd = fd;
+  strcpy(srv->path, path);
+  return 0;
+}
+
+void control_close(ControlServer *srv) {
+  for (int i = 0; i < CONTROL_MAX_CLIENTS; ++i) conn_close(&srv->conns[i]);
+  srv->input.fd = -1;
+
+  if (srv->listen_fd != -1) {
+    close(srv->listen_fd);
+    unlink(srv->path);
+    srv->listen_fd = -1;
+  }
+}
+
+int control_reply(ControlConn *conn, const char *fmt, ...) {
+  char buf[CONTROL_REPLY_MAX];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf, sizeof(buf) - 1, fmt, ap);
+  va_end(ap);
+
+  if (n < 0 || conn->fd == -1) return -1;
+  if (n > (int)sizeof(buf) - 2) n = sizeof(buf) - 2;
+  buf[n++] = '\n';
+
+  if (conn->out) {
+    fwrite(buf, 1, n, conn->out);
+    fflush(conn->out);
+    return 0;
+  }
+
+  // An answer is far below the socket buffer, a full one means the client stopped reading
+  if (send(conn->fd, buf, n, MSG_DONTWAIT | MSG_NOSIGNAL) != n) {
+    conn_close(conn);
+    return -1;
+  }
+  return 0;
+}
+
+// Hands out the first buffered line, answers and drops an overlong one
+static int take_line(ControlConn *conn, char *line, size_t size) {
+  while (conn->fd != -1 && conn->len > 0) {
+    char *nl = memchr(conn->buf, '\n', conn->len);
+
+    if (!nl) {
+      if (conn->len < CONTROL_LINE_MAX) return 0; // Rest of the line still to come
+      if (!conn->skip) control_reply(conn, "{\"ok\":false,\"error\":\"line too long\"}");
+      conn->skip = 1;
+      conn->len = 0;
+      return 0;
+    }
+
+    size_t n = nl - conn->buf;
+    int skipped = conn->skip;
+    if (!skipped) {
+      if (n >= size) n = size - 1;
+      memcpy(line, conn->buf, n);
+      line[n] = '\0';
+      if (n > 0 && line[n - 1] == '\r') line[n - 1] = '\0';
+    }
+
+    size_t used = nl - conn->buf + 1;
+    memmove(conn->buf, nl + 1, conn->len - used);
+    conn->len -= used;
+    conn->skip = 0;
+
+    if (!skipped) return 1;
+  }
+  return 0;
+}
+
+// Reads what arrived, returns 0 once the peer closed or failed
+static int fill(ControlConn *conn) {
+  ssize_t n = read(conn->fd, conn->buf + conn->len, CONTROL_LINE_MAX - conn->len);
+  if (n > 0) {
+    conn->len += n;
+    return 1;
+  }
+  return n == -1 && (errno == EAGAIN || errno == EINTR);
+}
+
+// Any buffered line, the terminal first, then clients in turn
+static int next_buffered(ControlServer *srv, ControlConn **from, char *line, size_t size) {
+  if (take_line(&srv->input, line, size)) {
+    *from = &srv->input;
+    return 1;
+  }
+  for (int k = 0; k < CONTROL_MAX_CLIENTS; ++k) {
+    int i = (srv->next_conn + k) % CONTROL_MAX_CLIENTS;
+    if (take_line(&srv->conns[i], line, size)) {
+      *from = &srv->conns[i];
+      srv->next_conn = (i + 1) % CONTROL_MAX_CLIENTS;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void accept_clients(ControlServer *srv) {
+  for (int i = 0; i < CONTROL_MAX_CLIENTS; ++i) {
+    if (srv->conns[i].fd != -1) continue;
+    int fd = accept4(srv->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd == -1) return;
+    conn_reset(&srv->conns[i], fd, NULL);
+  }
+}
+
+int control_next(ControlServer *srv, int timeout_ms, const sigset_t *sigmask,
+		 ControlConn **from, char *line, size_t size) {
+  if (next_buffered(srv, from, line, size)) return 1;
+
+  // Poll set: terminal, clients and the socket while a client entry is free
+  struct pollfd pfd[CONTROL_MAX_CLIENTS + 2];
+  ControlConn *conn[CONTROL_MAX_CLIENTS + 2];
+  int n = 0, listening = 0;
+
+  if (srv->input.fd != -1) {
+    pfd[n] = (struct pollfd){srv->input.fd, POLLIN, 0};
+    conn[n++] = &srv->input;
+  }
+  for (int i = 0; i < CONTROL_MAX_CLIENTS; ++i) {
+    if (srv->conns[i].fd == -1) {
+      listening = srv->listen_fd != -1;
+      continue;
+    }
+    pfd[n] = (struct pollfd){srv->conns[i].fd, POLLIN, 0};
+    conn[n++] = &srv->conns[i];
+  }
+  if (listening) {
+    pfd[n] = (struct pollfd){srv->listen_fd, POLLIN, 0};
+    conn[n++] = NULL;
+  }
+
+  struct timespec ts = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+  int ready = ppoll(pfd, n, timeout_ms < 0 ? NULL : &ts, sigmask);
+  if (ready == -1) return errno == EINTR ? 0 : -1;
+
+  for (int i = 0; i < n && ready > 0; ++i) {
+    if (!pfd[i].revents) continue;
+    --ready;
+    if (!conn[i]) accept_clients(srv);
+    else if (!fill(conn[i])) conn_close(conn[i]);
+  }
+
+  return next_buffered(srv, from, line, size);
+}
+
+// Parses a whole word as a number
+static int parse_long(const char *word, long *out) {
+  char *end;
+  errno = 0;
+  *out = strtol(word, &end, 10);
+  return end != word && *end == '\0' && errno == 0 ? 0 : -1;
+}
+
+static int parse_positive(const char *word, double *out) {
+  char *end;
+  *out = strtod(word, &end);
+  return end != word && *end == '\0' && *out > 0.0 ? 0 : -1;
+}
+
+static int reject(ControlRequest *req, const char *error) {
+  req->error = error;
+  return -1;
+}
+
+int control_parse(const char *line, ControlRequest *req) {
+  char copy[CONTROL_LINE_MAX];
+  char *words[CONTROL_MAX_WORDS + 1];
+  char *save;
+  int n = 0;
+
+  memset(req, 0, sizeof(*req));
+  snprintf(copy, sizeof(copy), "%s", line);
+  for (char *w = strtok_r(copy, " \t", &save); w && n <= CONTROL_MAX_WORDS; w = strtok_r(NULL, " \t", &save)) {
+    words[n++] = w;
+  }
+  if (n == 0) return reject(req, "empty command");
+  if (n > CONTROL_MAX_WORDS) return reject(req, "too many arguments");
+
+  const char *cmd = words[0];
+  int args = n - 1;
+  long value;
+
+  if (strcmp(cmd, "depart") == 0 || strcmp(cmd, "express") == 0) {
+    req->op = cmd[0] == 'd' ? CTL_DEPART : CTL_EXPRESS;
+    if (args < 1) return reject(req, "missing dock");
+    if (args > (req->op == CTL_EXPRESS ? 2 : 1)) return reject(req, "too many arguments");
+    if (parse_long(words[1], &value) == -1 || value < 1 || value > MAX_DOCKS) return reject(req, "invalid dock");
+    req->dock = (int)value - 1;
+
+    if (args == 2) {
+      if (parse_long(words[2], &req->count) == -1 || req->count < 0 || req->count > MAX_EXPRESS_BATCH) {
+	return reject(req, "invalid package count");
+      }
+    }
+    return 0;
+  }
+
+  if (strcmp(cmd, "set-rate") == 0) {
+    req->op = CTL_SET_RATE;
+    if (args != 1) return reject(req, args < 1 ? "missing rate" : "too many arguments");
+    if (parse_long(words[1], &req->count) == -1 || req->count < 0 || req->count > MAX_WORKER_RATE) {
+      return reject(req, "invalid rate");
+    }
+    return 0;
+  }
+
+  if (strcmp(cmd, "set-delay") == 0) {
+    req->op = CTL_SET_DELAY;
+    if (args != 2) return reject(req, args < 2 ? "missing delay kind or delay" : "too many arguments");
+    if ((req->delay_kind = delay_kind_of(words[1])) == -1) return reject(req, "unknown delay kind");
+    if (delay_parse(words[2], &req->delay) == -1) return reject(req, "invalid delay");
+    return 0;
+  }
+
+  if (strcmp(cmd, "resize") == 0) {
+    if (args >= 1 && strcmp(words[1], "belt") == 0) {
+      req->op = CTL_RESIZE_BELT;
+      if (args != 2) return reject(req, args < 2 ? "missing weight" : "too many arguments");
+      if (parse_positive(words[2], &req->weight) == -1) return reject(req, "invalid weight");
+      return 0;
+    }
+    if (args >= 1 && strcmp(words[1], "truck") == 0) {
+      req->op = CTL_RESIZE_TRUCK;
+      if (args != 3) return reject(req, args < 3 ? "missing weight or volume" : "too many arguments");
+      if (parse_positive(words[2], &req->weight) == -1) return reject(req, "invalid weight");
+      if (parse_positive(words[3], &req->volume) == -1) return reject(req, "invalid volume");
+      return 0;
+    }
+    return reject(req, "resize belt or truck");
+  }
+
+  if (strcmp(cmd, "stats") == 0 || strcmp(cmd, "shutdown") == 0) {
+    req->op = cmd[1] == 't' ? CTL_STATS : CTL_SHUTDOWN;
+    if (args != 0) return reject(req, "too many arguments");
+    return 0;
+  }
+
+  return reject(req, "unknown command");
+}
@@ -0,0 +1,156 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "delay.h"
+
+/**
+ * @file control.h
+ * @brief Control channel of the Dispatcher, a Unix domain socket next to stdin.
+ *
+ * The Dispatcher serves its terminal and any number of local clients from one
+ * event loop (@ref control_next, `ppoll`). Clients connect to the socket given
+ * with `--control=<path>` and send one command per line, every command is
+ * answered with one line of JSON, in order, so a script may pipeline many
+ * commands before reading the answers:
+ *
+ * - `depart <dock>`: the truck at the dock departs early (dock mailbox).
+ * - `express <dock> [count]`: the express worker loads `count` packages there,
+ * 0 or none = random 1-5.
+ * - `stats`: live counters of the run.
+ * - `set-rate <n>`: every standard worker produces `n` packages per second,
+ * 0 = back to the simulated work time.
+ * - `set-delay <kind> <delay>`: new distribution of a simulated delay
+ * (`work`, `overweight`, `load`, `delivery`, `return`), e.g.
+ * `set-delay delivery exp:5s`, see @ref delay.h.
+ * - `resize belt <M>`: new belt weight limit M.
+ * - `resize truck <W> <V>`: new truck weight and volume capacity.
+ * - `shutdown`: graceful shutdown, as command 3 of the terminal.
+ *
+ * Docks are numbered from 1 as in the terminal. A success answer is
+ * `{"ok":true,...}` with fields of the command, a failure
+ * `{"ok":false,"error":"..."}`.
+ *
+ * The terminal takes the same commands next to its numbered menu. A client
+ * that stops reading its answers is disconnected instead of blocking the
+ * Dispatcher.
+ */
+
+/** @brief Longest command line, longer lines are rejected. */
+#define CONTROL_LINE_MAX 256
+/** @brief Clients connected at the same time, further clients wait in the backlog. */
+#define CONTROL_MAX_CLIENTS 16
+/** @brief Longest socket path (size of `sockaddr_un::sun_path`). */
+#define CONTROL_PATH_MAX 108
+
+/**
+ * @brief Commands of the control channel.
+ */
+typedef enum {
+  CTL_DEPART,       /**< Force departure at a dock. */
+  CTL_EXPRESS,      /**< Express load at a dock. */
+  CTL_STATS,        /**< Live counters. */
+  CTL_SET_RATE,     /**< Production rate of standard workers. */
+  CTL_SET_DELAY,    /**< Simulated delay. */
+  CTL_RESIZE_BELT,  /**< Belt weight limit. */
+  CTL_RESIZE_TRUCK, /**< Truck capacity. */
+  CTL_SHUTDOWN      /**< Graceful shutdown. */
+} ControlOp;
+
+/**
+ * @brief A parsed command line.
+ */
+typedef struct {
+  ControlOp op;      /**< Command. */
+  int dock;          /**< Dock index (0-based) of depart and express. */
+  long count;        /**< Express packages (0 = random) or packages per second. */
+  double weight;     /**< New belt limit M or truck capacity W (kg). */
+  double volume;     /**< New truck volume V (m3). */
+  int delay_kind;    /**< Delay replaced by set-delay (@ref DelayKind). */
+  SimDelay delay;    /**< New delay. */
+  const char *error; /**< Reason a line was rejected. */
+} ControlRequest;
+
+/**
+ * @brief A connection lines are read from, a client or the terminal.
+ */
+typedef struct {
+  int fd;       /**< Descriptor read from, -1 when closed. */
+  FILE *out;    /**< Stream answers of the terminal go to, NULL for a client socket. */
+  int skip;     /**< Rest of an overlong line is dropped up to its newline. */
+  size_t len;   /**< Bytes buffered in @ref buf. */
+  char buf[CONTROL_LINE_MAX]; /**< Received bytes not yet handed out as a line. */
+} ControlConn;
+
+/**
+ * @brief Listening socket, its clients and the terminal.
+ */
+typedef struct {
+  int listen_fd;                 /**< Listening socket, -1 without `--control`. */
+  char path[CONTROL_PATH_MAX];   /**< Socket path, removed on close. */
+  ControlConn input;             /**< Terminal, fd -1 when not read or closed. */
+  ControlConn conns[CONTROL_MAX_CLIENTS]; /**< Clients, fd -1 for a free entry. */
+  int next_conn;                 /**< Client served first by the next call, for fairness. */
+} ControlServer;
+
+/**
+ * @brief Opens the control channel.
+ *
+ * A stale socket left at `path` by a previous run is replaced.
+ *
+ * @param srv      Server to fill.
+ * @param path     Socket path, NULL for the terminal only.
+ * @param input_fd Terminal to read (STDIN_FILENO), answered on stdout, -1 for none.
+ * @return 0 on success, -1 with errno set if the socket cannot be created.
+ */
+int control_open(ControlServer *srv, const char *path, int input_fd);
+
+/**
+ * @brief Closes all clients and the socket and removes the socket file.
+ *
+ * @param srv Server.
+ */
+void control_close(ControlServer *srv);
+
+/**
+ * @brief Waits for the next command line of the terminal or a client.
+ *
+ * Lines already buffered are handed out without waiting. New clients are
+ * accepted and closed ones dropped on the way, an overlong line is answered
+ * with an error here. Signals not blocked in `sigmask` interrupt the wait.
+ *
+ * @param srv        Server.
+ * @param timeout_ms Longest wait, -1 without limit.
+ * @param sigmask    Signal mask during the wait (`ppoll`), NULL keeps the current one.
+ * @param from       Receives the connection the line came from.
+ * @param line       Receives the line without its newline.
+ * @param size       Size of `line`, at least @ref CONTROL_LINE_MAX.
+ * @return 1 if a line was received, 0 on timeout, signal or closed terminal, -1 on error.
+ */
+int control_next(ControlServer *srv, int timeout_ms, const sigset_t *sigmask,
+		 ControlConn **from, char *line, size_t size);
+
+/**
+ * @brief Sends one answer line, a newline is appended.
+ *
+ * A client whose socket buffer is full is disconnected.
+ *
+ * @param conn Connection the command came from.
+ * @param fmt  printf format of the answer.
+ * @return 0 on success, -1 if the answer could not be sent.
+ */
+int control_reply(ControlConn *conn, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Parses a command line.
+ *
+ * @param line Command line without newline.
+ * @param req  Receives the command, `error` tells why a line was rejected.
+ * @return 0 on success, -1 on an unknown command or invalid arguments.
+ */
+int control_parse(const char *line, ControlRequest *req);
+
+#endif // CONTROL_H
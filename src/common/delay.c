@@ -0,0 +1,137 @@
+#include "delay.h"
+#include "common.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *kind_names[DELAY_END] = {"work", "overweight", "load", "delivery", "return"};
+
+void delay_defaults(SimDelay *delays) {
+  memset(delays, 0, sizeof(SimDelay) * DELAY_END);
+  delays[DELAY_WORK] = (SimDelay){DIST_UNIFORM, 0, WORKER_MIN_DELAY_US, WORKER_MIN_DELAY_US + WORKER_RAND_DELAY_US};
+  delays[DELAY_OVERWEIGHT] = (SimDelay){DIST_FIXED, 0, WORKER_OVERWEIGHT_US, 0};
+  delays[DELAY_LOAD] = (SimDelay){DIST_FIXED, 0, TRUCK_LOAD_TIME_US, 0};
+  delays[DELAY_DELIVERY] = (SimDelay){DIST_FIXED, 0, TRUCK_DELIVERY_TIME_S * 1000000ull, 0};
+  delays[DELAY_RETURN] = (SimDelay){DIST_FIXED, 0, TRUCK_RETURN_TIME_S * 1000000ull, 0};
+}
+
+int delay_kind_of(const char *name) {
+  for (int k = 0; k < DELAY_END; ++k) {
+    if (strcmp(name, kind_names[k]) == 0) return k;
+  }
+  return -1;
+}
+
+const char *delay_kind_name(int kind) {
+  return kind >= 0 && kind < DELAY_END ? kind_names[kind] : "?";
+}
+
+// Time with an optional unit, up to `stop` or the end of the text
+static int parse_time(const char *text, const char *stop, uint64_t *out) {
+  char *end;
+  double v = strtod(text, &end);
+  if (end == text || v < 0.0 || !isfinite(v)) return -1;
+
+  size_t unit_len = (size_t)((stop ? stop : end + strlen(end)) - end);
+  double scale;
+  if (unit_len == 0 || (unit_len == 2 && strncmp(end, "us", 2) == 0)) scale = 1.0;
+  else if (unit_len == 2 && strncmp(end, "ms", 2) == 0) scale = 1e3;
+  else if (unit_len == 1 && *end == 's') scale = 1e6;
+  else return -1;
+
+  v *= scale;
+  if (v > (double)DELAY_MAX_US) return -1;
+  *out = (uint64_t)llround(v);
+  return 0;
+}
+
+int delay_parse(const char *text, SimDelay *out) {
+  SimDelay d = {DIST_FIXED, 0, 0, 0};
+
+  if (strncmp(text, "exp:", 4) == 0) {
+    d.dist = DIST_EXP;
+    if (parse_time(text + 4, NULL, &d.a_us) == -1) return -1;
+  }
+  else {
+    // A minus sign never starts a time, so the first one splits a range
+    const char *dash = strchr(text, '-');
+    if (dash) {
+      d.dist = DIST_UNIFORM;
+      if (parse_time(text, dash, &d.a_us) == -1 || parse_time(dash + 1, NULL, &d.b_us) == -1) return -1;
+      if (d.b_us < d.a_us) return -1;
+    }
+    else if (parse_time(text, NULL, &d.a_us) == -1) {
+      return -1;
+    }
+  }
+
+  *out = d;
+  return 0;
+}
+
+int delay_parse_option(const char *text, SimDelay *delays) {
+  const char *eq = strchr(text, '=');
+  if (!eq) return -1;
+
+  char name[16];
+  size_t len = (size_t)(eq - text);
+  if (len >= sizeof(name)) return -1;
+  memcpy(name, text, len);
+  name[len] = '\0';
+
+  int kind = delay_kind_of(name);
+  if (kind == -1) return -1;
+  return delay_parse(eq + 1, &delays[kind]);
+}
+
+// Largest unit the time is a whole multiple of
+static void format_time(uint64_t us, char *buf, size_t size) {
+  if (us > 0 && us % 1000000 == 0) snprintf(buf, size, "%llus", (unsigned long long)(us / 1000000));
+  else if (us > 0 && us % 1000 == 0) snprintf(buf, size, "%llums", (unsigned long long)(us / 1000));
+  else snprintf(buf, size, "%lluus", (unsigned long long)us);
+}
+
+void delay_format(const SimDelay *d, char *buf, size_t size) {
+  char a[20], b[20];
+  format_time(d->a_us, a, sizeof(a));
+  format_time(d->b_us, b, sizeof(b));
+
+  if (d->dist == DIST_UNIFORM) snprintf(buf, size, "%s-%s", a, b);
+  else if (d->dist == DIST_EXP) snprintf(buf, size, "exp:%s", a);
+  else snprintf(buf, size, "%s", a);
+}
+
+uint64_t delay_draw_us(const SimDelay *d) {
+  if (d->dist == DIST_UNIFORM) {
+    // Bounds of a racing change may come out swapped
+    uint64_t lo = d->a_us < d->b_us ? d->a_us : d->b_us;
+    uint64_t span = (d->a_us < d->b_us ? d->b_us : d->a_us) - lo;
+    if (span == 0) return lo;
+    return lo + (uint64_t)((double)rand() / ((double)RAND_MAX + 1.0) * (double)span);
+  }
+
+  if (d->dist == DIST_EXP) {
+    double u = ((double)rand() + 1.0) / ((double)RAND_MAX + 1.0); // (0, 1]
+    double v = -log(u) * (double)d->a_us;
+    return v < (double)DELAY_MAX_US ? (uint64_t)v : DELAY_MAX_US;
+  }
+
+  return d->a_us;
+}
+
+SimDelay delay_load(const SimDelay *d) {
+  SimDelay v;
+  v.dist = __atomic_load_n(&d->dist, __ATOMIC_RELAXED);
+  v.pad = 0;
+  v.a_us = __atomic_load_n(&d->a_us, __ATOMIC_RELAXED);
+  v.b_us = __atomic_load_n(&d->b_us, __ATOMIC_RELAXED);
+  return v;
+}
+
+void delay_store(SimDelay *d, const SimDelay *val) {
+  __atomic_store_n(&d->a_us, val->a_us, __ATOMIC_RELAXED);
+  __atomic_store_n(&d->b_us, val->b_us, __ATOMIC_RELAXED);
+  __atomic_store_n(&d->dist, val->dist, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,134 @@
+#ifndef DELAY_H
+#define DELAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file delay.h
+ * @brief Simulated delays, set at start (`--delay`) and at run time (`set-delay`).
+ *
+ * Every physical delay of the simulation (work time of a worker, loading a
+ * package, a delivery, ...) is a @ref SimDelay: a fixed time, a uniform range
+ * or an exponential distribution. The defaults are the classic constants of
+ * @ref common.h. The table lives in @ref SharedState, roles draw a fresh
+ * value for every delay, so a change reaches them with their next wait.
+ *
+ * A delay is written as `<us>`, `<min>-<max>` or `exp:<mean>`, every time
+ * with an optional unit `us`, `ms` or `s` (default `us`), e.g. `5s`,
+ * `200ms-700ms` or `exp:5s`.
+ */
+
+/** @brief Longest delay accepted, one day. */
+#define DELAY_MAX_US (24ull * 3600 * 1000000)
+/** @brief Room for a delay written by @ref delay_format. */
+#define DELAY_TEXT_MAX 48
+
+/**
+ * @brief Delays of the simulation.
+ */
+typedef enum {
+  DELAY_WORK,       /**< Work time of a standard worker per package (`work`). */
+  DELAY_OVERWEIGHT, /**< Back-off after a belt weight rejection (`overweight`). */
+  DELAY_LOAD,       /**< Loading one package into a truck (`load`). */
+  DELAY_DELIVERY,   /**< Delivery of a loaded truck (`delivery`). */
+  DELAY_RETURN,     /**< Drive back to the queue after an empty departure (`return`). */
+  DELAY_END
+} DelayKind;
+
+/**
+ * @brief Distributions of a delay.
+ */
+typedef enum {
+  DIST_FIXED,   /**< Always @ref SimDelay::a_us. */
+  DIST_UNIFORM, /**< Uniform in [a_us, b_us). */
+  DIST_EXP      /**< Exponential with mean a_us. */
+} DelayDist;
+
+/**
+ * @brief A delay. Fields are written with atomic stores while roles read them.
+ */
+typedef struct {
+  uint32_t dist; /**< @ref DelayDist */
+  uint32_t pad;
+  uint64_t a_us; /**< Fixed time, lower bound or mean (us). */
+  uint64_t b_us; /**< Upper bound of a uniform delay (us). */
+} SimDelay;
+
+/**
+ * @brief Fills a table with the default delays.
+ *
+ * @param delays Table of @ref DELAY_END delays.
+ */
+void delay_defaults(SimDelay *delays);
+
+/**
+ * @brief Delay kind of its name.
+ *
+ * @param name `work`, `overweight`, `load`, `delivery` or `return`.
+ * @return @ref DelayKind, -1 for an unknown name.
+ */
+int delay_kind_of(const char *name);
+
+/**
+ * @brief Name of a delay kind.
+ *
+ * @param kind @ref DelayKind
+ * @return Name as accepted by @ref delay_kind_of.
+ */
+const char *delay_kind_name(int kind);
+
+/**
+ * @brief Parses a delay.
+ *
+ * @param text Delay, see @ref delay.h.
+ * @param out  Receives the delay.
+ * @return 0 on success, -1 on invalid text or a time above @ref DELAY_MAX_US.
+ */
+int delay_parse(const char *text, SimDelay *out);
+
+/**
+ * @brief Parses `<kind>=<delay>` of `--delay`.
+ *
+ * @param text   Option value.
+ * @param delays Table, the entry of the kind is replaced.
+ * @return 0 on success, -1 on an unknown kind or invalid delay.
+ */
+int delay_parse_option(const char *text, SimDelay *delays);
+
+/**
+ * @brief Writes a delay the way @ref delay_parse reads it.
+ *
+ * @param d    Delay.
+ * @param buf  Output, at least @ref DELAY_TEXT_MAX bytes.
+ * @param size Size of `buf`.
+ */
+void delay_format(const SimDelay *d, char *buf, size_t size);
+
+/**
+ * @brief Draws a value of a delay, with rand().
+ *
+ * @param d Delay.
+ * @return Time in microseconds.
+ */
+uint64_t delay_draw_us(const SimDelay *d);
+
+/**
+ * @brief Reads a delay that may be changed at the same time.
+ *
+ * A draw racing a change may mix the old and the new delay once.
+ *
+ * @param d Delay in the shared table.
+ * @return Copy of the delay.
+ */
+SimDelay delay_load(const SimDelay *d);
+
+/**
+ * @brief Replaces a delay that roles may be reading.
+ *
+ * @param d   Delay in the shared table.
+ * @param val New delay.
+ */
+void delay_store(SimDelay *d, const SimDelay *val);
+
+#endif // DELAY_H
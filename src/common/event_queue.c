@@ -0,0 +1,75 @@
+#include "event_queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Earlier time first, then insertion order
+static int event_before(const SimEvent *a, const SimEvent *b) {
+  if (a->time_us != b->time_us) return a->time_us < b->time_us;
+  return a->seq < b->seq;
+}
+
+void event_queue_init(EventQueue *q, int capacity) {
+  if (capacity < 1) capacity = 1;
+
+  q->heap = malloc(sizeof(SimEvent) * capacity);
+  if (q->heap == NULL) {
+    perror("Event queue: malloc error");
+    exit(1);
+  }
+  q->size = 0;
+  q->capacity = capacity;
+  q->next_seq = 0;
+}
+
+void event_queue_free(EventQueue *q) {
+  free(q->heap);
+  q->heap = NULL;
+  q->size = 0;
+  q->capacity = 0;
+}
+
+void event_queue_push(EventQueue *q, long long time_us, int type, int id, long tag) {
+  if (q->size == q->capacity) {
+    SimEvent *grown = realloc(q->heap, sizeof(SimEvent) * q->capacity * 2);
+    if (grown == NULL) {
+      perror("Event queue: realloc error");
+      exit(1);
+    }
+    q->heap = grown;
+    q->capacity *= 2;
+  }
+
+  SimEvent ev = {time_us, q->next_seq++, type, id, tag};
+
+  // Sift up
+  int i = q->size++;
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!event_before(&ev, &q->heap[parent])) break;
+    q->heap[i] = q->heap[parent];
+    i = parent;
+  }
+  q->heap[i] = ev;
+}
+
+int event_queue_pop(EventQueue *q, SimEvent *out) {
+  if (q->size == 0) return 0;
+
+  *out = q->heap[0];
+  SimEvent last = q->heap[--q->size];
+
+  // Sift down
+  int i = 0;
+  while (1) {
+    int child = 2 * i + 1;
+    if (child >= q->size) break;
+    if (child + 1 < q->size && event_before(&q->heap[child + 1], &q->heap[child])) child++;
+    if (!event_before(&q->heap[child], &last)) break;
+    q->heap[i] = q->heap[child];
+    i = child;
+  }
+  if (q->size > 0) q->heap[i] = last;
+
+  return 1;
+}
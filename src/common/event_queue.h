@@ -0,0 +1,69 @@
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+/**
+ * @file event_queue.h
+ * @brief Event calendar (binary min-heap) for discrete-event simulation.
+ *
+ * Events are ordered by time. Events scheduled for the same time are popped in
+ * the order they were pushed (FIFO), which keeps simulations deterministic.
+ * Push and pop are O(log n).
+ */
+
+/**
+ * @brief Single scheduled event.
+ */
+typedef struct {
+  long long time_us;  /**< Simulated time of the event in microseconds. */
+  unsigned long seq;  /**< Insertion order, tie breaker for equal times. */
+  int type;           /**< Event type, defined by the simulation. */
+  int id;             /**< Entity the event belongs to (worker, truck...). */
+  long tag;           /**< Extra payload, e.g. generation counter of the entity. */
+} SimEvent;
+
+/**
+ * @brief Event calendar. Grows automatically.
+ */
+typedef struct {
+  SimEvent *heap;          /**< Heap ordered array of events. */
+  int size;                /**< Number of scheduled events. */
+  int capacity;            /**< Allocated heap slots. */
+  unsigned long next_seq;  /**< Sequence number of the next pushed event. */
+} EventQueue;
+
+/**
+ * @brief Allocates an empty event calendar.
+ *
+ * @param q        Calendar to initialize.
+ * @param capacity Initial number of slots (grows on demand).
+ */
+void event_queue_init(EventQueue *q, int capacity);
+
+/**
+ * @brief Releases calendar memory.
+ *
+ * @param q Calendar to release.
+ */
+void event_queue_free(EventQueue *q);
+
+/**
+ * @brief Schedules an event.
+ *
+ * @param q       Calendar.
+ * @param time_us Simulated time of the event.
+ * @param type    Event type.
+ * @param id      Entity id.
+ * @param tag     Extra payload.
+ */
+void event_queue_push(EventQueue *q, long long time_us, int type, int id, long tag);
+
+/**
+ * @brief Removes the earliest event.
+ *
+ * @param q   Calendar.
+ * @param out Receives the event.
+ * @return 1 if an event was popped, 0 if the calendar is empty.
+ */
+int event_queue_pop(EventQueue *q, SimEvent *out);
+
+#endif // EVENT_QUEUE_H
@@ -0,0 +1,35 @@
+#define _GNU_SOURCE
+#include "futex_wrapper.h"
+
+#include <errno.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+void futex_wait(unsigned int *uaddr, unsigned int expected) {
+  if (syscall(SYS_futex, uaddr, FUTEX_WAIT, expected, NULL, NULL, 0) == -1) {
+    // Value already changed or signal arrived, caller re-checks its condition
+    if (errno == EAGAIN || errno == EINTR) return;
+    perror("Futex wrapper: FUTEX_WAIT error");
+    exit(1);
+  }
+}
+
+void futex_wait_timeout(unsigned int *uaddr, unsigned int expected, uint64_t timeout_ns) {
+  struct timespec ts = {timeout_ns / 1000000000ull, timeout_ns % 1000000000ull};
+  if (syscall(SYS_futex, uaddr, FUTEX_WAIT, expected, &ts, NULL, 0) == -1) {
+    if (errno == EAGAIN || errno == EINTR || errno == ETIMEDOUT) return;
+    perror("Futex wrapper: FUTEX_WAIT error");
+    exit(1);
+  }
+}
+
+void futex_wake(unsigned int *uaddr, int count) {
+  if (syscall(SYS_futex, uaddr, FUTEX_WAKE, count, NULL, NULL, 0) == -1) {
+    perror("Futex wrapper: FUTEX_WAKE error");
+    exit(1);
+  }
+}
@@ -0,0 +1,50 @@
+#ifndef FUTEX_WRAPPER_H
+#define FUTEX_WRAPPER_H
+
+#include <stdint.h>
+
+/**
+ * @file futex_wrapper.h
+ * @brief Wrapper functions for Linux futexes placed in Shared Memory.
+ *
+ * A futex word is a plain 32-bit integer that lives in the attached shared
+ * memory block. Processes only enter the kernel when they actually have to
+ * sleep or when somebody is known to be sleeping, which makes futexes a cheap
+ * blocking fallback for lock-free structures.
+ *
+ * Futexes are used in shared (non-private) mode, so waiters and wakers may
+ * belong to different processes attached to the same System V segment.
+ */
+
+/**
+ * @brief Sleeps while the futex word still holds the expected value.
+ *
+ * Returns immediately if `*uaddr != expected` at the time of the call.
+ * Spurious wakeups, signal interruptions (`EINTR`) and value mismatches
+ * (`EAGAIN`) are not errors: the caller is expected to re-check its condition.
+ *
+ * @param uaddr    Address of the futex word (in shared memory).
+ * @param expected Value the caller observed before deciding to sleep.
+ */
+void futex_wait(unsigned int *uaddr, unsigned int expected);
+
+/**
+ * @brief @ref futex_wait that gives up after a timeout.
+ *
+ * A timeout is no error either, the caller re-checks its condition.
+ *
+ * @param uaddr      Address of the futex word (in shared memory).
+ * @param expected   Value the caller observed before deciding to sleep.
+ * @param timeout_ns Longest sleep in nanoseconds.
+ */
+void futex_wait_timeout(unsigned int *uaddr, unsigned int expected, uint64_t timeout_ns);
+
+/**
+ * @brief Wakes processes sleeping on a futex word.
+ *
+ * @param uaddr Address of the futex word (in shared memory).
+ * @param count Maximum number of waiters to wake (use INT_MAX for all).
+ */
+void futex_wake(unsigned int *uaddr, int count);
+
+#endif // FUTEX_WRAPPER_H
@@ -0,0 +1,62 @@
+#include "histogram.h"
+
+int hist_bucket(uint64_t value) {
+  if (value < HIST_SUB_BUCKETS) return (int)value;
+
+  // Highest set bit selects the power of two range, the following bits the sub-bucket
+  int msb = 63 - __builtin_clzll(value);
+  int sub = (int)(value >> (msb - HIST_SUB_BITS)) & (HIST_SUB_BUCKETS - 1);
+  return (msb - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS + sub;
+}
+
+uint64_t hist_bucket_max(int bucket) {
+  if (bucket < HIST_SUB_BUCKETS) return (uint64_t)bucket;
+
+  int range = bucket / HIST_SUB_BUCKETS;
+  int sub = bucket % HIST_SUB_BUCKETS;
+  int shift = range - 1;
+  uint64_t low = (uint64_t)(HIST_SUB_BUCKETS + sub) << shift;
+  return low + ((uint64_t)1 << shift) - 1;
+}
+
+void hist_record(Histogram *hist, uint64_t value) {
+  __atomic_add_fetch(&hist->buckets[hist_bucket(value)], 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&hist->count, 1, __ATOMIC_RELAXED);
+
+  uint64_t max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+  while (value > max &&
+	 !__atomic_compare_exchange_n(&hist->max, &max, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+uint64_t hist_percentile(const Histogram *hist, double p) {
+  uint64_t count = __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+  if (count == 0) return 0;
+
+  // Rank of the value at percentile p, 1-based
+  uint64_t rank = (uint64_t)(p / 100.0 * count + 0.5);
+  if (rank < 1) rank = 1;
+  if (rank > count) rank = count;
+
+  uint64_t max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+  uint64_t seen = 0;
+  for (int b = 0; b < HIST_BUCKETS; ++b) {
+    seen += __atomic_load_n(&hist->buckets[b], __ATOMIC_RELAXED);
+    if (seen >= rank) {
+      uint64_t v = hist_bucket_max(b);
+      return v < max ? v : max;
+    }
+  }
+  return max;
+}
+
+void hist_merge(Histogram *dst, const Histogram *src) {
+  // Count is summed from the buckets read, so it matches them while src keeps growing
+  for (int b = 0; b < HIST_BUCKETS; ++b) {
+    uint64_t n = __atomic_load_n(&src->buckets[b], __ATOMIC_RELAXED);
+    dst->buckets[b] += n;
+    dst->count += n;
+  }
+
+  uint64_t max = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+  if (max > dst->max) dst->max = max;
+}
@@ -0,0 +1,80 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+/**
+ * @file histogram.h
+ * @brief Log-linear latency histogram that lives in Shared Memory.
+ *
+ * Values below @ref HIST_SUB_BUCKETS get a bucket of their own. Every higher
+ * power of two range is split into @ref HIST_SUB_BUCKETS equal buckets, so a
+ * reported percentile is at most 1/16 (6.25 %) above the recorded value over
+ * the whole uint64 range.
+ *
+ * The histogram is a plain array of counters without pointers, recording is
+ * one relaxed atomic increment, so processes attached to the same segment can
+ * record into it concurrently without locks.
+ */
+
+/** @brief Sub-buckets per power of two (bits of precision). */
+#define HIST_SUB_BITS 4
+/** @brief Number of sub-buckets per power of two. */
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+/** @brief Total number of buckets covering the uint64 range. */
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+/**
+ * @brief Histogram of recorded values (e.g. nanoseconds).
+ */
+typedef struct {
+  uint64_t count;                  /**< Number of recorded values. */
+  uint64_t max;                    /**< Largest recorded value. */
+  uint64_t buckets[HIST_BUCKETS];  /**< Counters per bucket (@ref hist_bucket). */
+} Histogram;
+
+/**
+ * @brief Bucket index of a value.
+ *
+ * @param value Recorded value.
+ * @return Bucket index (0 .. HIST_BUCKETS-1).
+ */
+int hist_bucket(uint64_t value);
+
+/**
+ * @brief Largest value that falls into a bucket.
+ *
+ * @param bucket Bucket index.
+ * @return Upper bound of the bucket (inclusive).
+ */
+uint64_t hist_bucket_max(int bucket);
+
+/**
+ * @brief Records a value, safe to call concurrently from several processes.
+ *
+ * @param hist  Histogram (usually in Shared Memory).
+ * @param value Value to record.
+ */
+void hist_record(Histogram *hist, uint64_t value);
+
+/**
+ * @brief Value at a percentile.
+ *
+ * @param hist Histogram.
+ * @param p    Percentile (0-100), e.g. 99.9.
+ * @return Upper bound of the bucket holding the percentile (never above the
+ * recorded maximum), 0 if the histogram is empty.
+ */
+uint64_t hist_percentile(const Histogram *hist, double p);
+
+/**
+ * @brief Adds all values of one histogram to another.
+ *
+ * The source may be updated concurrently, every counter is read atomically.
+ *
+ * @param dst Target histogram (private copy).
+ * @param src Source histogram.
+ */
+void hist_merge(Histogram *dst, const Histogram *src);
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,108 @@
+#include "log.h"
+#include "common.h"
+
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_BUF_SIZE 16384
+#define LOG_RECORD_MAX 512
+
+// Logger state is per thread, so roles running as threads (--threads) keep
+// their own tag and buffer, exactly as they do as processes
+static _Thread_local char log_buf[LOG_BUF_SIZE];
+static _Thread_local size_t log_len = 0;
+static _Thread_local long long log_oldest_ms = 0; // Time of the first record in the buffer
+
+static _Thread_local const char *log_tag = "";
+static _Thread_local int log_level = LOG_LEVEL_INFO;
+
+static int log_fd = STDOUT_FILENO;
+static int log_atexit_done = 0;
+
+// Timestamp cache
+static _Thread_local long long cached_ms = -1;
+static _Thread_local time_t cached_sec = -1;
+static _Thread_local char cached_hms[16];  // HH:MM:SS, refreshed once per second
+static _Thread_local char cached_stamp[32]; // HH:MM:SS.mmm, refreshed once per millisecond
+
+static long long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+  return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static const char *log_stamp(long long ms) {
+  if (ms == cached_ms) return cached_stamp;
+
+  time_t sec = ms / 1000;
+  if (sec != cached_sec) {
+    struct tm t;
+    localtime_r(&sec, &t);
+    strftime(cached_hms, sizeof(cached_hms), "%H:%M:%S", &t);
+    cached_sec = sec;
+  }
+  snprintf(cached_stamp, sizeof(cached_stamp), "%s.%03d", cached_hms, (int)(ms % 1000));
+  cached_ms = ms;
+  return cached_stamp;
+}
+
+void log_init(const char *tag, int level) {
+  log_tag = tag;
+  log_level = level;
+  // Flushes the thread calling exit(), threads flush themselves before returning
+  if (!__atomic_exchange_n(&log_atexit_done, 1, __ATOMIC_RELAXED)) atexit(log_flush);
+}
+
+void log_set_fd(int fd) {
+  log_fd = fd;
+}
+
+void log_flush(void) {
+  size_t off = 0;
+  while (off < log_len) {
+    ssize_t n = write(log_fd, log_buf + off, log_len - off);
+    if (n == -1) {
+      if (errno == EINTR) continue;
+      break; // Log is lost, simulation goes on
+    }
+    off += n;
+  }
+  log_len = 0;
+}
+
+void log_write(int level, const char *fmt, ...) {
+  if (level > log_level) return;
+
+  long long ms = now_ms();
+  const char *color = level == LOG_LEVEL_ERROR ? COLOR_RED : (level == LOG_LEVEL_WARN ? COLOR_YELLOW : COLOR_GREEN);
+
+  // Whole record is built first, the buffer only ever holds complete records
+  char rec[LOG_RECORD_MAX];
+  int len = snprintf(rec, sizeof(rec), "[%s%s" COLOR_RESET "]%s" COLOR_RESET, color, log_stamp(ms), log_tag);
+
+  va_list args;
+  va_start(args, fmt);
+  len += vsnprintf(rec + len, sizeof(rec) - len, fmt, args);
+  va_end(args);
+
+  if (len > (int)sizeof(rec) - 2) len = sizeof(rec) - 2; // Truncated record
+  rec[len++] = '\n';
+
+  if (log_len + len > sizeof(log_buf)) log_flush();
+  if (log_len == 0) log_oldest_ms = ms;
+
+  memcpy(log_buf + log_len, rec, len);
+  log_len += len;
+
+  if (ms - log_oldest_ms >= LOG_FLUSH_MS) log_flush();
+}
+
+int log_level_parse(const char *name) {
+  if (strcmp(name, "error") == 0) return LOG_LEVEL_ERROR;
+  if (strcmp(name, "warn") == 0) return LOG_LEVEL_WARN;
+  if (strcmp(name, "info") == 0) return LOG_LEVEL_INFO;
+  if (strcmp(name, "debug") == 0) return LOG_LEVEL_DEBUG;
+  return -1;
+}
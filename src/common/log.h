@@ -0,0 +1,113 @@
+#ifndef LOG_H
+#define LOG_H
+
+/**
+ * @file log.h
+ * @brief Buffered, leveled logger of the child processes.
+ *
+ * Records are formatted into a per-process buffer and written with a single
+ * `write()` of whole records, so lines of different processes never interleave
+ * in `simulation.log`. The buffer is flushed when it is full, when the oldest
+ * record is older than @ref LOG_FLUSH_MS, on @ref log_flush and at exit.
+ *
+ * The timestamp is cached and only reformatted once per millisecond
+ * (`localtime_r()` once per second), instead of a `localtime()` call per line.
+ *
+ * Levels are filtered twice:
+ * - **Compile time:** Records above @ref LOG_COMPILE_LEVEL compile out entirely,
+ * arguments included. Set with `cmake .. -DLOG_LEVEL=INFO`.
+ * - **Run time:** Records above the level given to @ref log_init are dropped
+ * before formatting. Set with the Dispatcher option `--log-level`.
+ *
+ * Logger state is thread-local, every thread of a `--threads` run is set up
+ * with @ref log_init and buffers its records like a process would.
+ *
+ * Logging must never happen while @ref SEM_MUTEX is held, callers copy what they
+ * need inside the critical section and log after it.
+ */
+
+/**
+ * @name Log Levels
+ * @{
+ */
+#define LOG_LEVEL_ERROR 0 /**< Failures. */
+#define LOG_LEVEL_WARN  1 /**< Unusual situations (limits reached, forced departures). */
+#define LOG_LEVEL_INFO  2 /**< State changes (docking, departures, deliveries). */
+#define LOG_LEVEL_DEBUG 3 /**< Hot path, one record per package. */
+/** @} */
+
+#ifndef LOG_COMPILE_LEVEL
+/** @brief Most verbose level compiled in. */
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+/** @brief Longest time a record waits in the buffer before it is written. */
+#define LOG_FLUSH_MS 200
+
+/**
+ * @brief Sets up the logger of the calling process or thread.
+ *
+ * Records go to stdout (redirected to `simulation.log` by the Dispatcher),
+ * see @ref log_set_fd. The first call registers @ref log_flush with `atexit()`.
+ *
+ * @param tag   Process tag printed after the timestamp (e.g. colored " P1  ").
+ * @param level Most verbose level written at run time.
+ */
+void log_init(const char *tag, int level);
+
+/**
+ * @brief Changes the file descriptor all records are written to.
+ *
+ * Used by the Dispatcher in threads mode, where roles share its stdout and
+ * write straight to `simulation.log` instead.
+ *
+ * @param fd Open file descriptor, stdout by default.
+ */
+void log_set_fd(int fd);
+
+/**
+ * @brief Formats a record into the process buffer.
+ *
+ * Use the LOG_* macros, they compile out records above @ref LOG_COMPILE_LEVEL.
+ *
+ * @param level Level of the record.
+ * @param fmt   printf-style format of the message (without trailing newline).
+ */
+void log_write(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Writes all buffered records.
+ *
+ * Called before the process sleeps for a long time, so the log stays current.
+ */
+void log_flush(void);
+
+/**
+ * @brief Parses a level name (error, warn, info, debug).
+ *
+ * @param name Level name.
+ * @return Level, or -1 if the name is unknown.
+ */
+int log_level_parse(const char *name);
+
+#define LOG_ERROR(...) log_write(LOG_LEVEL_ERROR, __VA_ARGS__) /**< Logs an error record. */
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) log_write(LOG_LEVEL_WARN, __VA_ARGS__) /**< Logs a warning record. */
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) log_write(LOG_LEVEL_INFO, __VA_ARGS__) /**< Logs an info record. */
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) log_write(LOG_LEVEL_DEBUG, __VA_ARGS__) /**< Logs a hot path record. */
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#endif // LOG_H
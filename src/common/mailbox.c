@@ -0,0 +1,81 @@
+#include "mailbox.h"
+#include "futex_wrapper.h"
+
+#include <time.h>
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Doorbell bump is ordered after the published slot, waiters re-check before sleeping
+void mailbox_kick(Mailbox *mb) {
+  __atomic_add_fetch(&mb->doorbell, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&mb->waiters, __ATOMIC_SEQ_CST) > 0) {
+    futex_wake(&mb->doorbell, 1);
+  }
+}
+
+uint64_t mailbox_post(Mailbox *mb, CommandType type, int dock, int count) {
+  uint64_t pos = __atomic_load_n(&mb->tail, __ATOMIC_RELAXED);
+  Command *slot;
+
+  while (1) {
+    slot = &mb->slots[pos % MAILBOX_SLOTS];
+    uint64_t turn = __atomic_load_n(&slot->turn, __ATOMIC_ACQUIRE);
+    uint64_t free_turn = 2 * (pos / MAILBOX_SLOTS);
+
+    if (turn == free_turn) {
+      // Free slot, claim its position
+      if (__atomic_compare_exchange_n(&mb->tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+    }
+    else if (turn < free_turn) {
+      // Slot still holds the command of the previous lap
+      __atomic_add_fetch(&mb->full, 1, __ATOMIC_RELAXED);
+      return 0;
+    }
+    else {
+      pos = __atomic_load_n(&mb->tail, __ATOMIC_RELAXED);
+    }
+  }
+
+  slot->t_post_ns = now_ns();
+  slot->type = type;
+  slot->dock = dock;
+  slot->count = count;
+  slot->seq = pos + 1;
+  __atomic_store_n(&slot->turn, 2 * (pos / MAILBOX_SLOTS) + 1, __ATOMIC_RELEASE);
+
+  mailbox_kick(mb);
+  return pos + 1;
+}
+
+int mailbox_take(Mailbox *mb, Command *out) {
+  uint64_t pos = mb->head;
+  Command *slot = &mb->slots[pos % MAILBOX_SLOTS];
+  uint64_t turn = 2 * (pos / MAILBOX_SLOTS);
+
+  if (__atomic_load_n(&slot->turn, __ATOMIC_ACQUIRE) != turn + 1) return 0;
+
+  *out = *slot;
+  __atomic_store_n(&slot->turn, turn + 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&mb->head, pos + 1, __ATOMIC_RELAXED);
+  return 1;
+}
+
+uint64_t mailbox_done(Mailbox *mb, const Command *cmd) {
+  __atomic_store_n(&mb->done, cmd->seq, __ATOMIC_RELEASE);
+  uint64_t now = now_ns();
+  return now > cmd->t_post_ns ? now - cmd->t_post_ns : 0;
+}
+
+unsigned int mailbox_doorbell(Mailbox *mb) {
+  return __atomic_load_n(&mb->doorbell, __ATOMIC_SEQ_CST);
+}
+
+void mailbox_wait(Mailbox *mb, unsigned int seen) {
+  __atomic_add_fetch(&mb->waiters, 1, __ATOMIC_SEQ_CST);
+  futex_wait(&mb->doorbell, seen);
+  __atomic_sub_fetch(&mb->waiters, 1, __ATOMIC_SEQ_CST);
+}
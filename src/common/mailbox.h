@@ -0,0 +1,124 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <stdint.h>
+
+/**
+ * @file mailbox.h
+ * @brief Command mailboxes in Shared Memory, Dispatcher to roles.
+ *
+ * A mailbox is a bounded ring of @ref Command entries with any number of
+ * senders and one receiver. Every slot carries the lap it is in (Vyukov
+ * ring): a sender claims a position with a CAS on @ref Mailbox::tail and
+ * publishes the slot by making its `turn` odd, the receiver frees it for the
+ * next lap by making it even again. A zeroed mailbox is empty, so it needs no
+ * setup in a fresh segment. Commands are never merged or lost, a full mailbox
+ * is reported to the sender.
+ *
+ * Posting bumps the @ref Mailbox::doorbell futex word. A receiver reads the
+ * doorbell, checks the mailbox and sleeps with @ref mailbox_wait on the value
+ * it read, so a command posted between the check and the sleep wakes it at
+ * once. Receivers that sleep on another futex (a truck waiting for packages)
+ * are woken by the sender through that futex instead.
+ *
+ * Every command is stamped when posted, the receiver records the time until it
+ * was executed (@ref SimStats::command_ns) and stores its sequence number in
+ * @ref Mailbox::done, so a sender can tell when a command took effect.
+ */
+
+/** @brief Commands a mailbox holds (power of two). */
+#define MAILBOX_SLOTS 32
+
+/**
+ * @brief Commands sent by the Dispatcher.
+ */
+typedef enum {
+  CMD_FORCE_DEPART, /**< Docked truck leaves at once, whatever its load. */
+  CMD_EXPRESS_LOAD, /**< Express worker loads packages into the truck at a dock. */
+  CMD_END           /**< Number of command types. */
+} CommandType;
+
+/**
+ * @brief A command with its arguments.
+ */
+typedef struct {
+  uint64_t turn;      /**< Slot state: 2 * lap when free, 2 * lap + 1 when published. */
+  uint64_t seq;       /**< Sequence number of the command (1, 2, ...). */
+  uint64_t t_post_ns; /**< CLOCK_MONOTONIC time the command was posted (ns). */
+  uint32_t type;      /**< @ref CommandType */
+  int32_t dock;       /**< Dock index the command addresses. */
+  int32_t count;      /**< Packages to load with @ref CMD_EXPRESS_LOAD, 0 = random. */
+  int32_t reserved;   /**< Padding. */
+} Command;
+
+/**
+ * @brief Command ring of one receiver.
+ */
+typedef struct {
+  unsigned int doorbell; /**< Futex word, bumped on every post. */
+  unsigned int waiters;  /**< Receivers sleeping in @ref mailbox_wait. */
+  uint64_t tail;         /**< Next position to claim (senders). */
+  uint64_t head;         /**< Next position to take (receiver). */
+  uint64_t done;         /**< Sequence number of the last executed command. */
+  uint64_t full;         /**< Posts rejected on a full mailbox. */
+  Command slots[MAILBOX_SLOTS]; /**< Ring of commands. */
+} __attribute__((aligned(64))) Mailbox;
+
+/**
+ * @brief Posts a command, safe to call from several senders at once.
+ *
+ * Wakes a receiver sleeping in @ref mailbox_wait.
+ *
+ * @param mb    Mailbox.
+ * @param type  Command type.
+ * @param dock  Dock index the command addresses.
+ * @param count Command argument (express packages, 0 = random).
+ * @return Sequence number of the command (1, 2, ...), 0 if the mailbox is full.
+ */
+uint64_t mailbox_post(Mailbox *mb, CommandType type, int dock, int count);
+
+/**
+ * @brief Takes the oldest command, receiver only.
+ *
+ * @param mb  Mailbox.
+ * @param out Receives the command, `seq` is its sequence number.
+ * @return 1 if a command was taken, 0 if the mailbox is empty.
+ */
+int mailbox_take(Mailbox *mb, Command *out);
+
+/**
+ * @brief Marks a taken command as executed.
+ *
+ * @param mb  Mailbox.
+ * @param cmd Command returned by @ref mailbox_take.
+ * @return Delivery latency, post until now (ns).
+ */
+uint64_t mailbox_done(Mailbox *mb, const Command *cmd);
+
+/**
+ * @brief Current doorbell value, read before checking the mailbox.
+ *
+ * @param mb Mailbox.
+ * @return Doorbell value to pass to @ref mailbox_wait.
+ */
+unsigned int mailbox_doorbell(Mailbox *mb);
+
+/**
+ * @brief Sleeps until a command is posted or the mailbox is kicked.
+ *
+ * Returns at once if the doorbell moved since `seen` was read. Spurious
+ * wakeups are possible, the caller re-checks the mailbox.
+ *
+ * @param mb   Mailbox.
+ * @param seen Doorbell value read before the mailbox was found empty.
+ */
+void mailbox_wait(Mailbox *mb, unsigned int seen);
+
+/**
+ * @brief Wakes the receiver without a command, e.g. to see a shutdown.
+ *
+ * @param mb Mailbox.
+ */
+void mailbox_kick(Mailbox *mb);
+
+#endif // MAILBOX_H
@@ -0,0 +1,144 @@
+#include "metrics.h"
+#include "shm_wrapper.h"
+#include "utils.h"
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * @brief Prometheus counter family read from one field of every entry.
+ */
+typedef struct {
+  const char *name;  /**< Metric name. */
+  const char *help;  /**< HELP text. */
+  size_t offset;     /**< Offset of the uint64_t field in the entry. */
+  int ns_to_seconds; /**< Field holds nanoseconds, exported in seconds. */
+} CounterDef;
+
+static const CounterDef worker_counters[] = {
+  {"warehouse_worker_packages_pushed_total", "Packages placed on the belt.", offsetof(WorkerMetrics, pushed), 0},
+  {"warehouse_worker_rejected_overweight_total", "Belt pushes rejected by the belt weight limit M.", offsetof(WorkerMetrics, rejected_overweight), 0},
+  {"warehouse_worker_push_wait_seconds_total", "Time spent in belt push, waiting for free slots and the belt lock.", offsetof(WorkerMetrics, push_wait_ns), 1},
+  {"warehouse_worker_express_loaded_total", "Express packages loaded directly into trucks.", offsetof(WorkerMetrics, express_loaded), 0},
+};
+
+static const CounterDef truck_counters[] = {
+  {"warehouse_truck_packages_loaded_total", "Packages loaded from the belt.", offsetof(TruckMetrics, popped), 0},
+  {"warehouse_truck_dockings_total", "Times the truck docked.", offsetof(TruckMetrics, dockings), 0},
+  {"warehouse_truck_deliveries_total", "Departures with a non-empty load.", offsetof(TruckMetrics, deliveries), 0},
+  {"warehouse_truck_forced_departures_total", "Departures forced by the dispatcher.", offsetof(TruckMetrics, forced_departures), 0},
+};
+
+static const CounterDef dock_counters[] = {
+  {"warehouse_dock_packages_loaded_total", "Packages loaded from the belt at the dock.", offsetof(DockMetrics, popped), 0},
+  {"warehouse_dock_deliveries_total", "Departures with a non-empty load from the dock.", offsetof(DockMetrics, deliveries), 0},
+  {"warehouse_dock_forced_departures_total", "Departures forced by the dispatcher at the dock.", offsetof(DockMetrics, forced_departures), 0},
+  {"warehouse_dock_express_loaded_total", "Express packages loaded at the dock.", offsetof(DockMetrics, express_loaded), 0},
+};
+
+// Entries used by processes while metrics are off, never exported
+static WorkerMetrics scratch_worker;
+static TruckMetrics scratch_truck;
+static DockMetrics scratch_dock;
+
+size_t metrics_segment_size(int N) {
+  return sizeof(MetricsBlock) + (size_t)N * sizeof(TruckMetrics);
+}
+
+void metrics_init(MetricsBlock *m, int N, int D, int workers) {
+  memset(m, 0, metrics_segment_size(N));
+  m->magic = METRICS_MAGIC;
+  m->version = METRICS_VERSION;
+  m->trucks = N;
+  m->docks = D;
+  m->worker_count = workers < METRICS_WORKERS ? workers : METRICS_WORKERS;
+  m->t0_ns = monotonic_ns();
+}
+
+MetricsBlock *metrics_attach(SharedState *shm) {
+  if (shm->metrics_trucks == 0) return NULL;
+
+  return attach_memory_block(KEY_PATH, KEY_ID_METRICS, 0);
+}
+
+WorkerMetrics *metrics_worker(MetricsBlock *m, int worker_id) {
+  if (!m || worker_id < 1 || worker_id > (int)m->worker_count) return &scratch_worker;
+  return &m->workers[worker_id - 1];
+}
+
+TruckMetrics *metrics_truck(MetricsBlock *m, int truck_id) {
+  if (!m || truck_id < 1 || truck_id > (int)m->trucks) return &scratch_truck;
+  return &m->truck[truck_id - 1];
+}
+
+DockMetrics *metrics_dock(MetricsBlock *m, int dock) {
+  if (!m || dock < 0 || dock >= MAX_DOCKS) return &scratch_dock;
+  return &m->dock[dock];
+}
+
+// One family, one sample per entry, entries are `stride` bytes apart
+static void write_family(FILE *out, const CounterDef *def, const char *label, const char *prefix,
+			 const void *first, size_t stride, int count) {
+  fprintf(out, "# HELP %s %s\n# TYPE %s counter\n", def->name, def->help, def->name);
+
+  for (int i = 0; i < count; ++i) {
+    const uint64_t *field = (const uint64_t *)((const char *)first + i * stride + def->offset);
+    uint64_t v = __atomic_load_n(field, __ATOMIC_RELAXED);
+
+    if (def->ns_to_seconds) {
+      fprintf(out, "%s{%s=\"%s%d\"} %.9f\n", def->name, label, prefix, i + 1, v / 1e9);
+    }
+    else {
+      fprintf(out, "%s{%s=\"%s%d\"} %" PRIu64 "\n", def->name, label, prefix, i + 1, v);
+    }
+  }
+}
+
+static void write_gauge(FILE *out, const char *name, const char *help) {
+  fprintf(out, "# HELP %s %s\n# TYPE %s gauge\n", name, help, name);
+}
+
+void metrics_write_prometheus(FILE *out, const MetricsBlock *m, const SharedState *shm) {
+  int D = (int)m->docks;
+
+  write_gauge(out, "warehouse_uptime_seconds", "Time since the simulation started.");
+  fprintf(out, "warehouse_uptime_seconds %.3f\n", (monotonic_ns() - m->t0_ns) / 1e9);
+
+  for (size_t i = 0; i < sizeof(worker_counters) / sizeof(worker_counters[0]); ++i) {
+    write_family(out, &worker_counters[i], "worker", "P", m->workers, sizeof(WorkerMetrics), (int)m->worker_count);
+  }
+  for (size_t i = 0; i < sizeof(truck_counters) / sizeof(truck_counters[0]); ++i) {
+    write_family(out, &truck_counters[i], "truck", "", m->truck, sizeof(TruckMetrics), (int)m->trucks);
+  }
+  for (size_t i = 0; i < sizeof(dock_counters) / sizeof(dock_counters[0]); ++i) {
+    write_family(out, &dock_counters[i], "dock", "", m->dock, sizeof(DockMetrics), D);
+  }
+
+  if (!shm) return;
+
+  // Belt and dock state, plain atomic loads without SEM_MUTEX
+  double belt_weight = g_to_kg(__atomic_load_n(&shm->current_belt_weight, __ATOMIC_RELAXED));
+
+  write_gauge(out, "warehouse_belt_packages", "Packages currently on the belt.");
+  fprintf(out, "warehouse_belt_packages %d\n", __atomic_load_n(&shm->current_count, __ATOMIC_RELAXED));
+  write_gauge(out, "warehouse_belt_capacity_packages", "Belt capacity K.");
+  fprintf(out, "warehouse_belt_capacity_packages %d\n", shm->max_items_K);
+  write_gauge(out, "warehouse_belt_weight_kg", "Weight currently on the belt.");
+  fprintf(out, "warehouse_belt_weight_kg %.3f\n", belt_weight);
+
+  write_gauge(out, "warehouse_belt_lane_packages", "Packages currently in the belt lane.");
+  for (int l = 0; l < shm->belt_lanes; ++l) {
+    fprintf(out, "warehouse_belt_lane_packages{lane=\"%d\"} %d\n", l + 1, __atomic_load_n(&shm->lanes[l].count, __ATOMIC_RELAXED));
+  }
+
+  write_gauge(out, "warehouse_dock_occupied", "1 if a truck stands at the dock.");
+  for (int d = 0; d < D; ++d) {
+    fprintf(out, "warehouse_dock_occupied{dock=\"%d\"} %d\n", d + 1, __atomic_load_n(&shm->docks[d].truck_docked, __ATOMIC_RELAXED));
+  }
+  write_gauge(out, "warehouse_dock_truck_load_kg", "Load of the truck at the dock.");
+  for (int d = 0; d < D; ++d) {
+    double load = g_to_kg(__atomic_load_n(&shm->docks[d].current_truck_load, __ATOMIC_RELAXED));
+    fprintf(out, "warehouse_dock_truck_load_kg{dock=\"%d\"} %.3f\n", d + 1, load);
+  }
+}
@@ -0,0 +1,148 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "common.h"
+
+/**
+ * @file metrics.h
+ * @brief Live counters in shared memory and their Prometheus text export.
+ *
+ * The Dispatcher creates a metrics segment (@ref KEY_ID_METRICS) next to the
+ * main one. Every worker, truck and dock owns an entry aligned to a cache
+ * line, so processes counting at the same time never write to the same line.
+ * Counters only grow and are updated with relaxed atomic adds, readers such as
+ * `warehouse_stats` take a consistent-enough snapshot with atomic loads and
+ * never touch @ref SEM_MUTEX.
+ *
+ * Segment layout: @ref MetricsBlock with @ref MetricsBlock::trucks entries of
+ * @ref TruckMetrics at its end.
+ */
+
+/** @brief Magic number of the metrics segment ("WMTR"). */
+#define METRICS_MAGIC 0x52544d57u
+/** @brief Version of the metrics layout. */
+#define METRICS_VERSION 2u
+/** @brief Worker entries: every standard worker (`--workers`) and the express worker. */
+#define METRICS_WORKERS (MAX_WORKERS_PER_TYPE * PKG_END + 1)
+
+/**
+ * @brief Counters of a worker (written by that worker only).
+ */
+typedef struct {
+  uint64_t pushed;              /**< Packages placed on the belt. */
+  uint64_t rejected_overweight; /**< Pushes rejected by belt weight limit M. */
+  uint64_t push_wait_ns;        /**< Time spent in belt push, waiting for free slots and the belt lock. */
+  uint64_t express_loaded;      /**< Express packages loaded directly into trucks (P4). */
+} __attribute__((aligned(CACHE_LINE_SIZE))) WorkerMetrics;
+
+/**
+ * @brief Counters of a truck (written by that truck only).
+ */
+typedef struct {
+  uint64_t popped;              /**< Packages loaded from the belt. */
+  uint64_t dockings;            /**< Times the truck docked. */
+  uint64_t deliveries;          /**< Departures with a non-empty load. */
+  uint64_t forced_departures;   /**< Departures forced by the Dispatcher. */
+} __attribute__((aligned(CACHE_LINE_SIZE))) TruckMetrics;
+
+/**
+ * @brief Counters of a loading dock (written by the docked truck and P4).
+ */
+typedef struct {
+  uint64_t popped;              /**< Packages loaded from the belt at this dock. */
+  uint64_t deliveries;          /**< Departures with a non-empty load. */
+  uint64_t forced_departures;   /**< Departures forced by the Dispatcher. */
+  uint64_t express_loaded;      /**< Express packages loaded at this dock. */
+} __attribute__((aligned(CACHE_LINE_SIZE))) DockMetrics;
+
+/**
+ * @brief Metrics segment.
+ */
+typedef struct {
+  uint32_t magic;               /**< @ref METRICS_MAGIC */
+  uint32_t version;             /**< @ref METRICS_VERSION */
+  uint32_t trucks;              /**< Number of truck entries (N). */
+  uint32_t docks;               /**< Number of docks in use (D). */
+  uint32_t worker_count;        /**< Number of worker entries in use, standard workers and the express worker. */
+  uint64_t t0_ns;               /**< Start of the run, CLOCK_MONOTONIC in ns. */
+  WorkerMetrics workers[METRICS_WORKERS]; /**< Index worker number - 1, the express worker is last. */
+  DockMetrics dock[MAX_DOCKS];  /**< Per-dock counters. */
+  TruckMetrics truck[];         /**< Per-truck counters, index truck id - 1. */
+} __attribute__((aligned(CACHE_LINE_SIZE))) MetricsBlock;
+
+/**
+ * @brief Size of a metrics segment.
+ *
+ * @param N Number of trucks.
+ * @return Segment size in bytes.
+ */
+size_t metrics_segment_size(int N);
+
+/**
+ * @brief Initializes an empty metrics segment.
+ *
+ * @param m Start of the segment (@ref metrics_segment_size bytes).
+ * @param N Number of trucks.
+ * @param D Number of docks.
+ * @param workers Number of workers, standard workers and the express worker.
+ */
+void metrics_init(MetricsBlock *m, int N, int D, int workers);
+
+/**
+ * @brief Attaches the metrics segment if the Dispatcher created one.
+ *
+ * @param shm Pointer to the attached SharedState structure.
+ * @return The segment, NULL when metrics are off.
+ */
+MetricsBlock *metrics_attach(SharedState *shm);
+
+/**
+ * @brief Counters of a worker.
+ *
+ * @param m         Metrics segment or NULL.
+ * @param worker_id Worker number (1..@ref MetricsBlock::worker_count).
+ * @return The entry. With metrics off a process-local scratch entry, so callers never branch.
+ */
+WorkerMetrics *metrics_worker(MetricsBlock *m, int worker_id);
+
+/**
+ * @brief Counters of a truck.
+ *
+ * @param m        Metrics segment or NULL.
+ * @param truck_id Truck id (1..N).
+ * @return The entry, a process-local scratch entry with metrics off or an unknown id.
+ */
+TruckMetrics *metrics_truck(MetricsBlock *m, int truck_id);
+
+/**
+ * @brief Counters of a dock.
+ *
+ * @param m    Metrics segment or NULL.
+ * @param dock Dock index (0..D-1).
+ * @return The entry, a process-local scratch entry with metrics off.
+ */
+DockMetrics *metrics_dock(MetricsBlock *m, int dock);
+
+/**
+ * @brief Adds to a counter, safe against concurrent readers and writers.
+ *
+ * @param counter Counter in a metrics entry.
+ * @param n       Amount to add.
+ */
+static inline void metrics_add(uint64_t *counter, uint64_t n) {
+  __atomic_add_fetch(counter, n, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Writes all counters in Prometheus text exposition format (0.0.4).
+ *
+ * @param out Output stream.
+ * @param m   Metrics segment.
+ * @param shm Main segment for belt and dock gauges, may be NULL.
+ */
+void metrics_write_prometheus(FILE *out, const MetricsBlock *m, const SharedState *shm);
+
+#endif // METRICS_H
@@ -0,0 +1,298 @@
+#define _GNU_SOURCE // sched_setaffinity, cpu_set_t
+#include "placement.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const char *role_names[PIN_END] = {"dispatcher", "workers", "express", "trucks"};
+
+void cpu_mask_zero(CpuMask *m) {
+  memset(m, 0, sizeof(*m));
+}
+
+void cpu_mask_set(CpuMask *m, int cpu) {
+  if (cpu >= 0 && cpu < PLACEMENT_MAX_CPUS) m->bits[cpu / 64] |= 1ull << (cpu % 64);
+}
+
+int cpu_mask_isset(const CpuMask *m, int cpu) {
+  return cpu >= 0 && cpu < PLACEMENT_MAX_CPUS && (m->bits[cpu / 64] >> (cpu % 64) & 1);
+}
+
+int cpu_mask_count(const CpuMask *m) {
+  int n = 0;
+  for (int i = 0; i < PLACEMENT_MAX_CPUS / 64; ++i) n += __builtin_popcountll(m->bits[i]);
+  return n;
+}
+
+int cpu_mask_first(const CpuMask *m) {
+  for (int i = 0; i < PLACEMENT_MAX_CPUS / 64; ++i) {
+    if (m->bits[i]) return i * 64 + __builtin_ctzll(m->bits[i]);
+  }
+  return -1;
+}
+
+static void cpu_mask_and(CpuMask *m, const CpuMask *other) {
+  for (int i = 0; i < PLACEMENT_MAX_CPUS / 64; ++i) m->bits[i] &= other->bits[i];
+}
+
+static void cpu_mask_or(CpuMask *m, const CpuMask *other) {
+  for (int i = 0; i < PLACEMENT_MAX_CPUS / 64; ++i) m->bits[i] |= other->bits[i];
+}
+
+int cpu_mask_parse(const char *text, CpuMask *out) {
+  CpuMask m;
+  cpu_mask_zero(&m);
+
+  const char *p = text;
+  while (1) {
+    char *end;
+    long lo = strtol(p, &end, 10);
+    if (end == p || lo < 0) return -1;
+    long hi = lo;
+    if (*end == '-') {
+      p = end + 1;
+      hi = strtol(p, &end, 10);
+      if (end == p || hi < lo) return -1;
+    }
+    if (hi >= PLACEMENT_MAX_CPUS) return -1;
+    for (long c = lo; c <= hi; ++c) cpu_mask_set(&m, (int)c);
+
+    if (*end == '\0' || *end == '\n') break;
+    if (*end != ',') return -1;
+    p = end + 1;
+  }
+
+  *out = m;
+  return 0;
+}
+
+void cpu_mask_format(const CpuMask *m, char *buf, size_t size) {
+  size_t len = 0;
+  buf[0] = '\0';
+
+  for (int c = 0; c < PLACEMENT_MAX_CPUS && len < size; ++c) {
+    if (!cpu_mask_isset(m, c)) continue;
+    int last = c;
+    while (cpu_mask_isset(m, last + 1)) ++last;
+
+    int n = last == c ? snprintf(buf + len, size - len, "%s%d", len ? "," : "", c)
+                      : snprintf(buf + len, size - len, "%s%d-%d", len ? "," : "", c, last);
+    if (n < 0) break;
+    len += (size_t)n;
+    c = last;
+  }
+
+  if (len == 0) snprintf(buf, size, "-");
+}
+
+const char *placement_role_name(int role) {
+  return role >= 0 && role < PIN_END ? role_names[role] : "?";
+}
+
+void placement_init(Placement *p) {
+  memset(p, 0, sizeof(*p));
+  p->layout = PLACE_NONE;
+  p->mem_node = -1;
+}
+
+int placement_parse_option(const char *text, Placement *p) {
+  if (strcmp(text, "l3") == 0 || strcmp(text, "spread") == 0) {
+    p->layout = text[0] == 'l' ? PLACE_L3 : PLACE_SPREAD;
+    return 0;
+  }
+
+  const char *eq = strchr(text, '=');
+  if (!eq) return -1;
+  size_t len = (size_t)(eq - text);
+
+  if (len == 3 && strncmp(text, "mem", 3) == 0) {
+    char *end;
+    long node = strtol(eq + 1, &end, 10);
+    if (end == eq + 1 || *end != '\0' || node < 0 || node >= PLACEMENT_MAX_NODES) return -1;
+    p->mem_node = (int)node;
+  }
+  else {
+    int role = -1;
+    for (int r = 0; r < PIN_END; ++r) {
+      if (strlen(role_names[r]) == len && strncmp(text, role_names[r], len) == 0) role = r;
+    }
+    if (role == -1 || cpu_mask_parse(eq + 1, &p->cpus[role]) == -1) return -1;
+  }
+
+  if (p->layout == PLACE_NONE) p->layout = PLACE_MANUAL;
+  return 0;
+}
+
+// First line of a small sysfs file, -1 if it cannot be read
+static int read_line(const char *path, char *buf, size_t size) {
+  FILE *f = fopen(path, "r");
+  if (!f) return -1;
+  char *ok = fgets(buf, (int)size, f);
+  fclose(f);
+  return ok ? 0 : -1;
+}
+
+// CPUs sharing the L3 (or the last level cache below it) with a CPU, -1 without cache information
+static int cache_domain_of(const char *cpu_root, int cpu, CpuMask *out) {
+  char path[256], text[4096];
+  int found = -1, best_level = 0;
+
+  for (int idx = 0; idx < 16; ++idx) {
+    snprintf(path, sizeof(path), "%s/cpu%d/cache/index%d/level", cpu_root, cpu, idx);
+    if (read_line(path, text, sizeof(text)) == -1) break;
+    int level = atoi(text);
+    if (level > 3 || level < best_level) continue;
+
+    snprintf(path, sizeof(path), "%s/cpu%d/cache/index%d/shared_cpu_list", cpu_root, cpu, idx);
+    if (read_line(path, text, sizeof(text)) == -1 || cpu_mask_parse(text, out) == -1) continue;
+    best_level = level;
+    found = 0;
+  }
+  return found;
+}
+
+int cpu_node_of(const char *cpu_root, int cpu) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/cpu%d", cpu_root, cpu);
+
+  DIR *dir = opendir(path);
+  if (!dir) return 0;
+
+  int node = 0;
+  struct dirent *e;
+  while ((e = readdir(dir))) {
+    char *end;
+    if (strncmp(e->d_name, "node", 4) != 0) continue;
+    long n = strtol(e->d_name + 4, &end, 10);
+    if (end != e->d_name + 4 && *end == '\0') {
+      node = (int)n;
+      break;
+    }
+  }
+  closedir(dir);
+  return node;
+}
+
+// Lower half of a set to the producers, upper half to the consumers, both the whole set on one CPU
+static void split_domain(const CpuMask *domain, CpuMask *producers, CpuMask *consumers) {
+  int n = cpu_mask_count(domain);
+  if (n < 2) {
+    *producers = *consumers = *domain;
+    return;
+  }
+
+  cpu_mask_zero(producers);
+  cpu_mask_zero(consumers);
+  for (int c = 0, i = 0; c < PLACEMENT_MAX_CPUS; ++c) {
+    if (!cpu_mask_isset(domain, c)) continue;
+    cpu_mask_set(i++ < (n + 1) / 2 ? producers : consumers, c);
+  }
+}
+
+int placement_resolve(Placement *p, const char *cpu_root, const CpuMask *allowed) {
+  if (p->layout == PLACE_NONE) return 0;
+
+  char path[256], text[4096];
+  CpuMask online;
+  snprintf(path, sizeof(path), "%s/online", cpu_root);
+  if (read_line(path, text, sizeof(text)) == -1 || cpu_mask_parse(text, &online) == -1) return -1;
+  cpu_mask_and(&online, allowed);
+  if (cpu_mask_count(&online) == 0) return -1;
+
+  // L3 domains in order of their lowest CPU, the first two are used
+  CpuMask domains[2], seen;
+  int kept = 0;
+  cpu_mask_zero(&seen);
+  p->l3_domains = 0;
+  for (int c = 0; c < PLACEMENT_MAX_CPUS; ++c) {
+    if (!cpu_mask_isset(&online, c) || cpu_mask_isset(&seen, c)) continue;
+
+    CpuMask d;
+    if (cache_domain_of(cpu_root, c, &d) == -1) d = online; // No cache information, one domain
+    cpu_mask_and(&d, &online);
+    cpu_mask_set(&d, c);
+    cpu_mask_or(&seen, &d);
+    if (kept < 2) domains[kept++] = d;
+    p->l3_domains++;
+  }
+
+  // Sets given by hand win over the layout
+  if (p->layout == PLACE_L3 || p->layout == PLACE_SPREAD) {
+    CpuMask producers, consumers;
+    if (p->layout == PLACE_SPREAD && kept > 1) {
+      producers = domains[0];
+      consumers = domains[1];
+    }
+    else {
+      split_domain(&domains[0], &producers, &consumers);
+    }
+
+    const CpuMask *fill[PIN_END] = {&domains[0], &producers, &producers, &consumers};
+    for (int r = 0; r < PIN_END; ++r) {
+      if (cpu_mask_count(&p->cpus[r]) == 0) p->cpus[r] = *fill[r];
+    }
+  }
+
+  for (int r = 0; r < PIN_END; ++r) {
+    if (cpu_mask_count(&p->cpus[r]) == 0) continue;
+    cpu_mask_and(&p->cpus[r], &online);
+    if (cpu_mask_count(&p->cpus[r]) == 0) return -1;
+  }
+
+  int producer = cpu_mask_first(&p->cpus[PIN_WORKERS]);
+  if (p->mem_node == -1 && producer != -1) p->mem_node = cpu_node_of(cpu_root, producer);
+  return 0;
+}
+
+int placement_allowed(CpuMask *out) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == -1) return -1;
+
+  cpu_mask_zero(out);
+  for (int c = 0; c < PLACEMENT_MAX_CPUS && c < CPU_SETSIZE; ++c) {
+    if (CPU_ISSET(c, &set)) cpu_mask_set(out, c);
+  }
+  return 0;
+}
+
+int placement_pin(const CpuMask *m) {
+  if (cpu_mask_count(m) == 0) return 0;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int c = 0; c < PLACEMENT_MAX_CPUS && c < CPU_SETSIZE; ++c) {
+    if (cpu_mask_isset(m, c)) CPU_SET(c, &set);
+  }
+  return sched_setaffinity(0, sizeof(set), &set);
+}
+
+int placement_prefer_node(int node) {
+  if (node < 0) return (int)syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+  if (node >= PLACEMENT_MAX_NODES) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  unsigned long nodes = 1ul << node;
+  return (int)syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodes, PLACEMENT_MAX_NODES + 1);
+}
+
+int placement_bind_memory(void *pdata, size_t size, int node) {
+  if (node < 0 || node >= PLACEMENT_MAX_NODES) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  unsigned long nodes = 1ul << node;
+  return (int)syscall(SYS_mbind, pdata, (size + page - 1) / page * page, MPOL_PREFERRED, &nodes,
+		      PLACEMENT_MAX_NODES + 1, 0);
+}
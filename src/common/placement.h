@@ -0,0 +1,231 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file placement.h
+ * @brief CPU and NUMA placement of the roles (`--pin`).
+ *
+ * Every group of roles (Dispatcher, standard workers, express worker, trucks)
+ * may be pinned to a CPU set with `sched_setaffinity()`, so the scheduler no
+ * longer migrates them across cores and sockets and the belt's cache lines
+ * stay in one cache. A set is given by hand (`--pin=workers=0-3`) or taken
+ * from an automatic layout read from the sysfs CPU topology:
+ * - `l3`: producers and trucks share the L3 of the first cache domain,
+ * workers on its first half of CPUs, trucks on the second half.
+ * - `spread`: workers on the first L3 domain, trucks on the next one, the
+ * cross-cache layout to compare against. With a single L3 it equals `l3`.
+ *
+ * The shared state is placed on the NUMA node the producers run on
+ * (`mem=<node>` overrides it): the Dispatcher prefers that node while it
+ * creates and touches the segment and binds the segment to it for the pages
+ * roles fault in later. Both are preferences, a full node falls back to
+ * another one.
+ *
+ * No role is pinned and no memory is placed unless `--pin` was given.
+ */
+
+/** @brief Highest number of CPUs a mask holds, `CPU_SETSIZE` of glibc. */
+#define PLACEMENT_MAX_CPUS 1024
+/** @brief Highest NUMA node a segment can be bound to, plus one. */
+#define PLACEMENT_MAX_NODES 63
+/** @brief Room for a mask written by @ref cpu_mask_format. */
+#define CPU_MASK_TEXT_MAX 128
+/** @brief CPU topology of the running system. */
+#define PLACEMENT_SYSFS_CPU "/sys/devices/system/cpu"
+
+/**
+ * @brief Set of CPUs, bit i is CPU i.
+ */
+typedef struct {
+  uint64_t bits[PLACEMENT_MAX_CPUS / 64];
+} CpuMask;
+
+/**
+ * @brief Groups of roles pinned together.
+ */
+typedef enum {
+  PIN_DISPATCHER, /**< The Dispatcher itself (`dispatcher`). */
+  PIN_WORKERS,    /**< Standard workers P1..PS (`workers`). */
+  PIN_EXPRESS,    /**< Express worker (`express`). */
+  PIN_TRUCKS,     /**< Trucks, or the truck fleet (`trucks`). */
+  PIN_END
+} PinRole;
+
+/**
+ * @brief Ways the CPU sets were chosen.
+ */
+typedef enum {
+  PLACE_NONE,   /**< No `--pin`, nothing pinned. */
+  PLACE_MANUAL, /**< Sets given per role. */
+  PLACE_L3,     /**< Workers and trucks share one L3. */
+  PLACE_SPREAD  /**< Workers and trucks on different L3 domains. */
+} PlacementLayout;
+
+/**
+ * @brief Placement of a run.
+ */
+typedef struct {
+  int layout;             /**< @ref PlacementLayout */
+  int mem_node;           /**< NUMA node of the shared state, -1 when not placed. */
+  int l3_domains;         /**< L3 domains found by @ref placement_resolve. */
+  CpuMask cpus[PIN_END];  /**< CPU set of every @ref PinRole, empty when not pinned. */
+} Placement;
+
+/**
+ * @brief Clears a mask.
+ *
+ * @param m Mask.
+ */
+void cpu_mask_zero(CpuMask *m);
+
+/**
+ * @brief Adds a CPU to a mask, CPUs beyond @ref PLACEMENT_MAX_CPUS are ignored.
+ *
+ * @param m   Mask.
+ * @param cpu CPU number.
+ */
+void cpu_mask_set(CpuMask *m, int cpu);
+
+/**
+ * @brief Tells if a CPU is in a mask.
+ *
+ * @param m   Mask.
+ * @param cpu CPU number.
+ * @return 1 if set, 0 otherwise.
+ */
+int cpu_mask_isset(const CpuMask *m, int cpu);
+
+/**
+ * @brief Number of CPUs in a mask.
+ *
+ * @param m Mask.
+ * @return CPU count, 0 for an empty mask.
+ */
+int cpu_mask_count(const CpuMask *m);
+
+/**
+ * @brief Lowest CPU of a mask.
+ *
+ * @param m Mask.
+ * @return CPU number, -1 for an empty mask.
+ */
+int cpu_mask_first(const CpuMask *m);
+
+/**
+ * @brief Parses a CPU list, e.g. `0-3,8,10-11`.
+ *
+ * @param text CPU list as in `/sys/devices/system/cpu/online`.
+ * @param out  Receives the mask.
+ * @return 0 on success, -1 on invalid text or a CPU above @ref PLACEMENT_MAX_CPUS.
+ */
+int cpu_mask_parse(const char *text, CpuMask *out);
+
+/**
+ * @brief Writes a mask the way @ref cpu_mask_parse reads it, `-` when empty.
+ *
+ * @param m    Mask.
+ * @param buf  Output, a longer list is cut.
+ * @param size Size of `buf`.
+ */
+void cpu_mask_format(const CpuMask *m, char *buf, size_t size);
+
+/**
+ * @brief Name of a role group.
+ *
+ * @param role @ref PinRole
+ * @return Name as accepted by @ref placement_parse_option.
+ */
+const char *placement_role_name(int role);
+
+/**
+ * @brief Empty placement, nothing pinned.
+ *
+ * @param p Placement.
+ */
+void placement_init(Placement *p);
+
+/**
+ * @brief Parses one `--pin` value.
+ *
+ * Takes a layout (`l3`, `spread`), a CPU set of a role group
+ * (`<role>=<cpus>`, role `dispatcher`, `workers`, `express` or `trucks`) or
+ * the node of the shared state (`mem=<node>`). Sets given by hand replace
+ * those of a layout.
+ *
+ * @param text Option value.
+ * @param p    Placement, updated.
+ * @return 0 on success, -1 on invalid text.
+ */
+int placement_parse_option(const char *text, Placement *p);
+
+/**
+ * @brief Completes a placement from the CPU topology.
+ *
+ * Reads the online CPUs, their L3 domains (`cpu<i>/cache/index<j>`) and
+ * NUMA nodes (`cpu<i>/node<n>`) below `cpu_root`. A layout fills the sets
+ * not given by hand, the express worker follows the workers and the
+ * Dispatcher the workers' L3. Without `mem=` the shared state goes to the
+ * node of the first worker CPU. Sets are cut to the CPUs in `allowed`.
+ *
+ * @param p        Placement, updated.
+ * @param cpu_root Topology directory, @ref PLACEMENT_SYSFS_CPU.
+ * @param allowed  CPUs the run may use (@ref placement_allowed).
+ * @return 0 on success, -1 if the topology cannot be read or a set given
+ * holds no allowed CPU.
+ */
+int placement_resolve(Placement *p, const char *cpu_root, const CpuMask *allowed);
+
+/**
+ * @brief NUMA node of a CPU.
+ *
+ * @param cpu_root Topology directory, @ref PLACEMENT_SYSFS_CPU.
+ * @param cpu      CPU number.
+ * @return Node number, 0 on systems without NUMA information.
+ */
+int cpu_node_of(const char *cpu_root, int cpu);
+
+/**
+ * @brief CPUs the calling thread may run on (`sched_getaffinity`).
+ *
+ * @param out Receives the mask.
+ * @return 0 on success, -1 on failure (errno set).
+ */
+int placement_allowed(CpuMask *out);
+
+/**
+ * @brief Pins the calling thread (and processes it forks) to a CPU set.
+ *
+ * Called by a thread, only that thread moves. An empty mask leaves the
+ * affinity as it is.
+ *
+ * @param m CPU set.
+ * @return 0 on success, -1 on failure (errno set).
+ */
+int placement_pin(const CpuMask *m);
+
+/**
+ * @brief Makes the calling thread allocate new pages on a node first.
+ *
+ * @param node NUMA node, -1 restores the default (local) policy.
+ * @return 0 on success, -1 on failure (errno set, e.g. ENOSYS without NUMA).
+ */
+int placement_prefer_node(int node);
+
+/**
+ * @brief Binds a memory block to a node, for every process using it.
+ *
+ * Pages faulted in later are taken from `node` first, pages already present
+ * stay where they are. On a System V segment the policy belongs to the
+ * segment, so roles attaching it follow it as well.
+ *
+ * @param pdata Start of the block, page aligned.
+ * @param size  Size of the block in bytes.
+ * @param node  NUMA node.
+ * @return 0 on success, -1 on failure (errno set).
+ */
+int placement_bind_memory(void *pdata, size_t size, int node);
+
+#endif // PLACEMENT_H
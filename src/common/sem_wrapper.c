@@ -1,5 +1,7 @@
 #include "sem_wrapper.h"
 
+#include <pthread.h>
+
 // Union definition for semctl function
 union semun {
   int val;
@@ -7,7 +9,102 @@ union semun {
   unsigned short *array;
 };
 
+// --- Process-private sets (threads mode) ---
+//
+// A set is addressed by -(index + 1) in private_sets. One condition variable
+// per semaphore, so giving dock slots never wakes belt producers.
+
+#define MAX_PRIVATE_SEM_SETS 8
+
+typedef struct {
+  pthread_mutex_t lock;
+  int nsems;
+  int *val;
+  pthread_cond_t *changed;
+} PrivateSemSet;
+
+static PrivateSemSet *private_sets[MAX_PRIVATE_SEM_SETS];
+static pthread_mutex_t private_sets_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static PrivateSemSet *private_set(int semid, int sem_num) {
+  int i = -semid - 1;
+  PrivateSemSet *set = i < MAX_PRIVATE_SEM_SETS ? private_sets[i] : NULL;
+  if (!set || sem_num < 0 || sem_num >= set->nsems) {
+    errno = EINVAL;
+    perror("Sem. wrapper: private semaphore error");
+    exit(1);
+  }
+  return set;
+}
+
+// Applies op, waiting while the value would drop below 0 unless nowait is set
+static int private_op(int semid, int sem_num, int op, int nowait) {
+  PrivateSemSet *set = private_set(semid, sem_num);
+  int applied = 1;
+
+  pthread_mutex_lock(&set->lock);
+  while (set->val[sem_num] + op < 0) {
+    if (nowait) {
+      applied = 0;
+      break;
+    }
+    pthread_cond_wait(&set->changed[sem_num], &set->lock);
+  }
+  if (applied) {
+    set->val[sem_num] += op;
+    // Waiters may need different amounts (batches), every one re-checks
+    if (op > 0) pthread_cond_broadcast(&set->changed[sem_num]);
+  }
+  pthread_mutex_unlock(&set->lock);
+
+  return applied;
+}
+
+static void private_destroy(int semid) {
+  PrivateSemSet *set = private_set(semid, 0);
+
+  pthread_mutex_lock(&private_sets_lock);
+  private_sets[-semid - 1] = NULL;
+  pthread_mutex_unlock(&private_sets_lock);
+
+  for (int i = 0; i < set->nsems; ++i) pthread_cond_destroy(&set->changed[i]);
+  pthread_mutex_destroy(&set->lock);
+  free(set->changed);
+  free(set->val);
+  free(set);
+}
+
+int sem_create_private(int semnum) {
+  PrivateSemSet *set = calloc(1, sizeof(PrivateSemSet));
+  if (!set || !(set->val = calloc(semnum, sizeof(int))) ||
+      !(set->changed = calloc(semnum, sizeof(pthread_cond_t)))) {
+    perror("Sem. wrapper: private semaphore alloc error");
+    exit(1);
+  }
+
+  set->nsems = semnum;
+  pthread_mutex_init(&set->lock, NULL);
+  for (int i = 0; i < semnum; ++i) pthread_cond_init(&set->changed[i], NULL);
+
+  pthread_mutex_lock(&private_sets_lock);
+  int i = 0;
+  while (i < MAX_PRIVATE_SEM_SETS && private_sets[i]) i++;
+  if (i < MAX_PRIVATE_SEM_SETS) private_sets[i] = set;
+  pthread_mutex_unlock(&private_sets_lock);
+
+  if (i == MAX_PRIVATE_SEM_SETS) {
+    fprintf(stderr, "Sem. wrapper: too many private semaphore sets\n");
+    exit(1);
+  }
+  return -(i + 1);
+}
+
 void sem_op(int semid, int sem_num, int op) {
+  if (semid < 0) {
+    private_op(semid, sem_num, op, 0);
+    return;
+  }
+
   struct sembuf sb;
   sb.sem_num = sem_num;
   sb.sem_op = op;
@@ -20,7 +117,71 @@ void sem_op(int semid, int sem_num, int op) {
   }
 }
 
+void sem_count_op(int semid, int sem_num, int op) {
+  if (semid < 0) {
+    private_op(semid, sem_num, op, 0);
+    return;
+  }
+
+  struct sembuf sb;
+  sb.sem_num = sem_num;
+  sb.sem_op = op;
+  sb.sem_flg = 0;
+
+  while (semop(semid, &sb, 1) == -1) {
+    if (errno == EINTR) continue; // Signal was handled, retry wait
+    perror("Sem. wrapper: semop() error");
+    exit(1);
+  }
+}
+
+int sem_count_try(int semid, int sem_num, int op) {
+  if (semid < 0) return private_op(semid, sem_num, op, 1);
+
+  struct sembuf sb;
+  sb.sem_num = sem_num;
+  sb.sem_op = op;
+  sb.sem_flg = IPC_NOWAIT;
+
+  if (semop(semid, &sb, 1) == -1) {
+    if (errno == EAGAIN || errno == EINTR) return 0;
+    perror("Sem. wrapper: semop() error");
+    exit(1);
+  }
+  return 1;
+}
+
+int sem_get(int semid, int sem_num) {
+  if (semid < 0) {
+    PrivateSemSet *set = private_set(semid, sem_num);
+    pthread_mutex_lock(&set->lock);
+    int val = set->val[sem_num];
+    pthread_mutex_unlock(&set->lock);
+    return val;
+  }
+
+  int val = semctl(semid, sem_num, GETVAL);
+  if (val == -1) {
+    perror("Sem. wrapper: semctl() error");
+    exit(1);
+  }
+  return val;
+}
+
 void sem_set(int semid, int sem_num, int cmd, int val) {
+  if (semid < 0) {
+    if (cmd == IPC_RMID) {
+      private_destroy(semid);
+      return;
+    }
+    PrivateSemSet *set = private_set(semid, sem_num);
+    pthread_mutex_lock(&set->lock);
+    set->val[sem_num] = val;
+    pthread_cond_broadcast(&set->changed[sem_num]);
+    pthread_mutex_unlock(&set->lock);
+    return;
+  }
+
   union semun su;
   su.val = val;
 
@@ -16,6 +16,10 @@
  * This header provides a simplified interface for creating, initializing,
  * and operating on semaphore sets using standard IPC mechanisms.
  * It includes macros for standard P (wait/lock) and V (signal/unlock) operations.
+ *
+ * Sets created with @ref sem_create_private live in process memory and are
+ * shared by threads only (`--threads`). They get negative ids, every function
+ * below accepts both kinds, so callers never know which one they hold.
  */
 
 /**
@@ -42,6 +46,26 @@
  */
 #define SEM_V(semid, sem_num) sem_op(semid, sem_num, 1)
 
+/**
+ * @brief Takes one unit of a counting semaphore without SEM_UNDO.
+ *
+ * Used for @ref SEM_EMPTY / @ref SEM_FULL, see @ref sem_count_op.
+ *
+ * @param semid The semaphore set identifier.
+ * @param sem_num The index of the semaphore in the set.
+ */
+#define SEM_COUNT_P(semid, sem_num) sem_count_op(semid, sem_num, -1)
+
+/**
+ * @brief Gives one unit of a counting semaphore without SEM_UNDO.
+ *
+ * Used for @ref SEM_EMPTY / @ref SEM_FULL, see @ref sem_count_op.
+ *
+ * @param semid The semaphore set identifier.
+ * @param sem_num The index of the semaphore in the set.
+ */
+#define SEM_COUNT_V(semid, sem_num) sem_count_op(semid, sem_num, 1)
+
 /**
  * @brief Initializes a semaphore to 0 (Locked/Taken state).
  *
@@ -78,6 +102,47 @@
  */
 void sem_op(int semid, int sem_num, int op);
 
+/**
+ * @brief Executes an operation on a counting semaphore without `SEM_UNDO`.
+ *
+ * Semaphores counting belt slots are taken by one process and given back by
+ * another (worker takes SEM_EMPTY, truck returns it). With `SEM_UNDO` every
+ * process would accumulate an adjustment value that only grows, and `semop()`
+ * fails with ERANGE once it passes SEMAEM (32767 operations). Undoing such
+ * operations on exit would also be wrong, the packages stay on the belt.
+ * EINTR is handled like in @ref sem_op.
+ *
+ * @param semid The semaphore set identifier.
+ * @param sem_num The index of the specific semaphore within the set (0-based).
+ * @param op The operation value (negative to wait/decrement, positive to signal/increment).
+ */
+void sem_count_op(int semid, int sem_num, int op);
+
+/**
+ * @brief Non-blocking variant of @ref sem_count_op.
+ *
+ * Used to reserve several belt packages at once without sleeping on an
+ * empty belt (`IPC_NOWAIT`).
+ *
+ * @param semid The semaphore set identifier.
+ * @param sem_num The index of the specific semaphore within the set (0-based).
+ * @param op The operation value (negative to take, positive to give).
+ * @return 1 if the operation was applied, 0 if it would block or was interrupted by a signal.
+ */
+int sem_count_try(int semid, int sem_num, int op);
+
+/**
+ * @brief Reads the current value of a semaphore (wrapper for semctl GETVAL).
+ *
+ * The value may change right after it is read, it is only a hint for sizing
+ * the next operation.
+ *
+ * @param semid The semaphore set identifier.
+ * @param sem_num The index of the semaphore within the set.
+ * @return int Current semaphore value. Exits on failure.
+ */
+int sem_get(int semid, int sem_num);
+
 /**
  * @brief Sets the value of a specific semaphore (wrapper for semctl).
  *
@@ -103,4 +168,16 @@ void sem_set(int semid, int sem_num, int cmd, int val);
  */
 int get_sem(const char* filename, int proj_id, int semnum);
 
+/**
+ * @brief Creates a process-private semaphore set.
+ *
+ * Implemented with a pthread mutex and one condition variable per semaphore,
+ * all semaphores start at 0. `SEM_UNDO` has no meaning without processes and
+ * is ignored. The set is freed with `sem_set(semid, 0, IPC_RMID, 0)`.
+ *
+ * @param semnum The number of semaphores in the set.
+ * @return int Negative set identifier, usable with every function of this header. Exits on failure.
+ */
+int sem_create_private(int semnum);
+
 #endif // SEM_WRAPPER_H
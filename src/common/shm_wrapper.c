@@ -1,10 +1,15 @@
+#define _GNU_SOURCE // SHM_HUGETLB
 #include "shm_wrapper.h"
 
+#include <sys/mman.h>
+#include <unistd.h>
+
 // Private function
 static int get_shared_block(const char* filename, int proj_id, size_t size) {
   key_t shm_key = ftok(filename, proj_id);
 
-  int shmid = shmget(shm_key, size, 0600|IPC_CREAT);
+  // Size 0 only looks up an existing block, its size is set by the creator
+  int shmid = shmget(shm_key, size, size ? 0600|IPC_CREAT : 0600);
   if (shmid == -1) {
     perror("Shm. wrapper: shmget error");
     exit(1);
@@ -25,6 +30,71 @@ void* attach_memory_block(const char* filename, int proj_id, size_t size) {
   return shm_result;
 }
 
+size_t huge_page_size(void) {
+  size_t kb = 2048;
+  FILE *f = fopen("/proc/meminfo", "r");
+  if (f) {
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+      if (sscanf(line, "Hugepagesize: %zu kB", &kb) == 1) break;
+    }
+    fclose(f);
+  }
+  return kb * 1024;
+}
+
+void* create_memory_block(const char* filename, int proj_id, size_t size, int flags, int *granted) {
+  *granted = 0;
+
+  int shmid = -1;
+  if (flags & SHM_BLOCK_HUGE) {
+    // A segment left under the key by an earlier run would be returned as is, on normal pages
+    key_t key = ftok(filename, proj_id);
+    int stale = shmget(key, 0, 0600);
+    if (stale != -1) shmctl(stale, IPC_RMID, NULL);
+
+    // Huge page segments are whole pages, no pages reserved fails with ENOMEM
+    size_t page = huge_page_size();
+    shmid = shmget(key, (size + page - 1) / page * page, 0600|IPC_CREAT|IPC_EXCL|SHM_HUGETLB);
+    if (shmid != -1) *granted |= SHM_BLOCK_HUGE;
+  }
+  if (shmid == -1) shmid = get_shared_block(filename, proj_id, size);
+
+  void *shm_result = shmat(shmid, (void *)0, 0);
+  if (shm_result == (void *)-1) {
+    perror("Shm. wrapper: shmat error");
+    exit(1);
+  }
+
+  if ((flags & SHM_BLOCK_LOCK) && lock_memory_block(shm_result, size) == 0) *granted |= SHM_BLOCK_LOCK;
+
+  return shm_result;
+}
+
+void* alloc_memory_block(size_t size, int flags, int *granted) {
+  *granted = 0;
+
+  void *block;
+  if (posix_memalign(&block, (flags & SHM_BLOCK_HUGE) ? huge_page_size() : CACHE_LINE_SIZE, size) != 0) {
+    perror("Shm. wrapper: posix_memalign error");
+    exit(1);
+  }
+
+  // Huge pages are taken by the first touch, the memset below
+  if ((flags & SHM_BLOCK_HUGE) && madvise(block, size, MADV_HUGEPAGE) == 0) *granted |= SHM_BLOCK_HUGE;
+  memset(block, 0, size);
+
+  if ((flags & SHM_BLOCK_LOCK) && lock_memory_block(block, size) == 0) *granted |= SHM_BLOCK_LOCK;
+
+  return block;
+}
+
+int lock_memory_block(void *pdata, size_t size) {
+  long page = sysconf(_SC_PAGESIZE);
+  for (size_t off = 0; off < size; off += page) __atomic_fetch_add((char *)pdata + off, 0, __ATOMIC_RELAXED);
+  return mlock(pdata, size);
+}
+
 void detach_memory_block(void *pdata) {
   if (shmdt(pdata) == -1) {
     perror("Shm. wrapper: could not detach memory. shmdt() error.");
@@ -23,13 +23,80 @@
  * provided filename. If the block does not exist, it creates one. Then, it attaches
  * the block to the process's address space.
  *
+ * Passing size 0 attaches to an already existing block of any size without
+ * creating it. Processes that do not create the block use it and read the real
+ * size from the block itself (see @ref SharedState::segment_size).
+ *
  * @param filename The file path used to generate a unique key (using ftok).
  * @param proj_id Project unique ID number for key generation (using ftok).
- * @param size The size of the shared memory block in bytes.
+ * @param size The size of the shared memory block in bytes, 0 for an existing block.
  * @return void* A pointer to the attached shared memory block. Returns (void*)-1 or NULL on failure.
  */
 void* attach_memory_block(const char* filename, int proj_id, size_t size);
 
+/** @brief Back a new block with huge pages (`SHM_HUGETLB`), normal pages when none are available. */
+#define SHM_BLOCK_HUGE 0x1
+/** @brief Pre-fault the block and lock it in RAM (`mlock`), see @ref lock_memory_block. */
+#define SHM_BLOCK_LOCK 0x2
+
+/**
+ * @brief Creates a shared memory block for low-jitter runs and attaches it.
+ *
+ * Like @ref attach_memory_block, with @ref SHM_BLOCK_HUGE the block is first
+ * requested with `SHM_HUGETLB`, its size rounded up to @ref huge_page_size.
+ * A segment left under the same key is removed first, so the block is always
+ * a new one and @ref SHM_BLOCK_HUGE is granted only for huge pages it has.
+ * Without reserved huge pages (`/proc/sys/vm/nr_hugepages`) or the right to
+ * use them the block falls back to normal pages. With @ref SHM_BLOCK_LOCK the
+ * block is locked once attached, a failing lock (`RLIMIT_MEMLOCK`) leaves it
+ * unlocked. Both fallbacks are silent, `granted` tells what was applied.
+ *
+ * @param filename The file path used to generate a unique key (using ftok).
+ * @param proj_id  Project unique ID number for key generation (using ftok).
+ * @param size     The size of the shared memory block in bytes.
+ * @param flags    SHM_BLOCK_* options requested.
+ * @param granted  Receives the SHM_BLOCK_* options applied.
+ * @return void* A pointer to the attached shared memory block.
+ */
+void* create_memory_block(const char* filename, int proj_id, size_t size, int flags, int *granted);
+
+/**
+ * @brief Private counterpart of @ref create_memory_block for roles running as threads.
+ *
+ * Allocates a zeroed block, released with `free()`. @ref SHM_BLOCK_HUGE aligns
+ * it to @ref huge_page_size and asks for transparent huge pages
+ * (`MADV_HUGEPAGE`) before the first touch, the kernel may still use normal
+ * pages. @ref SHM_BLOCK_LOCK behaves as in @ref create_memory_block.
+ *
+ * @param size    The size of the block in bytes.
+ * @param flags   SHM_BLOCK_* options requested.
+ * @param granted Receives the SHM_BLOCK_* options applied.
+ * @return void* The block, exits on allocation failure.
+ */
+void* alloc_memory_block(size_t size, int flags, int *granted);
+
+/**
+ * @brief Pre-faults a memory block and locks it in RAM.
+ *
+ * Every page is written once (an atomic add of 0, safe while other processes
+ * use the block), so the page tables of the calling process are complete and
+ * no later access faults, then the block is locked with `mlock()` so it is
+ * never paged out. Locks belong to a process, every process attaching the
+ * block locks it itself.
+ *
+ * @param pdata Start of the block.
+ * @param size  Size of the block in bytes.
+ * @return 0 on success, -1 if `mlock()` failed (errno set), the block is pre-faulted either way.
+ */
+int lock_memory_block(void *pdata, size_t size);
+
+/**
+ * @brief Default huge page size of the system.
+ *
+ * @return `Hugepagesize` of `/proc/meminfo`, 2 MiB if it cannot be read.
+ */
+size_t huge_page_size(void);
+
 /**
  * @brief Detaches the shared memory block from the process.
  *
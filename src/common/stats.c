@@ -0,0 +1,153 @@
+#include "stats.h"
+#include "utils.h"
+
+#include <string.h>
+
+static const char *stage_names[LAT_STAGE_END] = {"gen->belt", "belt dwell", "load->delivery", "end-to-end"};
+static const char *stage_keys[LAT_STAGE_END] = {"gen_to_belt", "belt_dwell", "load_to_delivery", "end_to_end"};
+static const char *command_names[CMD_END] = {"cmd depart", "cmd express"};
+static const char *command_keys[CMD_END] = {"cmd_force_depart", "cmd_express_load"};
+
+void stats_stage_total(const SimStats *stats, LatencyStage stage, Histogram *out) {
+  memset(out, 0, sizeof(*out));
+  for (int t = 0; t < PKG_END; ++t) hist_merge(out, &stats->latency_ns[stage][t]);
+}
+
+void stats_record_load(SimStats *stats, const Package *pkg) {
+  hist_record(&stats->latency_ns[LAT_GEN_TO_BELT][pkg->type], pkg->t_belt_ns - pkg->t_gen_ns);
+  hist_record(&stats->latency_ns[LAT_BELT_DWELL][pkg->type], pkg->t_load_ns - pkg->t_belt_ns);
+}
+
+void stats_record_delivery(SimStats *stats, const Package *pkg, uint64_t t_deliver_ns) {
+  hist_record(&stats->latency_ns[LAT_LOAD_TO_DELIVERY][pkg->type], t_deliver_ns - pkg->t_load_ns);
+  hist_record(&stats->latency_ns[LAT_END_TO_END][pkg->type], t_deliver_ns - pkg->t_gen_ns);
+}
+
+// Time from the start of the run to the first package loaded from the belt (ms), -1 when none was
+static double first_package_ms(const SimStats *stats) {
+  if (!stats->first_load_ns || stats->first_load_ns < stats->t_go_ns) return -1.0;
+  return (stats->first_load_ns - stats->t_go_ns) / 1e6;
+}
+
+void stats_print(FILE *out, const SimStats *stats, double seconds, int on_belt) {
+  long produced = 0;
+  for (int t = 0; t < PKG_END; ++t) produced += stats->produced[t];
+
+  double avg_fill = stats->deliveries ? 100.0 * stats->fill_ratio_sum / stats->deliveries : 0.0;
+  double hours = seconds / 3600.0;
+  Histogram dwell;
+
+  fprintf(out, "\n--- "COLOR_BLUE" Simulation Statistics "COLOR_RESET"---\n");
+  fprintf(out, "Duration:            %.2f s\n", seconds);
+  if (stats->started_roles > 0) {
+    fprintf(out, "Startup:             %d roles started in %.1f ms, all waiting after %.1f ms\n",
+	    stats->started_roles, stats->spawn_ns / 1e6, stats->ready_ns / 1e6);
+    if (first_package_ms(stats) >= 0) fprintf(out, "First package:       loaded %.3f ms after start\n", first_package_ms(stats));
+  }
+  fprintf(out, "Packages produced:   %ld (A=%ld, B=%ld, C=%ld)\n",
+	  produced, stats->produced[PKG_A], stats->produced[PKG_B], stats->produced[PKG_C]);
+  fprintf(out, "Overweight rejects:  %ld\n", stats->rejected_overweight);
+  fprintf(out, "Loaded from belt:    %ld\n", stats->loaded);
+  fprintf(out, "Express loaded:      %ld\n", stats->express_loaded);
+  fprintf(out, "Left on belt:        %d\n", on_belt);
+  fprintf(out, "Deliveries:          %ld (forced: %ld)\n", stats->deliveries, stats->forced_departures);
+  fprintf(out, "Delivered weight:    %.2f kg\n", g_to_kg(stats->delivered_weight));
+  fprintf(out, "Avg truck fill:      %.1f %% of W\n", avg_fill);
+  stats_stage_total(stats, LAT_BELT_DWELL, &dwell);
+  if (dwell.count > 0) {
+    fprintf(out, "Belt dwell:          p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+	    hist_percentile(&dwell, 50.0) / 1e6, hist_percentile(&dwell, 99.0) / 1e6, dwell.max / 1e6);
+  }
+  if (hours > 0) {
+    fprintf(out, "Deliveries per hour: %.1f\n", stats->deliveries / hours);
+    fprintf(out, "Packages per hour:   %.1f\n", (stats->loaded + stats->express_loaded) / hours);
+  }
+}
+
+// One latency object of the JSON report, in ns
+static void print_json_latency(FILE *out, const char *key, const Histogram *h) {
+  fprintf(out, ",\"%s_ns\":{\"count\":%llu,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}",
+	  key, (unsigned long long)h->count,
+	  (unsigned long long)hist_percentile(h, 50.0),
+	  (unsigned long long)hist_percentile(h, 90.0),
+	  (unsigned long long)hist_percentile(h, 99.0),
+	  (unsigned long long)hist_percentile(h, 99.9),
+	  (unsigned long long)h->max);
+}
+
+void stats_print_json(FILE *out, const SimStats *stats, double seconds, int on_belt) {
+  long produced = 0;
+  for (int t = 0; t < PKG_END; ++t) produced += stats->produced[t];
+
+  double avg_fill = stats->deliveries ? stats->fill_ratio_sum / stats->deliveries : 0.0;
+  long packages = stats->loaded + stats->express_loaded;
+  Histogram stage;
+
+  fprintf(out, "{\"duration_s\":%.6f,\"produced\":%ld,\"produced_a\":%ld,\"produced_b\":%ld,\"produced_c\":%ld,"
+	  "\"rejected_overweight\":%ld,\"loaded\":%ld,\"express_loaded\":%ld,\"left_on_belt\":%d,"
+	  "\"deliveries\":%ld,\"forced_departures\":%ld,\"delivered_weight\":%.3f,\"avg_fill_ratio\":%.4f,"
+	  "\"packages_per_s\":%.1f,\"deliveries_per_hour\":%.1f",
+	  seconds, produced, stats->produced[PKG_A], stats->produced[PKG_B], stats->produced[PKG_C],
+	  stats->rejected_overweight, stats->loaded, stats->express_loaded, on_belt,
+	  stats->deliveries, stats->forced_departures, g_to_kg(stats->delivered_weight), avg_fill,
+	  seconds > 0 ? packages / seconds : 0.0, seconds > 0 ? stats->deliveries * 3600.0 / seconds : 0.0);
+
+  // Process and threads mode only, virtual time has no startup
+  if (stats->started_roles > 0) {
+    char first[32] = "null";
+    if (first_package_ms(stats) >= 0) snprintf(first, sizeof(first), "%.3f", first_package_ms(stats));
+    fprintf(out, ",\"startup\":{\"roles\":%d,\"spawn_ms\":%.3f,\"ready_ms\":%.3f,\"first_package_ms\":%s}",
+	    stats->started_roles, stats->spawn_ns / 1e6, stats->ready_ns / 1e6, first);
+  }
+
+  // Latency of every stage over all package types, in ns
+  for (int s = 0; s < LAT_STAGE_END; ++s) {
+    stats_stage_total(stats, (LatencyStage)s, &stage);
+    print_json_latency(out, stage_keys[s], &stage);
+  }
+
+  // Dispatcher commands, posted until executed
+  for (int c = 0; c < CMD_END; ++c) {
+    memset(&stage, 0, sizeof(stage));
+    hist_merge(&stage, &stats->command_ns[c]);
+    print_json_latency(out, command_keys[c], &stage);
+  }
+  fprintf(out, "}\n");
+}
+
+// Percentiles of one table row, taken from a private snapshot of a live histogram
+static void print_latency_row(FILE *out, const char *stage, const char *type, const Histogram *h) {
+  fprintf(out, "%-15s %-4s %10llu %10.3f %10.3f %10.3f %10.3f\n", stage, type,
+	  (unsigned long long)h->count,
+	  hist_percentile(h, 50.0) / 1e6, hist_percentile(h, 90.0) / 1e6,
+	  hist_percentile(h, 99.0) / 1e6, hist_percentile(h, 99.9) / 1e6);
+}
+
+void stats_print_latency(FILE *out, const SimStats *stats) {
+  const char *type_names[PKG_END] = {"A", "B", "C"};
+  Histogram row;
+
+  fprintf(out, "\n--- "COLOR_BLUE" Package Latency (ms) "COLOR_RESET"---\n");
+  fprintf(out, "%-15s %-4s %10s %10s %10s %10s %10s\n", "Stage", "Type", "count", "p50", "p90", "p99", "p999");
+
+  for (int s = 0; s < LAT_STAGE_END; ++s) {
+    for (int t = 0; t < PKG_END; ++t) {
+      memset(&row, 0, sizeof(row));
+      hist_merge(&row, &stats->latency_ns[s][t]);
+      print_latency_row(out, t == 0 ? stage_names[s] : "", type_names[t], &row);
+    }
+
+    stats_stage_total(stats, (LatencyStage)s, &row);
+    print_latency_row(out, "", "all", &row);
+  }
+
+  memset(&row, 0, sizeof(row));
+  hist_merge(&row, &stats->dock_time_ns);
+  print_latency_row(out, "truck at dock", "", &row);
+
+  for (int c = 0; c < CMD_END; ++c) {
+    memset(&row, 0, sizeof(row));
+    hist_merge(&row, &stats->command_ns[c]);
+    print_latency_row(out, command_names[c], "", &row);
+  }
+}
@@ -0,0 +1,88 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+#include "common.h"
+
+/**
+ * @file stats.h
+ * @brief End-of-run statistics report.
+ *
+ * Both the process model (Dispatcher) and the virtual-time engine print the
+ * same report, so runs in both modes can be compared directly.
+ */
+
+/**
+ * @brief Prints the end-of-run statistics.
+ *
+ * @param out       Output stream (usually stdout).
+ * @param stats     Collected statistics.
+ * @param seconds   Simulated time covered by the run (wall time in process mode).
+ * @param on_belt   Number of packages left on the belt at the end of the run.
+ */
+void stats_print(FILE *out, const SimStats *stats, double seconds, int on_belt);
+
+/**
+ * @brief Prints the end-of-run statistics as a single line JSON object.
+ *
+ * Machine-readable form of @ref stats_print (`--report=json`), read by the
+ * `warehouse_bench` end-to-end scenarios. Durations are in seconds, latency
+ * percentiles of every stage (all package types) in nanoseconds. Runs with
+ * roles add a `startup` object in milliseconds: time to start the roles, until
+ * all waited at the start barrier, and from the start to the first package
+ * loaded from the belt.
+ *
+ * @param out       Output stream (usually stdout).
+ * @param stats     Collected statistics.
+ * @param seconds   Simulated time covered by the run (wall time in process mode).
+ * @param on_belt   Number of packages left on the belt at the end of the run.
+ */
+void stats_print_json(FILE *out, const SimStats *stats, double seconds, int on_belt);
+
+/**
+ * @brief Prints p50/p90/p99/p999 of every latency stage per package type.
+ *
+ * Followed by the time a truck stands at a dock and the delivery latency of
+ * Dispatcher commands (@ref mailbox.h).
+ *
+ * Safe to call while the simulation runs, the histograms are read with atomic
+ * loads and without @ref SEM_MUTEX (dispatcher command 4).
+ *
+ * @param out   Output stream (usually stdout).
+ * @param stats Collected statistics.
+ */
+void stats_print_latency(FILE *out, const SimStats *stats);
+
+/**
+ * @brief Merges the histograms of all package types of a stage.
+ *
+ * @param stats Collected statistics.
+ * @param stage Latency stage.
+ * @param out   Merged histogram (overwritten).
+ */
+void stats_stage_total(const SimStats *stats, LatencyStage stage, Histogram *out);
+
+/**
+ * @brief Records the stages that end when a package is loaded into a truck.
+ *
+ * Generation to belt and belt dwell, from the package timestamps
+ * (@ref Package::t_load_ns must be set). Lock-free, may run concurrently.
+ *
+ * @param stats Statistics (usually in Shared Memory).
+ * @param pkg   Loaded package.
+ */
+void stats_record_load(SimStats *stats, const Package *pkg);
+
+/**
+ * @brief Records the stages that end when a package is delivered.
+ *
+ * Load to delivery and end-to-end. Lock-free, may run concurrently.
+ *
+ * @param stats        Statistics (usually in Shared Memory).
+ * @param pkg          Delivered package.
+ * @param t_deliver_ns Delivery time (ns, same clock as the package timestamps).
+ */
+void stats_record_delivery(SimStats *stats, const Package *pkg, uint64_t t_deliver_ns);
+
+#endif // STATS_H
@@ -0,0 +1,151 @@
+#include "timer_wheel.h"
+
+#include <stddef.h>
+
+/** @brief Ticks covered by all levels, later deadlines wait at the far end of the top level. */
+#define WHEEL_SPAN (1ull << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+static int shift_of(int level) {
+  return level * TIMER_WHEEL_BITS;
+}
+
+// Sentinel left alone in its list, the slot is empty
+static int empty_slot(const TimerNode *head) {
+  return head->next == head;
+}
+
+// Puts a timer into the lowest level its deadline fits, relative to the current tick
+static void link_timer(TimerWheel *w, TimerNode *t) {
+  uint64_t tick = t->deadline_ns / w->tick_ns;
+  if (tick < w->tick) tick = w->tick; // Overdue, expires with the next call
+  if (tick - w->tick >= WHEEL_SPAN) tick = w->tick + WHEEL_SPAN - 1; // Placed again when it cascades
+
+  uint64_t delta = tick - w->tick;
+  int level = 0;
+  while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ull << shift_of(level + 1))) ++level;
+
+  int slot = (int)((tick >> shift_of(level)) & SLOT_MASK);
+  TimerNode *head = &w->slots[level][slot];
+  t->next = head->next;
+  t->prev = head;
+  head->next->prev = t;
+  head->next = t;
+  w->occupied[level] |= 1ull << slot;
+}
+
+// Moves the timers of a higher level slot down, done when the level below wraps into it
+static void cascade(TimerWheel *w, int level, int slot) {
+  TimerNode *head = &w->slots[level][slot];
+  TimerNode *t = head->next;
+
+  head->next = head->prev = head;
+  w->occupied[level] &= ~(1ull << slot);
+
+  while (t != head) {
+    TimerNode *next = t->next;
+    link_timer(w, t);
+    t = next;
+  }
+}
+
+// First tick at or after the current one that expires level 0 timers or cascades a level
+static uint64_t next_tick(const TimerWheel *w) {
+  uint64_t best = UINT64_MAX;
+
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+    uint64_t bits = w->occupied[level];
+    if (!bits) continue;
+
+    int shift = shift_of(level);
+    uint64_t turn = w->tick >> (shift + TIMER_WHEEL_BITS) << (shift + TIMER_WHEEL_BITS);
+    int idx = (int)((w->tick >> shift) & SLOT_MASK);
+
+    // Slot of the current tick is still ahead when all lower levels sit at their start
+    int first = (level == 0 || (w->tick & ((1ull << shift) - 1)) == 0) ? idx : idx + 1;
+    uint64_t ahead = first < TIMER_WHEEL_SLOTS ? bits & (~0ull << first) : 0;
+
+    uint64_t tick;
+    if (ahead) tick = turn + ((uint64_t)__builtin_ctzll(ahead) << shift);
+    else tick = turn + (1ull << (shift + TIMER_WHEEL_BITS)) + ((uint64_t)__builtin_ctzll(bits) << shift);
+    if (tick < best) best = tick;
+  }
+  return best;
+}
+
+void timer_wheel_init(TimerWheel *w, uint64_t now_ns, uint64_t tick_ns) {
+  for (int l = 0; l < TIMER_WHEEL_LEVELS; ++l) {
+    for (int s = 0; s < TIMER_WHEEL_SLOTS; ++s) w->slots[l][s].next = w->slots[l][s].prev = &w->slots[l][s];
+    w->occupied[l] = 0;
+  }
+  w->tick_ns = tick_ns > 0 ? tick_ns : 1;
+  w->tick = now_ns / w->tick_ns;
+  w->pending = 0;
+}
+
+void timer_wheel_add(TimerWheel *w, TimerNode *t, uint64_t deadline_ns) {
+  t->deadline_ns = deadline_ns;
+  link_timer(w, t);
+  ++w->pending;
+}
+
+void timer_wheel_cancel(TimerWheel *w, TimerNode *t) {
+  if (!t->prev) return;
+
+  TimerNode *prev = t->prev;
+  t->next->prev = prev;
+  prev->next = t->next;
+  t->next = t->prev = NULL;
+  --w->pending;
+
+  // Last timer of its slot, prev is then the sentinel
+  TimerNode *base = &w->slots[0][0];
+  if (prev >= base && prev < base + TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS && empty_slot(prev)) {
+    int i = (int)(prev - base);
+    w->occupied[i / TIMER_WHEEL_SLOTS] &= ~(1ull << (i % TIMER_WHEEL_SLOTS));
+  }
+}
+
+TimerNode *timer_wheel_expire(TimerWheel *w, uint64_t now_ns) {
+  uint64_t end = now_ns / w->tick_ns;
+  TimerNode *first = NULL, **tail = &first;
+
+  // Ticks without timers or cascades are skipped
+  while (w->pending > 0) {
+    uint64_t tick = next_tick(w);
+    if (tick > end) break;
+    w->tick = tick;
+
+    // Lowest level first, every level whose lower levels all wrapped at this tick
+    for (int l = 1; l < TIMER_WHEEL_LEVELS && (tick & ((1ull << shift_of(l)) - 1)) == 0; ++l) {
+      int slot = (int)((tick >> shift_of(l)) & SLOT_MASK);
+      if (w->occupied[l] & (1ull << slot)) cascade(w, l, slot);
+    }
+
+    // Level 0 slot only holds timers of this very tick
+    int slot = (int)(tick & SLOT_MASK);
+    TimerNode *head = &w->slots[0][slot];
+    for (TimerNode *t = head->next, *next; t != head; t = next) {
+      next = t->next;
+      t->prev = NULL;
+      t->next = NULL;
+      *tail = t;
+      tail = &t->next;
+      --w->pending;
+    }
+    head->next = head->prev = head;
+    w->occupied[0] &= ~(1ull << slot);
+
+    w->tick = tick + 1;
+  }
+
+  if (end >= w->tick) w->tick = end + 1;
+  return first;
+}
+
+uint64_t timer_wheel_next_ns(const TimerWheel *w) {
+  if (w->pending == 0) return UINT64_MAX;
+
+  uint64_t tick = next_tick(w);
+  return tick == UINT64_MAX ? UINT64_MAX : tick * w->tick_ns;
+}
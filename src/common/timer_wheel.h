@@ -0,0 +1,103 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+/**
+ * @file timer_wheel.h
+ * @brief Hierarchical timer wheel for roles that wait for many deadlines at once.
+ *
+ * Time is cut into ticks of @ref TimerWheel::tick_ns. Level 0 has one slot per
+ * tick for the next @ref TIMER_WHEEL_SLOTS ticks, every further level covers
+ * @ref TIMER_WHEEL_SLOTS times the span of the one below with slots of the
+ * same factor longer. A timer goes into the lowest level its deadline fits
+ * and moves down (cascades) when the level below reaches its slot, so it is
+ * touched once per level at most. With 1 ms ticks the four levels cover 4.6
+ * hours, later deadlines wait in the top level and are placed again.
+ *
+ * Timers are intrusive nodes (@ref TimerNode) embedded in the caller's
+ * structures, adding and cancelling are O(1) and the wheel never allocates.
+ * @ref timer_wheel_expire hands out every timer due by a time as one list,
+ * @ref timer_wheel_next_ns tells a caller how long it may sleep. A bitmap of
+ * occupied slots per level lets both skip empty stretches of time.
+ */
+
+/** @brief Levels of the wheel. */
+#define TIMER_WHEEL_LEVELS 4
+/** @brief log2 of @ref TIMER_WHEEL_SLOTS. */
+#define TIMER_WHEEL_BITS 6
+/** @brief Slots per level, one bit each in a 64-bit occupancy word. */
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+
+/**
+ * @brief Timer, embedded in the structure it belongs to.
+ */
+typedef struct TimerNode {
+  struct TimerNode *next; /**< Next timer in the slot, or in the expired list. */
+  struct TimerNode *prev; /**< Previous timer in the slot, NULL when not scheduled. */
+  uint64_t deadline_ns;   /**< Time the timer is due (CLOCK_MONOTONIC, ns). */
+} TimerNode;
+
+/**
+ * @brief Levels of timer slots.
+ */
+typedef struct {
+  TimerNode slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; /**< List heads (sentinels) of the slots. */
+  uint64_t occupied[TIMER_WHEEL_LEVELS]; /**< Bitmap of slots holding at least one timer, per level. */
+  uint64_t tick_ns;   /**< Length of a tick. */
+  uint64_t tick;      /**< Next tick to expire. */
+  long pending;       /**< Scheduled timers. */
+} TimerWheel;
+
+/**
+ * @brief Initializes an empty wheel.
+ *
+ * @param w       Wheel to initialize.
+ * @param now_ns  Current time, the first tick.
+ * @param tick_ns Length of a tick, the resolution of deadlines.
+ */
+void timer_wheel_init(TimerWheel *w, uint64_t now_ns, uint64_t tick_ns);
+
+/**
+ * @brief Schedules a timer, O(1).
+ *
+ * A deadline in the past expires with the next @ref timer_wheel_expire.
+ *
+ * @param w           Wheel.
+ * @param t           Timer, must not be scheduled.
+ * @param deadline_ns Time the timer is due.
+ */
+void timer_wheel_add(TimerWheel *w, TimerNode *t, uint64_t deadline_ns);
+
+/**
+ * @brief Cancels a scheduled timer, O(1). Does nothing for an idle timer.
+ *
+ * @param w Wheel.
+ * @param t Timer.
+ */
+void timer_wheel_cancel(TimerWheel *w, TimerNode *t);
+
+/**
+ * @brief Takes all timers due by `now_ns` off the wheel.
+ *
+ * Only ticks holding timers are visited, higher levels cascade on the way.
+ *
+ * @param w      Wheel.
+ * @param now_ns Current time.
+ * @return Expired timers linked through `next`, earlier ticks first, NULL if none.
+ */
+TimerNode *timer_wheel_expire(TimerWheel *w, uint64_t now_ns);
+
+/**
+ * @brief Earliest time a timer may be due, to bound a sleep.
+ *
+ * The next occupied tick of level 0 or the next cascade of a higher level,
+ * whichever comes first. A cascade is early but never late, after it the
+ * wheel knows the exact tick.
+ *
+ * @param w Wheel.
+ * @return Time in ns, UINT64_MAX with no timer scheduled.
+ */
+uint64_t timer_wheel_next_ns(const TimerWheel *w);
+
+#endif // TIMER_WHEEL_H
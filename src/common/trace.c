@@ -0,0 +1,189 @@
+#include "trace.h"
+#include "shm_wrapper.h"
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static size_t ring_size(uint32_t ring_events) {
+  return sizeof(TraceRing) + (size_t)ring_events * sizeof(TraceEvent);
+}
+
+size_t trace_segment_size(int ring_count, int ring_events) {
+  return sizeof(TraceHeader) + (size_t)ring_count * ring_size(ring_events);
+}
+
+void trace_init(TraceHeader *hdr, int ring_count, int ring_events, int workers) {
+  memset(hdr, 0, trace_segment_size(ring_count, ring_events));
+  hdr->magic = TRACE_MAGIC;
+  hdr->version = TRACE_VERSION;
+  hdr->ring_count = ring_count;
+  hdr->ring_events = ring_events;
+  hdr->workers = workers;
+  hdr->t0_ns = trace_now();
+
+  for (int i = 0; i < ring_count; ++i) trace_ring(hdr, i)->capacity = ring_events;
+}
+
+// Rings before the first truck ring: Dispatcher, standard workers, express worker
+int trace_ring_count(int workers, int N) {
+  return workers + 2 + N;
+}
+
+TraceRing *trace_ring(const TraceHeader *hdr, int i) {
+  return (TraceRing *)((char *)(hdr + 1) + (size_t)i * ring_size(hdr->ring_events));
+}
+
+TraceRing *trace_claim(TraceHeader *hdr, TraceRole role, int actor) {
+  int i;
+  switch (role) {
+  case TRACE_ROLE_DISPATCHER: i = 0; break;
+  case TRACE_ROLE_WORKER:     i = actor; break;
+  case TRACE_ROLE_EXPRESS:    i = hdr->workers + 1; break;
+  default:                    i = hdr->workers + 1 + actor; break;
+  }
+  if (i < 0 || i >= (int)hdr->ring_count) return NULL;
+
+  TraceRing *ring = trace_ring(hdr, i);
+  ring->pid = getpid();
+  ring->role = role;
+  ring->actor = actor;
+  return ring;
+}
+
+TraceRing *trace_attach(SharedState *shm, TraceRole role, int actor) {
+  if (shm->trace_rings == 0) return NULL;
+
+  TraceHeader *hdr = attach_memory_block(KEY_PATH, KEY_ID_TRACE, 0);
+  return trace_claim(hdr, role, actor);
+}
+
+uint64_t trace_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void trace_event(TraceRing *ring, TraceEventType type, uint64_t start_ns, uint32_t payload) {
+  if (ring) trace_event_actor(ring, ring->actor, type, start_ns, payload);
+}
+
+void trace_event_actor(TraceRing *ring, int actor, TraceEventType type, uint64_t start_ns, uint32_t payload) {
+  if (!ring) return;
+
+  uint64_t now = trace_now();
+  if (start_ns == 0) start_ns = now;
+
+  // Single writer, the record is published by the release store of head
+  uint64_t head = ring->head;
+  TraceEvent *ev = &ring->events[head % ring->capacity];
+  ev->ts_ns = start_ns;
+  ev->dur_ns = now - start_ns;
+  ev->payload = payload;
+  ev->role = ring->role;
+  ev->type = type;
+  ev->actor = (uint32_t)actor;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+int trace_dump(const TraceHeader *hdr, const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (!f) return -1;
+
+  size_t size = trace_segment_size(hdr->ring_count, hdr->ring_events);
+  int ok = fwrite(hdr, 1, size, f) == size;
+
+  if (fclose(f) != 0) ok = 0;
+  return ok ? 0 : -1;
+}
+
+// --- Chrome trace JSON ---
+//
+// pid groups tracks by role (plus one group for docks), tid is the actor.
+// Timestamps are microseconds since TraceHeader::t0_ns.
+
+#define TRACE_PID_DOCKS (TRACE_ROLE_TRUCK + 2)
+
+static const char *event_names[TRACE_EVENT_END] = {
+  "push", "pop", "dock queue", "docked", "express", "force depart"
+};
+
+static const char *role_names[] = {"Dispatcher", "Workers", "Express", "Trucks"};
+
+static void actor_name(char *buf, size_t size, int role, int actor) {
+  switch (role) {
+  case TRACE_ROLE_DISPATCHER: snprintf(buf, size, "Dispatcher"); break;
+  case TRACE_ROLE_WORKER:     snprintf(buf, size, "P%d", actor); break;
+  case TRACE_ROLE_EXPRESS:    snprintf(buf, size, "P%d (Express)", actor); break;
+  default:                    snprintf(buf, size, "Truck %d", actor); break;
+  }
+}
+
+static void json_sep(FILE *out, long *count) {
+  fprintf(out, "%s\n  ", *count ? "," : "");
+  (*count)++;
+}
+
+static void json_meta(FILE *out, long *count, const char *what, int pid, int tid, const char *name) {
+  json_sep(out, count);
+  fprintf(out, "{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+	  what, pid, tid, name);
+}
+
+static void json_span(FILE *out, long *count, const char *name, int pid, int tid,
+		      const TraceEvent *ev, uint64_t t0, const char *arg, long val) {
+  json_sep(out, count);
+  fprintf(out, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"%s\":%ld}}",
+	  name, pid, tid, (ev->ts_ns - t0) / 1000.0, ev->dur_ns / 1000.0, arg, val);
+}
+
+long trace_export_json(FILE *out, const TraceHeader *hdr) {
+  long count = 0;
+  long exported = 0;
+  char name[32];
+  int dock_seen[MAX_DOCKS] = {0};
+
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+  for (int r = 0; r < TRACE_PID_DOCKS; ++r) {
+    json_meta(out, &count, "process_name", r + 1, 0, r < TRACE_ROLE_TRUCK + 1 ? role_names[r] : "Docks");
+  }
+
+  for (uint32_t i = 0; i < hdr->ring_count; ++i) {
+    const TraceRing *ring = trace_ring(hdr, i);
+    if (ring->pid == 0) continue;
+
+    int pid = ring->role + 1;
+    actor_name(name, sizeof(name), ring->role, ring->actor);
+    json_meta(out, &count, "thread_name", pid, ring->actor, name);
+
+    // Oldest events were overwritten once the ring wrapped
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t first = head > ring->capacity ? head - ring->capacity : 0;
+
+    for (uint64_t n = first; n < head; ++n) {
+      const TraceEvent *ev = &ring->events[n % ring->capacity];
+      if (ev->type >= TRACE_EVENT_END) continue;
+
+      int dock_event = ev->type == TRACE_DOCK || ev->type == TRACE_UNDOCK || ev->type == TRACE_FORCE_DEPART;
+      // Events of a fleet ring carry the truck they belong to
+      json_span(out, &count, event_names[ev->type], pid, ev->actor, ev, hdr->t0_ns,
+		dock_event ? "dock" : "packages", dock_event ? (long)ev->payload + 1 : (long)ev->payload);
+      exported++;
+
+      // Dock occupancy track, gaps between trucks are idle dock time
+      if (ev->type == TRACE_UNDOCK && ev->payload < MAX_DOCKS) {
+	if (!dock_seen[ev->payload]) {
+	  snprintf(name, sizeof(name), "Dock %u", ev->payload + 1);
+	  json_meta(out, &count, "thread_name", TRACE_PID_DOCKS, ev->payload + 1, name);
+	  dock_seen[ev->payload] = 1;
+	}
+	snprintf(name, sizeof(name), "Truck %u", ev->actor);
+	json_span(out, &count, name, TRACE_PID_DOCKS, ev->payload + 1, ev, hdr->t0_ns, "truck", ev->actor);
+      }
+    }
+  }
+
+  fprintf(out, "\n]}\n");
+  return exported;
+}
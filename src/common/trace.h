@@ -0,0 +1,213 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "common.h"
+
+/**
+ * @file trace.h
+ * @brief Binary event trace in shared memory (`--trace`).
+ *
+ * The trace segment holds one ring of fixed size per process (Dispatcher,
+ * every standard worker, the express worker and every truck). A ring has a single writer, so recording an
+ * event is a clock read, a 32 byte store and a release store of the ring
+ * head, without locks or syscalls. When a ring is full the oldest events are
+ * overwritten.
+ *
+ * At shutdown the Dispatcher dumps the segment to a file, which the
+ * standalone `trace_export` tool turns into Chrome/Perfetto trace JSON
+ * (@ref trace_export_json).
+ *
+ * Segment layout: @ref TraceHeader, followed by @ref TraceHeader::ring_count
+ * rings of @ref TraceHeader::ring_events events each (@ref trace_ring).
+ */
+
+/** @brief Magic number of a trace segment / dump ("WTRC"). */
+#define TRACE_MAGIC 0x43525457u
+/** @brief Version of the binary trace layout. */
+#define TRACE_VERSION 3u
+/** @brief Events kept per process ring (32 B each, 512 KiB per ring). */
+#define TRACE_RING_EVENTS 16384
+
+/**
+ * @brief Roles of the processes writing to the trace.
+ */
+typedef enum {
+  TRACE_ROLE_DISPATCHER, /**< Dispatcher (main process). */
+  TRACE_ROLE_WORKER,     /**< Standard worker. */
+  TRACE_ROLE_EXPRESS,    /**< Express worker. */
+  TRACE_ROLE_TRUCK       /**< Truck. */
+} TraceRole;
+
+/**
+ * @brief Types of recorded events and meaning of their payload.
+ */
+typedef enum {
+  TRACE_PUSH,         /**< Worker placed packages on the belt, payload: package count. */
+  TRACE_POP,          /**< Truck loaded packages from the belt, payload: package count. */
+  TRACE_DOCK,         /**< Truck docked (duration: time in dock queue), payload: dock index. */
+  TRACE_UNDOCK,       /**< Truck left the dock (duration: time docked), payload: dock index. */
+  TRACE_EXPRESS,      /**< P4 loaded express packages, payload: package count. */
+  TRACE_FORCE_DEPART, /**< Dispatcher forced a departure, payload: dock index. */
+  TRACE_EVENT_END     /**< Number of event types. */
+} TraceEventType;
+
+/**
+ * @brief Single binary trace record.
+ *
+ * Events that cover a span of time (e.g. a push blocked on a full belt) are
+ * stored with their start time and duration.
+ */
+typedef struct {
+  uint64_t ts_ns;   /**< Start time, CLOCK_MONOTONIC in nanoseconds. */
+  uint64_t dur_ns;  /**< Duration in nanoseconds, 0 for instant events. */
+  uint32_t payload; /**< Event specific value, see @ref TraceEventType. */
+  uint32_t actor;   /**< Worker number or truck id, 0 for the Dispatcher. A fleet has 100k+ trucks. */
+  uint8_t role;     /**< Writer role (@ref TraceRole). */
+  uint8_t type;     /**< Event type (@ref TraceEventType). */
+  uint8_t reserved[6]; /**< Padding. */
+} TraceEvent;
+
+/**
+ * @brief Per-process event ring.
+ */
+typedef struct {
+  uint64_t head;       /**< Number of events written so far, slot is head % capacity. */
+  uint32_t capacity;   /**< Number of records in @ref events (ring_events). */
+  int32_t pid;         /**< PID of the writer, 0 if the ring was never claimed. */
+  uint32_t actor;      /**< Writer actor number. */
+  uint8_t role;        /**< Writer role (@ref TraceRole). */
+  uint8_t reserved[3]; /**< Padding. */
+  TraceEvent events[]; /**< Event records. */
+} TraceRing;
+
+/**
+ * @brief Header of the trace segment.
+ */
+typedef struct {
+  uint32_t magic;       /**< @ref TRACE_MAGIC */
+  uint32_t version;     /**< @ref TRACE_VERSION */
+  uint32_t ring_count;  /**< Number of rings. */
+  uint32_t ring_events; /**< Events per ring. */
+  uint32_t workers;     /**< Number of standard workers, rings 1..workers. */
+  uint32_t reserved;    /**< Padding. */
+  uint64_t t0_ns;       /**< Start of the run, timestamps are exported relative to it. */
+} TraceHeader;
+
+/**
+ * @brief Size of a trace segment.
+ *
+ * @param ring_count  Number of rings.
+ * @param ring_events Events per ring.
+ * @return Segment size in bytes.
+ */
+size_t trace_segment_size(int ring_count, int ring_events);
+
+/**
+ * @brief Initializes an empty trace segment.
+ *
+ * @param hdr         Start of the segment (@ref trace_segment_size bytes).
+ * @param ring_count  Number of rings.
+ * @param ring_events Events per ring.
+ * @param workers     Number of standard workers.
+ */
+void trace_init(TraceHeader *hdr, int ring_count, int ring_events, int workers);
+
+/**
+ * @brief Number of rings needed for a run with N trucks.
+ *
+ * @param workers Number of standard workers.
+ * @param N       Number of trucks.
+ * @return Ring count.
+ */
+int trace_ring_count(int workers, int N);
+
+/**
+ * @brief Returns ring `i` of the segment.
+ *
+ * @param hdr Trace segment header.
+ * @param i   Ring index (0 .. ring_count-1).
+ * @return Pointer to the ring.
+ */
+TraceRing *trace_ring(const TraceHeader *hdr, int i);
+
+/**
+ * @brief Claims the ring of the calling process.
+ *
+ * Rings are assigned by role: Dispatcher 0, worker Pn n (the express worker
+ * is number S + 1 with S standard workers), truck `id` S + 1 + id.
+ *
+ * @param hdr   Trace segment header.
+ * @param role  Role of the caller.
+ * @param actor Worker number or truck id.
+ * @return The ring, or NULL if it does not exist.
+ */
+TraceRing *trace_claim(TraceHeader *hdr, TraceRole role, int actor);
+
+/**
+ * @brief Attaches the trace segment if the Dispatcher enabled tracing.
+ *
+ * @param shm   Pointer to the attached SharedState structure.
+ * @param role  Role of the caller.
+ * @param actor Worker number or truck id.
+ * @return Ring of the caller, NULL when tracing is off.
+ */
+TraceRing *trace_attach(SharedState *shm, TraceRole role, int actor);
+
+/**
+ * @brief Current CLOCK_MONOTONIC time in nanoseconds.
+ *
+ * @return Timestamp in nanoseconds.
+ */
+uint64_t trace_now(void);
+
+/**
+ * @brief Records an event in the ring of the calling process.
+ *
+ * Does nothing if `ring` is NULL (tracing off).
+ *
+ * @param ring     Ring of the caller (@ref trace_attach).
+ * @param type     Event type.
+ * @param start_ns Start of the event (@ref trace_now), it ends now. 0 for an instant event.
+ * @param payload  Event specific value.
+ */
+void trace_event(TraceRing *ring, TraceEventType type, uint64_t start_ns, uint32_t payload);
+
+/**
+ * @brief Records an event on behalf of another actor of the same role.
+ *
+ * A truck fleet writes the events of all its trucks to one ring, each tagged
+ * with its truck id.
+ *
+ * @param ring     Ring of the caller (@ref trace_attach).
+ * @param actor    Actor the event belongs to.
+ * @param type     Event type.
+ * @param start_ns Start of the event (@ref trace_now), it ends now. 0 for an instant event.
+ * @param payload  Event specific value.
+ */
+void trace_event_actor(TraceRing *ring, int actor, TraceEventType type, uint64_t start_ns, uint32_t payload);
+
+/**
+ * @brief Writes the whole trace segment to a binary file.
+ *
+ * @param hdr  Trace segment header.
+ * @param path Output file path.
+ * @return 0 on success, -1 on I/O error.
+ */
+int trace_dump(const TraceHeader *hdr, const char *path);
+
+/**
+ * @brief Writes a trace as Chrome/Perfetto trace JSON.
+ *
+ * Every process gets its own track. Dock occupancy (from dock to undock) is
+ * additionally drawn on one track per dock, so idle docks show up as gaps.
+ *
+ * @param out Output stream.
+ * @param hdr Trace segment header (e.g. read back from a dump).
+ * @return Number of exported events.
+ */
+long trace_export_json(FILE *out, const TraceHeader *hdr);
+
+#endif // TRACE_H
@@ -1,4 +1,6 @@
 #include "utils.h"
+#include <errno.h>
+#include <math.h>
 #include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -9,28 +11,80 @@ void get_time(char* buffer, size_t size) {
   strftime(buffer, size, "%H:%M:%S", t);
 }
 
-double get_volume(PackageType type) {
-  if(type == PKG_A) return 0.019456;
-  if(type == PKG_B) return 0.046208;
-  if(type == PKG_C) return 0.099712;
-  return 0.0;
+int get_volume_cm3(PackageType type) {
+  if(type == PKG_A) return 19456;
+  if(type == PKG_B) return 46208;
+  if(type == PKG_C) return 99712;
+  return 0;
 }
 
-double generate_weight(PackageType type) {
+int weight_for_type_g(PackageType type, double d) {
   double min = 0.1;
   double max = 25.0;
 
-  // Generating random weight
-  double d = (double)rand() / (double)RAND_MAX; // d == 0 or 1
   double weight = min + d * (max - min); // Multiplication result can't be more than 24.9
 
   // Satisfying requirements: smaller package -> smaller weight
   if (type == PKG_A && weight > 10.0) weight /= 3.0;
   if (type == PKG_B && weight > 10.0) weight /= 2.0;
 
-  return weight;
+  return (int)lround(weight * GRAMS_PER_KG);
+}
+
+int generate_weight_g(PackageType type) {
+  // Generating random weight
+  double d = (double)rand() / (double)RAND_MAX; // d == 0 or 1
+  return weight_for_type_g(type, d);
+}
+
+int64_t package_weight_sum(const Package *pkgs, int count) {
+  int64_t w = 0;
+  for (int i = 0; i < count; ++i) w += pkgs[i].weight_g;
+  return w;
+}
+
+// Rounds to the nearest unit, limits beyond UNITS_MAX (e.g. "no limit" 1e300) saturate
+static int64_t to_units(double value, double scale) {
+  double units = value * scale;
+  if (!(units < (double)UNITS_MAX)) return units > 0.0 ? UNITS_MAX : 0;
+  if (units <= 0.0) return 0;
+  return llround(units);
+}
+
+int64_t kg_to_g(double kg) {
+  return to_units(kg, GRAMS_PER_KG);
+}
+
+double g_to_kg(int64_t g) {
+  return (double)g / GRAMS_PER_KG;
+}
+
+int64_t m3_to_cm3(double m3) {
+  return to_units(m3, CM3_PER_M3);
+}
+
+double cm3_to_m3(int64_t cm3) {
+  return (double)cm3 / CM3_PER_M3;
 }
 
 PackageType get_rand_package_type() {
   return (PackageType)(rand() % 3);
 }
+
+uint64_t monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t sim_delay_ns(const SharedState *shm, DelayKind kind) {
+  if (shm->no_sleep) return 0;
+
+  SimDelay d = delay_load(&shm->delays[kind]);
+  return delay_draw_us(&d) * 1000ull;
+}
+
+void sleep_until_ns(uint64_t t_ns) {
+  struct timespec ts = {t_ns / 1000000000ull, t_ns % 1000000000ull};
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
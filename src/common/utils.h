@@ -28,12 +28,24 @@ void get_time(char* buffer, size_t size);
  * @brief Generates a random weight for a specific package type.
  *
  * Uses a simple heuristic where smaller package types tend to be lighter.
- * The generated weight is typically between 0.1 and 25.0.
+ * The generated weight is typically between 0.1 and 25.0 kg.
  *
  * @param type The type of the package (defined in common.h).
- * @return double The generated weight of the package.
+ * @return int The generated weight of the package in grams.
  */
-double generate_weight(PackageType type);
+int generate_weight_g(PackageType type);
+
+/**
+ * @brief Weight of a package type for a uniform random number.
+ *
+ * The shaping behind @ref generate_weight_g, shared with generators that bring
+ * their own random numbers.
+ *
+ * @param type The type of the package.
+ * @param d    Uniform random number in [0, 1].
+ * @return int The weight of the package in grams.
+ */
+int weight_for_type_g(PackageType type, double d);
 
 /**
  * @brief Retrieves the volume for a given package type.
@@ -41,9 +53,9 @@ double generate_weight(PackageType type);
  * Returns a fixed volume value associated with the specific package category.
  *
  * @param type The type of the package.
- * @return double The volume corresponding to the package type.
+ * @return int The volume corresponding to the package type in cm3.
  */
-double get_volume(PackageType type);
+int get_volume_cm3(PackageType type);
 
 /**
  * @brief Generates a random package type.
@@ -54,5 +66,78 @@ double get_volume(PackageType type);
  * @return PackageType A randomly selected package type.
  */
 PackageType get_rand_package_type();
+
+/**
+ * @brief Sums the weight of a run of packages.
+ *
+ * @param pkgs  Packages.
+ * @param count Number of packages.
+ * @return int64_t Total weight in grams.
+ */
+int64_t package_weight_sum(const Package *pkgs, int count);
+
+/**
+ * @brief Converts kilograms (command line, control channel) to grams.
+ *
+ * Rounds to the nearest gram. Negative values give 0, values above
+ * @ref UNITS_MAX (e.g. 1e300 for "no limit") give UNITS_MAX.
+ *
+ * @param kg Weight in kg.
+ * @return int64_t Weight in grams.
+ */
+int64_t kg_to_g(double kg);
+
+/**
+ * @brief Converts grams to kilograms for reports.
+ *
+ * @param g Weight in grams.
+ * @return double Weight in kg.
+ */
+double g_to_kg(int64_t g);
+
+/**
+ * @brief Converts cubic metres to cubic centimetres, rounding like @ref kg_to_g.
+ *
+ * @param m3 Volume in m3.
+ * @return int64_t Volume in cm3.
+ */
+int64_t m3_to_cm3(double m3);
+
+/**
+ * @brief Converts cubic centimetres to cubic metres for reports.
+ *
+ * @param cm3 Volume in cm3.
+ * @return double Volume in m3.
+ */
+double cm3_to_m3(int64_t cm3);
+
+/**
+ * @brief Current CLOCK_MONOTONIC time in nanoseconds.
+ *
+ * @return Timestamp in nanoseconds, comparable between processes.
+ */
+uint64_t monotonic_ns(void);
+
+/**
+ * @brief Draws a simulated delay of the run (@ref SharedState::delays).
+ *
+ * Returns 0 when the run skips simulated times (@ref SharedState::no_sleep),
+ * e.g. in headless benchmark runs.
+ *
+ * @param shm  Pointer to the attached SharedState structure.
+ * @param kind Delay to draw.
+ * @return Delay in nanoseconds.
+ */
+uint64_t sim_delay_ns(const SharedState *shm, DelayKind kind);
+
+/**
+ * @brief Sleeps until a CLOCK_MONOTONIC deadline.
+ *
+ * Waiting for deadlines instead of durations keeps consecutive delays from
+ * drifting by the time spent between them. Resumes after signal handlers.
+ *
+ * @param t_ns Deadline in nanoseconds (@ref monotonic_ns), a past one returns at once.
+ */
+void sleep_until_ns(uint64_t t_ns);
   
 #endif // UTILS_H
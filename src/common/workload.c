@@ -0,0 +1,178 @@
+#include "workload.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+uint64_t workload_file_size(uint64_t records) {
+  return sizeof(WorkloadHeader) + records * sizeof(WorkloadRecord);
+}
+
+static WorkloadHeader *map_file(int fd, uint64_t size, int writable) {
+  int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  void *p = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+  close(fd);
+  return p == MAP_FAILED ? NULL : p;
+}
+
+WorkloadHeader *workload_create(const char *path, uint64_t capacity, int workers, int preallocate) {
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) return NULL;
+
+  // Sparse file unless preallocated, blocks are then reserved up front and
+  // not allocated by page faults of the writers
+  uint64_t size = workload_file_size(capacity);
+  int err = preallocate ? posix_fallocate(fd, 0, (off_t)size) : 0;
+  if (err == 0 && ftruncate(fd, (off_t)size) == -1) err = errno;
+  if (err != 0) {
+    close(fd);
+    errno = err;
+    return NULL;
+  }
+
+  WorkloadHeader *hdr = map_file(fd, size, 1);
+  if (!hdr) return NULL;
+
+  hdr->magic = WORKLOAD_MAGIC;
+  hdr->version = WORKLOAD_VERSION;
+  hdr->record_size = sizeof(WorkloadRecord);
+  hdr->workers = workers;
+  hdr->capacity = capacity;
+  hdr->t0_ns = monotonic_ns();
+  return hdr;
+}
+
+WorkloadHeader *workload_map(const char *path, int writable) {
+  int fd = open(path, writable ? O_RDWR : O_RDONLY);
+  if (fd == -1) return NULL;
+
+  struct stat st;
+  WorkloadHeader hdr;
+  if (fstat(fd, &st) == -1 || pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)
+      || hdr.magic != WORKLOAD_MAGIC || hdr.version != WORKLOAD_VERSION
+      || hdr.record_size != sizeof(WorkloadRecord)
+      || (uint64_t)st.st_size < workload_file_size(hdr.capacity)) {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  return map_file(fd, workload_file_size(hdr.capacity), writable);
+}
+
+void workload_unmap(WorkloadHeader *hdr) {
+  munmap(hdr, workload_file_size(hdr->capacity));
+}
+
+WorkloadRecord *workload_records(const WorkloadHeader *hdr) {
+  return (WorkloadRecord *)(hdr + 1);
+}
+
+// Records written, count keeps growing past the capacity while the file is full
+static uint64_t record_count(const WorkloadHeader *hdr) {
+  uint64_t count = __atomic_load_n(&hdr->count, __ATOMIC_ACQUIRE);
+  return count < hdr->capacity ? count : hdr->capacity;
+}
+
+void workload_record(WorkloadHeader *hdr, int worker, const Package *pkgs, int n) {
+  if (n <= 0) return;
+
+  uint64_t first = __atomic_fetch_add(&hdr->count, (uint64_t)n, __ATOMIC_RELAXED);
+  uint64_t fit = first >= hdr->capacity ? 0 : hdr->capacity - first;
+  if (fit > (uint64_t)n) fit = n;
+  if (fit < (uint64_t)n) __atomic_add_fetch(&hdr->dropped, n - fit, __ATOMIC_RELAXED);
+
+  WorkloadRecord *rec = workload_records(hdr) + first;
+  for (uint64_t i = 0; i < fit; ++i) {
+    rec[i].t_ns = pkgs[i].t_gen_ns > hdr->t0_ns ? pkgs[i].t_gen_ns - hdr->t0_ns : 0;
+    rec[i].worker = (uint16_t)worker;
+    rec[i].type = (uint8_t)pkgs[i].type;
+    rec[i].volume_cm3 = pkgs[i].volume_cm3;
+    rec[i].weight_g = pkgs[i].weight_g;
+  }
+}
+
+long long workload_finish(WorkloadHeader *hdr, const char *path) {
+  uint64_t n = record_count(hdr);
+
+  // Generated files know their duration, recordings take their latest arrival
+  if (hdr->duration_ns == 0) {
+    const WorkloadRecord *rec = workload_records(hdr);
+    for (uint64_t i = 0; i < n; ++i) {
+      if (rec[i].t_ns > hdr->duration_ns) hdr->duration_ns = rec[i].t_ns;
+    }
+  }
+
+  uint64_t capacity = hdr->capacity;
+  hdr->count = n;
+  hdr->capacity = n;
+  munmap(hdr, workload_file_size(capacity));
+
+  if (truncate(path, (off_t)workload_file_size(n)) == -1) return -1;
+  return (long long)n;
+}
+
+void workload_cursor_init(const WorkloadHeader *hdr, WorkloadCursor *cursor, int worker) {
+  cursor->next = 0;
+  cursor->lap_ns = 0;
+  cursor->worker = hdr->workers > 0 ? (uint16_t)((worker - 1) % hdr->workers + 1) : (uint16_t)worker;
+}
+
+int workload_next(const WorkloadHeader *hdr, WorkloadCursor *cursor, Package *out) {
+  const WorkloadRecord *rec = workload_records(hdr);
+  uint64_t n = record_count(hdr);
+
+  // A second lap from the start finds the records before the cursor
+  for (int lap = 0; lap < 2; ++lap) {
+    for (; cursor->next < n; ++cursor->next) {
+      const WorkloadRecord *r = &rec[cursor->next];
+      if (r->worker != cursor->worker || r->weight_g <= 0 || r->type >= PKG_END) continue;
+
+      out->type = (PackageType)r->type;
+      out->weight_g = r->weight_g;
+      out->volume_cm3 = r->volume_cm3;
+      out->t_gen_ns = cursor->lap_ns + r->t_ns;
+      ++cursor->next;
+      return 1;
+    }
+    cursor->next = 0;
+    cursor->lap_ns += hdr->duration_ns;
+  }
+  return 0;
+}
+
+// splitmix64 finalizer, a good random number for every counter value
+static uint64_t mix64(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+void workload_generate(WorkloadHeader *hdr, uint64_t first, uint64_t n, uint64_t seed, uint64_t gap_ns) {
+  const uint64_t golden = 0x9e3779b97f4a7c15ull;
+  uint64_t workers = hdr->workers > 0 ? hdr->workers : 1;
+  WorkloadRecord *rec = workload_records(hdr);
+
+  for (uint64_t i = first; i < first + n; ++i) {
+    uint64_t z = seed + 3 * i * golden;
+    uint64_t r_type = mix64(z + golden);
+    uint64_t r_weight = mix64(z + 2 * golden);
+    uint64_t r_time = mix64(z + 3 * golden);
+
+    PackageType type = (PackageType)(r_type % PKG_END);
+    double d = (double)(r_weight >> 11) * (1.0 / 9007199254740992.0); // 53 bits in [0, 1)
+
+    // One package per gap and worker, anywhere inside its gap
+    WorkloadRecord *r = &rec[i];
+    r->t_ns = (i / workers) * gap_ns + (gap_ns ? r_time % gap_ns : 0);
+    r->weight_g = weight_for_type_g(type, d);
+    r->volume_cm3 = get_volume_cm3(type);
+    r->worker = (uint16_t)(i % workers + 1);
+    r->type = (uint8_t)type;
+    memset(r->reserved, 0, sizeof(r->reserved));
+  }
+}
@@ -0,0 +1,205 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdint.h>
+
+#include "common.h"
+
+/**
+ * @file workload.h
+ * @brief Recorded package workloads in a memory-mapped binary file.
+ *
+ * A workload file is a @ref WorkloadHeader followed by fixed-size
+ * @ref WorkloadRecord entries, one per package a standard worker generated:
+ * its arrival time, type, weight and volume. The file is mapped with `mmap()`,
+ * records are read and written in place without copies or `read()` calls.
+ *
+ * - **Record** (`--record=<file>`): the Dispatcher creates a sparse file with
+ * room for @ref WORKLOAD_RECORD_CAPACITY records, every worker maps it and
+ * claims records with one atomic add on @ref WorkloadHeader::count. Records
+ * that do not fit are counted in @ref WorkloadHeader::dropped. On shutdown
+ * the file is cut to the records written (@ref workload_finish).
+ * - **Replay** (`--replay=<file>`): workers map the file read-only and take
+ * their packages from it instead of @ref generate_weight_g and random work
+ * times, every worker follows the records of one recorded worker
+ * (@ref workload_next). Runs with the same file see the same packages at the
+ * same moments.
+ * - **Generate** (`workload_gen`): @ref workload_generate fills records of a
+ * synthetic workload. Every record only depends on the seed and its index, so
+ * the file is filled by several threads at once.
+ *
+ * A worker killed between claiming and writing a record leaves it zeroed,
+ * replay skips records without weight.
+ */
+
+/** @brief Magic number of a workload file ("WWLD"). */
+#define WORKLOAD_MAGIC 0x444c5757u
+/** @brief Version of the workload file layout, 2 stores weights and volumes as integers (g, cm3). */
+#define WORKLOAD_VERSION 2u
+/** @brief Records a recording file has room for (32 B each, 512 MiB sparse file). */
+#define WORKLOAD_RECORD_CAPACITY (1ull << 24)
+
+/**
+ * @brief What standard workers do with the workload file.
+ */
+typedef enum {
+  WORKLOAD_OFF,    /**< Packages are generated at random. */
+  WORKLOAD_RECORD, /**< Generated packages are written to the file. */
+  WORKLOAD_REPLAY  /**< Packages are read from the file. */
+} WorkloadMode;
+
+/**
+ * @brief One generated package.
+ */
+typedef struct {
+  uint64_t t_ns;       /**< Arrival time, ns since the start of the recording. */
+  int32_t weight_g;    /**< Package weight in grams, 0 for a record that was never written. */
+  int32_t volume_cm3;  /**< Package volume in cm3. */
+  uint16_t worker;     /**< Number of the worker that generated the package (1..). */
+  uint8_t type;        /**< Package type (@ref PackageType). */
+  uint8_t reserved[13]; /**< Padding to 32 bytes. */
+} WorkloadRecord;
+
+/**
+ * @brief Header of a workload file, records follow right behind it.
+ */
+typedef struct {
+  uint32_t magic;       /**< @ref WORKLOAD_MAGIC */
+  uint32_t version;     /**< @ref WORKLOAD_VERSION */
+  uint32_t record_size; /**< sizeof(@ref WorkloadRecord). */
+  uint32_t workers;     /**< Number of workers in the file (worker numbers 1..workers). */
+  uint64_t capacity;    /**< Records the file has room for. */
+  uint64_t count;       /**< Records claimed so far, updated atomically while recording. */
+  uint64_t dropped;     /**< Packages not recorded because the file was full. */
+  uint64_t duration_ns; /**< Latest arrival time in the file. */
+  uint64_t t0_ns;       /**< Start of the recording, CLOCK_MONOTONIC in ns. */
+  uint64_t reserved;    /**< Padding to a cache line. */
+} WorkloadHeader;
+
+/**
+ * @brief Position of a worker in a replayed workload.
+ */
+typedef struct {
+  uint64_t next;   /**< Next record to look at. */
+  uint64_t lap_ns; /**< Added to arrival times, grows by the file duration on every wrap. */
+  uint16_t worker; /**< Recorded worker followed by this cursor. */
+} WorkloadCursor;
+
+/**
+ * @brief Size of a workload file.
+ *
+ * @param records Number of records.
+ * @return File size in bytes.
+ */
+uint64_t workload_file_size(uint64_t records);
+
+/**
+ * @brief Creates a workload file and maps it writable.
+ *
+ * The file is extended to its full size with `ftruncate()`, blocks are only
+ * allocated when records are written. A file that will be filled completely
+ * is preallocated with `posix_fallocate()` instead, page faults of the writers
+ * then find their blocks reserved (about twice as fast on ext4).
+ *
+ * @param path        File path, an existing file is replaced.
+ * @param capacity    Records the file has room for.
+ * @param workers     Number of workers that will write records.
+ * @param preallocate Reserve the blocks of all records up front.
+ * @return Mapped header, NULL on error (errno is set).
+ */
+WorkloadHeader *workload_create(const char *path, uint64_t capacity, int workers, int preallocate);
+
+/**
+ * @brief Maps an existing workload file.
+ *
+ * @param path     File path.
+ * @param writable Map for recording (read-write), otherwise read-only.
+ * @return Mapped header, NULL if the file cannot be mapped or is not a
+ * workload file of this version (errno is EINVAL).
+ */
+WorkloadHeader *workload_map(const char *path, int writable);
+
+/**
+ * @brief Unmaps a workload file.
+ *
+ * @param hdr Header returned by @ref workload_create or @ref workload_map.
+ */
+void workload_unmap(WorkloadHeader *hdr);
+
+/**
+ * @brief Records of the file.
+ *
+ * @param hdr Mapped header.
+ * @return First record.
+ */
+WorkloadRecord *workload_records(const WorkloadHeader *hdr);
+
+/**
+ * @brief Appends generated packages to a recording.
+ *
+ * Claims `n` records with one atomic add, safe to call from every worker at
+ * the same time. Packages that do not fit into the file are counted as
+ * dropped.
+ *
+ * @param hdr    Mapped header (writable).
+ * @param worker Worker number.
+ * @param pkgs   Generated packages, `t_gen_ns` is their arrival time.
+ * @param n      Number of packages.
+ */
+void workload_record(WorkloadHeader *hdr, int worker, const Package *pkgs, int n);
+
+/**
+ * @brief Ends a recording, cuts the file to the records written.
+ *
+ * Must be called after all workers stopped recording.
+ *
+ * @param hdr  Mapped header (writable), unmapped on return.
+ * @param path File path.
+ * @return Number of records in the file, -1 on error.
+ */
+long long workload_finish(WorkloadHeader *hdr, const char *path);
+
+/**
+ * @brief Places a worker at the start of a replayed workload.
+ *
+ * Worker numbers beyond the workers of the file wrap around, so a run with
+ * more workers than the recording replays some streams twice.
+ *
+ * @param hdr    Mapped header.
+ * @param cursor Cursor to initialize.
+ * @param worker Worker number (1..).
+ */
+void workload_cursor_init(const WorkloadHeader *hdr, WorkloadCursor *cursor, int worker);
+
+/**
+ * @brief Next package of the followed worker.
+ *
+ * When the end of the file is reached the replay starts over, arrival times
+ * keep growing by @ref WorkloadHeader::duration_ns per lap.
+ *
+ * @param hdr    Mapped header.
+ * @param cursor Cursor of the worker.
+ * @param out    Receives the package, `t_gen_ns` is its arrival time relative
+ * to the start of the replay.
+ * @return 1 on success, 0 if the file has no record of the followed worker.
+ */
+int workload_next(const WorkloadHeader *hdr, WorkloadCursor *cursor, Package *out);
+
+/**
+ * @brief Fills records of a synthetic workload.
+ *
+ * Record `i` belongs to worker `i % workers + 1`, which gets one package per
+ * `gap_ns` on average with a random arrival inside its gap. Type and weight
+ * follow the distribution of the simulation (@ref weight_for_type_g). The
+ * records only depend on `seed` and their index, any split of the index range
+ * gives the same file.
+ *
+ * @param hdr    Mapped header (writable), `workers` set.
+ * @param first  First record to fill.
+ * @param n      Number of records to fill.
+ * @param seed   Random seed.
+ * @param gap_ns Mean time between two packages of a worker.
+ */
+void workload_generate(WorkloadHeader *hdr, uint64_t first, uint64_t n, uint64_t seed, uint64_t gap_ns);
+
+#endif // WORKLOAD_H
@@ -5,51 +5,185 @@
  * This file contains the main entry point for the Warehouse Simulation.
  * The Dispatcher process is responsible for:
  * - Initializing System V IPC resources (Shared Memory & Semaphores).
- * - Spawning child processes (Workers and Trucks) using fork/exec.
+ * - Spawning child processes (Workers and Trucks) using posix_spawn, or with
+ * `--threads` running the same roles (@ref role.h) as threads on
+ * process-private memory and semaphores.
  * - Redirecting child process output to a log file to keep the CLI clean.
- * - Providing an interactive Command Line Interface (CLI) for user control.
+ * - Creating the workload file standard workers record to (`--record`) or
+ * checking the one they replay (`--replay`, @ref workload.h).
+ * - Providing an interactive Command Line Interface (CLI) for user control, and
+ * with `--control` the same commands over a Unix socket (@ref control.h).
  * - Managing the simulation lifecycle and safe resource cleanup.
  *
  * @author Mikołaj Kosiorek
  */
 
+#include <errno.h>
 #include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "common/belt.h"
 #include "common/common.h"
+#include "common/control.h"
+#include "common/futex_wrapper.h"
 #include "common/sem_wrapper.h"
 #include "common/shm_wrapper.h"
+#include "common/log.h"
+#include "common/metrics.h"
+#include "common/placement.h"
+#include "common/stats.h"
+#include "common/trace.h"
+#include "common/workload.h"
 #include "common/utils.h"
+#include "role.h"
+#include "virtual_time.h"
+
+/** @brief Poll period of a headless run waiting for its package target. */
+#define HEADLESS_POLL_MS 1
+/** @brief Stack size of a role thread, roles keep only small buffers on the stack. */
+#define ROLE_THREAD_STACK (256 * 1024)
+/** @brief Poll period of the Dispatcher waiting at the start barrier. */
+#define START_POLL_MS 10
+/** @brief Start without the missing roles once none reached the barrier for this long. */
+#define START_STALL_S 10
+
+extern char **environ;
+
+/**
+ * @brief A role running as a thread of the Dispatcher (`--threads`).
+ */
+typedef struct {
+  pthread_t thread;   /**< Thread running the role. */
+  const RoleEnv *env; /**< Resources shared by all roles. */
+  int arg;            /**< Worker number of a standard worker, id of a truck, size of the fleet. */
+  PackageType type;   /**< Package type of a standard worker. */
+  const CpuMask *cpus; /**< CPU set the thread pins itself to, NULL when nothing is pinned (`--pin`). */
+} RoleThread;
+
+// Threads inherit the CPU set of the Dispatcher, every role moves to its own and waits for the start
+static void pin_role_thread(const RoleThread *t) {
+  if (t->cpus && placement_pin(t->cpus) == -1) perror("Role thread: sched_setaffinity");
+  role_env_ready(t->env);
+}
+
+static void *worker_std_thread(void *arg) {
+  RoleThread *t = arg;
+  pin_role_thread(t);
+  worker_std_run(t->env, t->type, t->arg);
+  return NULL;
+}
+
+static void *worker_express_thread(void *arg) {
+  RoleThread *t = arg;
+  pin_role_thread(t);
+  worker_express_run(t->env);
+  return NULL;
+}
+
+static void *truck_thread(void *arg) {
+  RoleThread *t = arg;
+  pin_role_thread(t);
+  truck_run(t->env, t->arg);
+  return NULL;
+}
+
+static void *fleet_thread(void *arg) {
+  RoleThread *t = arg;
+  pin_role_thread(t);
+  fleet_run(t->env, 1, t->arg);
+  return NULL;
+}
+
+// Delays line of the start banner, printed when --delay changed any
+static void print_delays(const SimDelay *delays) {
+  printf("Delays:");
+  for (int k = 0; k < DELAY_END; ++k) {
+    char text[DELAY_TEXT_MAX];
+    delay_format(&delays[k], text, sizeof(text));
+    printf(" %s=%s", delay_kind_name(k), text);
+  }
+  printf("\n");
+}
+
+/**
+ * @brief CPU set a role is started on.
+ *
+ * @param p       Resolved placement.
+ * @param allowed CPUs the Dispatcher was started with, taken by roles without a set.
+ * @param role    @ref PinRole
+ * @return The set, NULL when nothing is pinned.
+ */
+static const CpuMask *role_cpus(const Placement *p, const CpuMask *allowed, int role) {
+  if (p->layout == PLACE_NONE) return NULL;
+  return cpu_mask_count(&p->cpus[role]) ? &p->cpus[role] : allowed;
+}
+
+// Spawned roles inherit the CPU set of the Dispatcher, it moves to the set of every group it starts
+static void pin_spawner(const CpuMask *cpus) {
+  if (cpus && placement_pin(cpus) == -1) perror("Placement: sched_setaffinity");
+}
+
+static int compare_pid(const void *a, const void *b) {
+  pid_t x = *(const pid_t *)a, y = *(const pid_t *)b;
+  return (x > y) - (x < y);
+}
 
 // HELPER FUNCTIONS
 
 /**
  * @brief Initializes the Shared Memory structure with simulation parameters.
  *
- * Zeros out the memory block to prevent garbage data and sets the initial
- * configuration constants derived from user input.
+ * Zeros out the segment header to prevent garbage data and sets the initial
+ * configuration constants derived from user input. Belt slots are not cleared,
+ * they are always written before being read.
  *
  * @param shm Pointer to the attached SharedState structure.
  * @param K   Maximum capacity of the conveyor belt (slots).
- * @param M   Maximum allowed weight on the conveyor belt.
- * @param W   Maximum weight capacity of a single truck.
- * @param V   Maximum volume capacity of a single truck.
+ * @param M   Maximum allowed weight on the conveyor belt (kg).
+ * @param W   Maximum weight capacity of a single truck (kg).
+ * @param V   Maximum volume capacity of a single truck (m3).
+ * @param D   Number of loading docks.
+ * @param B   Packages moved per belt operation by workers and trucks.
+ * @param L   Belt slots a truck inspects for the best fitting package (1 = head only).
+ * @param lanes       Number of belt lanes.
+ * @param lane_policy Order trucks drain the lanes in (@ref BeltLanePolicy).
+ * @param workers     Number of standard workers.
+ * @param log_level Most verbose log level of child processes.
+ * @param no_sleep  Skip simulated work, loading and delivery times.
+ * @param delays    Simulated delays, @ref DELAY_END entries.
  */
-void shm_init(SharedState *shm, int K, double M, double W, double V) {
+void shm_init(SharedState *shm, int K, double M, double W, double V, int D, int B, int L,
+	      int lanes, int lane_policy, int workers, int log_level, int no_sleep, const SimDelay *delays) {
   memset(shm, 0, sizeof(SharedState));
 
+  shm->segment_size = shared_state_size(K);
   shm->max_items_K = K;
-  shm->max_belt_weight_M = M;
-  shm->truck_capacity_W = W;
-  shm->truck_volume_V = V;
+  shm->max_belt_weight_M = kg_to_g(M);
+  shm->truck_capacity_W = kg_to_g(W);
+  shm->truck_volume_V = m3_to_cm3(V);
+  shm->batch_B = B;
+  shm->lookahead_L = L;
+  shm->belt_lanes = lanes;
+  shm->lane_policy = lane_policy;
+  shm->std_workers = workers;
+  shm->log_level = log_level;
+  shm->no_sleep = no_sleep;
+  memcpy(shm->delays, delays, sizeof(shm->delays));
 
   shm->shutdown = 0;
-  shm->truck_docked = 0;
+  shm->docks_D = D;
+
+  belt_init(shm);
 }
 
 /**
@@ -62,16 +196,338 @@ void shm_init(SharedState *shm, int K, double M, double W, double V) {
  * - @ref SEM_MUTEX : 1 (Binary, Critical Section Guard)
  * - @ref SEM_EMPTY : K (Counting, Available Slots)
  * - @ref SEM_FULL  : 0 (Counting, Items on Belt)
- * - @ref SEM_DOCK  : 1 (Binary, Dock Availability)
+ * - @ref SEM_DOCK  : D (Counting, Free Docks)
+ *
+ * With several belt lanes every lane gets its own MUTEX / EMPTY / FULL
+ * (@ref belt_lane_sem), EMPTY starts at the slots of the lane.
+ *
+ * The lock-free belt does not use SEM_EMPTY / SEM_FULL, they stay 0 so K is not
+ * limited by the semaphore maximum value.
  *
  * @param semid The ID of the semaphore set to initialize.
- * @param K     The initial value for SEM_EMPTY (belt capacity).
+ * @param shm   Initialized SharedState (lane layout and number of docks).
+ */
+void sem_init(int semid, const SharedState *shm) {
+  for (int l = 0; l < shm->belt_lanes; ++l) {
+    sem_set(semid, belt_lane_sem(l, SEM_MUTEX), SETVAL, 1);
+#ifdef BELT_LOCKFREE
+    sem_set(semid, belt_lane_sem(l, SEM_EMPTY), SETVAL, 0);
+#else
+    sem_set(semid, belt_lane_sem(l, SEM_EMPTY), SETVAL, shm->lanes[l].slots);
+#endif
+    sem_set(semid, belt_lane_sem(l, SEM_FULL), SETVAL, 0);
+  }
+  sem_set(semid, SEM_DOCK, SETVAL, shm->docks_D);
+}
+
+/**
+ * @brief Parses the number of standard workers per package type.
+ *
+ * Accepts one count for every type (`--workers=2`) or one per type
+ * (`--workers=2,1,1` for A, B and C).
+ *
+ * @param arg     Option value.
+ * @param workers Receives the counts of A, B and C.
+ * @return 0 on success, -1 on invalid input.
+ */
+int parse_workers(const char *arg, int workers[PKG_END]) {
+  char *end;
+  for (int t = 0; t < PKG_END; ++t) {
+    long n = strtol(arg, &end, 10);
+    if (end == arg || n < 0 || n > MAX_WORKERS_PER_TYPE) return -1;
+    workers[t] = (int)n;
+
+    if (*end == '\0') {
+      if (t != 0) return -1; // Either one count or all three
+      workers[PKG_B] = workers[PKG_C] = workers[PKG_A];
+      break;
+    }
+    if (*end != ',' || t == PKG_END - 1) return -1;
+    arg = end + 1;
+  }
+  return workers[PKG_A] + workers[PKG_B] + workers[PKG_C] > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Allocates a zeroed, cache line aligned block for threads mode.
+ *
+ * Takes the place of a shared memory segment when all roles are threads.
+ *
+ * @param size Block size in bytes.
+ * @return The block, freed with `free()`. Exits on failure.
  */
-void sem_init(int semid, int K) {
-  sem_set(semid, SEM_MUTEX, SETVAL, 1);
-  sem_set(semid, SEM_EMPTY, SETVAL, K);
-  sem_set(semid, SEM_FULL, SETVAL, 0);
-  sem_set(semid, SEM_DOCK, SETVAL, 1);
+void *alloc_private_block(size_t size) {
+  void *block;
+  if (posix_memalign(&block, CACHE_LINE_SIZE, size) != 0) {
+    perror("Private block");
+    exit(1);
+  }
+  memset(block, 0, size);
+  return block;
+}
+
+/**
+ * @brief Starts a role executable with its output going to the log file.
+ *
+ * `posix_spawn()` starts the child without copying the page tables of the
+ * Dispatcher (vfork semantics), so starting a role costs the same whatever
+ * the size of the Dispatcher and however many trucks were started before.
+ * Standard output is redirected by a file action.
+ *
+ * @param path   Executable, relative to the working directory.
+ * @param argv   Arguments, NULL terminated.
+ * @param log_fd Descriptor of `simulation.log`.
+ * @return pid of the role. Exits if it cannot be started.
+ */
+pid_t spawn_role(const char *path, char *const argv[], int log_fd) {
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, log_fd, STDOUT_FILENO);
+
+  pid_t pid;
+  int err = posix_spawn(&pid, path, &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+
+  if (err != 0) {
+    fprintf(stderr, "Spawn %s: %s\n", path, strerror(err));
+    exit(1);
+  }
+  return pid;
+}
+
+/**
+ * @brief Waits until every role waits at the start barrier (@ref role_env_ready).
+ *
+ * The last role wakes the Dispatcher, it also polls to notice roles that
+ * died before reaching the barrier: once none arrived for
+ * @ref START_STALL_S seconds it stops waiting.
+ *
+ * @param shm Pointer to the attached SharedState structure.
+ * @return Roles at the barrier.
+ */
+unsigned int wait_roles_ready(SharedState *shm) {
+  unsigned int ready = __atomic_load_n(&shm->roles_ready, __ATOMIC_ACQUIRE);
+  unsigned int seen = ready;
+  uint64_t last_arrival = monotonic_ns();
+
+  while (ready < shm->roles_expected) {
+    futex_wait_timeout(&shm->roles_ready, ready, START_POLL_MS * 1000000ull);
+    ready = __atomic_load_n(&shm->roles_ready, __ATOMIC_ACQUIRE);
+
+    uint64_t now = monotonic_ns();
+    if (ready != seen) {
+      seen = ready;
+      last_arrival = now;
+    }
+    else if (now - last_arrival > START_STALL_S * 1000000000ull) {
+      break;
+    }
+  }
+  return ready;
+}
+
+/**
+ * @brief Starts a role thread.
+ *
+ * @param t    Thread slot, filled with the thread handle.
+ * @param run  Thread function running the role.
+ * @param env  Resources of the run.
+ * @param arg  Role argument (@ref RoleThread::arg).
+ * @param cpus CPU set of the role, NULL when nothing is pinned.
+ */
+void start_role_thread(RoleThread *t, void *(*run)(void *), const RoleEnv *env, int arg, const CpuMask *cpus) {
+  t->env = env;
+  t->arg = arg;
+  t->cpus = cpus;
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, ROLE_THREAD_STACK);
+
+  int err = pthread_create(&t->thread, &attr, run, t);
+  pthread_attr_destroy(&attr);
+
+  if (err != 0) {
+    errno = err;
+    perror("Role thread");
+    exit(1);
+  }
+}
+
+/**
+ * @brief Outcome of a command posted to a mailbox.
+ */
+typedef enum {
+  POST_OK,       /**< Command posted. */
+  POST_NO_TRUCK, /**< No truck at the dock to address. */
+  POST_FULL      /**< Mailbox full, command dropped. */
+} PostStatus;
+
+/**
+ * @brief Posts a forced departure to the truck at a dock.
+ *
+ * Posted under SEM_MUTEX while the truck is docked, the truck takes it or
+ * drains it when undocking. The belt doorbell wakes the truck in case it
+ * sleeps on an empty belt.
+ *
+ * @param shm      Pointer to the attached SharedState structure.
+ * @param semid    Semaphore set ID.
+ * @param dock     Dock index (0-based).
+ * @param seq      Receives the command sequence number.
+ * @param truck_id Receives the id of the docked truck.
+ * @param truck_pid Receives the pid of the docked truck.
+ * @return Outcome of the post.
+ */
+PostStatus post_departure(SharedState *shm, int semid, int dock, uint64_t *seq, int *truck_id, pid_t *truck_pid) {
+  SEM_P(semid, SEM_MUTEX);
+
+  *truck_pid = shm->docks[dock].truck_docked ? shm->docks[dock].current_truck_pid : 0;
+  *truck_id = shm->docks[dock].current_truck_id;
+  *seq = 0;
+
+  if (*truck_pid) {
+    *seq = mailbox_post(&shm->dock_mail[dock], CMD_FORCE_DEPART, dock, 0);
+    belt_kick(shm);
+  }
+
+  SEM_V(semid, SEM_MUTEX);
+
+  if (!*truck_pid) return POST_NO_TRUCK;
+  return *seq ? POST_OK : POST_FULL;
+}
+
+/**
+ * @brief Answers a `stats` command with live counters of the run.
+ *
+ * Counters are read with atomic loads, without SEM_MUTEX.
+ *
+ * @param conn  Connection the command came from.
+ * @param shm   Pointer to the attached SharedState structure.
+ * @param run_s Seconds since the roles were started.
+ */
+void reply_stats(ControlConn *conn, SharedState *shm, double run_s) {
+  const SimStats *st = &shm->stats;
+  long produced[PKG_END];
+  for (int t = 0; t < PKG_END; ++t) produced[t] = __atomic_load_n(&st->produced[t], __ATOMIC_RELAXED);
+
+  double belt_weight = g_to_kg(__atomic_load_n(&shm->current_belt_weight, __ATOMIC_RELAXED));
+
+  control_reply(conn, "{\"ok\":true,\"cmd\":\"stats\",\"run_s\":%.3f,\"produced\":[%ld,%ld,%ld],"
+		"\"loaded\":%ld,\"express_loaded\":%ld,\"deliveries\":%ld,\"forced_departures\":%ld,"
+		"\"rejected_overweight\":%ld,\"on_belt\":%d,\"belt_weight\":%.2f,\"worker_rate\":%u}",
+		run_s, produced[PKG_A], produced[PKG_B], produced[PKG_C],
+		__atomic_load_n(&st->loaded, __ATOMIC_RELAXED),
+		__atomic_load_n(&st->express_loaded, __ATOMIC_RELAXED),
+		__atomic_load_n(&st->deliveries, __ATOMIC_RELAXED),
+		__atomic_load_n(&st->forced_departures, __ATOMIC_RELAXED),
+		__atomic_load_n(&st->rejected_overweight, __ATOMIC_RELAXED),
+		__atomic_load_n(&shm->current_count, __ATOMIC_RELAXED), belt_weight,
+		__atomic_load_n(&shm->worker_rate, __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief Turns a line of the terminal into a command.
+ *
+ * Takes the numbered menu (`1`..`4`) and, on other lines, the commands of the
+ * control channel. With several docks commands `1` and `2` ask for the dock,
+ * its number is the next line.
+ *
+ * @param line    Line of the terminal.
+ * @param D       Number of docks.
+ * @param pending Menu command waiting for its dock (0 = none), updated.
+ * @param req     Receives the command.
+ * @param menu    Receives the menu number, 0 for a control channel command.
+ * @return 1 if `req` holds a command, 0 if nothing is to be done yet.
+ */
+int terminal_command(const char *line, int D, int *pending, ControlRequest *req, int *menu) {
+  char *end;
+  long n = strtol(line, &end, 10);
+  int number = end != line && *end == '\0';
+
+  memset(req, 0, sizeof(*req));
+  *menu = 0;
+
+  if (*pending) {
+    *menu = *pending;
+    *pending = 0;
+    if (!number || n < 1 || n > D) {
+      printf("Incorrect dock number\n");
+      return 0;
+    }
+    req->op = *menu == 1 ? CTL_DEPART : CTL_EXPRESS;
+    req->dock = (int)n - 1;
+    return 1;
+  }
+
+  if (!number) {
+    if (control_parse(line, req) == -1) {
+      printf("Incorrect intput. Enter command number\n");
+      return 0;
+    }
+    return 1;
+  }
+
+  *menu = (int)n;
+  if (n == 1 || n == 2) {
+    if (D > 1) {
+      *pending = (int)n;
+      printf("Dock [1-%d]> ", D);
+      return 0;
+    }
+    req->op = n == 1 ? CTL_DEPART : CTL_EXPRESS;
+    return 1;
+  }
+  if (n == 3) {
+    req->op = CTL_SHUTDOWN;
+    return 1;
+  }
+  if (n == 4) {
+    req->op = CTL_STATS; // Latency report on the terminal
+    return 1;
+  }
+
+  printf("Unknown Command\n");
+  return 0;
+}
+
+/**
+ * @brief Prints command line usage.
+ *
+ * @param prog Program name (argv[0]).
+ */
+void print_usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [options] <N_Trucks> <K_BeltCap> <M_MaxBeltW> <W_TruckCap> <V_TruckVol>\n", prog);
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "  --docks=<D>            Number of loading docks (default: 1, max: %d)\n", MAX_DOCKS);
+  fprintf(stderr, "  --batch=<B>            Packages moved per belt operation (default: 1, max: %d)\n", MAX_BELT_BATCH);
+#ifdef BELT_LOCKFREE
+  fprintf(stderr, "  --lookahead=<L>        Belt slots a truck inspects for the best fitting package (default: 1, max: %d)\n", MAX_BELT_LOOKAHEAD);
+#else
+  fprintf(stderr, "  --lookahead=<L>        Belt slots a truck inspects for the best fitting package (default: 1, max: K)\n");
+#endif
+  fprintf(stderr, "  --workers=<n>|<a,b,c>  Standard workers per package type (default: 1, max: %d)\n", MAX_WORKERS_PER_TYPE);
+  fprintf(stderr, "  --lanes=<n>            Belt lanes, each with its own lock or ring (default: 1, max: %d)\n", MAX_BELT_LANES);
+  fprintf(stderr, "  --lane-policy=<p>      Lane a truck drains first: fullest, rr (default: fullest)\n");
+  fprintf(stderr, "  --log-level=<level>    simulation.log level: error, warn, info, debug (default: debug)\n");
+  fprintf(stderr, "  --trace=<file>         Record binary event trace, convert it with trace_export\n");
+  fprintf(stderr, "  --record=<file>        Record packages generated by standard workers to a workload file\n");
+  fprintf(stderr, "  --replay=<file>        Standard workers replay packages of a workload file (see workload_gen)\n");
+  fprintf(stderr, "  --headless=<n>         No CLI, shut down once <n> packages were loaded from the belt\n");
+  fprintf(stderr, "  --control=<path>       Take commands over a Unix socket, one per line, answered in JSON\n");
+  fprintf(stderr, "  --delay=<kind>=<time>  Simulated delay: work, overweight, load, delivery, return;\n");
+  fprintf(stderr, "                         <us>, <min>-<max> or exp:<mean>, units us/ms/s (e.g. delivery=exp:5s)\n");
+  fprintf(stderr, "  --no-sleep             Skip simulated work, loading and delivery times\n");
+  fprintf(stderr, "  --report=<format>      Statistics report format: text, json (default: text)\n");
+  fprintf(stderr, "  --threads              Run workers and trucks as threads of the dispatcher, no System V IPC\n");
+  fprintf(stderr, "  --fleet                Run all N trucks as state machines of one truck_fleet process or thread\n");
+  fprintf(stderr, "  --huge-pages           Back the shared state with huge pages, normal pages when none are reserved\n");
+  fprintf(stderr, "  --mlock                Pre-fault the shared state and lock it in RAM in every process\n");
+  fprintf(stderr, "  --pin=<placement>      Pin roles to CPUs: l3, spread or <role>=<cpus> (dispatcher, workers,\n");
+  fprintf(stderr, "                         express, trucks), mem=<node> for the shared state; repeatable\n");
+  fprintf(stderr, "  --virtual-time=<sec>   Run discrete-event simulation covering <sec> simulated seconds\n");
+  fprintf(stderr, "  --seed=<n>             Random seed for virtual-time mode (default: time based)\n");
+  fprintf(stderr, "  --express-every=<sec>  Virtual-time: trigger express load every <sec> seconds\n");
+  fprintf(stderr, "  --depart-every=<sec>   Virtual-time: force truck departure every <sec> seconds\n");
 }
 
 volatile sig_atomic_t exit_request = 0;
@@ -85,54 +541,332 @@ void handle_shutdown_signal(int sig) {
  * @brief Main Entry Point.
  *
  * Orchestrates the entire simulation.
- * usage: ./dispatcher <N> <K> <M> <W> <V>
+ * usage: ./dispatcher [--virtual-time=<sec>] <N> <K> <M> <W> <V>
+ *
+ * With `--virtual-time` the run is handed over to the discrete-event engine
+ * (@ref run_virtual_time) and no processes or IPC resources are created.
+ *
+ * With `--threads` the roles run as threads of this process. Shared memory is
+ * replaced by private allocations and the semaphore set by a private one
+ * (@ref sem_create_private), commands reach the threads through the same
+ * mailboxes and on shutdown the threads are woken (@ref belt_release_producers,
+ * @ref mailbox_kick) and joined.
  *
  * **Flow of Execution:**
  * 1. Validates command-line arguments and checks system process limits (`sysconf`).
  * 2. Opens/Creates `simulation.log` for child process output redirection.
- * 3. Initializes Shared Memory and Semaphores.
- * 4. Forks child processes:
+ * 3. Initializes Shared Memory and Semaphores, with `--pin` on the NUMA node
+ * of the producers (@ref placement.h).
+ * 4. Spawns child processes (@ref spawn_role):
  * - **P4 (Express Worker):** Handles priority packages.
- * - **P1-P3 (Standard Workers):** Generate standard packages.
- * - **Trucks:** N consumer processes.
- * *(Note: All children have stdout redirected to file via `dup2`)*.
- * 5. Enters the Interactive Dispatcher Loop:
- * - Command `1`: Force Truck Departure (SIGUSR1).
- * - Command `2`: Trigger Express Load (SIGUSR1 to P4).
+ * - **P1-P3 (Standard Workers):** Generate standard packages, with `--workers`
+ * several per type (P1..PS, the Express Worker becomes PS+1).
+ * - **Trucks:** N consumer processes, with `--fleet` one `truck_fleet`
+ * process running all of them (@ref fleet_run).
+ * *(Note: All children have stdout redirected to file by a spawn file action,
+ * with `--pin` they start on the CPU set of their role)*.
+ * Every role attaches and waits at the start barrier, the run starts once all
+ * are in place (@ref wait_roles_ready, @ref role_env_ready).
+ * 5. Enters the Interactive Dispatcher Loop (with `--headless` it only waits
+ * until the package target was loaded and then shuts down). The terminal and
+ * clients of the `--control` socket are served by one event loop
+ * (@ref control_next), signals are only taken while it waits:
+ * - Command `1`: Force Truck Departure at a chosen dock (dock mailbox).
+ * - Command `2`: Trigger Express Load at a chosen dock (express mailbox of P4).
  * - Command `3`: Graceful Shutdown (SIGTERM to all).
- * 6. Waits for children and cleans up IPC.
+ * - Command `4`: Package latency percentiles per stage and type (@ref stats_print_latency).
+ * - Control channel commands (@ref control.h), answered in JSON, also typed
+ * on the terminal.
+ * 6. Waits for children, prints end-of-run statistics and cleans up IPC.
  *
  * @param argc Argument count.
  * @param argv Argument values (Simulation Parameters).
  * @return 0 on success, exit code 1 on initialization failure.
  */
 int main(int argc, char *argv[]) {
-  if (argc < 6) {
-    fprintf(stderr, "Usage: %s <N_Trucks> <K_BeltCap> <M_MaxBeltW> <W_TruckCap> <V_TruckVol>\n", argv[0]);
+  // --- Options ---
+  VirtualTimeConfig vt_cfg = {0};
+  int virtual_time = 0;
+  int D = 1;
+  int B = 1;
+  int L = 1;
+  int workers_per_type[PKG_END] = {1, 1, 1};
+  int lanes = 1;
+  int lane_policy = LANE_FULLEST;
+  const char *trace_path = NULL;
+  const char *record_path = NULL;
+  const char *replay_path = NULL;
+  const char *control_path = NULL;
+  int log_level = LOG_LEVEL_DEBUG;
+  long headless_target = 0;
+  int no_sleep = 0;
+  int report_json = 0;
+  int threads = 0;
+  int fleet = 0;
+  int mem_flags = 0;
+  Placement placement;
+  placement_init(&placement);
+  int delays_set = 0;
+  SimDelay delays[DELAY_END];
+  delay_defaults(delays);
+  vt_cfg.seed = time(NULL) ^ getpid();
+
+  static struct option long_opts[] = {
+    {"virtual-time",  required_argument, 0, 't'},
+    {"seed",          required_argument, 0, 's'},
+    {"express-every", required_argument, 0, 'e'},
+    {"depart-every",  required_argument, 0, 'd'},
+    {"docks",         required_argument, 0, 'D'},
+    {"batch",         required_argument, 0, 'B'},
+    {"lookahead",     required_argument, 0, 'l'},
+    {"workers",       required_argument, 0, 'w'},
+    {"lanes",         required_argument, 0, 'n'},
+    {"lane-policy",   required_argument, 0, 'p'},
+    {"trace",         required_argument, 0, 'T'},
+    {"record",        required_argument, 0, 'r'},
+    {"replay",        required_argument, 0, 'y'},
+    {"log-level",     required_argument, 0, 'L'},
+    {"headless",      required_argument, 0, 'H'},
+    {"control",       required_argument, 0, 'C'},
+    {"no-sleep",      no_argument,       0, 'S'},
+    {"report",        required_argument, 0, 'R'},
+    {"threads",       no_argument,       0, 'P'},
+    {"fleet",         no_argument,       0, 'F'},
+    {"delay",         required_argument, 0, 'Y'},
+    {"huge-pages",    no_argument,       0, 'G'},
+    {"mlock",         no_argument,       0, 'K'},
+    {"pin",           required_argument, 0, 'A'},
+    {0, 0, 0, 0}
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+    switch (opt) {
+    case 't': virtual_time = 1; vt_cfg.duration_s = atof(optarg); break;
+    case 's': vt_cfg.seed = (unsigned int)strtoul(optarg, NULL, 10); break;
+    case 'e': vt_cfg.express_every_s = atof(optarg); break;
+    case 'd': vt_cfg.depart_every_s = atof(optarg); break;
+    case 'D': D = atoi(optarg); break;
+    case 'B': B = atoi(optarg); break;
+    case 'l': L = atoi(optarg); break;
+    case 'w':
+      if (parse_workers(optarg, workers_per_type) == -1) {
+	fprintf(stderr, "Workers must be <n> or <a>,<b>,<c> with counts between 0 and %d, at least one worker.\n", MAX_WORKERS_PER_TYPE);
+	exit(1);
+      }
+      break;
+    case 'n': lanes = atoi(optarg); break;
+    case 'p':
+      if (strcmp(optarg, "fullest") == 0) lane_policy = LANE_FULLEST;
+      else if (strcmp(optarg, "rr") == 0) lane_policy = LANE_ROUND_ROBIN;
+      else {
+	fprintf(stderr, "Unknown lane policy '%s'.\n", optarg);
+	exit(1);
+      }
+      break;
+    case 'T': trace_path = optarg; break;
+    case 'r': record_path = optarg; break;
+    case 'y': replay_path = optarg; break;
+    case 'L':
+      log_level = log_level_parse(optarg);
+      if (log_level == -1) {
+	fprintf(stderr, "Unknown log level '%s'.\n", optarg);
+	exit(1);
+      }
+      break;
+    case 'H': headless_target = atol(optarg); break;
+    case 'C': control_path = optarg; break;
+    case 'S': no_sleep = 1; break;
+    case 'P': threads = 1; break;
+    case 'F': fleet = 1; break;
+    case 'G': mem_flags |= SHM_BLOCK_HUGE; break;
+    case 'K': mem_flags |= SHM_BLOCK_LOCK; break;
+    case 'A':
+      if (placement_parse_option(optarg, &placement) == -1) {
+	fprintf(stderr, "Invalid placement '%s', use l3, spread, <role>=<cpus> or mem=<node>.\n", optarg);
+	exit(1);
+      }
+      break;
+    case 'Y':
+      if (delay_parse_option(optarg, delays) == -1) {
+	fprintf(stderr, "Invalid delay '%s', use <kind>=<us>|<min>-<max>|exp:<mean> with units us, ms or s.\n", optarg);
+	exit(1);
+      }
+      delays_set = 1;
+      break;
+    case 'R':
+      if (strcmp(optarg, "json") == 0) report_json = 1;
+      else if (strcmp(optarg, "text") == 0) report_json = 0;
+      else {
+	fprintf(stderr, "Unknown report format '%s'.\n", optarg);
+	exit(1);
+      }
+      break;
+    default:  print_usage(argv[0]); exit(1);
+    }
+  }
+
+  if (argc - optind < 5) {
+    print_usage(argv[0]);
     exit(1);
   }
   
-  int N = atoi(argv[1]);
-  int K = atoi(argv[2]);
-  double M = atof(argv[3]);
-  double W = atof(argv[4]);
-  double V = atof(argv[5]);
+  int N = atoi(argv[optind]);
+  int K = atoi(argv[optind + 1]);
+  double M = atof(argv[optind + 2]);
+  double W = atof(argv[optind + 3]);
+  double V = atof(argv[optind + 4]);
 
-  if (N<=0 || K<=0 || M<=0 || W<=0 || V<=0) {
+  // Limits below one gram or one cm3 round to zero
+  if (N<=0 || K<=0 || kg_to_g(M)<=0 || kg_to_g(W)<=0 || m3_to_cm3(V)<=0) {
     fprintf(stderr, "All parameters must be positive numbers.\n");
     exit(1);
   }
 
+  if (D < 1 || D > MAX_DOCKS) {
+    fprintf(stderr, "Number of docks must be between 1 and %d.\n", MAX_DOCKS);
+    exit(1);
+  }
+
+  if (B < 1 || B > MAX_BELT_BATCH) {
+    fprintf(stderr, "Batch size must be between 1 and %d.\n", MAX_BELT_BATCH);
+    exit(1);
+  }
+
+#ifdef BELT_LOCKFREE
+  if (L < 1 || L > MAX_BELT_LOOKAHEAD) {
+    fprintf(stderr, "Lookahead must be between 1 and %d.\n", MAX_BELT_LOOKAHEAD);
+    exit(1);
+  }
+#else
+  // Belt index answers a pick in constant time, the window may span the whole belt
+  if (L < 1) {
+    fprintf(stderr, "Lookahead must be a positive number.\n");
+    exit(1);
+  }
+#endif
+
+  if (lanes < 1 || lanes > MAX_BELT_LANES || lanes > K) {
+    fprintf(stderr, "Number of lanes must be between 1 and %d and not exceed K.\n", MAX_BELT_LANES);
+    exit(1);
+  }
+
+  int S = workers_per_type[PKG_A] + workers_per_type[PKG_B] + workers_per_type[PKG_C];
+
+  const char *workload_path = record_path ? record_path : replay_path;
+  if (record_path && replay_path) {
+    fprintf(stderr, "A workload file is either recorded or replayed, not both.\n");
+    exit(1);
+  }
+
+  if (workload_path && strlen(workload_path) >= WORKLOAD_PATH_MAX) {
+    fprintf(stderr, "Workload file path must be shorter than %d characters.\n", WORKLOAD_PATH_MAX);
+    exit(1);
+  }
+
+  if (headless_target < 0) {
+    fprintf(stderr, "Headless package count must be a positive number.\n");
+    exit(1);
+  }
+
+  // Batch and lookahead never need more slots than the belt has
+  if (B > K) B = K;
+  if (L > K) L = K;
+
+  // --- Virtual Time Mode ---
+  // No processes and no IPC, the whole run is replayed in this process
+  if (virtual_time) {
+    if (vt_cfg.duration_s <= 0) {
+      fprintf(stderr, "Virtual time duration must be a positive number.\n");
+      exit(1);
+    }
+
+    if (trace_path) {
+      fprintf(stderr, "Event trace is only recorded in process mode.\n");
+      exit(1);
+    }
+
+    if (threads || fleet || placement.layout != PLACE_NONE) {
+      fprintf(stderr, "Virtual time mode runs without processes or threads.\n");
+      exit(1);
+    }
+
+    if (workload_path) {
+      fprintf(stderr, "Workload files are only recorded and replayed by workers in process or threads mode.\n");
+      exit(1);
+    }
+
+    if (control_path) {
+      fprintf(stderr, "Control channel only serves process and threads mode, use --express-every and --depart-every.\n");
+      exit(1);
+    }
+
+    vt_cfg.N = N;
+    vt_cfg.K = K;
+    vt_cfg.M = kg_to_g(M);
+    vt_cfg.W = kg_to_g(W);
+    vt_cfg.V = m3_to_cm3(V);
+    vt_cfg.D = D;
+    vt_cfg.L = L;
+    for (int t = 0; t < PKG_END; ++t) vt_cfg.workers[t] = workers_per_type[t];
+    vt_cfg.report_json = report_json;
+    memcpy(vt_cfg.delays, delays, sizeof(vt_cfg.delays));
+
+    printf("--- "COLOR_BLUE" Virtual Time Simulation "COLOR_RESET"---\n");
+    printf("Params: N=%d, K=%d, M=%.2f, W=%.2f, V=%.2f, D=%d, L=%d, workers=%d,%d,%d, T=%.0fs, seed=%u\n",
+	   N, K, M, W, V, D, L, workers_per_type[PKG_A], workers_per_type[PKG_B], workers_per_type[PKG_C],
+	   vt_cfg.duration_s, vt_cfg.seed);
+    if (delays_set) print_delays(delays);
+
+    return run_virtual_time(&vt_cfg);
+  }
+
   // Check process count limit for truck
   long max_sys_procs = sysconf(_SC_CHILD_MAX);
 
-  if (N > (max_sys_procs / 2)) { // Divided by 2 to leave some place for other programs
-    fprintf(stderr, "Requesting %d trucks (N_trucks) is close to system limit\n", N);
+  // A fleet is one process whatever N is
+  if (!threads && (fleet ? 1 : N) + S > (max_sys_procs / 2)) { // Divided by 2 to leave some place for other programs
+    fprintf(stderr, "Requesting %d trucks (N_trucks) and %d workers is close to system limit, try --fleet\n", N, S);
     exit(1);
   }
   
-  if (K > MAX_BELT_CAPACITY) {
-    fprintf(stderr, "K cannot exceed internal buffer limit (%d).\n", MAX_BELT_CAPACITY);
+#ifndef BELT_LOCKFREE
+  // Private semaphores have no SEMVMX, every lane counts its own slots
+  if (!threads && (K + lanes - 1) / lanes > SEM_BELT_MAX_CAPACITY) {
+    fprintf(stderr, "K per lane cannot exceed semaphore belt limit (%d), use more --lanes or build with -DBELT_LOCKFREE=ON.\n", SEM_BELT_MAX_CAPACITY);
+    exit(1);
+  }
+#endif
+
+  // --- Placement ---
+  // Roles without a set of their own keep the CPUs the Dispatcher was started with
+  CpuMask allowed;
+  if (placement_allowed(&allowed) == -1) {
+    perror("Placement: sched_getaffinity");
+    exit(1);
+  }
+  if (placement_resolve(&placement, PLACEMENT_SYSFS_CPU, &allowed) == -1) {
+    fprintf(stderr, "Placement needs the CPU topology and an online, allowed CPU in every set given.\n");
+    exit(1);
+  }
+  if (placement_pin(&placement.cpus[PIN_DISPATCHER]) == -1) {
+    perror("Placement: sched_setaffinity");
+    exit(1);
+  }
+
+  // --- Workload File ---
+  // Opened before any IPC exists, a bad file leaves nothing to clean up
+  WorkloadHeader *workload = NULL;
+  if (workload_path) {
+    workload = record_path ? workload_create(record_path, WORKLOAD_RECORD_CAPACITY, S, 0) : workload_map(replay_path, 0);
+    if (!workload) { perror("Workload file"); exit(1); }
+  }
+
+  // --- Control Channel ---
+  // Headless runs have no terminal, a socket still takes commands
+  ControlServer control;
+  if (control_open(&control, control_path, headless_target > 0 ? -1 : STDIN_FILENO) == -1) {
+    perror("Control socket");
     exit(1);
   }
 
@@ -144,74 +878,226 @@ int main(int argc, char *argv[]) {
   if (log_ds == -1) { perror("Log file"); exit(1); }
   
   // --- IPC Initialization ---
-  // Semaphore init
-  int semid = get_sem(KEY_PATH, KEY_ID_SEM, 4);
-
-  // Shared mem attachment
+  // Threads share the address space, the same structures live in private memory
+  int semid;
   SharedState *shm;
-  shm = (SharedState *)attach_memory_block(KEY_PATH, KEY_ID_SHM, sizeof(SharedState));
+  MetricsBlock *metrics;
+  int mem_granted; // Huge pages and locking are options of the state segment only
+
+  // Pages the Dispatcher touches while creating the state go to the producers' node
+  int mem_placed = placement.mem_node >= 0 && placement_prefer_node(placement.mem_node) == 0;
+
+  if (threads) {
+    semid = sem_create_private(belt_sem_count(lanes));
+    shm = (SharedState *)alloc_memory_block(shared_state_size(K), mem_flags, &mem_granted);
+    metrics = (MetricsBlock *)alloc_private_block(metrics_segment_size(N));
+  }
+  else {
+    // Semaphore init
+    semid = get_sem(KEY_PATH, KEY_ID_SEM, belt_sem_count(lanes));
+
+    // Shared mem attachment
+    shm = (SharedState *)create_memory_block(KEY_PATH, KEY_ID_SHM, shared_state_size(K), mem_flags, &mem_granted);
+
+    // Live metrics segment, read by warehouse_stats
+    metrics = (MetricsBlock *)attach_memory_block(KEY_PATH, KEY_ID_METRICS, metrics_segment_size(N));
+  }
+
+  shm_init(shm, K, M, W, V, D, B, L, lanes, lane_policy, S, log_level, no_sleep, delays);
+  shm->mem_flags = mem_granted;
+  sem_init(semid, shm);
+
+  // Pages roles fault in later follow the segment's policy, private blocks were touched whole
+  if (mem_placed) {
+    size_t size = shared_state_size(K);
+    if (mem_granted & SHM_BLOCK_HUGE) size = (size + huge_page_size() - 1) / huge_page_size() * huge_page_size();
+    if (!threads && placement_bind_memory(shm, size, placement.mem_node) == -1) mem_placed = 0;
+    placement_prefer_node(-1);
+  }
 
-  shm_init(shm, K, M, W, V);
-  sem_init(semid, K);
+  metrics_init(metrics, N, D, S + 1);
+  shm->metrics_trucks = N;
+
+  // Event trace segment, one ring per role
+  TraceHeader *trace = NULL;
+  TraceRing *trace_ring_disp = NULL;
+  if (trace_path) {
+    int rings = trace_ring_count(S, fleet ? 1 : N); // A fleet writes one ring
+    size_t size = trace_segment_size(rings, TRACE_RING_EVENTS);
+    trace = (TraceHeader *)(threads ? alloc_private_block(size) : attach_memory_block(KEY_PATH, KEY_ID_TRACE, size));
+    trace_init(trace, rings, TRACE_RING_EVENTS, S);
+    trace_ring_disp = trace_claim(trace, TRACE_ROLE_DISPATCHER, 0);
+    shm->trace_rings = rings;
+  }
+
+  if (workload) {
+    shm->workload_mode = record_path ? WORKLOAD_RECORD : WORKLOAD_REPLAY;
+    snprintf(shm->workload_path, sizeof(shm->workload_path), "%s", workload_path);
+  }
 
   printf("--- "COLOR_BLUE" Simulation Started "COLOR_RESET"---\n");
 
 #ifdef SIM_DELAY_MS
   printf("Simulation Delay Enabled: %d ms\n", SIM_DELAY_MS);
 #endif
-  
-  printf("Params: N=%d, K=%d, M=%.2f, W=%.2f, V=%.2f\n", N, K, M, W, V);
 
-  // --- Fork Processes ---
+#ifdef BELT_LOCKFREE
+  printf("Belt: lock-free MPMC ring\n");
+#else
+  printf("Belt: semaphore guarded buffer\n");
+#endif
+  
+  printf("Roles: %s%s\n", threads ? "threads of the dispatcher" : "processes", fleet ? ", trucks as one fleet" : "");
 
-  // Worker P4 (Express)
-  pid_t pid_p4 = fork();
-  if(pid_p4 == 0) {
-    // Change standart output
-    if (dup2(log_ds, STDOUT_FILENO) == -1) { perror("dup2 P4"); exit(1); }
+  if (mem_flags) {
+    printf("Memory: %s pages%s\n", (mem_granted & SHM_BLOCK_HUGE) ? "huge" : "normal",
+	   (mem_granted & SHM_BLOCK_LOCK) ? ", pre-faulted and locked" : "");
+    if ((mem_flags & ~mem_granted) & SHM_BLOCK_HUGE) printf("  No huge pages available (vm.nr_hugepages), using normal pages\n");
+    if ((mem_flags & ~mem_granted) & SHM_BLOCK_LOCK) printf("  mlock failed (ulimit -l), segment is not locked\n");
+  }
+  
+  if (placement.layout != PLACE_NONE) {
+    static const char *layouts[] = {"none", "manual", "l3", "spread"};
+    printf("Placement: %s, %d L3 domain%s,", layouts[placement.layout], placement.l3_domains,
+	   placement.l3_domains == 1 ? "" : "s");
+    for (int r = 0; r < PIN_END; ++r) {
+      char cpus[CPU_MASK_TEXT_MAX];
+      cpu_mask_format(&placement.cpus[r], cpus, sizeof(cpus));
+      printf(" %s=%s", placement_role_name(r), cpus);
+    }
+    printf("\n");
+    if (placement.mem_node >= 0) {
+      printf("  Shared state on node %d%s\n", placement.mem_node, mem_placed ? "" : " not applied (no NUMA memory policy)");
+    }
+  }
 
-    execl("./worker_express", "worker_express", NULL);
-    perror("Exec P4"); exit(1);
+  printf("Params: N=%d, K=%d, M=%.2f, W=%.2f, V=%.2f, D=%d, B=%d, L=%d\n", N, K, M, W, V, D, B, belt_lookahead(shm));
+  printf("Workers: %d,%d,%d (A,B,C), lanes: %d (%s)\n",
+	 workers_per_type[PKG_A], workers_per_type[PKG_B], workers_per_type[PKG_C],
+	 shm->belt_lanes, lane_policy == LANE_ROUND_ROBIN ? "round-robin" : "fullest first");
+  if (delays_set) print_delays(delays);
+  if (record_path) {
+    printf("Workload: recording to %s\n", record_path);
   }
-  else if (pid_p4 == -1) {
-    perror("Fork P4"); exit(1);
+  else if (replay_path) {
+    printf("Workload: replaying %s (%llu packages of %u workers)\n", replay_path,
+	   (unsigned long long)workload->count, workload->workers);
   }
-  shm->p4_pid = pid_p4;
-  
-  // Workers: P1, P2, P3 (Standard)
-  pid_t workers[3];
-  const char *types[] = {"A", "B", "C"};
-  
-  for(int i=0; i<3; ++i) {
-    if((workers[i] = fork()) == 0) {
-      // Change standart output
-      if (dup2(log_ds, STDOUT_FILENO) == -1) { perror("dup2 Std. Worker"); exit(1); }
-      
-      execl("./worker_std", "worker_std", types[i], NULL);
-      perror("Exec Worker"); exit(1);
+
+  struct timespec run_start, run_end;
+
+  // Standard workers are numbered by type: A workers first, then B and C
+  PackageType worker_types[MAX_WORKERS_PER_TYPE * PKG_END];
+  for (int t = 0, w = 0; t < PKG_END; ++t) {
+    for (int i = 0; i < workers_per_type[t]; ++i) worker_types[w++] = (PackageType)t;
+  }
+
+  pid_t *workers = NULL;
+  pid_t *trucks = NULL;
+  RoleThread express_thread;
+  RoleThread *worker_threads = NULL;
+  RoleThread *truck_threads = NULL;
+  RoleEnv env = {shm, semid, metrics, trace, workload};
+
+  // Every role waits at the start barrier once attached
+  shm->roles_expected = S + 1 + (fleet ? 1 : N);
+  uint64_t t_spawn = monotonic_ns();
+
+  // --- Start Threads ---
+  if (threads) {
+    // Roles log straight to simulation.log, stdout stays with the CLI
+    log_set_fd(log_ds);
+
+    // Role threads inherit a mask without SIGINT/TERM, they must interrupt the CLI
+    sigset_t term, old_mask;
+    sigemptyset(&term);
+    sigaddset(&term, SIGINT);
+    sigaddset(&term, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &term, &old_mask);
+
+    start_role_thread(&express_thread, worker_express_thread, &env, 0, role_cpus(&placement, &allowed, PIN_EXPRESS));
+
+    worker_threads = malloc(sizeof(RoleThread) * S);
+    for (int i = 0; i < S; ++i) {
+      worker_threads[i].type = worker_types[i];
+      start_role_thread(&worker_threads[i], worker_std_thread, &env, i + 1, role_cpus(&placement, &allowed, PIN_WORKERS));
+    }
+
+    if (fleet) {
+      truck_threads = malloc(sizeof(RoleThread));
+      start_role_thread(&truck_threads[0], fleet_thread, &env, N, role_cpus(&placement, &allowed, PIN_TRUCKS));
     }
-    else if (workers[i] == -1) {
-      perror("Fork Worker"); exit(1);
+    else {
+      truck_threads = malloc(sizeof(RoleThread) * N);
+      const CpuMask *truck_cpus = role_cpus(&placement, &allowed, PIN_TRUCKS);
+      for (int i = 0; i < N; ++i) start_role_thread(&truck_threads[i], truck_thread, &env, i + 1, truck_cpus);
     }
+
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
   }
 
-  // Trucks
-  pid_t *trucks = malloc(sizeof(pid_t) * N);
+  // --- Spawn Processes ---
+  // Output of every role goes to simulation.log, use tail -f simulation.log to follow it
+  else {
+    // Worker P4 (Express)
+    pin_spawner(role_cpus(&placement, &allowed, PIN_EXPRESS));
+    char *express_argv[] = {"worker_express", NULL};
+    shm->p4_pid = spawn_role("./worker_express", express_argv, log_ds);
 
-  for(int i=0; i<N; ++i) {
-    if((trucks[i] = fork()) == 0) {
-      // Change standart output
-      if (dup2(log_ds, STDOUT_FILENO) == -1) { perror("dup2 Truck"); exit(1); }
-      
+    // Workers: P1, P2, P3 (Standard), P1..PS with --workers
+    char *types[] = {"A", "B", "C"};
+    workers = malloc(sizeof(pid_t) * S);
+
+    pin_spawner(role_cpus(&placement, &allowed, PIN_WORKERS));
+    for (int i = 0; i < S; ++i) {
       char id_str[11];
-      sprintf(id_str, "%d", i+1);
-      execl("./truck", "truck", id_str, NULL);
-      perror("Exec Truck"); exit(1);
+      sprintf(id_str, "%d", i + 1);
+      char *worker_argv[] = {"worker_std", types[worker_types[i]], id_str, NULL};
+      workers[i] = spawn_role("./worker_std", worker_argv, log_ds);
     }
-    else if(trucks[i] == -1) {
-      perror("Fork Truck"); exit(1);
+
+    // Trucks, all of them in one process with --fleet
+    trucks = malloc(sizeof(pid_t) * N);
+
+    pin_spawner(role_cpus(&placement, &allowed, PIN_TRUCKS));
+    if (fleet) {
+      char count_str[11];
+      sprintf(count_str, "%d", N);
+      char *fleet_argv[] = {"truck_fleet", "1", count_str, NULL};
+      trucks[0] = spawn_role("./truck_fleet", fleet_argv, log_ds);
+    }
+
+    for (int i = 0; !fleet && i < N; ++i) {
+      char id_str[11];
+      sprintf(id_str, "%d", i + 1);
+      char *truck_argv[] = {"truck", id_str, NULL};
+      trucks[i] = spawn_role("./truck", truck_argv, log_ds);
     }
+
+    pin_spawner(role_cpus(&placement, &allowed, PIN_DISPATCHER));
   }
+  shm->stats.spawn_ns = monotonic_ns() - t_spawn;
+
+  // --- Start Barrier ---
+  // Trucks never dock before the workers are attached, the run starts with all roles in place
+  unsigned int ready = wait_roles_ready(shm);
+  shm->stats.ready_ns = monotonic_ns() - t_spawn;
+  shm->stats.started_roles = (int)ready;
+  if (ready < shm->roles_expected) {
+    printf("Start: only %u of %u roles reached the start barrier, see simulation.log\n", ready, shm->roles_expected);
+  }
+
+  // Arrival times of the workload are relative to the start of the roles
+  shm->workload_t0_ns = monotonic_ns();
+  if (record_path) workload->t0_ns = shm->workload_t0_ns;
+  shm->stats.t_go_ns = shm->workload_t0_ns;
+  clock_gettime(CLOCK_MONOTONIC, &run_start);
+
+  __atomic_store_n(&shm->start_gate, 1, __ATOMIC_RELEASE);
+  futex_wake(&shm->start_gate, INT_MAX);
+
+  printf("Start: %u roles started in %.1f ms, all waiting after %.1f ms\n", ready,
+	 shm->stats.spawn_ns / 1e6, shm->stats.ready_ns / 1e6);
 
   // SIGTERM handler definition
   struct sigaction sa_term;
@@ -221,116 +1107,297 @@ int main(int argc, char *argv[]) {
   sigaction(SIGTERM, &sa_term, NULL);
   sigaction(SIGINT, &sa_term, NULL);
 
+  // Signals are only taken while waiting for commands, so none slips in between
+  // the exit_request check and the wait
+  sigset_t term, wait_mask;
+  sigemptyset(&term);
+  sigaddset(&term, SIGINT);
+  sigaddset(&term, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &term, &wait_mask);
+
   // --- Dispatcher Loop ---
-  int cmd;
   char time_buf[64];
-    
-  printf("\nCommands:\n 1: Force Truck Departure\n 2: Express Load (P4)\n 3: Shutdown\n");
+  char line[CONTROL_LINE_MAX];
+  int pending_dock = 0;
+  int prompt = control.input.fd != -1;
+
+  if (headless_target > 0) {
+    printf("\nHeadless run until %ld packages are loaded\n", headless_target);
+  }
+  else {
+    printf("\nCommands:\n 1: Force Truck Departure\n 2: Express Load (P%d)\n 3: Shutdown\n 4: Latency Report\n", S + 1);
+  }
+  if (control_path) {
+    printf("Control: %s (depart, express, stats, set-rate, resize, shutdown)\n", control_path);
+  }
 
   while(1) {
-    // Forcing cmd 3 if SIGTERM/INT was called before scanf
+    ControlRequest req;
+    ControlConn *from = NULL; // NULL: shutdown without a command
+    int menu = 0;             // Numbered command of the terminal, answered in text
+
     if (exit_request) {
-      cmd = 3;
+      req.op = CTL_SHUTDOWN;
       printf("\nTermination signal recived\n");
     }
+    // No CLI, shut down once the target was loaded or on SIGTERM/INT
+    else if (headless_target > 0 && __atomic_load_n(&shm->stats.loaded, __ATOMIC_RELAXED) >= headless_target) {
+      req.op = CTL_SHUTDOWN;
+    }
     else {
-      printf("CMD> ");
+      // A dock question is its own prompt
+      if (prompt && !pending_dock && control.input.fd != -1) printf("CMD> ");
+      prompt = 0;
       fflush(stdout);
 
-      int scanf_res = scanf("%d", &cmd);
+      int res = control_next(&control, headless_target > 0 ? HEADLESS_POLL_MS : -1, &wait_mask, &from, line, sizeof(line));
+      if (res == -1) {
+	perror("Control channel");
+	exit_request = 1;
+	continue;
+      }
+      if (res == 0) {
+	// Closed terminal without a socket leaves nobody to give commands
+	if (headless_target == 0 && control.input.fd == -1 && control.listen_fd == -1) {
+	  printf("\nInput closed\n");
+	  exit_request = 1;
+	}
+	continue;
+      }
 
-      // Signal broke scanf work, set shutdown cmd
-      if (exit_request) {
-	cmd = 3;
-	printf("\nTermination signal recived\n");
+      if (from == &control.input) {
+	prompt = 1;
+	if (!terminal_command(line, D, &pending_dock, &req, &menu)) continue;
       }
-      else if (scanf_res != 1) {
-	// Consume garbage
-	while(getchar() != '\n');
-	printf("Incorrect intput. Enter command number\n");
+      else if (control_parse(line, &req) == -1) {
+	control_reply(from, "{\"ok\":false,\"error\":\"%s\"}", req.error);
 	continue;
       }
     }
 
-    if (cmd == 1) {
-      SEM_P(semid, SEM_MUTEX);
+    if (req.op == CTL_DEPART || req.op == CTL_EXPRESS) {
+      if (req.dock >= D) {
+	control_reply(from, "{\"ok\":false,\"error\":\"invalid dock\"}");
+	continue;
+      }
+    }
 
-      if (shm->truck_docked) {
+    if (req.op == CTL_DEPART) {
+      uint64_t seq;
+      int truck_id;
+      pid_t truck_pid;
+      PostStatus st = post_departure(shm, semid, req.dock, &seq, &truck_id, &truck_pid);
+      if (st == POST_OK) trace_event(trace_ring_disp, TRACE_FORCE_DEPART, 0, req.dock);
 
-	get_time(time_buf, sizeof(time_buf));
-	printf("["COLOR_GREEN"%s"COLOR_RESET"]"COLOR_BLUE"  Dispatcher "COLOR_RESET"Signaling truck %d to depart early.\n", time_buf, shm->current_truck_pid);
+      if (!menu) {
+	if (st == POST_OK) {
+	  control_reply(from, "{\"ok\":true,\"cmd\":\"depart\",\"dock\":%d,\"truck\":%d,\"seq\":%llu}",
+			req.dock + 1, truck_id, (unsigned long long)seq);
+	}
+	else {
+	  control_reply(from, "{\"ok\":false,\"error\":\"%s\"}", st == POST_FULL ? "mailbox full" : "no truck at dock");
+	}
+	continue;
+      }
 
-	// Sends force departure signal to the truck
-	kill(shm->current_truck_pid, SIGUSR1);
+      // Output only after the critical section
+      get_time(time_buf, sizeof(time_buf));
+      if (st == POST_FULL) {
+	printf("["COLOR_YELLOW"%s"COLOR_RESET"]"COLOR_BLUE"  Dispatcher "COLOR_RESET"Mailbox of dock %d is full, command dropped.\n", time_buf, req.dock + 1);
+      }
+      else if (st == POST_OK) {
+	printf("["COLOR_GREEN"%s"COLOR_RESET"]"COLOR_BLUE"  Dispatcher "COLOR_RESET"Command %llu: truck %d at dock %d departs early.\n", time_buf, (unsigned long long)seq, threads || fleet ? truck_id : truck_pid, req.dock + 1);
       }
       else {
-	get_time(time_buf, sizeof(time_buf));
-	printf("["COLOR_YELLOW"%s"COLOR_RESET"]"COLOR_BLUE"  Dispatcher "COLOR_RESET"No truck at dock to release.\n", time_buf);
+	printf("["COLOR_YELLOW"%s"COLOR_RESET"]"COLOR_BLUE"  Dispatcher "COLOR_RESET"No truck at dock %d to release.\n", time_buf, req.dock + 1);
       }
-
-      SEM_V(semid, SEM_MUTEX);
     }
-    else if (cmd == 2) { // Signaling P4 (Express)
-      get_time(time_buf, sizeof(time_buf));
-      printf("["COLOR_GREEN"%s"COLOR_RESET"]"COLOR_BLUE"  Dispatcher "COLOR_RESET"Signaling P4 (Express).\n", time_buf);
+    else if (req.op == CTL_EXPRESS) {
+      // Dock and package count travel with the command, random 1-5 packages from the menu
+      uint64_t seq = mailbox_post(&shm->express_mail, CMD_EXPRESS_LOAD, req.dock, (int)req.count);
+
+      if (!menu) {
+	if (seq) {
+	  control_reply(from, "{\"ok\":true,\"cmd\":\"express\",\"dock\":%d,\"count\":%ld,\"seq\":%llu}",
+			req.dock + 1, req.count, (unsigned long long)seq);
+	}
+	else {
+	  control_reply(from, "{\"ok\":false,\"error\":\"mailbox full\"}");
+	}
+	continue;
+      }
 
-      // No need for shared state access, p4_pid is being set once in dispatcher
-      kill(shm->p4_pid, SIGUSR1);
+      get_time(time_buf, sizeof(time_buf));
+      if (seq) {
+	printf("["COLOR_GREEN"%s"COLOR_RESET"]"COLOR_BLUE"  Dispatcher "COLOR_RESET"Command %llu: P%d (Express) loads at dock %d.\n", time_buf, (unsigned long long)seq, S + 1, req.dock + 1);
+      }
+      else {
+	printf("["COLOR_YELLOW"%s"COLOR_RESET"]"COLOR_BLUE"  Dispatcher "COLOR_RESET"Mailbox of P%d (Express) is full, command dropped.\n", time_buf, S + 1);
+      }
     }
-    else if (cmd == 3) {
+    else if (req.op == CTL_STATS) {
+      if (menu) {
+	// Histograms are updated with atomics, read without SEM_MUTEX
+	stats_print_latency(stdout, &shm->stats);
+      }
+      else {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	reply_stats(from, shm, (now.tv_sec - run_start.tv_sec) + (now.tv_nsec - run_start.tv_nsec) / 1e9);
+      }
+    }
+    else if (req.op == CTL_SET_RATE) {
+      // Workers pick the rate up after their current batch
+      __atomic_store_n(&shm->worker_rate, (unsigned int)req.count, __ATOMIC_RELAXED);
+      control_reply(from, "{\"ok\":true,\"cmd\":\"set-rate\",\"rate\":%ld}", req.count);
+    }
+    else if (req.op == CTL_SET_DELAY) {
+      // Roles draw the new delay for their next wait, pending ones run out
+      char text[DELAY_TEXT_MAX];
+      delay_store(&shm->delays[req.delay_kind], &req.delay);
+      delay_format(&req.delay, text, sizeof(text));
+      control_reply(from, "{\"ok\":true,\"cmd\":\"set-delay\",\"kind\":\"%s\",\"delay\":\"%s\"}",
+		    delay_kind_name(req.delay_kind), text);
+    }
+    else if (req.op == CTL_RESIZE_BELT) {
+      // Takes effect with the next push, a belt above the new limit drains first
+      __atomic_store_n(&shm->max_belt_weight_M, kg_to_g(req.weight), __ATOMIC_RELAXED);
+      control_reply(from, "{\"ok\":true,\"cmd\":\"resize\",\"belt_weight\":%.2f}", req.weight);
+    }
+    else if (req.op == CTL_RESIZE_TRUCK) {
+      // Docked trucks load up to the new capacity, one already above it departs
+      __atomic_store_n(&shm->truck_capacity_W, kg_to_g(req.weight), __ATOMIC_RELAXED);
+      __atomic_store_n(&shm->truck_volume_V, m3_to_cm3(req.volume), __ATOMIC_RELAXED);
+      control_reply(from, "{\"ok\":true,\"cmd\":\"resize\",\"truck_weight\":%.2f,\"truck_volume\":%.2f}",
+		    req.weight, req.volume);
+    }
+    else if (req.op == CTL_SHUTDOWN) {
+      if (from && !menu) control_reply(from, "{\"ok\":true,\"cmd\":\"shutdown\"}");
+
       get_time(time_buf, sizeof(time_buf));
       printf("["COLOR_RED"%s"COLOR_RESET"]"COLOR_BLUE"  Dispatcher "COLOR_RESET"Shutting down...\n", time_buf);
 
-      // Set shutdown and block the dock, so last truck will deliver packages and then kill all processses
+      // Set shutdown and block all docks, so last trucks will deliver packages and then kill all processses
       SEM_P(semid, SEM_MUTEX);
       shm->shutdown = 1;
       SEM_V(semid, SEM_MUTEX);
 
-      SEM_P(semid, SEM_DOCK);
+      // Wake docked trucks sleeping on empty belt, so they can deliver last packages
+      belt_kick(shm);
+
+      sem_op(semid, SEM_DOCK, -D);
       
-      // Kills P1, P2 and P3
-      for(int i=0; i<3; ++i) {
-	kill(workers[i], SIGTERM);
+      if (threads) {
+	// Threads are not killed, blocked workers and P4 are woken to see shutdown
+	belt_release_producers(shm, semid, S);
+	mailbox_kick(&shm->express_mail);
+	for (int i = 0; i < S; ++i) pthread_join(worker_threads[i].thread, NULL);
+	pthread_join(express_thread.thread, NULL);
+      }
+
+      // Kills standard workers
+      for(int i=0; i<S; ++i) {
+	if (!threads) kill(workers[i], SIGTERM);
 	printf(" -> ["COLOR_YELLOW"-"COLOR_RESET"]  Worker: P%d\n", i+1);
       }
       // Kills P4 (Express)
-      kill(shm->p4_pid, SIGTERM);
-      printf(" -> ["COLOR_YELLOW"-"COLOR_RESET"]  Worker: P4 (Express)\n");
+      if (!threads) kill(shm->p4_pid, SIGTERM);
+      printf(" -> ["COLOR_YELLOW"-"COLOR_RESET"]  Worker: P%d (Express)\n", S + 1);
       // Kills trucks
-      for(int i=0; i<N; ++i) {
-	SEM_V(semid, SEM_DOCK); // Lets truck die naturally
-      }
+      sem_op(semid, SEM_DOCK, fleet ? D : N); // Lets trucks die naturally, a fleet stopped its queue itself
 
       break;
     }
-    else { // Incorrect Argument
-      printf("Unknown Command\n");
-      continue;
-    }
   }
 
+  control_close(&control);
+  pthread_sigmask(SIG_SETMASK, &wait_mask, NULL);
+
+  // Trucks deliver their last load and end in order of their ids
+  for (int i = 0; threads && i < (fleet ? 1 : N); ++i) {
+    pthread_join(truck_threads[i].thread, NULL);
+    if (!fleet) printf(" -> ["COLOR_YELLOW"-"COLOR_RESET"]  Truck: %d\n", i+1);
+  }
+
+  // Truck numbers of ended children by binary search, pids sorted with their index
+  int truck_procs = fleet ? 1 : N;
+  pid_t *truck_index = threads ? NULL : malloc(sizeof(pid_t) * 2 * truck_procs);
+  for (int i = 0; truck_index && i < truck_procs; ++i) {
+    truck_index[2 * i] = trucks[i];
+    truck_index[2 * i + 1] = i + 1;
+  }
+  if (truck_index) qsort(truck_index, truck_procs, sizeof(pid_t) * 2, compare_pid);
+
   // Wait for child processes to end its work and print truck info
   pid_t ended_pid;
-  while ((ended_pid = wait(NULL)) > 0) {
-    // Check if pid belongs to a truck
-    int found_truck = -1;
-    for (int i=0; i<N; ++i) {
-      if (trucks[i] == ended_pid) {
-	found_truck = i+1; // Get truck number
-	break;
-      }
+  while (!threads && (ended_pid = wait(NULL)) > 0) {
+    pid_t *found = truck_index ? bsearch(&ended_pid, truck_index, truck_procs, sizeof(pid_t) * 2, compare_pid) : NULL;
+    if (found && fleet) {
+      printf(" -> ["COLOR_YELLOW"-"COLOR_RESET"]  Fleet: %d trucks\n", N);
     }
-
-    if (found_truck != -1) {
-      printf(" -> ["COLOR_YELLOW"-"COLOR_RESET"]  Truck: %d\n", found_truck);
+    else if (found) {
+      printf(" -> ["COLOR_YELLOW"-"COLOR_RESET"]  Truck: %d\n", found[1]);
     }
   }
+  free(truck_index);
+  if (threads && fleet) printf(" -> ["COLOR_YELLOW"-"COLOR_RESET"]  Fleet: %d trucks\n", N);
   
+  clock_gettime(CLOCK_MONOTONIC, &run_end);
+  double run_s = (run_end.tv_sec - run_start.tv_sec) + (run_end.tv_nsec - run_start.tv_nsec) / 1e9;
+  if (report_json) {
+    stats_print_json(stdout, &shm->stats, run_s, shm->current_count);
+  }
+  else {
+    stats_print(stdout, &shm->stats, run_s, shm->current_count);
+  }
+
+  if (trace) {
+    if (trace_dump(trace, trace_path) == 0) {
+      printf("Event trace written to %s (convert with ./trace_export %s trace.json)\n", trace_path, trace_path);
+    }
+    else {
+      perror("Trace file");
+    }
+    if (threads) {
+      free(trace);
+    }
+    else {
+      detach_memory_block(trace);
+      destroy_memory_block(KEY_PATH, KEY_ID_TRACE);
+    }
+  }
+
+  if (record_path) {
+    unsigned long long dropped = workload->dropped;
+    long long recorded = workload_finish(workload, record_path);
+    if (recorded >= 0) {
+      printf("Workload recorded: %lld packages to %s (%llu dropped on a full file)\n", recorded, record_path, dropped);
+    }
+    else {
+      perror("Workload file");
+    }
+  }
+  else if (workload) {
+    workload_unmap(workload);
+  }
+
   // Destructing IPC and allocated mem
+  free(workers);
   free(trucks);
+  free(worker_threads);
+  free(truck_threads);
+
+  if (threads) {
+    free(metrics);
+    free(shm);
+  }
+  else {
+    detach_memory_block(metrics);
+    destroy_memory_block(KEY_PATH, KEY_ID_METRICS);
   
-  detach_memory_block(shm);
-  destroy_memory_block(KEY_PATH, KEY_ID_SHM);
+    detach_memory_block(shm);
+    destroy_memory_block(KEY_PATH, KEY_ID_SHM);
+  }
 
   sem_set(semid, 0, IPC_RMID, 0);
   
@@ -0,0 +1,40 @@
+#include "role.h"
+
+#include "common/futex_wrapper.h"
+#include "common/sem_wrapper.h"
+#include "common/shm_wrapper.h"
+
+void role_env_attach(RoleEnv *env) {
+  env->shm = attach_memory_block(
+    KEY_PATH,
+    KEY_ID_SHM,
+    0 // Existing segment, belt size is read from its header
+  );
+  // Best effort, the Dispatcher already locked the pages with the same limits
+  if (env->shm->mem_flags & SHM_BLOCK_LOCK) (void)lock_memory_block(env->shm, env->shm->segment_size);
+  env->semid = get_sem(KEY_PATH, KEY_ID_SEM, 0);
+  env->metrics = metrics_attach(env->shm);
+  env->trace = env->shm->trace_rings ? attach_memory_block(KEY_PATH, KEY_ID_TRACE, 0) : NULL;
+  env->workload = env->shm->workload_mode != WORKLOAD_OFF
+    ? workload_map(env->shm->workload_path, env->shm->workload_mode == WORKLOAD_RECORD)
+    : NULL;
+}
+
+void role_env_ready(const RoleEnv *env) {
+  SharedState *shm = env->shm;
+  if (!shm->roles_expected) return; // No barrier armed, e.g. a role started by hand or by a test
+
+  // Only the last role wakes the Dispatcher, it polls while roles attach
+  if (__atomic_add_fetch(&shm->roles_ready, 1, __ATOMIC_RELEASE) == shm->roles_expected) futex_wake(&shm->roles_ready, 1);
+
+  while (!__atomic_load_n(&shm->start_gate, __ATOMIC_ACQUIRE) && !__atomic_load_n(&shm->shutdown, __ATOMIC_RELAXED)) {
+    futex_wait(&shm->start_gate, 0);
+  }
+}
+
+void role_env_detach(RoleEnv *env) {
+  if (env->workload) workload_unmap(env->workload);
+  if (env->trace) detach_memory_block(env->trace);
+  if (env->metrics) detach_memory_block(env->metrics);
+  detach_memory_block(env->shm);
+}
@@ -0,0 +1,115 @@
+#ifndef ROLE_H
+#define ROLE_H
+
+#include "common/common.h"
+#include "common/metrics.h"
+#include "common/trace.h"
+#include "common/workload.h"
+
+/**
+ * @file role.h
+ * @brief Roles of the simulation (workers, trucks), shared by processes and threads.
+ *
+ * Every role is a run function taking a @ref RoleEnv. The `worker_std`,
+ * `worker_express` and `truck` executables attach the System V resources and
+ * call it from `main()`. With `--threads` the Dispatcher calls the very same
+ * functions from pthreads on process-private memory and semaphores
+ * (@ref sem_create_private), so both modes run identical logic.
+ *
+ * Run functions never change process-wide signal dispositions. The Dispatcher
+ * sends commands (forced departure, express load) through the mailboxes in
+ * shared memory (@ref mailbox.h), which work the same for processes and
+ * threads.
+ */
+
+/**
+ * @brief Resources a role works on.
+ */
+typedef struct {
+  SharedState *shm;      /**< Main state (shared memory segment or private allocation). */
+  int semid;             /**< Semaphore set, negative for a private set. */
+  MetricsBlock *metrics; /**< Metrics block, NULL when metrics are off. */
+  TraceHeader *trace;    /**< Event trace, NULL when tracing is off. */
+  WorkloadHeader *workload; /**< Recorded or replayed workload file, NULL when off. */
+} RoleEnv;
+
+/**
+ * @brief Attaches the System V resources created by the Dispatcher.
+ *
+ * Used by the role executables. Metrics, trace and the workload file are
+ * attached only when the Dispatcher enabled them.
+ *
+ * @param env Receives the attached resources.
+ */
+void role_env_attach(RoleEnv *env);
+
+/**
+ * @brief Detaches what @ref role_env_attach attached.
+ *
+ * @param env Attached resources.
+ */
+void role_env_detach(RoleEnv *env);
+
+/**
+ * @brief Start barrier, waits until the Dispatcher lets all roles go.
+ *
+ * Every role calls it once it is attached and before its run function. The
+ * role adds itself to @ref SharedState::roles_ready, the last of
+ * @ref SharedState::roles_expected wakes the Dispatcher, and sleeps on
+ * @ref SharedState::start_gate. Workers and trucks so start together: no
+ * truck takes a dock before the workers are attached, and the measured run
+ * starts with every role in place. Returns at once on shutdown, or when
+ * the segment was not set up by a Dispatcher arming the barrier
+ * (@ref SharedState::roles_expected 0).
+ *
+ * @param env Attached resources.
+ */
+void role_env_ready(const RoleEnv *env);
+
+/**
+ * @brief Standard worker, produces packages of one type until shutdown.
+ *
+ * The worker pushes to its own belt lane (@ref belt_lane_of).
+ *
+ * @param env       Resources.
+ * @param type      Package type (A, B or C).
+ * @param worker_id Worker number (1..@ref SharedState::std_workers), P1-P3 with one worker per type.
+ * @return 0 on shutdown.
+ */
+int worker_std_run(const RoleEnv *env, PackageType type, int worker_id);
+
+/**
+ * @brief Express worker (P4 by default), loads express packages on every
+ * command in @ref SharedState::express_mail.
+ *
+ * @param env Resources.
+ * @return 0 on shutdown.
+ */
+int worker_express_run(const RoleEnv *env);
+
+/**
+ * @brief Truck, docks, loads from the belt and delivers until shutdown.
+ *
+ * A docked truck leaves early on a @ref CMD_FORCE_DEPART in the mailbox of
+ * its dock (@ref SharedState::dock_mail).
+ *
+ * @param env      Resources.
+ * @param truck_id Truck id (1..N).
+ * @return 0 on shutdown.
+ */
+int truck_run(const RoleEnv *env, int truck_id);
+
+/**
+ * @brief Fleet of trucks run as state machines of one role (`--fleet`).
+ *
+ * Every truck goes through the steps of @ref truck_run, waiting states are
+ * timers instead of sleeps. Trucks queue for the docks in id order.
+ *
+ * @param env      Resources.
+ * @param first_id Id of the first truck.
+ * @param count    Number of trucks.
+ * @return 0 on shutdown.
+ */
+int fleet_run(const RoleEnv *env, int first_id, int count);
+
+#endif // ROLE_H
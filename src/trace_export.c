@@ -0,0 +1,60 @@
+/**
+ * @file trace_export.c
+ * @brief Trace Decoder - Converts a binary event trace into Chrome trace JSON.
+ *
+ * Reads the file written by the Dispatcher when it runs with `--trace=<file>`
+ * and prints Chrome/Perfetto trace JSON. Open the result in `chrome://tracing`
+ * or https://ui.perfetto.dev to see belt contention and dock idle gaps on a
+ * timeline.
+ *
+ * Usage: `./trace_export <trace.bin> [out.json]` (default output: stdout).
+ *
+ * @author Mikołaj Kosiorek
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common/trace.h"
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <trace.bin> [out.json]\n", argv[0]);
+    exit(1);
+  }
+
+  FILE *in = fopen(argv[1], "rb");
+  if (!in) { perror("Trace file"); exit(1); }
+
+  // Header tells the size of the rest of the dump
+  TraceHeader hdr;
+  if (fread(&hdr, sizeof(hdr), 1, in) != 1 || hdr.magic != TRACE_MAGIC || hdr.version != TRACE_VERSION) {
+    fprintf(stderr, "%s is not a warehouse trace (version %u)\n", argv[1], TRACE_VERSION);
+    exit(1);
+  }
+
+  size_t size = trace_segment_size(hdr.ring_count, hdr.ring_events);
+  TraceHeader *trace = malloc(size);
+  if (!trace) { perror("Trace decoder: malloc error"); exit(1); }
+
+  *trace = hdr;
+  if (fread(trace + 1, 1, size - sizeof(hdr), in) != size - sizeof(hdr)) {
+    fprintf(stderr, "%s is truncated\n", argv[1]);
+    exit(1);
+  }
+  fclose(in);
+
+  FILE *out = stdout;
+  if (argc > 2) {
+    out = fopen(argv[2], "w");
+    if (!out) { perror("Output file"); exit(1); }
+  }
+
+  long events = trace_export_json(out, trace);
+  if (out != stdout) fclose(out);
+
+  fprintf(stderr, "Exported %ld events from %u rings\n", events, hdr.ring_count);
+
+  free(trace);
+  return 0;
+}
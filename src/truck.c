@@ -1,222 +1,277 @@
 /**
  * @file truck.c
- * @brief Truck Process (Consumer) - Smart Loading & Delivery Simulation.
+ * @brief Truck (Consumer) - Smart Loading & Delivery Simulation.
  *
- * This file implements the logic for a Truck process, acting as a **Consumer** in the system.
+ * This file implements the logic for a Truck, acting as a **Consumer** in the system.
+ * It runs as a process (`truck_main.c`) or as a thread of the Dispatcher (`--threads`).
  *
  * Key behaviors:
- * - **Docking Queue:** Competes for the single Loading Dock (@ref SEM_DOCK).
+ * - **Docking Queue:** Competes for one of D Loading Docks (@ref SEM_DOCK counts free
+ * docks). Trucks at different docks load from the belt at the same time.
  * - **Smart Loading:** "Peeks" at the conveyor belt to check if the next package fits
- * within remaining weight/volume limits.
- * - **Signal Responsiveness:** Uses non-blocking semaphore operations (`IPC_NOWAIT`)
- * to check for `SIGUSR1` (Forced Departure) even when the belt is empty.
+ * within remaining weight/volume limits (@ref belt_pop_to_truck).
+ * - **Event-Driven Waiting:** Sleeps on the belt doorbell (futex) when the belt is
+ * empty. It wakes immediately on a new package or when the Dispatcher kicks the
+ * belt (forced departure posted to the dock mailbox, shutdown).
  * - **Delivery Cycle:** Simulates travel time after loading and returns to the queue.
+ * Loading, delivery and return times are drawn from the delays of the run
+ * (@ref delay.h) and waited for as deadlines.
  *
  * @author Mikołaj Kosiorek
  */
 
-#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "common/belt.h"
 #include "common/common.h"
+#include "common/log.h"
+#include "common/metrics.h"
 #include "common/sem_wrapper.h"
-#include "common/shm_wrapper.h"
+#include "common/stats.h"
+#include "common/trace.h"
 #include "common/utils.h"
+#include "role.h"
+#include "truck.h"
 
-/**
- * @brief Flag indicating a forced departure request.
- *
- * Set to 1 by the signal handler when `SIGUSR1` is received from the Dispatcher.
- * volatile is used to prevent compiler optimization, ensuring visibility in the main loop.
- */
-volatile sig_atomic_t force_departure = 0;
+int truck_dock(SharedState *shm, int semid, int truck_id, pid_t pid) {
+  SEM_P(semid, SEM_MUTEX);
 
-/**
- * @brief Signal Handler for SIGUSR1.
- *
- * Handles the "Force Departure" command. It sets the global flag, allowing the
- * truck to break out of the loading loop and depart immediately.
- *
- * @param sig Signal number (SIGUSR1).
- */
-void handle_sigusr1(int sig) {
-  (void)sig; // Satisfies compiler
-  force_departure = 1;
+  // SEM_DOCK guarantees at least one dock is free
+  int dock_id = 0;
+  while (shm->docks[dock_id].truck_docked) dock_id++;
+  DockState *dock = &shm->docks[dock_id];
+
+  dock->current_truck_pid = pid;
+  dock->current_truck_id = truck_id;
+  dock->truck_docked = 1;
+  dock->current_truck_load = 0;
+  dock->current_truck_vol = 0;
+
+  SEM_V(semid, SEM_MUTEX);
+  return dock_id;
+}
+
+int truck_take_commands(SharedState *shm, int dock_id) {
+  Mailbox *mail = &shm->dock_mail[dock_id];
+  Command cmd;
+  while (mailbox_take(mail, &cmd)) {
+    hist_record(&shm->stats.command_ns[cmd.type], mailbox_done(mail, &cmd));
+    if (cmd.type == CMD_FORCE_DEPART) return 1;
+  }
+  return 0;
+}
+
+int truck_is_full(const SharedState *shm, int dock_id) {
+  const DockState *dock = &shm->docks[dock_id];
+  return dock->current_truck_load >= shm->truck_capacity_W || dock->current_truck_vol >= shm->truck_volume_V;
+}
+
+void truck_loaded(SharedState *shm, TruckMetrics *metrics, DockMetrics *dock_metrics,
+		  TruckCargo *cargo, Package *pkgs, int n) {
+  // Packages are already accounted in truck load
+  long before = __atomic_fetch_add(&shm->stats.loaded, n, __ATOMIC_RELAXED);
+  metrics_add(&metrics->popped, n);
+  metrics_add(&dock_metrics->popped, n);
+
+  // Stamps loaded packages, they stay in the cargo list until delivery
+  uint64_t t_loaded = monotonic_ns();
+  if (before == 0) __atomic_store_n(&shm->stats.first_load_ns, t_loaded, __ATOMIC_RELAXED); // Time to first package
+  if (cargo->count + n > cargo->cap) {
+    cargo->cap = (cargo->count + n) * 2;
+    cargo->pkgs = realloc(cargo->pkgs, sizeof(Package) * cargo->cap);
+    if (!cargo->pkgs) {
+      perror("Truck: realloc error");
+      exit(1);
+    }
+  }
+  for (int i = 0; i < n; ++i) {
+    pkgs[i].t_load_ns = t_loaded;
+    stats_record_load(&shm->stats, &pkgs[i]);
+    cargo->pkgs[cargo->count++] = pkgs[i];
+  }
+}
+
+int64_t truck_undock(SharedState *shm, int semid, TruckMetrics *metrics, DockMetrics *dock_metrics,
+		    int dock_id, int forced, uint64_t t_docked) {
+  DockState *dock = &shm->docks[dock_id];
+  hist_record(&shm->stats.dock_time_ns, monotonic_ns() - t_docked);
+
+  SEM_P(semid, SEM_MUTEX);
+  dock->truck_docked = 0;
+  dock->current_truck_pid = 0;
+  dock->current_truck_id = 0;
+
+  // Commands posted while the truck was leaving took effect with it
+  Mailbox *mail = &shm->dock_mail[dock_id];
+  Command cmd;
+  while (mailbox_take(mail, &cmd)) {
+    hist_record(&shm->stats.command_ns[cmd.type], mailbox_done(mail, &cmd));
+  }
+
+  if (forced) {
+    shm->stats.forced_departures++;
+    metrics_add(&metrics->forced_departures, 1);
+    metrics_add(&dock_metrics->forced_departures, 1);
+  }
+
+  int64_t load = dock->current_truck_load;
+  if (load != 0) {
+    shm->stats.deliveries++;
+    shm->stats.delivered_weight += load;
+    shm->stats.fill_ratio_sum += (double)load / shm->truck_capacity_W;
+    metrics_add(&metrics->deliveries, 1);
+    metrics_add(&dock_metrics->deliveries, 1);
+  }
+
+  SEM_V(semid, SEM_MUTEX);
+  return load;
+}
+
+void truck_deliver(SharedState *shm, TruckCargo *cargo) {
+  uint64_t t_delivered = monotonic_ns();
+  for (int i = 0; i < cargo->count; ++i) stats_record_delivery(&shm->stats, &cargo->pkgs[i], t_delivered);
+  cargo->count = 0;
 }
 
 /**
- * @brief Main Entry Point for Truck Process.
- *
- * Usage: ./truck <ID>
+ * @brief Truck Loop - Docking, Loading and Delivery until shutdown.
  *
  * **Algorithm Flow:**
- * 1. Setup: Validates args, disables buffering, registers signal handler, attaches IPC.
+ * 1. Setup: Claims its trace ring and metrics entry, sets up the logger.
  * 2. **Outer Loop (Delivery Cycle):**
  * - **Docking:** Waits for `SEM_DOCK` to enter the loading bay.
- * - **Registration:** Writes its PID to Shared Memory so Dispatcher can signal it.
+ * - **Registration:** Claims a free @ref DockState and writes its PID and id
+ * there.
  * - **Inner Loop (Loading):**
- * - Checks `force_departure` flag.
+ * - Takes commands from the mailbox of its dock (@ref SharedState::dock_mail),
+ * leaves on a forced departure.
  * - Checks if truck is full (Capacity limits).
- * - **Polling:** Tries to decrease `SEM_FULL` (wait for package) using `IPC_NOWAIT`.
- * - *Reason:* If we used a blocking wait, the truck would hang on an empty belt
- * and ignore the forced departure signal.
- * - **Peek & Check:** Enters Critical Section (`SEM_MUTEX`), reads the package at `head`.
- * - If package fits: Consumes it (Updates `head`, `count`, `truck_load`).
- * - If package doesn't fit: Leaves it on belt, releases mutex, and departs (Truck Full).
- * - **Undocking:** Releases `SEM_DOCK` and clears PID from Shared Memory.
- * - **Edge Case:** If forced to depart while empty, drives back to queue immediately.
- * - **Delivery:** Sleeps for 5 seconds to simulate transport.
+ * - **Doorbell:** Reads @ref belt_doorbell before checking any wake condition.
+ * - Calls @ref belt_pop_batch_to_truck, which never blocks on an empty belt and
+ * drains up to B packages that fit (@ref SharedState::batch_B) at once.
+ * - On empty belt sleeps in @ref belt_wait_package. The Dispatcher rings the
+ * doorbell after posting a command, and the doorbell value makes wakeups between
+ * check and sleep impossible to lose.
+ * - **Peek & Check (`--lookahead` 1):** Head package is compared with remaining capacity.
+ * - If package fits: Consumes it together with following packages that fit (Updates `head`, `count`, `truck_load`).
+ * - If package doesn't fit: Leaves it on belt and departs (Truck Full).
+ * - **Best Fit (`--lookahead` L > 1):** Takes the best fitting package of the
+ * first L slots (@ref belt_index_best_fit on the semaphore belt), repeated while
+ * one fits. Packages taken behind the head leave holes that later pops skip.
+ * Departs (Truck Full) when no package of the window fits.
+ * - **Undocking:** Clears its dock in Shared Memory and releases `SEM_DOCK`.
+ * Commands still in the dock mailbox are taken as done, the truck is leaving,
+ * so the next truck at the dock starts with an empty mailbox.
+ * - **Edge Case:** If forced to depart while empty, drives back to queue after
+ * the `DELAY_RETURN` delay.
+ * - **Delivery:** Waits the `DELAY_DELIVERY` delay drawn through @ref sim_delay_ns
+ * in @ref sleep_until_ns to simulate transport (no wait with `--no-sleep`).
  * - Returns to queue.
  *
- * @param argc Argument count.
- * @param argv Argument values. argv[1] is the Truck ID.
- * @return 0 on success.
+ * @param env      Resources.
+ * @param truck_id Truck id (1..N).
+ * @return 0 on shutdown.
  */
-int main(int argc, char *argv[]) {
-  // Turn off buffering for real time logging to simulation.log file
-  setbuf(stdout, NULL);
-
-  // Ignoring SIGINT/TERM so dispatcher can terminate child processes gracefully
-  signal(SIGINT, SIG_IGN);
-  signal(SIGTERM, SIG_IGN);
-
-  // Validate Arguments
-  if (argc < 2) {
-    fprintf(stderr, "Usage: %s <ID>\n", argv[0]);
-    exit(1);
-  }
-
-  // Register signal handler
-  struct sigaction sa;
-  sa.sa_handler = handle_sigusr1;
-  sigemptyset(&sa.sa_mask);
-  sa.sa_flags = 0;
-  sigaction(SIGUSR1, &sa, NULL);
-
-  // Shared Memory Attachment
-  SharedState *shm;
-
-  shm = attach_memory_block(
-    KEY_PATH,
-    KEY_ID_SHM,
-    sizeof(SharedState)
-  );
-
-  // Gets Access to Semaphores
-  int semid;
-
-  semid = get_sem(KEY_PATH, KEY_ID_SEM, 0);
-
-  // Assign truck id
-  int truck_id = atoi(argv[1]);
-
-  char time_buf[64];
+int truck_run(const RoleEnv *env, int truck_id) {
+  SharedState *shm = env->shm;
+  int semid = env->semid;
+
+  int B = belt_batch_size(shm);
+  Package pkgs[MAX_BELT_BATCH];
+  TruckCargo cargo = {NULL, 0, 0}; // Packages loaded since docking, grows on demand
+  TraceRing *trace = env->trace ? trace_claim(env->trace, TRACE_ROLE_TRUCK, truck_id) : NULL;
+  MetricsBlock *metrics_seg = env->metrics;
+  TruckMetrics *metrics = metrics_truck(metrics_seg, truck_id);
+
+  char log_tag[32];
+  snprintf(log_tag, sizeof(log_tag), COLOR_CYAN " Truck %d  ", truck_id);
+  log_init(log_tag, shm->log_level);
   
   // Truck main loop
   while (1) {
     if (shm->shutdown) break;
 
-    // Dock Truck
+    // Dock Truck, waiting in queue may take long
+    log_flush();
+    uint64_t t_queue = trace ? trace_now() : 0;
     SEM_P(semid, SEM_DOCK);
 
     // When truck wakes up while docked, check if simulation wasn't terminated
     if (shm->shutdown) {
       SEM_V(semid, SEM_DOCK); // Give access to dispatcher
-      // Truck is empty before entering loading loop, we can terminate process
-      exit(0);
+      // Truck is empty before entering loading loop, we can terminate
+      break;
     }
 
-    // Critical Part
-    SEM_P(semid, SEM_MUTEX);
-
-    shm->current_truck_pid = getpid();
-    shm->truck_docked = 1;
-    shm->current_truck_load = 0.0;
-    shm->current_truck_vol = 0.0;
-
-    // Reset force departure
-    force_departure = 0;
+    int dock_id = truck_dock(shm, semid, truck_id, getpid());
+    DockState *dock = &shm->docks[dock_id];
+    int forced = 0;
 
-    SEM_V(semid, SEM_MUTEX);
+    trace_event(trace, TRACE_DOCK, t_queue, dock_id);
+    DockMetrics *dock_metrics = metrics_dock(metrics_seg, dock_id);
+    metrics_add(&metrics->dockings, 1);
+    uint64_t t_docked = monotonic_ns();
 
-    get_time(time_buf, sizeof(time_buf));
-    printf("["COLOR_GREEN"%s"COLOR_RESET"]"COLOR_CYAN" Truck %d  "COLOR_RESET"Truck docked, ready to load.\n",
-	   time_buf, truck_id);
+    LOG_INFO("Truck docked at dock %d, ready to load.", dock_id + 1);
     
     // Loading Loop
     while (1) {
-      if (force_departure) {
-	      get_time(time_buf, sizeof(time_buf));
-	      printf("["COLOR_YELLOW"%s"COLOR_RESET"]"COLOR_CYAN" Truck %d  "COLOR_RESET"Forced departure signal received.\n", time_buf, truck_id);	
+      // Doorbell is read before any wake condition is checked, so a package or
+      // a kick arriving after the checks makes belt_wait_package() return at once
+      unsigned int bell = belt_doorbell(shm);
+
+      if (truck_take_commands(shm, dock_id)) {
+	      forced = 1;
+	      LOG_WARN("Forced departure command received.");
 	      break;
       }
 
       if (shm->shutdown) break;
 
       // case: Limit is reached exactly (truck load: 20/20 kg)
-      if (shm->current_truck_load >= shm->truck_capacity_W ||
-	        shm->current_truck_vol >= shm->truck_volume_V) {
-	      get_time(time_buf, sizeof(time_buf));
-	      printf("["COLOR_GREEN"%s"COLOR_RESET"]"COLOR_CYAN" Truck %d  "COLOR_RESET"Truck filled to capacity. Departure...\n", time_buf, truck_id);
+      if (truck_is_full(shm, dock_id)) {
+	      LOG_INFO("Truck filled to capacity. Departure...");
 	      break;
       }
       
-      // Waiting For Packages (SEM_FULL)
-      // If process waits on SEM_FULL semaphore and forced departure is called
-      // truck could possibly stuck here.
-      // IPC_NOWAIT flag must be set up so we can regularly check if departure is being forced
-      struct sembuf sb = {SEM_FULL, -1, IPC_NOWAIT};
-      if(semop(semid, &sb, 1) == -1) {
-        if (errno == EAGAIN) {
-          usleep(50000); // Waits 50ms to avoid busy loop slamming
-          continue;
-        } else {
-          perror("Truck semop");
-          exit(1);
-        }
+      // Peek & Check head packages against remaining capacity, up to B at once
+      int popped;
+      uint64_t t_pop = trace ? trace_now() : 0;
+      BeltStatus status = belt_pop_batch_to_truck(shm, semid, dock_id, pkgs, B, &popped);
+
+      // Empty belt, sleep until next push or a kick from dispatcher
+      if (status == BELT_EMPTY) {
+	log_flush();
+	belt_wait_package(shm, bell);
+	continue;
       }
 
-      // Package Available
-      SEM_P(semid, SEM_MUTEX);
-
-      // Get head package data
-      int idx = shm->head;
-      Package pkg = shm->belt[idx];
-      
-      double w = pkg.weight;
-      double v = pkg.volume;
-
       // Reached Truck Load Limits Check
-      if (shm->current_truck_load + w > shm->truck_capacity_W ||
-          shm->current_truck_vol + v > shm->truck_volume_V) {
-        get_time(time_buf, sizeof(time_buf));
-        printf("["COLOR_GREEN"%s"COLOR_RESET"]"COLOR_CYAN" Truck %d  "COLOR_RESET"Truck is full. Departure...\n",
-              time_buf, truck_id);
-        SEM_V(semid, SEM_FULL); // Truck didn't load head package so it is still on belt
-        SEM_V(semid, SEM_MUTEX);
-        break;
+      if (status == BELT_NO_FIT) {
+	LOG_INFO("Truck is full. Departure...");
+	break;
       }
 
       // Limit NOT Reached
-      shm->current_truck_load += w;
-      shm->current_truck_vol += v;
+      truck_loaded(shm, metrics, dock_metrics, &cargo, pkgs, popped);
+      trace_event(trace, TRACE_POP, t_pop, popped);
 
-      // Moving head
-      shm->head = (shm->head + 1) % shm->max_items_K;
-      shm->current_count--;
-      shm->current_belt_weight -= w;
-
-      SEM_V(semid, SEM_MUTEX);
-      SEM_V(semid, SEM_EMPTY);
-      
-      get_time(time_buf, sizeof(time_buf));
-      printf("["COLOR_GREEN"%s"COLOR_RESET"]"COLOR_CYAN" Truck %d  "COLOR_RESET"Loaded pkg %s %.2fkg. Total: %.2f/%.2f kg\n",
-	     time_buf, truck_id, (pkg.type == 0 ? "A" : (pkg.type == 1 ? "B" : "C")), w, shm->current_truck_load, shm->truck_capacity_W);
+      if (popped == 1) {
+	LOG_DEBUG("Loaded pkg %s %.2fkg. Total: %.2f/%.2f kg",
+		  (pkgs[0].type == 0 ? "A" : (pkgs[0].type == 1 ? "B" : "C")), g_to_kg(pkgs[0].weight_g), g_to_kg(dock->current_truck_load), g_to_kg(shm->truck_capacity_W));
+      }
+      else {
+	LOG_DEBUG("Loaded %d pkgs %.2fkg. Total: %.2f/%.2f kg",
+		  popped, g_to_kg(package_weight_sum(pkgs, popped)), g_to_kg(dock->current_truck_load), g_to_kg(shm->truck_capacity_W));
+      }
 
-      // Simulate loading time
-      usleep(100000);
+      // Simulate loading time of every package
+      uint64_t loaded_at = monotonic_ns();
+      for (int i = 0; i < popped; ++i) loaded_at += sim_delay_ns(shm, DELAY_LOAD);
+      sleep_until_ns(loaded_at);
 
 #ifdef SIM_DELAY_MS
       usleep(SIM_DELAY_MS * 1000);
@@ -224,37 +279,32 @@ int main(int argc, char *argv[]) {
     } // END OF LOADING LOOP
     
     // Undocking
-    SEM_P(semid, SEM_MUTEX);
-    shm->truck_docked = 0;
-    shm->current_truck_pid = 0;
+    trace_event(trace, TRACE_UNDOCK, t_docked, dock_id);
+    int64_t load = truck_undock(shm, semid, metrics, dock_metrics, dock_id, forced, t_docked);
+    SEM_V(semid, SEM_DOCK);
 
     // case: departure was forced before first package was loaded. Send truck back to queue
-    if (shm->current_truck_load == 0.0) {
-      get_time(time_buf, sizeof(time_buf));
-      printf("["COLOR_YELLOW"%s"COLOR_RESET"]"COLOR_CYAN" Truck %d  "COLOR_RESET"Departure forced. Truck empty. Sending truck back to queue\n",
-	     time_buf, truck_id);
-
-      SEM_V(semid, SEM_MUTEX);
-      SEM_V(semid, SEM_DOCK);
+    if (load == 0) {
+      LOG_WARN("Departure forced. Truck empty. Sending truck back to queue");
+      log_flush();
 
-      sleep(1); // Drive back to queue
+      sleep_until_ns(monotonic_ns() + sim_delay_ns(shm, DELAY_RETURN)); // Drive back to queue
       continue;
     }
-    
-    SEM_V(semid, SEM_MUTEX);
-    SEM_V(semid, SEM_DOCK);
 
-    get_time(time_buf, sizeof(time_buf));
-    printf("["COLOR_GREEN"%s"COLOR_RESET"]"COLOR_CYAN" Truck %d  "COLOR_RESET"Delivering packages...\n",
-	   time_buf, truck_id);
+    LOG_INFO("Delivering packages...");
+    log_flush();
+
+    // Simulate delivery time (5s by default)
+    sleep_until_ns(monotonic_ns() + sim_delay_ns(shm, DELAY_DELIVERY));
 
-    // Simulate delivery time (5s)
-    sleep(5);
+    // Delivered, closes the latency stages of every package on board
+    truck_deliver(shm, &cargo);
 
-    get_time(time_buf, sizeof(time_buf));
-    printf("["COLOR_GREEN"%s"COLOR_RESET"]"COLOR_CYAN" Truck %d  "COLOR_RESET"Truck returned to queue\n",
-	   time_buf, truck_id);
+    LOG_INFO("Truck returned to queue");
   }
   
+  free(cargo.pkgs);
+  log_flush();
   return 0;
 }
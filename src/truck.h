@@ -0,0 +1,104 @@
+#ifndef TRUCK_H
+#define TRUCK_H
+
+#include <sys/types.h>
+
+#include "common/common.h"
+#include "common/metrics.h"
+
+/**
+ * @file truck.h
+ * @brief Steps of a truck, shared by @ref truck_run and the fleet (@ref fleet_run).
+ *
+ * A truck process blocks between the steps, the fleet runs them from its
+ * event loop for thousands of trucks. Both go through the same docking,
+ * command, loading and undocking code, so the statistics of a run do not
+ * depend on how its trucks are hosted.
+ */
+
+/**
+ * @brief Packages on board since docking, kept until delivery.
+ */
+typedef struct {
+  Package *pkgs; /**< Loaded packages, grows on demand. */
+  int count;     /**< Packages on board. */
+  int cap;       /**< Allocated entries. */
+} TruckCargo;
+
+/**
+ * @brief Claims a free dock and registers the truck there.
+ *
+ * The caller holds a unit of @ref SEM_DOCK, so a dock is free. Takes SEM_MUTEX.
+ *
+ * @param shm      Pointer to the attached SharedState structure.
+ * @param semid    Semaphore set ID.
+ * @param truck_id Truck id.
+ * @param pid      Process hosting the truck.
+ * @return Dock index.
+ */
+int truck_dock(SharedState *shm, int semid, int truck_id, pid_t pid);
+
+/**
+ * @brief Takes the commands in the mailbox of a dock.
+ *
+ * Stops at a forced departure, records the command latency of every command taken.
+ *
+ * @param shm     Pointer to the attached SharedState structure.
+ * @param dock_id Dock of the truck.
+ * @return 1 on a forced departure, 0 otherwise.
+ */
+int truck_take_commands(SharedState *shm, int dock_id);
+
+/**
+ * @brief Whether the truck at a dock reached its weight or volume capacity.
+ *
+ * @param shm     Pointer to the attached SharedState structure.
+ * @param dock_id Dock of the truck.
+ * @return 1 if full.
+ */
+int truck_is_full(const SharedState *shm, int dock_id);
+
+/**
+ * @brief Books packages popped from the belt into the truck.
+ *
+ * Counts them in statistics and metrics (the very first load stamps
+ * @ref SimStats::first_load_ns), stamps their load time and keeps
+ * them in the cargo until delivery. Exits if memory is exhausted.
+ *
+ * @param shm          Pointer to the attached SharedState structure.
+ * @param metrics      Metrics of the truck.
+ * @param dock_metrics Metrics of its dock.
+ * @param cargo        Cargo of the truck.
+ * @param pkgs         Popped packages.
+ * @param n            Number of popped packages.
+ */
+void truck_loaded(SharedState *shm, TruckMetrics *metrics, DockMetrics *dock_metrics,
+		  TruckCargo *cargo, Package *pkgs, int n);
+
+/**
+ * @brief Leaves a dock.
+ *
+ * Clears the dock, takes leftover commands as done and counts the departure
+ * under SEM_MUTEX. The caller releases @ref SEM_DOCK afterwards.
+ *
+ * @param shm       Pointer to the attached SharedState structure.
+ * @param semid     Semaphore set ID.
+ * @param metrics   Metrics of the truck.
+ * @param dock_metrics Metrics of its dock.
+ * @param dock_id   Dock of the truck.
+ * @param forced    Departure was forced by the Dispatcher.
+ * @param t_docked  Time the truck docked (ns).
+ * @return Weight on board (g), 0 for an empty truck that drives back to the queue.
+ */
+int64_t truck_undock(SharedState *shm, int semid, TruckMetrics *metrics, DockMetrics *dock_metrics,
+		    int dock_id, int forced, uint64_t t_docked);
+
+/**
+ * @brief Delivers the cargo, closing the latency stages of every package.
+ *
+ * @param shm   Pointer to the attached SharedState structure.
+ * @param cargo Cargo of the truck, emptied.
+ */
+void truck_deliver(SharedState *shm, TruckCargo *cargo);
+
+#endif // TRUCK_H
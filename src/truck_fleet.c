@@ -0,0 +1,239 @@
+/**
+ * @file truck_fleet.c
+ * @brief Truck Fleet - Many trucks multiplexed as state machines in one role.
+ *
+ * With `--fleet` the Dispatcher starts a single `truck_fleet` process (or
+ * thread with `--threads`) instead of one process per truck. Every truck is
+ * a small @ref FleetTruck moving through the states of @ref truck_run:
+ *
+ * - **Queued:** waits in a FIFO for a free dock (@ref SEM_DOCK, never blocking).
+ * - **Docked:** loads from the belt, one step per event loop round.
+ * - **Loading:** waits for the load time of the packages it just popped.
+ * - **Delivering / Returning:** away for the delivery time, or back to the
+ * queue after an empty forced departure.
+ *
+ * Waiting states are timers on a hierarchical timer wheel (@ref timer_wheel.h)
+ * with delays drawn from the run (@ref delay.h), a truck costs its state entry
+ * and cargo, and every event is O(1) whatever the size of the fleet. A zero
+ * delay (`--no-sleep`) sets no timer, the truck leaves the waiting state in
+ * the same event loop round. Docking, commands, loading and undocking are the
+ * steps of a truck process (@ref truck.h), so statistics compare directly.
+ *
+ * The fleet sleeps on the belt doorbell until a package, a kick of the
+ * Dispatcher (command, shutdown) or the next timer. On shutdown queued trucks
+ * stop, docked ones leave and the fleet ends after the last delivery.
+ *
+ * @author Mikołaj Kosiorek
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common/belt.h"
+#include "common/common.h"
+#include "common/log.h"
+#include "common/metrics.h"
+#include "common/sem_wrapper.h"
+#include "common/utils.h"
+#include "truck_fleet.h"
+
+static void enqueue(Fleet *f, int i) {
+  f->queue[(f->queue_head + f->queue_len++) % f->count] = i;
+  f->trucks[i].state = FLEET_QUEUED;
+  f->trucks[i].t_since = monotonic_ns();
+}
+
+static void stop(Fleet *f, FleetTruck *t) {
+  t->state = FLEET_DONE;
+  free(t->cargo.pkgs);
+  t->cargo.pkgs = NULL;
+  --f->active;
+}
+
+// End of a waiting state: loading done, cargo delivered, back from an empty departure
+static void wait_done(Fleet *f, FleetTruck *t, int shutdown) {
+  if (t->state == FLEET_LOADING) {
+    t->state = FLEET_DOCKED;
+    return;
+  }
+
+  if (t->state == FLEET_DELIVERING) truck_deliver(f->env->shm, &t->cargo);
+
+  // Back to the queue, a truck process ends there on shutdown too
+  if (shutdown) stop(f, t);
+  else enqueue(f, (int)(t - f->trucks));
+}
+
+// Simulated delay as a timer. A zero delay (--no-sleep) ends the state at once,
+// the wheel would hold it until its next tick
+static void delay(Fleet *f, FleetTruck *t, int state, uint64_t ns) {
+  t->state = state;
+  if (ns == 0) wait_done(f, t, f->env->shm->shutdown);
+  else timer_wheel_add(&f->wheel, &t->timer, monotonic_ns() + ns);
+}
+
+static void dock_truck(Fleet *f, int i) {
+  SharedState *shm = f->env->shm;
+  FleetTruck *t = &f->trucks[i];
+
+  t->dock = truck_dock(shm, f->env->semid, t->id, getpid());
+  trace_event_actor(f->trace, t->id, TRACE_DOCK, f->trace ? t->t_since : 0, t->dock);
+  metrics_add(&metrics_truck(f->env->metrics, t->id)->dockings, 1);
+
+  t->state = FLEET_DOCKED;
+  t->forced = 0;
+  t->t_since = monotonic_ns();
+  f->at_dock[t->dock] = i;
+  LOG_DEBUG("Truck %d docked at dock %d.", t->id, t->dock + 1);
+}
+
+static void undock_truck(Fleet *f, FleetTruck *t) {
+  SharedState *shm = f->env->shm;
+  int dock = t->dock;
+
+  trace_event_actor(f->trace, t->id, TRACE_UNDOCK, t->t_since, dock);
+  int64_t load = truck_undock(shm, f->env->semid, metrics_truck(f->env->metrics, t->id),
+			     metrics_dock(f->env->metrics, dock), dock, t->forced, t->t_since);
+  sem_count_op(f->env->semid, SEM_DOCK, 1);
+  f->at_dock[dock] = -1;
+
+  if (load == 0) {
+    LOG_DEBUG("Truck %d left dock %d empty, back to queue.", t->id, dock + 1);
+    delay(f, t, FLEET_RETURNING, sim_delay_ns(shm, DELAY_RETURN));
+  }
+  else {
+    LOG_DEBUG("Truck %d left dock %d with %.2f kg, delivering.", t->id, dock + 1, g_to_kg(load));
+    delay(f, t, FLEET_DELIVERING, sim_delay_ns(shm, DELAY_DELIVERY));
+  }
+}
+
+// One round of the loading loop of truck_run, returns 1 if the truck moved on
+static int load_step(Fleet *f, FleetTruck *t) {
+  SharedState *shm = f->env->shm;
+  Package *pkgs = f->pkgs;
+
+  if (truck_take_commands(shm, t->dock)) {
+    t->forced = 1;
+    LOG_WARN("Truck %d: forced departure command received.", t->id);
+    undock_truck(f, t);
+    return 1;
+  }
+
+  if (shm->shutdown || truck_is_full(shm, t->dock)) {
+    undock_truck(f, t);
+    return 1;
+  }
+
+  int popped;
+  uint64_t t_pop = f->trace ? trace_now() : 0;
+  BeltStatus status = belt_pop_batch_to_truck(shm, f->env->semid, t->dock, pkgs, belt_batch_size(shm), &popped);
+
+  if (status == BELT_EMPTY) return 0;
+  if (status == BELT_NO_FIT) {
+    undock_truck(f, t);
+    return 1;
+  }
+
+  truck_loaded(shm, metrics_truck(f->env->metrics, t->id), metrics_dock(f->env->metrics, t->dock),
+	       &t->cargo, pkgs, popped);
+  trace_event_actor(f->trace, t->id, TRACE_POP, t_pop, popped);
+  uint64_t load_ns = 0;
+  for (int i = 0; i < popped; ++i) load_ns += sim_delay_ns(shm, DELAY_LOAD);
+  delay(f, t, FLEET_LOADING, load_ns);
+  return 1;
+}
+
+// Timers due by now: loading done, cargo delivered, back from an empty departure
+static void expire_timers(Fleet *f, uint64_t now, int shutdown) {
+  for (TimerNode *n = timer_wheel_expire(&f->wheel, now), *next; n; n = next) {
+    next = n->next;
+    wait_done(f, (FleetTruck *)n, shutdown);
+  }
+}
+
+void fleet_init(Fleet *f, const RoleEnv *env, int first_id, int count) {
+  memset(f, 0, sizeof(*f));
+  f->env = env;
+  f->count = count;
+  f->active = count;
+  f->trucks = calloc(count, sizeof(FleetTruck));
+  f->queue = malloc(sizeof(int) * count);
+  if (!f->trucks || !f->queue) {
+    perror("Fleet: alloc error");
+    exit(1);
+  }
+  timer_wheel_init(&f->wheel, monotonic_ns(), FLEET_TICK_NS);
+  for (int d = 0; d < MAX_DOCKS; ++d) f->at_dock[d] = -1;
+
+  // Trace events of all trucks go to the ring of the first one
+  f->trace = env->trace ? trace_claim(env->trace, TRACE_ROLE_TRUCK, 1) : NULL;
+
+  for (int i = 0; i < count; ++i) {
+    f->trucks[i].id = first_id + i;
+    enqueue(f, i);
+  }
+}
+
+int fleet_round(Fleet *f, uint64_t now, int shutdown) {
+  SharedState *shm = f->env->shm;
+
+  expire_timers(f, now, shutdown);
+
+  // Queued trucks end on shutdown, otherwise take the free docks in order
+  while (f->queue_len > 0 && (shutdown || sem_count_try(f->env->semid, SEM_DOCK, -1))) {
+    int i = f->queue[f->queue_head];
+    f->queue_head = (f->queue_head + 1) % f->count;
+    --f->queue_len;
+    if (shutdown) stop(f, &f->trucks[i]);
+    else dock_truck(f, i);
+  }
+
+  int progress = 0;
+  for (int d = 0; d < shm->docks_D; ++d) {
+    int i = f->at_dock[d];
+    if (i >= 0 && f->trucks[i].state == FLEET_DOCKED) progress |= load_step(f, &f->trucks[i]);
+  }
+  return progress;
+}
+
+void fleet_free(Fleet *f) {
+  for (int i = 0; i < f->count; ++i) free(f->trucks[i].cargo.pkgs);
+  free(f->queue);
+  free(f->trucks);
+}
+
+int fleet_run(const RoleEnv *env, int first_id, int count) {
+  SharedState *shm = env->shm;
+
+  log_init(COLOR_CYAN " Fleet  ", shm->log_level);
+
+  Fleet f;
+  fleet_init(&f, env, first_id, count);
+  LOG_INFO("Fleet of %d trucks (%d-%d) in the dock queue.", count, first_id, first_id + count - 1);
+
+  while (f.active > 0) {
+    // Doorbell is read before any wake condition is checked, as in truck_run
+    unsigned int bell = belt_doorbell(shm);
+    uint64_t now = monotonic_ns();
+
+    if (fleet_round(&f, now, shm->shutdown) || f.active == 0) continue;
+
+    // Nothing to do until a package, a kick or the next timer
+    uint64_t next = timer_wheel_next_ns(&f.wheel);
+    if (next == UINT64_MAX) {
+      log_flush();
+      belt_wait_package(shm, bell);
+    }
+    else if (next > now) {
+      log_flush();
+      belt_wait_package_timeout(shm, bell, next - now);
+    }
+  }
+
+  LOG_INFO("Fleet stopped, all trucks delivered.");
+  fleet_free(&f);
+  log_flush();
+  return 0;
+}
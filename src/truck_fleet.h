@@ -0,0 +1,95 @@
+#ifndef TRUCK_FLEET_H
+#define TRUCK_FLEET_H
+
+#include "common/common.h"
+#include "common/timer_wheel.h"
+#include "common/trace.h"
+#include "role.h"
+#include "truck.h"
+
+/**
+ * @file truck_fleet.h
+ * @brief Event loop steps of the truck fleet (`--fleet`, @ref fleet_run).
+ *
+ * @ref fleet_run is @ref fleet_init, then @ref fleet_round until every truck
+ * stopped, sleeping on the belt doorbell or until the next timer when a round
+ * made no progress. Tests drive the rounds themselves.
+ */
+
+/** @brief Tick of the fleet timer wheel, resolution of load and delivery times. */
+#define FLEET_TICK_NS 1000000ull
+
+/**
+ * @brief States of a fleet truck.
+ */
+typedef enum {
+  FLEET_QUEUED,     /**< Waiting for a dock. */
+  FLEET_DOCKED,     /**< At a dock, ready to load. */
+  FLEET_LOADING,    /**< At a dock, loading popped packages (timer). */
+  FLEET_DELIVERING, /**< Delivering its cargo (timer). */
+  FLEET_RETURNING,  /**< Driving back after an empty forced departure (timer). */
+  FLEET_DONE        /**< Stopped on shutdown. */
+} FleetState;
+
+/**
+ * @brief A truck of the fleet.
+ */
+typedef struct {
+  TimerNode timer;  /**< Pending delay, first member so a timer is its truck. */
+  TruckCargo cargo; /**< Packages on board. */
+  uint64_t t_since; /**< Time the truck queued or docked (ns). */
+  int id;           /**< Truck id. */
+  int dock;         /**< Dock index while docked. */
+  int forced;       /**< Current departure was forced. */
+  int state;        /**< @ref FleetState */
+} FleetTruck;
+
+/**
+ * @brief State of the whole fleet.
+ */
+typedef struct {
+  const RoleEnv *env;
+  FleetTruck *trucks;        /**< Trucks, index = id - first id. */
+  int *queue;                /**< FIFO of queued truck indexes. */
+  int count;                 /**< Trucks in the fleet. */
+  int queue_head;            /**< Oldest queued truck. */
+  int queue_len;             /**< Queued trucks. */
+  int at_dock[MAX_DOCKS];    /**< Truck index per dock, -1 when free. */
+  long active;               /**< Trucks not stopped yet. */
+  TimerWheel wheel;          /**< Pending delays. */
+  TraceRing *trace;          /**< One ring for all trucks, NULL without `--trace`. */
+  Package pkgs[MAX_BELT_BATCH]; /**< Packages of one load step. */
+} Fleet;
+
+/**
+ * @brief Sets up a fleet, every truck in the dock queue in id order.
+ *
+ * @param f        Fleet.
+ * @param env      Resources.
+ * @param first_id Id of the first truck.
+ * @param count    Number of trucks.
+ */
+void fleet_init(Fleet *f, const RoleEnv *env, int first_id, int count);
+
+/**
+ * @brief One round of the event loop.
+ *
+ * Ends the waiting states due by `now`, docks queued trucks at free docks
+ * and runs one load step of every docked truck. On shutdown queued trucks
+ * stop, docked ones leave, and trucks stop once their delivery is done.
+ *
+ * @param f        Fleet.
+ * @param now      Current time, CLOCK_MONOTONIC in nanoseconds.
+ * @param shutdown Shutdown was requested.
+ * @return 1 if a truck moved on, 0 if the fleet may sleep.
+ */
+int fleet_round(Fleet *f, uint64_t now, int shutdown);
+
+/**
+ * @brief Releases what @ref fleet_init allocated.
+ *
+ * @param f Fleet.
+ */
+void fleet_free(Fleet *f);
+
+#endif // TRUCK_FLEET_H
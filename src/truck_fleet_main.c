@@ -0,0 +1,38 @@
+/**
+ * @file truck_fleet_main.c
+ * @brief Truck Fleet Process - Entry point of `truck_fleet`.
+ *
+ * Attaches the IPC resources of the Dispatcher and runs @ref fleet_run for
+ * `<COUNT>` trucks numbered from `<FIRST_ID>`.
+ *
+ * Usage: `./truck_fleet <FIRST_ID> <COUNT>`
+ *
+ * @author Mikołaj Kosiorek
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "role.h"
+
+int main(int argc, char *argv[]) {
+  // Ignoring SIGINT/TERM so dispatcher can terminate child processes gracefully
+  signal(SIGINT, SIG_IGN);
+  signal(SIGTERM, SIG_IGN);
+
+  // Validate Arguments
+  if (argc < 3 || atoi(argv[1]) < 1 || atoi(argv[2]) < 1) {
+    fprintf(stderr, "Usage: %s <FIRST_ID> <COUNT>\n", argv[0]);
+    exit(1);
+  }
+
+  RoleEnv env;
+  role_env_attach(&env);
+  role_env_ready(&env);
+
+  int ret = fleet_run(&env, atoi(argv[1]), atoi(argv[2]));
+
+  role_env_detach(&env);
+  return ret;
+}
@@ -0,0 +1,37 @@
+/**
+ * @file truck_main.c
+ * @brief Truck Process - Entry point of `truck`.
+ *
+ * Attaches the IPC resources of the Dispatcher and runs @ref truck_run.
+ *
+ * Usage: `./truck <ID>`
+ *
+ * @author Mikołaj Kosiorek
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "role.h"
+
+int main(int argc, char *argv[]) {
+  // Ignoring SIGINT/TERM so dispatcher can terminate child processes gracefully
+  signal(SIGINT, SIG_IGN);
+  signal(SIGTERM, SIG_IGN);
+
+  // Validate Arguments
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <ID>\n", argv[0]);
+    exit(1);
+  }
+
+  RoleEnv env;
+  role_env_attach(&env);
+  role_env_ready(&env);
+
+  int ret = truck_run(&env, atoi(argv[1]));
+
+  role_env_detach(&env);
+  return ret;
+}
@@ -0,0 +1,408 @@
+/**
+ * @file virtual_time.c
+ * @brief Virtual-Time Engine - Discrete-Event Replay of the Warehouse.
+ *
+ * Replays the rules of the process model in a single thread, without sleeping
+ * and without spawning processes. Time only advances from one scheduled event
+ * to the next (event calendar, @ref EventQueue), so a simulated hour takes as
+ * long as it takes to process its events.
+ *
+ * Modeled rules (same as in worker_std.c, truck.c and worker_express.c):
+ * - **Standard Workers (P1-P3, or `--workers` per type):** Generate a package,
+ * wait while the belt is full (K), get rejected if belt weight M would be
+ * exceeded (retry after back-off), then work for a random time. The belt is
+ * modeled as a single lane, `--lanes` only changes lock contention, which
+ * virtual time does not have.
+ * - **Trucks:** Queue for one of the D docks (FIFO), load head package if it fits W/V
+ * ("Peek & Check"), or the best fitting one of the first L slots with lookahead
+ * (@ref belt_index_best_fit), leave when full, deliver and return to the queue.
+ * - **Express Worker (P4):** Periodically loads 1-5 packages directly into a
+ * docked truck, like dispatcher command 2. Docks are addressed round-robin.
+ * - **Forced departure:** Periodically releases a docked truck, like
+ * dispatcher command 1. Docks are addressed round-robin.
+ *
+ * @author Mikołaj Kosiorek
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "common/belt.h"
+#include "common/belt_index.h"
+#include "common/common.h"
+#include "common/event_queue.h"
+#include "common/stats.h"
+#include "common/utils.h"
+#include "virtual_time.h"
+
+#define US_PER_S 1000000LL
+#define STD_WORKERS (MAX_WORKERS_PER_TYPE * PKG_END)
+
+/**
+ * @brief Event types of the calendar.
+ */
+typedef enum {
+  EV_WORKER,       /**< Standard worker finished work and has a new package. */
+  EV_WORKER_RETRY, /**< Standard worker retries after weight limit rejection. */
+  EV_TRUCK,        /**< Docked truck tries to load the next package. */
+  EV_TRUCK_RETURN, /**< Truck came back from delivery and joins the dock queue. */
+  EV_EXPRESS,      /**< Express load command. */
+  EV_DEPART,       /**< Forced departure command. */
+  EV_END           /**< End of simulated time. */
+} VtEventType;
+
+/**
+ * @brief Truck life-cycle states.
+ */
+typedef enum {
+  TRUCK_QUEUED,  /**< Waiting for a free dock. */
+  TRUCK_IDLE,    /**< Docked, sleeping on an empty belt. */
+  TRUCK_LOADING, /**< Docked, next load attempt is scheduled. */
+  TRUCK_AWAY     /**< Delivering or driving back to the queue. */
+} VtTruckState;
+
+typedef struct {
+  VtTruckState state;
+  int64_t load; /**< Weight on board (g). */
+  int64_t vol;  /**< Volume on board (cm3). */
+  int dock;   /**< Dock the truck stands at, -1 when not docked. */
+  long epoch; /**< Bumped on departure, invalidates scheduled load attempts. */
+  long long docked_at; /**< Time the truck docked (us). */
+  Package *cargo;      /**< Packages loaded since docking, timed at delivery. */
+  int cargo_count, cargo_cap;
+} VtTruck;
+
+typedef struct {
+  const VirtualTimeConfig *cfg;
+  EventQueue events;
+  long long now;
+
+  // Belt
+  void *belt_block;      /**< Block holding the slot columns. */
+  BeltSlots belt;        /**< Slot columns, same layout as the shared belt. */
+  int head, tail, count;
+  int holes; /**< Slots emptied out of order (lookahead), freed when head passes them. */
+  BeltIndex index;       /**< Packages by type and weight class, same index as the semaphore belt. */
+  BeltIndexLink *links;  /**< Bucket links, one per slot. */
+  int64_t belt_weight;
+  int next_pkg_id;
+
+  // Standard workers blocked on a full belt (FIFO) with their pending package
+  int blocked[STD_WORKERS];
+  int blocked_count;
+  Package pending[STD_WORKERS];
+  PackageType worker_type[STD_WORKERS];
+  int workers;
+
+  // Trucks and the docks
+  VtTruck *trucks;
+  int *dock_queue;
+  int dq_head, dq_count;
+  int docked[MAX_DOCKS]; /**< Truck at each dock, -1 if the dock is free. */
+  int express_dock, depart_dock; /**< Round-robin targets of the commands. */
+
+  SimStats stats;
+} VtSim;
+
+static long long delay_us(const VtSim *sim, DelayKind kind) {
+  return (long long)delay_draw_us(&sim->cfg->delays[kind]);
+}
+
+static void dock_next(VtSim *sim) {
+  // Lowest free dock first, same as truck.c
+  for (int d = 0; d < sim->cfg->D && sim->dq_count > 0; ++d) {
+    if (sim->docked[d] != -1) continue;
+
+    int t = sim->dock_queue[sim->dq_head];
+    sim->dq_head = (sim->dq_head + 1) % sim->cfg->N;
+    sim->dq_count--;
+
+    sim->docked[d] = t;
+    sim->trucks[t].dock = d;
+    sim->trucks[t].state = TRUCK_LOADING;
+    sim->trucks[t].load = 0;
+    sim->trucks[t].vol = 0;
+    sim->trucks[t].docked_at = sim->now;
+    event_queue_push(&sim->events, sim->now, EV_TRUCK, t, sim->trucks[t].epoch);
+  }
+}
+
+static void enqueue_truck(VtSim *sim, int t) {
+  sim->trucks[t].state = TRUCK_QUEUED;
+  sim->dock_queue[(sim->dq_head + sim->dq_count) % sim->cfg->N] = t;
+  sim->dq_count++;
+  dock_next(sim);
+}
+
+static void depart(VtSim *sim, int t) {
+  VtTruck *truck = &sim->trucks[t];
+
+  truck->epoch++;
+  truck->state = TRUCK_AWAY;
+  hist_record(&sim->stats.dock_time_ns, (uint64_t)(sim->now - truck->docked_at) * 1000);
+  sim->docked[truck->dock] = -1;
+  truck->dock = -1;
+
+  if (truck->load == 0) {
+    // Forced departure of an empty truck, drive back to queue
+    event_queue_push(&sim->events, sim->now + delay_us(sim, DELAY_RETURN), EV_TRUCK_RETURN, t, 0);
+  }
+  else {
+    sim->stats.deliveries++;
+    sim->stats.delivered_weight += truck->load;
+    sim->stats.fill_ratio_sum += (double)truck->load / sim->cfg->W;
+
+    // Delivery time is known at departure
+    long long delivered_at = sim->now + delay_us(sim, DELAY_DELIVERY);
+    uint64_t t_delivered = (uint64_t)delivered_at * 1000;
+    for (int i = 0; i < truck->cargo_count; ++i) stats_record_delivery(&sim->stats, &truck->cargo[i], t_delivered);
+    truck->cargo_count = 0;
+    event_queue_push(&sim->events, delivered_at, EV_TRUCK_RETURN, t, 0);
+  }
+
+  dock_next(sim);
+}
+
+// Same order of checks as belt_push(): capacity, then weight limit
+static void worker_push(VtSim *sim, int w, const Package *pkg) {
+  if (sim->count + sim->holes == sim->cfg->K) {
+    sim->pending[w] = *pkg;
+    sim->blocked[sim->blocked_count++] = w;
+    return;
+  }
+
+  if (sim->belt_weight + pkg->weight_g > sim->cfg->M) {
+    sim->stats.rejected_overweight++;
+    event_queue_push(&sim->events, sim->now + delay_us(sim, DELAY_OVERWEIGHT), EV_WORKER_RETRY, w, 0);
+    return;
+  }
+
+  belt_slot_put(&sim->belt, sim->tail, pkg, (uint64_t)sim->now * 1000);
+  belt_index_insert(&sim->index, sim->links, &sim->belt, sim->tail);
+  sim->tail = (sim->tail + 1) % sim->cfg->K;
+  sim->count++;
+  sim->belt_weight += pkg->weight_g;
+  sim->stats.produced[pkg->type]++;
+
+  event_queue_push(&sim->events, sim->now + delay_us(sim, DELAY_WORK), EV_WORKER, w, 0);
+
+  // Doorbell, wake all trucks sleeping on empty belt
+  for (int d = 0; d < sim->cfg->D; ++d) {
+    int t = sim->docked[d];
+    if (t != -1 && sim->trucks[t].state == TRUCK_IDLE) {
+      sim->trucks[t].state = TRUCK_LOADING;
+      event_queue_push(&sim->events, sim->now, EV_TRUCK, t, sim->trucks[t].epoch);
+    }
+  }
+}
+
+static void worker_new_package(VtSim *sim, int w) {
+  Package pkg;
+  pkg.id = sim->next_pkg_id++;
+  pkg.type = sim->worker_type[w];
+  pkg.weight_g = generate_weight_g(pkg.type);
+  pkg.volume_cm3 = get_volume_cm3(pkg.type);
+  pkg.t_gen_ns = (uint64_t)sim->now * 1000;
+
+  worker_push(sim, w, &pkg);
+}
+
+static void truck_load_next(VtSim *sim, int t) {
+  VtTruck *truck = &sim->trucks[t];
+
+  // case: Limit is reached exactly
+  if (truck->load >= sim->cfg->W || truck->vol >= sim->cfg->V) {
+    depart(sim, t);
+    return;
+  }
+
+  if (sim->count == 0) {
+    truck->state = TRUCK_IDLE;
+    return;
+  }
+
+  // Same pick as belt_pop_batch_to_truck(), head only with L = 1
+  int slot = sim->head;
+  if (sim->cfg->L > 1) {
+    slot = belt_index_best_fit(&sim->index, &sim->belt, sim->cfg->K, sim->head, sim->cfg->L,
+			       truck->load, truck->vol, sim->cfg->W, sim->cfg->V);
+  }
+  else if (truck->load + sim->belt.weight_g[slot] > sim->cfg->W || truck->vol + sim->belt.volume_cm3[slot] > sim->cfg->V) {
+    slot = -1;
+  }
+  if (slot == -1) {
+    depart(sim, t); // No package of the window fits, truck is full
+    return;
+  }
+
+  Package pkg;
+  belt_slot_get(&sim->belt, slot, &pkg);
+  truck->load += pkg.weight_g;
+  truck->vol += pkg.volume_cm3;
+  belt_index_remove(&sim->index, sim->links, &sim->belt, slot);
+  sim->belt.type[slot] = BELT_HOLE;
+  sim->holes++;
+  sim->count--;
+  sim->belt_weight -= pkg.weight_g;
+  sim->stats.loaded++;
+
+  // Head moves over holes, every slot behind it is free again
+  int freed = 0;
+  while (sim->holes > 0 && sim->belt.type[sim->head] == BELT_HOLE) {
+    sim->head = (sim->head + 1) % sim->cfg->K;
+    sim->holes--;
+    freed++;
+  }
+
+  pkg.t_load_ns = (uint64_t)sim->now * 1000;
+  stats_record_load(&sim->stats, &pkg);
+  if (truck->cargo_count == truck->cargo_cap) {
+    truck->cargo_cap = truck->cargo_cap ? truck->cargo_cap * 2 : 16;
+    truck->cargo = realloc(truck->cargo, sizeof(Package) * truck->cargo_cap);
+    if (!truck->cargo) {
+      perror("Virtual time: realloc error");
+      exit(1);
+    }
+  }
+  truck->cargo[truck->cargo_count++] = pkg;
+
+  // Every free slot wakes first worker blocked on full belt
+  while (freed-- > 0 && sim->blocked_count > 0) {
+    int w = sim->blocked[0];
+    for (int i = 1; i < sim->blocked_count; ++i) sim->blocked[i - 1] = sim->blocked[i];
+    sim->blocked_count--;
+    worker_push(sim, w, &sim->pending[w]);
+  }
+
+  event_queue_push(&sim->events, sim->now + delay_us(sim, DELAY_LOAD), EV_TRUCK, t, truck->epoch);
+}
+
+static void express_load(VtSim *sim) {
+  int dock = sim->express_dock;
+  sim->express_dock = (dock + 1) % sim->cfg->D;
+  if (sim->docked[dock] == -1) return;
+
+  VtTruck *truck = &sim->trucks[sim->docked[dock]];
+  int count = (rand() % 5) + 1;
+
+  for (int i = 0; i < count; ++i) {
+    PackageType type = get_rand_package_type();
+    int w = generate_weight_g(type);
+    int v = get_volume_cm3(type);
+
+    if (truck->load + w <= sim->cfg->W && truck->vol + v <= sim->cfg->V) {
+      truck->load += w;
+      truck->vol += v;
+      sim->stats.express_loaded++;
+    }
+  }
+}
+
+int run_virtual_time(const VirtualTimeConfig *cfg) {
+  VtSim sim = {0};
+  sim.cfg = cfg;
+  for (int d = 0; d < MAX_DOCKS; ++d) sim.docked[d] = -1;
+
+  sim.belt_block = aligned_alloc(CACHE_LINE_SIZE, belt_slots_size(cfg->K));
+  sim.links = malloc(sizeof(BeltIndexLink) * cfg->K);
+  sim.trucks = calloc(cfg->N, sizeof(VtTruck));
+  sim.dock_queue = malloc(sizeof(int) * cfg->N);
+  if (!sim.belt_block || !sim.links || !sim.trucks || !sim.dock_queue) {
+    perror("Virtual time: malloc error");
+    exit(1);
+  }
+  sim.belt = belt_slots_layout(sim.belt_block, cfg->K);
+
+  // Workers numbered by type like the Dispatcher spawns them, P1-P3 with one per type
+  for (int t = 0; t < PKG_END; ++t) {
+    for (int i = 0; i < cfg->workers[t]; ++i) sim.worker_type[sim.workers++] = (PackageType)t;
+  }
+
+  belt_index_init(&sim.index);
+  event_queue_init(&sim.events, cfg->N + sim.workers + 4);
+  srand(cfg->seed);
+
+  long long end_us = (long long)(cfg->duration_s * US_PER_S);
+  long long express_us = (long long)(cfg->express_every_s * US_PER_S);
+  long long depart_us = (long long)(cfg->depart_every_s * US_PER_S);
+
+  // Initial calendar
+  for (int w = 0; w < sim.workers; ++w) event_queue_push(&sim.events, 0, EV_WORKER, w, 0);
+  for (int t = 0; t < cfg->N; ++t) {
+    sim.trucks[t].dock = -1;
+    enqueue_truck(&sim, t);
+  }
+  if (express_us > 0) event_queue_push(&sim.events, express_us, EV_EXPRESS, 0, 0);
+  if (depart_us > 0) event_queue_push(&sim.events, depart_us, EV_DEPART, 0, 0);
+  event_queue_push(&sim.events, end_us, EV_END, 0, 0);
+
+  struct timespec wall_start, wall_end;
+  clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+  long events = 0;
+  SimEvent ev;
+
+  while (event_queue_pop(&sim.events, &ev)) {
+    sim.now = ev.time_us;
+    events++;
+
+    if (ev.type == EV_END) break;
+
+    switch (ev.type) {
+    case EV_WORKER:
+    case EV_WORKER_RETRY:
+      worker_new_package(&sim, ev.id);
+      break;
+    case EV_TRUCK:
+      // Stale attempt of a truck that already departed
+      if (ev.tag == sim.trucks[ev.id].epoch && sim.trucks[ev.id].dock != -1) truck_load_next(&sim, ev.id);
+      break;
+    case EV_TRUCK_RETURN:
+      enqueue_truck(&sim, ev.id);
+      break;
+    case EV_EXPRESS:
+      express_load(&sim);
+      event_queue_push(&sim.events, sim.now + express_us, EV_EXPRESS, 0, 0);
+      break;
+    case EV_DEPART: {
+      int dock = sim.depart_dock;
+      sim.depart_dock = (dock + 1) % cfg->D;
+      if (sim.docked[dock] != -1) {
+	sim.stats.forced_departures++;
+	depart(&sim, sim.docked[dock]);
+      }
+      event_queue_push(&sim.events, sim.now + depart_us, EV_DEPART, 0, 0);
+      break;
+    }
+    }
+  }
+
+  // Shutdown: docked trucks deliver what they already loaded
+  for (int d = 0; d < cfg->D; ++d) {
+    int t = sim.docked[d];
+    if (t != -1 && sim.trucks[t].load > 0) depart(&sim, t);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &wall_end);
+  double wall_s = (wall_end.tv_sec - wall_start.tv_sec) + (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+
+  if (cfg->report_json) {
+    stats_print_json(stdout, &sim.stats, sim.now / (double)US_PER_S, sim.count);
+  }
+  else {
+    stats_print(stdout, &sim.stats, sim.now / (double)US_PER_S, sim.count);
+    stats_print_latency(stdout, &sim.stats);
+    printf("Events processed:    %ld in %.3f s wall (%.2f M events/s)\n",
+	   events, wall_s, wall_s > 0 ? events / wall_s / 1e6 : 0.0);
+  }
+
+  event_queue_free(&sim.events);
+  for (int t = 0; t < cfg->N; ++t) free(sim.trucks[t].cargo);
+  free(sim.dock_queue);
+  free(sim.trucks);
+  free(sim.links);
+  free(sim.belt_block);
+
+  return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef VIRTUAL_TIME_H
+#define VIRTUAL_TIME_H
+
+#include "common/delay.h"
+
+/**
+ * @file virtual_time.h
+ * @brief Virtual-time engine - single-threaded discrete-event simulation.
+ */
+
+/**
+ * @brief Parameters of a virtual-time run.
+ *
+ * N/K/M/W/V/D have the same meaning as in the process model.
+ */
+typedef struct {
+  int N;                  /**< Number of trucks. */
+  int K;                  /**< Belt capacity (items). */
+  int64_t M;              /**< Max belt weight (g). */
+  int64_t W;              /**< Truck weight capacity (g). */
+  int64_t V;              /**< Truck volume capacity (cm3). */
+  int D;                  /**< Number of loading docks (1..MAX_DOCKS). */
+  int L;                  /**< Lookahead window of truck loading, 1 = head only (`--lookahead`). */
+  int workers[3];         /**< Standard workers per package type A, B, C (`--workers`). */
+  double duration_s;      /**< Simulated time to cover, in seconds. */
+  unsigned int seed;      /**< Random seed, same seed gives the same run. */
+  double express_every_s; /**< Period of express loads (dispatcher command 2), 0 disables. */
+  double depart_every_s;  /**< Period of forced departures (dispatcher command 1), 0 disables. */
+  int report_json;        /**< Print the statistics as JSON (@ref stats_print_json). */
+  SimDelay delays[DELAY_END]; /**< Simulated delays (`--delay`, @ref delay.h). */
+} VirtualTimeConfig;
+
+/**
+ * @brief Runs the simulation in virtual time and prints end-of-run statistics.
+ *
+ * @param cfg Simulation parameters.
+ * @return 0 on success.
+ */
+int run_virtual_time(const VirtualTimeConfig *cfg);
+
+#endif // VIRTUAL_TIME_H
@@ -0,0 +1,212 @@
+/**
+ * @file warehouse_stats.c
+ * @brief Metrics Exporter - Live counters of a running simulation in Prometheus format.
+ *
+ * Attaches to the shared memory of a simulation running from the same
+ * directory and writes the metrics segment (@ref metrics.h) in Prometheus text
+ * exposition format. Counters are read with atomic loads, the exporter never
+ * takes @ref SEM_MUTEX and cannot slow the simulation down.
+ *
+ * Outputs:
+ * - stdout (default): a single snapshot.
+ * - `--out=<file>`: the snapshot replaces `<file>` atomically (write & rename),
+ * with `--interval` it is rewritten periodically, e.g. for the node_exporter
+ * textfile collector.
+ * - `--socket=<path>`: serves a fresh snapshot to every client connecting to a
+ * Unix stream socket (e.g. `nc -U <path>`).
+ *
+ * The exporter ends after a last snapshot once the simulation shuts down, or
+ * on SIGINT/SIGTERM.
+ *
+ * Usage: `./warehouse_stats [--out=<file>] [--socket=<path>] [--interval=<ms>]`
+ * (default interval: 1000 ms when serving or rewriting).
+ *
+ * @author Mikołaj Kosiorek
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "common/common.h"
+#include "common/metrics.h"
+#include "common/shm_wrapper.h"
+
+volatile sig_atomic_t exit_request = 0;
+
+void handle_shutdown_signal(int sig) {
+  (void)sig;
+  exit_request = 1;
+}
+
+// Renders one snapshot into a malloc'd buffer, so it can be written at once
+static char *render(const MetricsBlock *m, const SharedState *shm, size_t *len) {
+  char *buf = NULL;
+  FILE *out = open_memstream(&buf, len);
+  if (!out) {
+    perror("Stats: open_memstream error");
+    exit(1);
+  }
+  metrics_write_prometheus(out, m, shm);
+  fclose(out);
+  return buf;
+}
+
+static void write_file(const char *path, const char *buf, size_t len) {
+  char tmp[4096];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+  FILE *f = fopen(tmp, "w");
+  if (!f || fwrite(buf, 1, len, f) != len || fclose(f) != 0) {
+    perror("Stats: output file");
+    exit(1);
+  }
+  // Readers never see a half written file
+  if (rename(tmp, path) == -1) {
+    perror("Stats: rename error");
+    exit(1);
+  }
+}
+
+static void write_all(int fd, const char *buf, size_t len) {
+  while (len > 0) {
+    ssize_t w = write(fd, buf, len);
+    if (w == -1) {
+      if (errno == EINTR) continue;
+      return; // Client went away
+    }
+    buf += w;
+    len -= w;
+  }
+}
+
+static int open_socket(const char *path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path too long: %s\n", path);
+    exit(1);
+  }
+  strcpy(addr.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1) {
+    perror("Stats: socket error");
+    exit(1);
+  }
+
+  unlink(path); // Stale socket of a previous run
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(fd, 16) == -1) {
+    perror("Stats: bind error");
+    exit(1);
+  }
+  return fd;
+}
+
+int main(int argc, char *argv[]) {
+  const char *out_path = NULL;
+  const char *socket_path = NULL;
+  int interval_ms = 0;
+
+  static struct option long_opts[] = {
+    {"out",      required_argument, 0, 'o'},
+    {"socket",   required_argument, 0, 's'},
+    {"interval", required_argument, 0, 'i'},
+    {0, 0, 0, 0}
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+    switch (opt) {
+    case 'o': out_path = optarg; break;
+    case 's': socket_path = optarg; break;
+    case 'i': interval_ms = atoi(optarg); break;
+    default:
+      fprintf(stderr, "Usage: %s [--out=<file>] [--socket=<path>] [--interval=<ms>]\n", argv[0]);
+      exit(1);
+    }
+  }
+
+  if (interval_ms < 0) {
+    fprintf(stderr, "Interval must be a positive number.\n");
+    exit(1);
+  }
+  if (socket_path && interval_ms == 0) interval_ms = 1000;
+
+  // Simulation must run from this directory, IPC keys derive from it
+  if (shmget(ftok(KEY_PATH, KEY_ID_SHM), 0, 0600) == -1) {
+    fprintf(stderr, "No simulation is running in this directory.\n");
+    exit(1);
+  }
+
+  SharedState *shm = attach_memory_block(KEY_PATH, KEY_ID_SHM, 0);
+  if (shm->metrics_trucks == 0) {
+    fprintf(stderr, "Simulation runs without metrics.\n");
+    exit(1);
+  }
+
+  MetricsBlock *m = metrics_attach(shm);
+  if (m->magic != METRICS_MAGIC || m->version != METRICS_VERSION) {
+    fprintf(stderr, "Unknown metrics segment (version %u).\n", METRICS_VERSION);
+    exit(1);
+  }
+
+  struct sigaction sa;
+  sa.sa_handler = handle_shutdown_signal;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = 0;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  int listen_fd = socket_path ? open_socket(socket_path) : -1;
+  size_t len;
+  char *buf;
+
+  while (1) {
+    int done = exit_request || __atomic_load_n(&shm->shutdown, __ATOMIC_RELAXED);
+
+    if (out_path) {
+      buf = render(m, shm, &len);
+      write_file(out_path, buf, len);
+      free(buf);
+    }
+    else if (!socket_path) {
+      buf = render(m, shm, &len);
+      fwrite(buf, 1, len, stdout);
+      free(buf);
+    }
+
+    if (done || interval_ms == 0) break;
+
+    // Serve clients until the next rewrite is due
+    struct pollfd pfd = {listen_fd, POLLIN, 0};
+    if (poll(&pfd, listen_fd != -1 ? 1 : 0, interval_ms) > 0 && (pfd.revents & POLLIN)) {
+      int client = accept(listen_fd, NULL, NULL);
+      if (client != -1) {
+	buf = render(m, shm, &len);
+	write_all(client, buf, len);
+	free(buf);
+	close(client);
+      }
+    }
+  }
+
+  if (listen_fd != -1) {
+    close(listen_fd);
+    unlink(socket_path);
+  }
+
+  detach_memory_block(m);
+  detach_memory_block(shm);
+
+  return 0;
+}
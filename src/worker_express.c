@@ -1,163 +1,197 @@
 /**
  * @file worker_express.c
- * @brief Express Worker Process (P4) - Event-Driven Priority Loader.
+ * @brief Express Worker (P4) - Event-Driven Priority Loader.
  *
- * This file implements the logic for the Express Worker (P4).
+ * This file implements the logic for the Express Worker (P4), run as a process
+ * (`worker_express_main.c`) or as a thread of the Dispatcher (`--threads`).
  * Unlike standard workers that continuously produce items for the belt, the Express Worker
- * is **event-driven**. It sleeps until it receives a signal (`SIGUSR1`) from the Dispatcher.
+ * is **event-driven**. It sleeps until the Dispatcher posts a command to its mailbox.
  *
  * Key Features:
- * - **Signal Handling:** Uses `pause()` to suspend execution until triggered.
+ * - **Command Mailbox:** Sleeps on the mailbox futex until a command arrives
+ * (@ref mailbox.h), every command carries its dock and package count.
  * - **Direct Loading:** Bypasses the conveyor belt and loads packages directly onto the Truck.
  * - **Priority Logic:** Executed on demand to simulate high-priority shipments.
  *
  * @author Mikołaj Kosiorek
  */
 
-#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include "common/belt.h"
 #include "common/common.h"
+#include "common/log.h"
+#include "common/metrics.h"
 #include "common/sem_wrapper.h"
-#include "common/shm_wrapper.h"
+#include "common/trace.h"
 #include "common/utils.h"
+#include "role.h"
 
-/**
- * @brief Atomic flag for signal handling.
- *
- * Defined as `volatile sig_atomic_t` to ensure safe access between the asynchronous
- * signal handler and the main program loop without race conditions.
- */
-volatile sig_atomic_t load_signal = 0;
+/** @brief Largest random number of express packages, used when a command leaves the count open. */
+#define EXPRESS_RANDOM_BATCH 5
 
 /**
- * @brief Signal Handler for SIGUSR1.
+ * @brief Outcome of loading a single express package.
  *
- * Sets the global flag `load_signal` to 1, waking up the main loop.
- *
- * @param sig The signal number (expected SIGUSR1).
+ * Filled inside the critical section and logged after it.
  */
-void handle_sigusr1(int sig) {
-  (void)sig; // Satisfies compiler
-  load_signal = 1;
-}
+typedef struct {
+  int weight;         /**< Package weight (g). */
+  int64_t load_after; /**< Truck load after the attempt (g). */
+  int loaded;         /**< 1 if the package was loaded, 0 if it was skipped. */
+} ExpressLoad;
 
 /**
  * @brief Simulates loading a batch of express packages directly into the truck.
  *
  * Iterates `count` times, generating random packages. Unlike standard workers,
  * this function checks the **Truck's remaining capacity** directly and updates
- * the load, bypassing the conveyor belt buffer.
+ * the load, bypassing the conveyor belt buffer. Called with @ref SEM_MUTEX
+ * held, so it does not log, outcomes are stored in `res`.
  *
  * @param shm   Pointer to the shared memory state.
+ * @param dock  Index of the dock whose truck receives the packages.
  * @param count Number of packages to attempt to load in this batch.
+ * @param res   Receives the outcome of every attempt (`count` entries).
+ * @return Number of packages actually loaded.
  */
-void load_express_packages(SharedState *shm, int count) {
-  char time_buf[64];
-  get_time(time_buf, sizeof(time_buf));
-
-  printf("[" COLOR_GREEN "%s" COLOR_RESET "]" COLOR_MAGENTA " P4 (Express)  " COLOR_RESET "Attempting to load %d packages...\n", time_buf, count);
+int load_express_packages(SharedState *shm, int dock, int count, ExpressLoad *res) {
+  int loaded = 0;
 
   for (int i = 0; i < count; ++i) {
     PackageType type = get_rand_package_type();
 
-    double w = generate_weight(type);
-    double v = get_volume(type);
+    int w = generate_weight_g(type);
+    int v = get_volume_cm3(type);
+
+    // Loading single package
+    res[i].weight = w;
+    res[i].loaded = truck_try_load(shm, dock, w, v);
+    res[i].load_after = shm->docks[dock].current_truck_load;
+
+    if (res[i].loaded) {
+      shm->stats.express_loaded++;
+      loaded++;
+    }
+  }
+
+  return loaded;
+}
 
-    if(shm->current_truck_load + w <= shm->truck_capacity_W &&
-       shm->current_truck_vol + v <= shm->truck_volume_V) {
+/**
+ * @brief Logs the outcome of @ref load_express_packages.
+ *
+ * @param res   Outcome of every attempt.
+ * @param count Number of attempts.
+ * @param dock  Index of the dock.
+ * @param W     Truck weight capacity (g).
+ */
+void log_express_packages(const ExpressLoad *res, int count, int dock, int64_t W) {
+  (void)res; (void)dock; (void)W; // Unused when records are compiled out
 
-      // Loading single package
-      shm->current_truck_load += w;
-      shm->current_truck_vol += v;
+  LOG_INFO("Attempting to load %d packages at dock %d...", count, dock + 1);
 
-      printf("   -> ["COLOR_GREEN"+"COLOR_RESET"] Loaded pkg %d/%d: %.2f kg (Load: %.2f/%.2f)\n",
-	     i+1, count, w, shm->current_truck_load, shm->truck_capacity_W);
+  for (int i = 0; i < count; ++i) {
+    if (res[i].loaded) {
+      LOG_DEBUG("   -> ["COLOR_GREEN"+"COLOR_RESET"] Loaded pkg %d/%d: %.2f kg (Load: %.2f/%.2f)",
+		i+1, count, g_to_kg(res[i].weight), g_to_kg(res[i].load_after), g_to_kg(W));
     } else { // Limit reached
-      printf("   -> ["COLOR_YELLOW"-"COLOR_RESET"] Skipped pkg %d/%d (Truck full or limit reached)\n", i+1, count);
+      LOG_DEBUG("   -> ["COLOR_YELLOW"-"COLOR_RESET"] Skipped pkg %d/%d (Truck full or limit reached)", i+1, count);
     }
   }
 }
 
 /**
- * @brief Main Entry Point for Express Worker.
+ * @brief Event Loop of the Express Worker.
  *
  * **Flow of Execution:**
- * 1. Disables stdout buffering for real-time logging.
- * 2. Registers `handle_sigusr1` for `SIGUSR1`.
- * 3. Attaches to Shared Memory and Semaphores.
- * 4. Enters the Event Loop:
- * - Calls `pause()` to sleep and wait for signals (saves CPU).
- * - **On Wake Up:** Checks if `load_signal` is set.
+ * 1. Claims its trace ring, sets up the logger.
+ * 2. Enters the Event Loop:
+ * - Reads the mailbox doorbell, then takes the next command from
+ * @ref SharedState::express_mail. An empty mailbox puts the worker to sleep
+ * in @ref mailbox_wait (saves CPU), a command posted after the check rings
+ * the doorbell and wakes it at once. Every command is executed, none merge.
  * - **Critical Section:** Locks `SEM_MUTEX`.
- * - Checks if a truck is present (`truck_docked`).
- * - Calls `load_express_packages()` to load a random batch (1-5 items).
+ * - Checks if a truck is present at the dock named by the command (`truck_docked`).
+ * - Calls `load_express_packages()` to load the requested number of packages,
+ * or a random batch (1-5 items) when the command leaves it open.
  * - Unlocks `SEM_MUTEX`.
- * - Resets `load_signal` and goes back to sleep.
+ * - Marks the command done and records its delivery latency.
  *
+ * @param env Resources.
  * @return 0 on clean exit.
  */
-int main() {
-  // Turn off buffering for real time logging to simulation.log file
-  setbuf(stdout, NULL);
-
-  // Register signal handler
-  struct sigaction sa;
-  sa.sa_handler = handle_sigusr1;
-  sigemptyset(&sa.sa_mask);
-  sa.sa_flags = 0;
-  sigaction(SIGUSR1, &sa, NULL);
-
-  // IPC Setup
-  SharedState *shm;
-  shm = attach_memory_block(
-    KEY_PATH,
-    KEY_ID_SHM,
-    sizeof(SharedState)
-  );
-
-  int semid = get_sem(KEY_PATH, KEY_ID_SEM, 0);
+int worker_express_run(const RoleEnv *env) {
+  SharedState *shm = env->shm;
+  int semid = env->semid;
+  int worker_id = express_worker_id(shm);
+  TraceRing *trace = env->trace ? trace_claim(env->trace, TRACE_ROLE_EXPRESS, worker_id) : NULL;
+  MetricsBlock *metrics = env->metrics;
+  Mailbox *mail = &shm->express_mail;
+
+  char log_tag[32];
+  snprintf(log_tag, sizeof(log_tag), COLOR_MAGENTA " P%d (Express)  ", worker_id);
+  log_init(log_tag, shm->log_level);
 
   srand(time(NULL) ^ getpid());
-  char time_buf[64];
+  ExpressLoad res[MAX_EXPRESS_BATCH];
 
   while(1) {
-    if (!load_signal) {
-      if (shm->shutdown) break;
+    // Doorbell is read before the mailbox, a command posted after the check wakes the sleep
+    unsigned int bell = mailbox_doorbell(mail);
+
+    if (shm->shutdown) break;
 
-      // Waits for signal
-      pause();
+    Command cmd;
+    if (!mailbox_take(mail, &cmd)) {
+      // Waits for command
+      log_flush();
+      mailbox_wait(mail, bell);
+      continue;
     }
 
-    if(shm->shutdown) break;
+    LOG_INFO("Received command %llu. Attempting to load packet.", (unsigned long long)cmd.seq);
 
-    if (load_signal) {
-      get_time(time_buf, sizeof(time_buf));
-      printf("["COLOR_GREEN"%s"COLOR_RESET"]"COLOR_MAGENTA" P4 (Express)  "COLOR_RESET"Received signal. Attempting to load packet.\n", time_buf);
+    int dock = cmd.dock;
+    int count = 0;
+    int loaded = 0;
+    int docked = 0;
+    uint64_t t_load = trace_now();
 
+    if (dock >= 0 && dock < shm->docks_D) {
       //Critical Part
       SEM_P(semid, SEM_MUTEX);
-      
-      if (!shm->truck_docked) {
-	printf("["COLOR_YELLOW"%s"COLOR_RESET"]"COLOR_MAGENTA" P4 (Express)  "COLOR_RESET"No truck at dock. Cannot load.\n", time_buf);
-      } else {
-	// Generate a batch of express packages. For example 1-5
-	int count = (rand() % 5) + 1;
-	load_express_packages(shm, count);
+
+      docked = shm->docks[dock].truck_docked;
+      if (docked) {
+	// Requested batch, or a random one of 1-5 packages
+	count = cmd.count > 0 ? cmd.count : (rand() % EXPRESS_RANDOM_BATCH) + 1;
+	if (count > MAX_EXPRESS_BATCH) count = MAX_EXPRESS_BATCH;
+	loaded = load_express_packages(shm, dock, count, res);
       }
-      load_signal = 0;
       SEM_V(semid, SEM_MUTEX);
     }
 
+    hist_record(&shm->stats.command_ns[CMD_EXPRESS_LOAD], mailbox_done(mail, &cmd));
+
+    // Logging only after the critical section
+    if (!docked) {
+      LOG_WARN("No truck at dock %d. Cannot load.", dock + 1);
+    } else {
+      trace_event(trace, TRACE_EXPRESS, t_load, loaded);
+      metrics_add(&metrics_worker(metrics, worker_id)->express_loaded, loaded);
+      metrics_add(&metrics_dock(metrics, dock)->express_loaded, loaded);
+      log_express_packages(res, count, dock, shm->truck_capacity_W);
+    }
+
 #ifdef SIM_DELAY_MS
     usleep(SIM_DELAY_MS * 1000);
 #endif
   }
 
-  detach_memory_block(shm);
-
+  log_flush();
   return 0;
 }
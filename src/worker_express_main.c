@@ -0,0 +1,22 @@
+/**
+ * @file worker_express_main.c
+ * @brief Express Worker Process (P4) - Entry point of `worker_express`.
+ *
+ * Attaches the IPC resources of the Dispatcher and runs @ref worker_express_run.
+ * The Dispatcher requests express loads through @ref SharedState::express_mail.
+ *
+ * @author Mikołaj Kosiorek
+ */
+
+#include "role.h"
+
+int main() {
+  RoleEnv env;
+  role_env_attach(&env);
+  role_env_ready(&env);
+
+  int ret = worker_express_run(&env);
+
+  role_env_detach(&env);
+  return ret;
+}
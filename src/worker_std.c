@@ -1,139 +1,186 @@
-#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "common/belt.h"
 #include "common/common.h"
+#include "common/log.h"
+#include "common/metrics.h"
 #include "common/sem_wrapper.h"
-#include "common/shm_wrapper.h"
+#include "common/trace.h"
 #include "common/utils.h"
+#include "common/workload.h"
+#include "role.h"
 
 /**
  * @file worker_std.c
- * @brief Standard Worker Process (Producer) - Generates Packages A, B, or C.
+ * @brief Standard Worker (Producer) - Generates Packages A, B, or C.
  *
- * This file implements the logic for a Standard Worker process.
+ * This file implements the logic for a Standard Worker, run as a process
+ * (`worker_std_main.c`) or as a thread of the Dispatcher (`--threads`).
  * The worker acts as a **Producer** in the system, generating packages of a specific
  * type (A, B, or C) and attempting to place them on the conveyor belt (Shared Memory).
  *
  * Key Responsibilities:
  * - Continuously generating packages with randomized weights within defined bounds.
- * - waiting for available slots on the belt (@ref SEM_EMPTY).
- * - Enforcing the Maximum Belt Weight limit (M) before placing an item.
- * - Updating the Circular Buffer (Push operation).
+ * - Placing packages on the conveyor belt via @ref belt_push_batch, which waits for
+ * available slots and enforces the Maximum Belt Weight limit (M).
+ * - Generating B packages up front (@ref SharedState::batch_B, `--batch`), so a
+ * whole batch costs one belt reservation and one critical section.
+ * - Pushing to its own belt lane (`--lanes`), several workers of a type
+ * (`--workers`) spread over the lanes instead of queueing on one lock.
+ * - Writing generated packages to a workload file (`--record`), or taking
+ * packages and their arrival times from one instead of generating them
+ * (`--replay`, @ref workload.h).
+ * - Pacing production by deadlines: the work time of every package is drawn
+ * from the delays of the run (`--delay`, `set-delay`, @ref delay.h), or
+ * follows the rate set with `set-rate` over the control channel
+ * (@ref SharedState::worker_rate).
  *
  * @author Mikołaj Kosiorek
  */
-int main(int argc, char *argv[]) {
-  // Turn off buffering for real time logging to simulation.log file
-  setbuf(stdout, NULL);
 
-  if(argc < 2) {
-    fprintf(stderr, "Usage: %s <Type A/B/C>\n", argv[0]);
-    exit(1);
-  }
+/** @brief Longest single sleep while waiting for a replayed arrival or a paced batch, shutdown is checked in between. */
+#define WAIT_SLICE_NS 100000000ull
 
-  // Determine package type
-  PackageType type;
-  if (strcmp(argv[1], "A") == 0) type = PKG_A;
-  else if (strcmp(argv[1], "B") == 0) type = PKG_B;
-  else if (strcmp(argv[1], "C") == 0) type = PKG_C;
-  else {
-    fprintf(stderr, "Usage: %s <Type A/B/C>\n", argv[0]);
-    exit(1);
+// Sleeps until a CLOCK_MONOTONIC time or shutdown
+static void pace_until_ns(const SharedState *shm, uint64_t t_ns) {
+  uint64_t now;
+  while (!shm->shutdown && (now = monotonic_ns()) < t_ns) {
+    sleep_until_ns(t_ns - now > WAIT_SLICE_NS ? now + WAIT_SLICE_NS : t_ns);
   }
+}
 
-  // Shared memory attachment
-  SharedState *shm;
-
-  shm = (SharedState *)attach_memory_block(
-    KEY_PATH,
-    KEY_ID_SHM,
-    sizeof(SharedState)
-  );
+// Waits for a replayed arrival time, at once with --no-sleep
+static void wait_until_ns(const SharedState *shm, uint64_t t_ns) {
+  if (!shm->no_sleep) pace_until_ns(shm, t_ns);
+}
 
-  // Gets access to semaphores
-  int semid = get_sem(KEY_PATH, KEY_ID_SEM, 0);
+int worker_std_run(const RoleEnv *env, PackageType type, int worker_id) {
+  SharedState *shm = env->shm;
+  int semid = env->semid;
+  const char *type_name = type == PKG_A ? "A" : (type == PKG_B ? "B" : "C");
 
   int allow_full_belt_msg = 1;
-  int worker_id = (type==PKG_A ? 1 : (type==PKG_B ? 2 : 3));
-  char time_buf[64];
+  int B = belt_batch_size(shm);
+  int lane = belt_lane_of(shm, worker_id - 1);
+  TraceRing *trace = env->trace ? trace_claim(env->trace, TRACE_ROLE_WORKER, worker_id) : NULL;
+  WorkerMetrics *metrics = metrics_worker(env->metrics, worker_id);
+  Package batch[MAX_BELT_BATCH];
+
+  WorkloadHeader *workload = env->workload;
+  int record = workload && shm->workload_mode == WORKLOAD_RECORD;
+  int replay = workload && shm->workload_mode == WORKLOAD_REPLAY;
+  WorkloadCursor cursor;
+  if (replay) workload_cursor_init(workload, &cursor, worker_id);
+  uint64_t paced_ns = 0; // Time the next batch is due
+
+  char log_tag[32];
+  snprintf(log_tag, sizeof(log_tag), COLOR_BLUE " P%d  ", worker_id);
+  log_init(log_tag, shm->log_level);
+
   srand(time(NULL) ^ getpid()); // Seed random
   
   while(1) {
     if (shm->shutdown) break;
 
-    // Creating package data
-    double w = generate_weight(type);
-    double v = get_volume(type);
+    // Creating data of a whole batch up front
+    uint64_t t_gen = monotonic_ns();
+    for (int i = 0; i < B; ++i) {
+      batch[i].id = rand() % 10000;
+      if (replay && workload_next(workload, &cursor, &batch[i])) {
+	batch[i].t_gen_ns += shm->workload_t0_ns;
+	continue;
+      }
+      if (replay) {
+	LOG_WARN("Worker P%d: no packages of worker %d in the workload file, generating at random",
+		 worker_id, cursor.worker);
+	replay = 0;
+      }
+      batch[i].type = type;
+      batch[i].weight_g = generate_weight_g(type);
+      batch[i].volume_cm3 = get_volume_cm3(type);
+      batch[i].t_gen_ns = t_gen;
+    }
+
+    if (record) workload_record(workload, worker_id, batch, B);
+
+    // Replayed batches are pushed once their last package arrived
+    if (replay) {
+      wait_until_ns(shm, batch[B - 1].t_gen_ns);
+      if (shm->shutdown) break;
+    }
 
-    // Wating for space on belt
-    SEM_P(semid, SEM_EMPTY);
+    int pushed;
+    uint64_t t_push = monotonic_ns();
+    BeltStatus status = belt_push_batch(shm, semid, lane, batch, B, &pushed);
+    metrics_add(&metrics->push_wait_ns, monotonic_ns() - t_push);
 
-    // Critical section
-    SEM_P(semid, SEM_MUTEX);
+    if (status == BELT_SHUTDOWN) break;
 
-    if(shm->shutdown) {
-      SEM_V(semid, SEM_MUTEX);
-      break;
+    if (pushed > 0) {
+      allow_full_belt_msg = 1; // Allow printing full belt message after successfuly placing next package
+      // Replayed packages keep the type they were recorded with
+      long produced[PKG_END] = {0};
+      for (int i = 0; i < pushed; ++i) ++produced[batch[i].type];
+      for (int t = 0; t < PKG_END; ++t) {
+	if (produced[t]) __atomic_add_fetch(&shm->stats.produced[t], produced[t], __ATOMIC_RELAXED);
+      }
+      metrics_add(&metrics->pushed, pushed);
+      trace_event(trace, TRACE_PUSH, t_push, pushed);
+
+      if (pushed == 1) {
+	LOG_DEBUG("Worker P%d: Placed pkg %s (%.2f kg) on belt. Load: %.2f/%.2f",
+		  worker_id, type_name, g_to_kg(batch[0].weight_g),
+		  g_to_kg(shm->current_belt_weight), g_to_kg(shm->max_belt_weight_M));
+      }
+      else {
+	LOG_DEBUG("Worker P%d: Placed %d pkgs %s (%.2f kg) on belt. Load: %.2f/%.2f",
+		  worker_id, pushed, type_name, g_to_kg(package_weight_sum(batch, pushed)),
+		  g_to_kg(shm->current_belt_weight), g_to_kg(shm->max_belt_weight_M));
+      }
     }
 
-    // Checking weight limit
-    if (shm->current_belt_weight + w > shm->max_belt_weight_M) {
-      // Cannot place item, releasing resources
-      SEM_V(semid, SEM_MUTEX);
-      SEM_V(semid, SEM_EMPTY);
+    if (status == BELT_OVERWEIGHT) {
+      __atomic_add_fetch(&shm->stats.rejected_overweight, 1, __ATOMIC_RELAXED);
+      metrics_add(&metrics->rejected_overweight, 1);
 
       // Print  only at first occurrance
       if (allow_full_belt_msg) {
-	get_time(time_buf, sizeof(time_buf));
-	printf("[" COLOR_YELLOW "%s" COLOR_RESET "]" COLOR_BLUE " P%d  " COLOR_RESET "Worker P%d: pkg %s (%.2f kg) Load: %.2f/%.2f. Limit reached...\n",
-	       time_buf, worker_id, worker_id, argv[1], w,
-	       shm->current_belt_weight, shm->max_belt_weight_M
-	);
+	LOG_WARN("Worker P%d: pkg %s (%.2f kg) Load: %.2f/%.2f. Limit reached...",
+		 worker_id, type_name, g_to_kg(batch[pushed].weight_g),
+		 g_to_kg(shm->current_belt_weight), g_to_kg(shm->max_belt_weight_M));
 	
 	allow_full_belt_msg = 0;
       }
 
       // Waits few 100ms to avoid busy loop slamming
-      usleep(100000);
+      pace_until_ns(shm, monotonic_ns() + sim_delay_ns(shm, DELAY_OVERWEIGHT));
 
-      // Take different package
+      // Take different packages, rest of the batch is dropped
       continue;
     }
-    allow_full_belt_msg = 1; // Allow printing full belt message after successfuly placing next package
-
-    // Placing package on belt
-    int idx = shm->tail;
-    shm->belt[idx].type = type;
-    shm->belt[idx].weight = w;
-    shm->belt[idx].volume = v;
-    shm->belt[idx].id = rand() % 10000;
 
-    shm->tail = (shm->tail + 1) % shm->max_items_K;
-    shm->current_count++;
-    shm->current_belt_weight += w;
-
-    get_time(time_buf, sizeof(time_buf));
-    printf("[" COLOR_GREEN "%s" COLOR_RESET "]" COLOR_BLUE " P%d  " COLOR_RESET "Worker P%d: Placed pkg %s (%.2f kg) on belt. Load: %.2f/%.2f\n", 
-	   time_buf, worker_id, worker_id, argv[1], w, 
-	   shm->current_belt_weight, shm->max_belt_weight_M);
-
-    // Unlock access
-    SEM_V(semid, SEM_MUTEX);
-    SEM_V(semid, SEM_FULL);
-
-    // Simulates work time
-    usleep(rand() % 500000 + 200000);
+    // Simulates work time of every placed package, replay waits for arrival times instead.
+    // A rate set over the control channel replaces the work time, also with --no-sleep.
+    // Deadlines follow each other, time spent pushing counts towards the next one
+    unsigned int rate = __atomic_load_n(&shm->worker_rate, __ATOMIC_RELAXED);
+    if (!replay) {
+      uint64_t work = 0;
+      if (rate > 0) work = (uint64_t)pushed * 1000000000ull / rate;
+      for (int i = 0; rate == 0 && i < pushed; ++i) work += sim_delay_ns(shm, DELAY_WORK);
+
+      uint64_t now = monotonic_ns();
+      paced_ns = (paced_ns > now ? paced_ns : now) + work;
+      pace_until_ns(shm, paced_ns);
+    }
 
 #ifdef SIM_DELAY_MS
     usleep(SIM_DELAY_MS * 1000);
 #endif
   }
 
-  detach_memory_block(shm);
-
+  log_flush();
   return 0;
 }
@@ -0,0 +1,49 @@
+/**
+ * @file worker_std_main.c
+ * @brief Standard Worker Process - Entry point of `worker_std`.
+ *
+ * Attaches the IPC resources of the Dispatcher and runs @ref worker_std_run.
+ *
+ * Usage: `./worker_std <Type A/B/C> [worker number]`, the worker number
+ * defaults to 1, 2 or 3 (P1-P3) by type.
+ *
+ * @author Mikołaj Kosiorek
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "role.h"
+
+int main(int argc, char *argv[]) {
+  if(argc < 2) {
+    fprintf(stderr, "Usage: %s <Type A/B/C> [worker number]\n", argv[0]);
+    exit(1);
+  }
+
+  // Determine package type
+  PackageType type;
+  if (strcmp(argv[1], "A") == 0) type = PKG_A;
+  else if (strcmp(argv[1], "B") == 0) type = PKG_B;
+  else if (strcmp(argv[1], "C") == 0) type = PKG_C;
+  else {
+    fprintf(stderr, "Usage: %s <Type A/B/C> [worker number]\n", argv[0]);
+    exit(1);
+  }
+
+  int worker_id = argc > 2 ? atoi(argv[2]) : (int)type + 1;
+  if (worker_id < 1) {
+    fprintf(stderr, "Invalid worker number %s\n", argv[2]);
+    exit(1);
+  }
+
+  RoleEnv env;
+  role_env_attach(&env);
+  role_env_ready(&env);
+
+  int ret = worker_std_run(&env, type, worker_id);
+
+  role_env_detach(&env);
+  return ret;
+}
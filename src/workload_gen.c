@@ -0,0 +1,137 @@
+/**
+ * @file workload_gen.c
+ * @brief Workload Generator - Writes synthetic workload files for `--replay`.
+ *
+ * Creates a workload file (@ref workload.h) of the given number of packages,
+ * spread round-robin over the standard workers. Every worker gets one package
+ * per `1 / rate` seconds on average, types and weights follow the distribution
+ * of the simulation. The file is mapped and filled by several threads in
+ * place, so multi-GB files are written at memory speed. The same seed always
+ * gives the same file, whatever the thread count.
+ *
+ * Usage: `./workload_gen <out.bin> <packages> [--workers=<S>] [--rate=<pkg/s>]
+ * [--seed=<n>] [--threads=<n>]` (defaults: 3 workers, 2 packages per second and
+ * worker, seed 1, one thread per CPU).
+ *
+ * @author Mikołaj Kosiorek
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/utils.h"
+#include "common/workload.h"
+
+/** @brief Largest number of generator threads. */
+#define MAX_GEN_THREADS 64
+
+/**
+ * @brief Range of records filled by one thread.
+ */
+typedef struct {
+  pthread_t thread;
+  WorkloadHeader *hdr;
+  uint64_t first;
+  uint64_t n;
+  uint64_t seed;
+  uint64_t gap_ns;
+} GenChunk;
+
+static void *gen_thread(void *arg) {
+  GenChunk *c = arg;
+  workload_generate(c->hdr, c->first, c->n, c->seed, c->gap_ns);
+  return NULL;
+}
+
+static void print_usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [options] <out.bin> <packages>\n", prog);
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "  --workers=<S>    Standard workers in the file (default: 3, max: %d)\n", MAX_WORKERS_PER_TYPE * PKG_END);
+  fprintf(stderr, "  --rate=<pkg/s>   Packages per second and worker (default: 2)\n");
+  fprintf(stderr, "  --seed=<n>       Random seed (default: 1)\n");
+  fprintf(stderr, "  --threads=<n>    Generator threads (default: CPU count, max: %d)\n", MAX_GEN_THREADS);
+}
+
+int main(int argc, char *argv[]) {
+  int workers = PKG_END;
+  double rate = 2.0;
+  uint64_t seed = 1;
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+  static struct option long_opts[] = {
+    {"workers", required_argument, 0, 'w'},
+    {"rate",    required_argument, 0, 'r'},
+    {"seed",    required_argument, 0, 's'},
+    {"threads", required_argument, 0, 't'},
+    {0, 0, 0, 0}
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+    switch (opt) {
+    case 'w': workers = atoi(optarg); break;
+    case 'r': rate = atof(optarg); break;
+    case 's': seed = strtoull(optarg, NULL, 10); break;
+    case 't': threads = atol(optarg); break;
+    default:  print_usage(argv[0]); exit(1);
+    }
+  }
+
+  if (argc - optind < 2) {
+    print_usage(argv[0]);
+    exit(1);
+  }
+
+  const char *path = argv[optind];
+  long long packages = atoll(argv[optind + 1]);
+
+  if (packages <= 0 || rate <= 0) {
+    fprintf(stderr, "Package count and rate must be positive numbers.\n");
+    exit(1);
+  }
+
+  if (workers < 1 || workers > MAX_WORKERS_PER_TYPE * PKG_END) {
+    fprintf(stderr, "Workers must be between 1 and %d.\n", MAX_WORKERS_PER_TYPE * PKG_END);
+    exit(1);
+  }
+
+  if (threads < 1) threads = 1;
+  if (threads > MAX_GEN_THREADS) threads = MAX_GEN_THREADS;
+
+  WorkloadHeader *hdr = workload_create(path, (uint64_t)packages, workers, 1);
+  if (!hdr) { perror("Workload file"); exit(1); }
+
+  // Records of a worker are `workers` apart, the last one arrives within its gap
+  uint64_t gap_ns = (uint64_t)(1e9 / rate);
+  uint64_t n = (uint64_t)packages;
+  hdr->duration_ns = ((n - 1) / workers + 1) * gap_ns;
+
+  uint64_t t_start = monotonic_ns();
+
+  GenChunk chunks[MAX_GEN_THREADS];
+  uint64_t per_thread = (n + threads - 1) / threads;
+  for (long i = 0; i < threads; ++i) {
+    uint64_t first = i * per_thread < n ? i * per_thread : n;
+    uint64_t last = first + per_thread < n ? first + per_thread : n;
+    chunks[i] = (GenChunk){0, hdr, first, last - first, seed, gap_ns};
+    if (pthread_create(&chunks[i].thread, NULL, gen_thread, &chunks[i]) != 0) {
+      perror("Generator thread"); exit(1);
+    }
+  }
+  for (long i = 0; i < threads; ++i) pthread_join(chunks[i].thread, NULL);
+
+  hdr->count = n;
+  double gen_s = (monotonic_ns() - t_start) / 1e9;
+  double duration_s = hdr->duration_ns / 1e9;
+
+  if (workload_finish(hdr, path) < 0) { perror("Workload file"); exit(1); }
+
+  double gib = workload_file_size(n) / (1024.0 * 1024.0 * 1024.0);
+  fprintf(stderr, "Generated %lld packages of %d workers covering %.1f s: %.2f GiB in %.2f s (%.2f GiB/s, %ld threads)\n",
+	  packages, workers, duration_s, gib, gen_s, gen_s > 0 ? gib / gen_s : 0.0, threads);
+  return 0;
+}
@@ -0,0 +1,580 @@
+#include <gtest/gtest.h>
+#include <sys/ipc.h>
+#include <sys/sem.h>
+#include <sys/shm.h>
+#include <sys/types.h>
+
+extern "C" {
+  #include "../src/common/belt.h"
+  #include "../src/common/common.h"
+  #include "../src/common/utils.h"
+
+  union semun {
+    int val;
+    struct semid_ds *buf;
+    unsigned short *array;
+  };
+}
+
+class BeltTest : public ::testing::Test {
+protected:
+  int shmid;
+  int semid;
+  SharedState *shm;
+
+  void SetUp() override {
+    key_t key_shm = ftok(KEY_PATH, KEY_ID_SHM);
+    key_t key_sem = ftok(KEY_PATH, KEY_ID_SEM);
+
+    shmid = shmget(key_shm, shared_state_size(3), 0600|IPC_CREAT);
+    ASSERT_NE(shmid, -1) << "Failed to create SHM";
+    shm = (SharedState *)shmat(shmid, (void *)0, 0);
+    ASSERT_NE(shm, (void *)-1) << "Failed to attach SHM";
+
+    memset(shm, 0, sizeof(SharedState));
+    shm->max_items_K = 3;
+    shm->max_belt_weight_M = 100000;
+    shm->truck_capacity_W = 1000000;
+    shm->truck_volume_V = 1000000000;
+
+    semid = semget(key_sem, SEM_NUM, 0600|IPC_CREAT);
+    ASSERT_NE(semid, -1) << "Failed to create SEM";
+
+    union semun arg;
+    arg.val = 1;
+    semctl(semid, SEM_MUTEX, SETVAL, arg);
+    arg.val = shm->max_items_K;
+    semctl(semid, SEM_EMPTY, SETVAL, arg);
+    arg.val = 0;
+    semctl(semid, SEM_FULL, SETVAL, arg);
+
+    belt_init(shm);
+  }
+
+  void TearDown() override {
+    shmdt(shm);
+    shmctl(shmid, IPC_RMID, 0);
+    semctl(semid, 0, IPC_RMID);
+  }
+
+  Package MakePkg(int id, int weight_g, int volume_cm3 = 19000) {
+    Package pkg = {id, PKG_A, weight_g, volume_cm3};
+    return pkg;
+  }
+};
+
+TEST_F(BeltTest, PopOnEmptyBelt) {
+  Package out;
+  EXPECT_EQ(belt_pop_to_truck(shm, semid, 0, &out), BELT_EMPTY);
+}
+
+TEST_F(BeltTest, KeepsFifoOrderAcrossWrapAround) {
+  Package out;
+
+  // K = 3, so positions wrap several times
+  for (int i = 0; i < 10; ++i) {
+    Package pkg = MakePkg(i, 1000);
+    ASSERT_EQ(belt_push(shm, semid, &pkg), BELT_OK);
+    ASSERT_EQ(belt_pop_to_truck(shm, semid, 0, &out), BELT_OK);
+    EXPECT_EQ(out.id, i);
+  }
+
+  EXPECT_EQ(shm->current_count, 0);
+  EXPECT_EQ(shm->current_belt_weight, 0);
+  EXPECT_EQ(shm->docks[0].current_truck_load, 10000);
+}
+
+TEST_F(BeltTest, StampsPackagesWhenPlacedOnBelt) {
+  Package pkg = MakePkg(1, 1000);
+  pkg.t_gen_ns = 1;
+  Package out;
+
+  uint64_t before = monotonic_ns();
+  ASSERT_EQ(belt_push(shm, semid, &pkg), BELT_OK);
+  uint64_t after = monotonic_ns();
+  ASSERT_EQ(belt_pop_to_truck(shm, semid, 0, &out), BELT_OK);
+
+  EXPECT_EQ(out.t_gen_ns, 1u); // Worker stamp is kept
+  EXPECT_GE(out.t_belt_ns, before);
+  EXPECT_LE(out.t_belt_ns, after);
+}
+
+// More operations than SEMAEM, counting semaphores must not keep undo values
+TEST_F(BeltTest, SurvivesMoreOperationsThanUndoLimit) {
+  Package out;
+
+  for (int i = 0; i < 40000; ++i) {
+    Package pkg = MakePkg(i, 1);
+    ASSERT_EQ(belt_push(shm, semid, &pkg), BELT_OK);
+    ASSERT_EQ(belt_pop_to_truck(shm, semid, 0, &out), BELT_OK);
+  }
+
+  EXPECT_EQ(shm->current_count, 0);
+}
+
+// Belt size comes from the segment header, not from a compile-time limit
+TEST_F(BeltTest, RuntimeSizedBeltHoldsThousandsOfPackages) {
+  const int K = 20000;
+
+  int big_shmid = shmget(IPC_PRIVATE, shared_state_size(K), 0600|IPC_CREAT);
+  ASSERT_NE(big_shmid, -1) << "Failed to create SHM";
+  SharedState *big = (SharedState *)shmat(big_shmid, (void *)0, 0);
+  ASSERT_NE(big, (void *)-1) << "Failed to attach SHM";
+  shmctl(big_shmid, IPC_RMID, 0); // Removed on detach
+
+  memset(big, 0, sizeof(SharedState));
+  big->segment_size = shared_state_size(K);
+  big->max_items_K = K;
+  big->max_belt_weight_M = UNITS_MAX;
+  big->truck_capacity_W = UNITS_MAX;
+  big->truck_volume_V = UNITS_MAX;
+  belt_init(big);
+
+  union semun arg;
+  arg.val = K;
+  semctl(semid, SEM_EMPTY, SETVAL, arg);
+
+  for (int i = 0; i < K; ++i) {
+    Package pkg = MakePkg(i, 1000);
+    ASSERT_EQ(belt_push(big, semid, &pkg), BELT_OK);
+  }
+  EXPECT_EQ(big->current_count, K);
+
+  Package out;
+  for (int i = 0; i < K; ++i) {
+    ASSERT_EQ(belt_pop_to_truck(big, semid, 0, &out), BELT_OK);
+    ASSERT_EQ(out.id, i);
+  }
+  EXPECT_EQ(belt_pop_to_truck(big, semid, 0, &out), BELT_EMPTY);
+
+  shmdt(big);
+}
+
+// Words written by producers, by consumers and by both never share a cache line
+TEST(BeltLayoutTest, HotWordsOwnTheirCacheLines) {
+  auto line = [](size_t offset) { return offset / CACHE_LINE_SIZE; };
+
+  size_t config = line(offsetof(SharedState, max_items_K));
+  size_t producer = line(offsetof(SharedState, belt_not_empty));
+  size_t consumer = line(offsetof(SharedState, belt_pop_waiters));
+  size_t counters = line(offsetof(SharedState, current_count));
+  EXPECT_LT(config, producer);
+  EXPECT_LT(line(offsetof(SharedState, shutdown)), producer);
+  EXPECT_LT(producer, consumer);
+  EXPECT_LT(consumer, counters);
+  EXPECT_EQ(line(offsetof(SharedState, current_belt_weight)), counters);
+  EXPECT_LT(counters, line(offsetof(SharedState, lanes)));
+
+  EXPECT_LT(line(offsetof(BeltLane, slots)), line(offsetof(BeltLane, tail)));
+  EXPECT_LT(line(offsetof(BeltLane, tail)), line(offsetof(BeltLane, head)));
+  EXPECT_LT(line(offsetof(BeltLane, head)), line(offsetof(BeltLane, count)));
+  EXPECT_EQ(sizeof(DockState) % CACHE_LINE_SIZE, 0u);
+  EXPECT_NE(line(offsetof(SimStats, rejected_overweight)), line(offsetof(SimStats, loaded)));
+  EXPECT_EQ(offsetof(SharedState, belt) % CACHE_LINE_SIZE, 0u);
+}
+
+TEST(BeltLayoutTest, SlotColumnsStartOnCacheLines) {
+  const int K = 5;
+  void *block = aligned_alloc(CACHE_LINE_SIZE, belt_slots_size(K));
+  ASSERT_NE(block, nullptr);
+  BeltSlots s = belt_slots_layout(block, K);
+
+  const void *columns[] = {s.weight_g, s.volume_cm3, s.type, s.id, s.t_gen_ns, s.t_belt_ns};
+  for (const void *c : columns) EXPECT_EQ((uintptr_t)c % CACHE_LINE_SIZE, 0u);
+  EXPECT_LE((char *)(s.t_belt_ns + K), (char *)block + belt_slots_size(K));
+
+  Package pkg = {7, PKG_C, 12500, 99712, 100, 0, 300};
+  belt_slot_put(&s, 4, &pkg, 200);
+  BeltSlots lane = belt_slots_at(s, 3);
+  Package out;
+  belt_slot_get(&lane, 1, &out);
+  EXPECT_EQ(out.id, 7);
+  EXPECT_EQ(out.type, PKG_C);
+  EXPECT_EQ(out.weight_g, 12500);
+  EXPECT_EQ(out.volume_cm3, 99712);
+  EXPECT_EQ(out.t_gen_ns, 100u);
+  EXPECT_EQ(out.t_belt_ns, 200u);
+  EXPECT_EQ(out.t_load_ns, 0u); // Not loaded yet
+
+  free(block);
+}
+
+TEST_F(BeltTest, RejectsOverweightPackage) {
+  Package heavy = MakePkg(1, 60000);
+  ASSERT_EQ(belt_push(shm, semid, &heavy), BELT_OK);
+  EXPECT_EQ(belt_push(shm, semid, &heavy), BELT_OVERWEIGHT);
+
+  EXPECT_EQ(shm->current_count, 1);
+  EXPECT_EQ(shm->current_belt_weight, 60000);
+}
+
+TEST_F(BeltTest, HeadPackageStaysIfItDoesNotFit) {
+  shm->truck_capacity_W = 10000;
+
+  Package heavy = MakePkg(1, 20000);
+  Package light = MakePkg(2, 5000);
+  ASSERT_EQ(belt_push(shm, semid, &heavy), BELT_OK);
+  ASSERT_EQ(belt_push(shm, semid, &light), BELT_OK);
+
+  Package out;
+  EXPECT_EQ(belt_pop_to_truck(shm, semid, 0, &out), BELT_NO_FIT);
+
+  EXPECT_EQ(shm->current_count, 2);
+  EXPECT_EQ(shm->current_belt_weight, 25000);
+  EXPECT_EQ(shm->docks[0].current_truck_load, 0);
+}
+
+TEST_F(BeltTest, BatchKeepsFifoOrderAcrossWrapAround) {
+  Package pkgs[2];
+  Package out[3];
+  int pushed, popped;
+  int next_id = 0;
+
+  // K = 3, batches of 2 wrap around the end of the ring
+  for (int lap = 0; lap < 5; ++lap) {
+    pkgs[0] = MakePkg(next_id++, 1000);
+    pkgs[1] = MakePkg(next_id++, 2000);
+    ASSERT_EQ(belt_push_batch(shm, semid, 0, pkgs, 2, &pushed), BELT_OK);
+    ASSERT_EQ(pushed, 2);
+    EXPECT_EQ(shm->current_count, 2);
+    EXPECT_EQ(shm->current_belt_weight, 3000);
+
+    ASSERT_EQ(belt_pop_batch_to_truck(shm, semid, 0, out, 3, &popped), BELT_OK);
+    ASSERT_EQ(popped, 2);
+    EXPECT_EQ(out[0].id, pkgs[0].id);
+    EXPECT_EQ(out[1].id, pkgs[1].id);
+  }
+
+  EXPECT_EQ(shm->current_count, 0);
+  EXPECT_EQ(shm->current_belt_weight, 0);
+  EXPECT_EQ(shm->docks[0].current_truck_load, 15000);
+}
+
+TEST_F(BeltTest, BatchPushStopsAtFirstOverweightPackage) {
+  Package pkgs[3] = {MakePkg(1, 40000), MakePkg(2, 70000), MakePkg(3, 10000)};
+  int pushed;
+
+  // Second package exceeds M = 100, it and the rest of the batch are not placed
+  EXPECT_EQ(belt_push_batch(shm, semid, 0, pkgs, 3, &pushed), BELT_OVERWEIGHT);
+  EXPECT_EQ(pushed, 1);
+  EXPECT_EQ(shm->current_count, 1);
+  EXPECT_EQ(shm->current_belt_weight, 40000);
+
+  // Slots of rejected packages were released
+  Package light[2] = {MakePkg(4, 1000), MakePkg(5, 1000)};
+  EXPECT_EQ(belt_push_batch(shm, semid, 0, light, 2, &pushed), BELT_OK);
+  EXPECT_EQ(shm->current_count, 3);
+}
+
+TEST_F(BeltTest, BatchPopLoadsOnlyPackagesThatFit) {
+  shm->truck_capacity_W = 10000;
+
+  Package pkgs[3] = {MakePkg(1, 4000), MakePkg(2, 5000), MakePkg(3, 2000)};
+  int pushed, popped;
+  ASSERT_EQ(belt_push_batch(shm, semid, 0, pkgs, 3, &pushed), BELT_OK);
+
+  // Third package would exceed W = 10, it stays on belt
+  Package out[3];
+  EXPECT_EQ(belt_pop_batch_to_truck(shm, semid, 0, out, 3, &popped), BELT_OK);
+  EXPECT_EQ(popped, 2);
+  EXPECT_EQ(shm->current_count, 1);
+  EXPECT_EQ(shm->current_belt_weight, 2000);
+  EXPECT_EQ(shm->docks[0].current_truck_load, 9000);
+
+  EXPECT_EQ(belt_pop_batch_to_truck(shm, semid, 0, out, 3, &popped), BELT_NO_FIT);
+  EXPECT_EQ(popped, 0);
+
+  // Package left on belt can still be popped by the next truck
+  shm->docks[0].current_truck_load = 0;
+  shm->docks[0].current_truck_vol = 0;
+  EXPECT_EQ(belt_pop_batch_to_truck(shm, semid, 0, out, 3, &popped), BELT_OK);
+  EXPECT_EQ(popped, 1);
+  EXPECT_EQ(out[0].id, 3);
+  EXPECT_EQ(belt_pop_batch_to_truck(shm, semid, 0, out, 3, &popped), BELT_EMPTY);
+}
+
+TEST_F(BeltTest, BatchSizeIsClampedToBelt) {
+  EXPECT_EQ(belt_batch_size(shm), 1); // Not set
+
+  shm->batch_B = 2;
+  EXPECT_EQ(belt_batch_size(shm), 2);
+
+  shm->batch_B = 50;
+  EXPECT_EQ(belt_batch_size(shm), 3); // K = 3
+}
+
+TEST_F(BeltTest, ExpressLoadRespectsTruckLimits) {
+  shm->truck_capacity_W = 10000;
+  shm->truck_volume_V = 1000000;
+
+  EXPECT_EQ(truck_try_load(shm, 0, 6000, 500000), 1);
+  EXPECT_EQ(truck_try_load(shm, 0, 6000, 100000), 0); // Weight limit
+  EXPECT_EQ(truck_try_load(shm, 0, 1000, 600000), 0); // Volume limit
+
+  EXPECT_EQ(shm->docks[0].current_truck_load, 6000);
+  EXPECT_EQ(shm->docks[0].current_truck_vol, 500000);
+}
+
+TEST_F(BeltTest, LookaheadIsClampedToBelt) {
+  EXPECT_EQ(belt_lookahead(shm), 1); // Not set, head only
+
+  shm->lookahead_L = 2;
+  EXPECT_EQ(belt_lookahead(shm), 2);
+
+  shm->lookahead_L = 50;
+  EXPECT_EQ(belt_lookahead(shm), 3); // K = 3
+}
+
+TEST_F(BeltTest, LookaheadLoadsPackageBehindHeadThatDoesNotFit) {
+  shm->truck_capacity_W = 10000;
+  shm->lookahead_L = 3;
+
+  Package heavy = MakePkg(1, 20000);
+  Package light = MakePkg(2, 5000);
+  ASSERT_EQ(belt_push(shm, semid, &heavy), BELT_OK);
+  ASSERT_EQ(belt_push(shm, semid, &light), BELT_OK);
+
+  Package out;
+  ASSERT_EQ(belt_pop_to_truck(shm, semid, 0, &out), BELT_OK);
+  EXPECT_EQ(out.id, 2);
+  EXPECT_EQ(shm->current_count, 1);
+  EXPECT_EQ(shm->current_belt_weight, 20000);
+  EXPECT_EQ(shm->docks[0].current_truck_load, 5000);
+
+  // Head package still does not fit, nothing else in the window
+  EXPECT_EQ(belt_pop_to_truck(shm, semid, 0, &out), BELT_NO_FIT);
+
+  // Hole keeps its slot until the head passes it
+#ifdef BELT_LOCKFREE
+  EXPECT_EQ(shm->lanes[0].head, 0ul);
+#else
+  EXPECT_EQ(semctl(semid, SEM_EMPTY, GETVAL), 1);
+  EXPECT_EQ(shm->lanes[0].holes, 1);
+#endif
+
+  // Next truck takes the head package, head moves over the hole
+  shm->truck_capacity_W = 100000;
+  shm->docks[0].current_truck_load = 0;
+  shm->docks[0].current_truck_vol = 0;
+  ASSERT_EQ(belt_pop_to_truck(shm, semid, 0, &out), BELT_OK);
+  EXPECT_EQ(out.id, 1);
+  EXPECT_EQ(shm->current_count, 0);
+
+#ifdef BELT_LOCKFREE
+  EXPECT_EQ(shm->lanes[0].head, 2ul);
+#else
+  EXPECT_EQ(semctl(semid, SEM_EMPTY, GETVAL), 3);
+  EXPECT_EQ(shm->lanes[0].holes, 0);
+#endif
+  EXPECT_EQ(belt_pop_to_truck(shm, semid, 0, &out), BELT_EMPTY);
+}
+
+TEST_F(BeltTest, LookaheadBatchPicksBestFitsOutOfOrder) {
+  shm->truck_capacity_W = 10000;
+  shm->lookahead_L = 3;
+
+  Package pkgs[3] = {MakePkg(1, 2000), MakePkg(2, 6000), MakePkg(3, 3500)};
+  int pushed, popped;
+  ASSERT_EQ(belt_push_batch(shm, semid, 0, pkgs, 3, &pushed), BELT_OK);
+
+  // 6 kg first, then 3.5 kg, then 2 kg would exceed W = 10 kg
+  Package out[3];
+  ASSERT_EQ(belt_pop_batch_to_truck(shm, semid, 0, out, 3, &popped), BELT_OK);
+  ASSERT_EQ(popped, 2);
+  EXPECT_EQ(out[0].id, 2);
+  EXPECT_EQ(out[1].id, 3);
+  EXPECT_EQ(shm->current_count, 1);
+  EXPECT_EQ(shm->current_belt_weight, 2000);
+  EXPECT_EQ(shm->docks[0].current_truck_load, 9500);
+}
+
+TEST_F(BeltTest, LookaheadKeepsSlotsAcrossWrapAround) {
+  shm->lookahead_L = 3;
+  Package out;
+
+  // K = 3, every lap leaves a hole behind the head that is then passed over.
+  // A slot lost on the way would block the push of a later lap
+  for (int lap = 0; lap < 10; ++lap) {
+    Package heavy = MakePkg(2 * lap, 20000);
+    Package light = MakePkg(2 * lap + 1, 5000);
+    ASSERT_EQ(belt_push(shm, semid, &heavy), BELT_OK);
+    ASSERT_EQ(belt_push(shm, semid, &light), BELT_OK);
+
+    shm->truck_capacity_W = 10000;
+    shm->docks[0].current_truck_load = 0;
+    ASSERT_EQ(belt_pop_to_truck(shm, semid, 0, &out), BELT_OK);
+    EXPECT_EQ(out.id, 2 * lap + 1);
+
+    shm->truck_capacity_W = 100000;
+    ASSERT_EQ(belt_pop_to_truck(shm, semid, 0, &out), BELT_OK);
+    EXPECT_EQ(out.id, 2 * lap);
+  }
+
+  EXPECT_EQ(shm->current_count, 0);
+  EXPECT_EQ(shm->current_belt_weight, 0);
+#ifndef BELT_LOCKFREE
+  // Index followed every push and pop
+  for (int t = 0; t < PKG_END; ++t) EXPECT_EQ(shm->lanes[0].index.occupied[t], 0u);
+#endif
+}
+
+// K = 7 split into 3 lanes of 3, 2 and 2 slots
+class BeltLaneTest : public ::testing::Test {
+protected:
+  static const int K = 7;
+  static const int LANES = 3;
+  int shmid;
+  int semid;
+  SharedState *shm;
+
+  void SetUp() override {
+    shmid = shmget(IPC_PRIVATE, shared_state_size(K), 0600|IPC_CREAT);
+    ASSERT_NE(shmid, -1) << "Failed to create SHM";
+    shm = (SharedState *)shmat(shmid, (void *)0, 0);
+    ASSERT_NE(shm, (void *)-1) << "Failed to attach SHM";
+
+    memset(shm, 0, sizeof(SharedState));
+    shm->max_items_K = K;
+    shm->max_belt_weight_M = 100000;
+    shm->truck_capacity_W = 1000000;
+    shm->truck_volume_V = 1000000000;
+    shm->belt_lanes = LANES;
+
+    semid = semget(IPC_PRIVATE, belt_sem_count(LANES), 0600|IPC_CREAT);
+    ASSERT_NE(semid, -1) << "Failed to create SEM";
+
+    belt_init(shm);
+
+    union semun arg;
+    for (int l = 0; l < LANES; ++l) {
+      arg.val = 1;
+      semctl(semid, belt_lane_sem(l, SEM_MUTEX), SETVAL, arg);
+      arg.val = shm->lanes[l].slots;
+      semctl(semid, belt_lane_sem(l, SEM_EMPTY), SETVAL, arg);
+      arg.val = 0;
+      semctl(semid, belt_lane_sem(l, SEM_FULL), SETVAL, arg);
+    }
+  }
+
+  void TearDown() override {
+    shmdt(shm);
+    shmctl(shmid, IPC_RMID, 0);
+    semctl(semid, 0, IPC_RMID);
+  }
+
+  void Push(int lane, int id, int weight_g) {
+    Package pkg = {id, PKG_A, weight_g, 19000};
+    int pushed;
+    ASSERT_EQ(belt_push_batch(shm, semid, lane, &pkg, 1, &pushed), BELT_OK);
+  }
+};
+
+TEST_F(BeltLaneTest, LanesSplitBeltSlots) {
+  EXPECT_EQ(shm->belt_lanes, 3);
+  EXPECT_EQ(shm->lanes[0].first, 0);
+  EXPECT_EQ(shm->lanes[0].slots, 3);
+  EXPECT_EQ(shm->lanes[1].first, 3);
+  EXPECT_EQ(shm->lanes[1].slots, 2);
+  EXPECT_EQ(shm->lanes[2].first, 5);
+  EXPECT_EQ(shm->lanes[2].slots, 2);
+
+  EXPECT_EQ(belt_lane_of(shm, 0), 0);
+  EXPECT_EQ(belt_lane_of(shm, 4), 1);
+  EXPECT_EQ((uintptr_t)&shm->lanes[1] % CACHE_LINE_SIZE, 0u);
+
+  // Batch and lookahead fit into the smallest lane
+  shm->batch_B = 10;
+  shm->lookahead_L = 10;
+  EXPECT_EQ(belt_batch_size(shm), 2);
+#ifdef BELT_LOCKFREE
+  EXPECT_EQ(belt_lookahead(shm), 1); // Lanes of 2 slots cannot tell holes from free slots
+#else
+  EXPECT_EQ(belt_lookahead(shm), 2);
+#endif
+
+  // More lanes than slots, every lane keeps one slot
+  shm->belt_lanes = MAX_BELT_LANES + 1;
+  belt_init(shm);
+  EXPECT_EQ(shm->belt_lanes, 7);
+}
+
+TEST_F(BeltLaneTest, PushGoesToItsLaneOnly) {
+  Push(2, 1, 1000);
+  Push(2, 2, 1000);
+
+  EXPECT_EQ(shm->lanes[0].count, 0);
+  EXPECT_EQ(shm->lanes[1].count, 0);
+  EXPECT_EQ(shm->lanes[2].count, 2);
+  EXPECT_EQ(shm->current_count, 2);
+  EXPECT_EQ(belt_slots(shm).id[5], 1);
+  EXPECT_EQ(belt_slots(shm).id[6], 2);
+
+#ifndef BELT_LOCKFREE
+  // Lane 2 is full, the others still have all their slots
+  EXPECT_EQ(semctl(semid, belt_lane_sem(2, SEM_EMPTY), GETVAL), 0);
+  EXPECT_EQ(semctl(semid, belt_lane_sem(2, SEM_FULL), GETVAL), 2);
+  EXPECT_EQ(semctl(semid, belt_lane_sem(0, SEM_EMPTY), GETVAL), 3);
+#endif
+
+  // Full lane does not block producers of other lanes
+  Push(0, 3, 1000);
+  EXPECT_EQ(shm->lanes[0].count, 1);
+}
+
+TEST_F(BeltLaneTest, WeightLimitIsSharedByAllLanes) {
+  Push(0, 1, 60000);
+
+  Package pkg = {2, PKG_A, 50000, 19000};
+  int pushed;
+  EXPECT_EQ(belt_push_batch(shm, semid, 1, &pkg, 1, &pushed), BELT_OVERWEIGHT);
+  EXPECT_EQ(pushed, 0);
+  EXPECT_EQ(shm->current_belt_weight, 60000);
+}
+
+TEST_F(BeltLaneTest, TruckDrainsFullestLaneFirst) {
+  Push(0, 1, 1000);
+  Push(2, 2, 1000);
+  Push(2, 3, 1000);
+
+  Package out[3];
+  int popped;
+  ASSERT_EQ(belt_pop_batch_to_truck(shm, semid, 0, out, 3, &popped), BELT_OK);
+  ASSERT_EQ(popped, 2); // One lane per call
+  EXPECT_EQ(out[0].id, 2);
+  EXPECT_EQ(out[1].id, 3);
+
+  ASSERT_EQ(belt_pop_batch_to_truck(shm, semid, 0, out, 3, &popped), BELT_OK);
+  ASSERT_EQ(popped, 1);
+  EXPECT_EQ(out[0].id, 1);
+  EXPECT_EQ(shm->current_count, 0);
+  EXPECT_EQ(belt_pop_batch_to_truck(shm, semid, 0, out, 3, &popped), BELT_EMPTY);
+}
+
+TEST_F(BeltLaneTest, RoundRobinWalksLanesInTurn) {
+  shm->lane_policy = LANE_ROUND_ROBIN;
+  Push(0, 1, 1000);
+  Push(0, 2, 1000);
+  Push(1, 3, 1000);
+  Push(2, 4, 1000);
+
+  Package out;
+  int expected[] = {1, 3, 4, 2};
+  for (int id : expected) {
+    ASSERT_EQ(belt_pop_to_truck(shm, semid, 0, &out), BELT_OK);
+    EXPECT_EQ(out.id, id);
+  }
+}
+
+TEST_F(BeltLaneTest, LaneWithoutFitPassesTruckOn) {
+  shm->truck_capacity_W = 10000;
+  Push(0, 1, 40000);
+  Push(0, 2, 40000);
+  Push(1, 3, 5000);
+
+  // Fullest lane holds only heavy packages, the light one comes from lane 1
+  Package out;
+  ASSERT_EQ(belt_pop_to_truck(shm, semid, 0, &out), BELT_OK);
+  EXPECT_EQ(out.id, 3);
+  EXPECT_EQ(belt_pop_to_truck(shm, semid, 0, &out), BELT_NO_FIT);
+  EXPECT_EQ(shm->lanes[0].count, 2);
+}
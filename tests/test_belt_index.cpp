@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+
+extern "C" {
+  #include "../src/common/belt_index.h"
+  #include "../src/common/common.h"
+  #include "../src/common/utils.h"
+}
+
+class BeltIndexTest : public ::testing::Test {
+protected:
+  static const int K = 8;
+  void *block;
+  BeltSlots belt;
+  BeltIndexLink links[K];
+  BeltIndex idx;
+
+  void SetUp() override {
+    block = calloc(1, belt_slots_size(K));
+    belt = belt_slots_layout(block, K);
+    belt_index_init(&idx);
+  }
+
+  void TearDown() override {
+    free(block);
+  }
+
+  // Weights in kg, stored in grams like the belt does
+  void Put(int slot, PackageType type, double kg) {
+    belt.id[slot] = slot;
+    belt.type[slot] = type;
+    belt.weight_g[slot] = (int)kg_to_g(kg);
+    belt.volume_cm3[slot] = get_volume_cm3(type);
+    belt_index_insert(&idx, links, &belt, slot);
+  }
+
+  int BestFit(int head, int L, double load, double vol = 0.0, double W = 10.0, double V = 1.0) {
+    return belt_index_best_fit(&idx, &belt, K, head, L, kg_to_g(load), m3_to_cm3(vol), kg_to_g(W), m3_to_cm3(V));
+  }
+};
+
+TEST(BeltIndexClassTest, ClassesCoverWeightRange) {
+  EXPECT_EQ(belt_index_class(0), 0);
+  EXPECT_EQ(belt_index_class(100), 0);
+  EXPECT_EQ(belt_index_class(BELT_INDEX_CLASS_G * 3 / 2), 1);
+  EXPECT_EQ(belt_index_class(25000), 62); // Heaviest generated package keeps its own class
+  EXPECT_EQ(belt_index_class(1000000), BELT_INDEX_CLASSES - 1);
+}
+
+TEST_F(BeltIndexTest, EmptyIndexHasNoFit) {
+  EXPECT_EQ(BestFit(0, K, 0.0), -1);
+}
+
+TEST_F(BeltIndexTest, PicksHeaviestPackageThatFits) {
+  Put(0, PKG_A, 8.0);
+  Put(1, PKG_B, 6.0);
+  Put(2, PKG_C, 2.0);
+  Put(3, PKG_C, 6.5);
+
+  // Truck holds 3 kg of 10: 8 kg does not fit, 6.5 kg wins over 6 kg
+  EXPECT_EQ(BestFit(0, K, 3.0), 3);
+  EXPECT_EQ(BestFit(0, K, 0.0), 0);
+  EXPECT_EQ(BestFit(0, K, 7.0), 2);
+  EXPECT_EQ(BestFit(0, K, 8.5), -1);
+}
+
+TEST_F(BeltIndexTest, TieGoesToPackageCloserToHead) {
+  Put(0, PKG_C, 5.0);
+  Put(1, PKG_A, 5.0);
+
+  EXPECT_EQ(BestFit(0, K, 0.0), 0);
+}
+
+TEST_F(BeltIndexTest, OnlyWindowIsConsidered) {
+  Put(0, PKG_A, 1.0);
+  Put(1, PKG_B, 2.0);
+  Put(2, PKG_C, 9.0);
+
+  EXPECT_EQ(BestFit(0, 2, 0.0), 1);
+  EXPECT_EQ(BestFit(0, 1, 0.0), 0);
+  EXPECT_EQ(BestFit(0, 3, 0.0), 2);
+}
+
+TEST_F(BeltIndexTest, WindowWrapsAroundRing) {
+  Put(6, PKG_A, 1.0);
+  Put(7, PKG_B, 2.0);
+  Put(0, PKG_B, 3.0);
+  Put(1, PKG_C, 9.0);
+
+  EXPECT_EQ(BestFit(6, 3, 0.0), 0);
+  EXPECT_EQ(BestFit(6, 4, 0.0), 1);
+}
+
+TEST_F(BeltIndexTest, OldestPackageStandsForItsClass) {
+  Put(0, PKG_A, 1.0);
+  Put(1, PKG_B, 2.0);
+  Put(2, PKG_A, 4.0);
+  Put(3, PKG_A, 4.1); // Same class as slot 2
+
+  EXPECT_EQ(BestFit(0, K, 0.0), 2);
+  // Oldest of the class is outside the window, so are all younger ones
+  EXPECT_EQ(BestFit(0, 2, 0.0), 1);
+}
+
+TEST_F(BeltIndexTest, VolumeLimitIsChecked) {
+  Put(0, PKG_C, 2.0);
+  Put(1, PKG_A, 1.0);
+
+  EXPECT_EQ(BestFit(0, K, 0.0, 0.95), 1);
+  EXPECT_EQ(BestFit(0, K, 0.0, 0.99), -1);
+}
+
+TEST_F(BeltIndexTest, RemoveKeepsBucketOrderAndClearsBitmap) {
+  Put(0, PKG_B, 4.9);
+  Put(1, PKG_B, 5.0);
+  Put(2, PKG_B, 5.1);
+  int c = belt_index_class(4900);
+
+  belt_index_remove(&idx, links, &belt, 1);
+  EXPECT_EQ(idx.first[PKG_B][c], 0);
+  EXPECT_EQ(links[0].next, 2);
+  EXPECT_EQ(links[2].prev, 0);
+
+  belt_index_remove(&idx, links, &belt, 0);
+  EXPECT_EQ(idx.first[PKG_B][c], 2);
+  EXPECT_EQ(idx.last[PKG_B][c], 2);
+  EXPECT_NE(idx.occupied[PKG_B] & (1ULL << c), 0u);
+
+  belt_index_remove(&idx, links, &belt, 2);
+  EXPECT_EQ(idx.first[PKG_B][c], -1);
+  EXPECT_EQ(idx.last[PKG_B][c], -1);
+  EXPECT_EQ(idx.occupied[PKG_B], 0u);
+  EXPECT_EQ(BestFit(0, K, 0.0), -1);
+}
+
+TEST_F(BeltIndexTest, PickIsWithinOneClassOfExactBestFit) {
+  srand(7);
+  int head = 0, count = 0;
+
+  for (int round = 0; round < 2000; ++round) {
+    // Keep the ring half full of random packages
+    while (count < K / 2 + rand() % (K / 2)) {
+      PackageType type = get_rand_package_type();
+      Put((head + count) % K, type, g_to_kg(generate_weight_g(type)));
+      count++;
+    }
+
+    int64_t load = (rand() % 250) * 100;
+    int L = 1 + rand() % count;
+
+    // Exact answer by scanning the window
+    int exact = -1;
+    for (int i = 0; i < L; ++i) {
+      int s = (head + i) % K;
+      if (load + belt.weight_g[s] > 25000) continue;
+      if (exact == -1 || belt.weight_g[s] > belt.weight_g[exact]) exact = s;
+    }
+
+    int slot = belt_index_best_fit(&idx, &belt, K, head, L, load, 0, 25000, 1000000);
+    if (exact == -1) {
+      EXPECT_EQ(slot, -1);
+      continue;
+    }
+    ASSERT_NE(slot, -1);
+    ASSERT_LT((slot - head + K) % K, L);
+    EXPECT_LE(load + belt.weight_g[slot], 25000);
+    EXPECT_GE(belt_index_class(belt.weight_g[slot]) + 1, belt_index_class(belt.weight_g[exact]));
+
+    // Head package leaves, like a head-only truck
+    belt_index_remove(&idx, links, &belt, head);
+    head = (head + 1) % K;
+    count--;
+  }
+}
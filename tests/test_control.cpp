@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+extern "C" {
+  #include "../src/common/control.h"
+}
+
+TEST(ControlParseTest, CommandsWithArguments) {
+  ControlRequest req;
+
+  ASSERT_EQ(control_parse("depart 2", &req), 0);
+  EXPECT_EQ(req.op, CTL_DEPART);
+  EXPECT_EQ(req.dock, 1);
+
+  ASSERT_EQ(control_parse("express 1 7", &req), 0);
+  EXPECT_EQ(req.op, CTL_EXPRESS);
+  EXPECT_EQ(req.dock, 0);
+  EXPECT_EQ(req.count, 7);
+
+  ASSERT_EQ(control_parse("  express\t3 ", &req), 0);
+  EXPECT_EQ(req.dock, 2);
+  EXPECT_EQ(req.count, 0); // Random count
+
+  ASSERT_EQ(control_parse("set-rate 500", &req), 0);
+  EXPECT_EQ(req.op, CTL_SET_RATE);
+  EXPECT_EQ(req.count, 500);
+
+  ASSERT_EQ(control_parse("set-delay delivery exp:3s", &req), 0);
+  EXPECT_EQ(req.op, CTL_SET_DELAY);
+  EXPECT_EQ(req.delay_kind, DELAY_DELIVERY);
+  EXPECT_EQ(req.delay.dist, (uint32_t)DIST_EXP);
+  EXPECT_EQ(req.delay.a_us, 3000000u);
+
+  ASSERT_EQ(control_parse("resize belt 80.5", &req), 0);
+  EXPECT_EQ(req.op, CTL_RESIZE_BELT);
+  EXPECT_DOUBLE_EQ(req.weight, 80.5);
+
+  ASSERT_EQ(control_parse("resize truck 40 3.5", &req), 0);
+  EXPECT_EQ(req.op, CTL_RESIZE_TRUCK);
+  EXPECT_DOUBLE_EQ(req.weight, 40.0);
+  EXPECT_DOUBLE_EQ(req.volume, 3.5);
+
+  ASSERT_EQ(control_parse("stats", &req), 0);
+  EXPECT_EQ(req.op, CTL_STATS);
+  ASSERT_EQ(control_parse("shutdown", &req), 0);
+  EXPECT_EQ(req.op, CTL_SHUTDOWN);
+}
+
+TEST(ControlParseTest, RejectsInvalidLines) {
+  const char *bad[] = {"", "fly", "depart", "depart 0", "depart x", "depart 1 2",
+		       "express 1 -1", "express 1 1000", "set-rate", "set-rate -5",
+		       "resize", "resize belt 0", "resize truck 10", "resize dock 3",
+		       "stats now", "depart 1 2 3 4 5", "set-delay", "set-delay load",
+		       "set-delay warp 1s", "set-delay load fast"};
+  for (const char *line : bad) {
+    ControlRequest req;
+    EXPECT_EQ(control_parse(line, &req), -1) << line;
+    EXPECT_NE(req.error, nullptr) << line;
+  }
+}
+
+class ControlServerTest : public ::testing::Test {
+protected:
+  ControlServer srv;
+  std::string path;
+
+  void SetUp() override {
+    char tmpl[] = "/tmp/control_test_XXXXXX";
+    ASSERT_NE(mkdtemp(tmpl), nullptr);
+    path = std::string(tmpl) + "/ctl.sock";
+    ASSERT_EQ(control_open(&srv, path.c_str(), -1), 0);
+  }
+
+  void TearDown() override {
+    control_close(&srv);
+    EXPECT_NE(access(path.c_str(), F_OK), 0); // Socket file removed
+    rmdir(path.substr(0, path.rfind('/')).c_str());
+  }
+
+  int Connect() {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    EXPECT_EQ(connect(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+    return fd;
+  }
+
+  // Next line of any connection, polling until one arrives
+  std::string Next(ControlConn **from) {
+    char line[CONTROL_LINE_MAX];
+    for (int i = 0; i < 100; ++i) {
+      if (control_next(&srv, 10, NULL, from, line, sizeof(line)) == 1) return line;
+    }
+    return "<none>";
+  }
+
+  static std::string Read(int fd) {
+    char buf[1024];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    return n > 0 ? std::string(buf, n) : std::string();
+  }
+};
+
+TEST_F(ControlServerTest, PipelinedLinesAreAnsweredInOrder) {
+  int fd = Connect();
+  const char *cmds = "stats\ndepart 1\r\nexpr";
+  ASSERT_EQ(write(fd, cmds, strlen(cmds)), (ssize_t)strlen(cmds));
+
+  ControlConn *from;
+  EXPECT_EQ(Next(&from), "stats");
+  EXPECT_EQ(control_reply(from, "{\"n\":%d}", 1), 0);
+  EXPECT_EQ(Next(&from), "depart 1");
+  EXPECT_EQ(control_reply(from, "{\"n\":%d}", 2), 0);
+  EXPECT_EQ(Read(fd), "{\"n\":1}\n{\"n\":2}\n");
+
+  // Rest of a line arrives later
+  ASSERT_EQ(write(fd, "ess 1\n", 6), 6);
+  EXPECT_EQ(Next(&from), "express 1");
+  close(fd);
+}
+
+TEST_F(ControlServerTest, OverlongLineIsRejected) {
+  int fd = Connect();
+  std::string longline(CONTROL_LINE_MAX + 40, 'x');
+  longline += "\nstats\n";
+  ASSERT_EQ(write(fd, longline.data(), longline.size()), (ssize_t)longline.size());
+
+  ControlConn *from;
+  EXPECT_EQ(Next(&from), "stats");
+  EXPECT_EQ(Read(fd), "{\"ok\":false,\"error\":\"line too long\"}\n");
+  close(fd);
+}
+
+TEST_F(ControlServerTest, ClientsAreServedInTurn) {
+  int a = Connect(), b = Connect();
+  ASSERT_EQ(write(a, "stats\nstats\n", 12), 12);
+  ASSERT_EQ(write(b, "shutdown\n", 9), 9);
+
+  // Both clients connected before any line is handed out
+  ControlConn *first, *second, *third;
+  std::string l1 = Next(&first);
+  std::string l2 = Next(&second);
+  std::string l3 = Next(&third);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(l1 == "shutdown" || l2 == "shutdown", true);
+  EXPECT_EQ(l3, "stats");
+  close(a);
+  close(b);
+}
+
+TEST_F(ControlServerTest, ClosedClientFreesItsEntry) {
+  for (int i = 0; i < CONTROL_MAX_CLIENTS + 4; ++i) {
+    int fd = Connect();
+    ASSERT_EQ(write(fd, "stats\n", 6), 6);
+    ControlConn *from;
+    EXPECT_EQ(Next(&from), "stats");
+    close(fd);
+  }
+
+  // Closures are seen by the next waits
+  ControlConn *from;
+  char line[CONTROL_LINE_MAX];
+  for (int i = 0; i < 5; ++i) control_next(&srv, 1, NULL, &from, line, sizeof(line));
+  int open_conns = 0;
+  for (int i = 0; i < CONTROL_MAX_CLIENTS; ++i) open_conns += srv.conns[i].fd != -1;
+  EXPECT_EQ(open_conns, 0);
+}
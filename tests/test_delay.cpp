@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string>
+
+extern "C" {
+  #include "../src/common/common.h"
+  #include "../src/common/delay.h"
+}
+
+static std::string Format(const SimDelay &d) {
+  char buf[DELAY_TEXT_MAX];
+  delay_format(&d, buf, sizeof(buf));
+  return buf;
+}
+
+TEST(DelayTest, ParsesTimesWithUnits) {
+  SimDelay d;
+
+  ASSERT_EQ(delay_parse("250", &d), 0);
+  EXPECT_EQ(d.dist, (uint32_t)DIST_FIXED);
+  EXPECT_EQ(d.a_us, 250u);
+
+  ASSERT_EQ(delay_parse("1.5s", &d), 0);
+  EXPECT_EQ(d.a_us, 1500000u);
+
+  ASSERT_EQ(delay_parse("200ms-700ms", &d), 0);
+  EXPECT_EQ(d.dist, (uint32_t)DIST_UNIFORM);
+  EXPECT_EQ(d.a_us, 200000u);
+  EXPECT_EQ(d.b_us, 700000u);
+
+  ASSERT_EQ(delay_parse("exp:5s", &d), 0);
+  EXPECT_EQ(d.dist, (uint32_t)DIST_EXP);
+  EXPECT_EQ(d.a_us, 5000000u);
+
+  const char *bad[] = {"", "s", "5m", "5 s", "-5", "700-200", "exp:", "exp:-1s", "1-2-3", "2d", "100000s"};
+  for (const char *text : bad) EXPECT_EQ(delay_parse(text, &d), -1) << text;
+}
+
+TEST(DelayTest, FormatRoundTrips) {
+  const char *texts[] = {"250us", "100ms", "5s", "200ms-700ms", "exp:5s", "0us", "1500ms"};
+  for (const char *text : texts) {
+    SimDelay d;
+    ASSERT_EQ(delay_parse(text, &d), 0) << text;
+    EXPECT_EQ(Format(d), text);
+  }
+}
+
+TEST(DelayTest, OptionReplacesOneKind) {
+  SimDelay delays[DELAY_END];
+  delay_defaults(delays);
+  EXPECT_EQ(Format(delays[DELAY_WORK]), "200ms-700ms");
+  EXPECT_EQ(Format(delays[DELAY_DELIVERY]), "5s");
+
+  ASSERT_EQ(delay_parse_option("delivery=exp:2s", delays), 0);
+  EXPECT_EQ(Format(delays[DELAY_DELIVERY]), "exp:2s");
+  EXPECT_EQ(Format(delays[DELAY_RETURN]), "1s");
+
+  EXPECT_EQ(delay_parse_option("teleport=1s", delays), -1);
+  EXPECT_EQ(delay_parse_option("delivery", delays), -1);
+  EXPECT_EQ(delay_kind_of("load"), DELAY_LOAD);
+  EXPECT_STREQ(delay_kind_name(DELAY_OVERWEIGHT), "overweight");
+}
+
+TEST(DelayTest, DrawsFollowTheDistribution) {
+  srand(3);
+  SimDelay fixed = {DIST_FIXED, 0, 1234, 0};
+  SimDelay uniform = {DIST_UNIFORM, 0, 100, 200};
+  SimDelay exp = {DIST_EXP, 0, 1000, 0};
+
+  double sum = 0.0;
+  const int n = 20000;
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(delay_draw_us(&fixed), 1234u);
+    uint64_t u = delay_draw_us(&uniform);
+    EXPECT_GE(u, 100u);
+    EXPECT_LT(u, 200u);
+    sum += (double)delay_draw_us(&exp);
+  }
+  EXPECT_NEAR(sum / n, 1000.0, 50.0); // Mean of the exponential
+}
@@ -0,0 +1,41 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+  #include "../src/common/event_queue.h"
+}
+
+TEST(EventQueueTest, PopsEventsInTimeOrder) {
+  EventQueue q;
+  event_queue_init(&q, 2); // Forces heap growth
+
+  long long times[] = {50, 10, 40, 30, 20, 60, 0};
+  for (int i = 0; i < 7; ++i) event_queue_push(&q, times[i], 0, i, 0);
+
+  SimEvent ev;
+  long long last = -1;
+  int popped = 0;
+  while (event_queue_pop(&q, &ev)) {
+    EXPECT_GE(ev.time_us, last);
+    last = ev.time_us;
+    popped++;
+  }
+
+  EXPECT_EQ(popped, 7);
+  event_queue_free(&q);
+}
+
+TEST(EventQueueTest, EqualTimesKeepInsertionOrder) {
+  EventQueue q;
+  event_queue_init(&q, 4);
+
+  for (int i = 0; i < 10; ++i) event_queue_push(&q, 100, 0, i, 0);
+
+  SimEvent ev;
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(event_queue_pop(&q, &ev), 1);
+    EXPECT_EQ(ev.id, i);
+  }
+  EXPECT_EQ(event_queue_pop(&q, &ev), 0);
+
+  event_queue_free(&q);
+}
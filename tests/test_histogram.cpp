@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+extern "C" {
+  #include "../src/common/histogram.h"
+  #include "../src/common/stats.h"
+}
+
+TEST(HistogramTest, SmallValuesAreExact) {
+  for (uint64_t v = 0; v < HIST_SUB_BUCKETS * 2; ++v) {
+    EXPECT_EQ(hist_bucket_max(hist_bucket(v)), v);
+  }
+}
+
+TEST(HistogramTest, BucketBoundsCoverValueWithinPrecision) {
+  uint64_t values[] = {17, 100, 1000, 123456, 999999999, 1ull << 40, ~0ull};
+
+  for (uint64_t v : values) {
+    int b = hist_bucket(v);
+    ASSERT_GE(b, 0);
+    ASSERT_LT(b, HIST_BUCKETS);
+
+    uint64_t max = hist_bucket_max(b);
+    EXPECT_GE(max, v);
+    EXPECT_LE((double)(max - v), v / (double)HIST_SUB_BUCKETS);
+    if (b > 0) EXPECT_LT(hist_bucket_max(b - 1), v); // Previous bucket ends below the value
+  }
+}
+
+TEST(HistogramTest, Percentiles) {
+  static Histogram h;
+  memset(&h, 0, sizeof(h));
+
+  EXPECT_EQ(hist_percentile(&h, 50.0), 0u);
+
+  // 1..1000 us in ns
+  for (uint64_t i = 1; i <= 1000; ++i) hist_record(&h, i * 1000);
+
+  EXPECT_EQ(h.count, 1000u);
+  EXPECT_EQ(h.max, 1000000u);
+
+  uint64_t p50 = hist_percentile(&h, 50.0);
+  uint64_t p99 = hist_percentile(&h, 99.0);
+  EXPECT_GE(p50, 500000u);
+  EXPECT_LE(p50, 500000u + 500000u / HIST_SUB_BUCKETS);
+  EXPECT_GE(p99, 990000u);
+  EXPECT_LE(p99, 1000000u);
+  EXPECT_EQ(hist_percentile(&h, 100.0), 1000000u); // Never above the recorded max
+}
+
+TEST(HistogramTest, MergeAddsCountsAndKeepsMax) {
+  static Histogram a, b;
+  memset(&a, 0, sizeof(a));
+  memset(&b, 0, sizeof(b));
+
+  hist_record(&a, 10);
+  hist_record(&b, 20);
+  hist_record(&b, 5000);
+  hist_merge(&a, &b);
+
+  EXPECT_EQ(a.count, 3u);
+  EXPECT_EQ(a.max, 5000u);
+  EXPECT_EQ(hist_percentile(&a, 100.0), 5000u);
+}
+
+TEST(StatsLatencyTest, RecordsStagesPerPackageType) {
+  static SimStats stats;
+  memset(&stats, 0, sizeof(stats));
+
+  Package pkg = {};
+  pkg.type = PKG_B;
+  pkg.t_gen_ns = 1000;
+  pkg.t_belt_ns = 1010;
+  pkg.t_load_ns = 1100;
+
+  stats_record_load(&stats, &pkg);
+  stats_record_delivery(&stats, &pkg, 1105);
+
+  EXPECT_EQ(stats.latency_ns[LAT_GEN_TO_BELT][PKG_B].max, 10u);
+  EXPECT_EQ(stats.latency_ns[LAT_BELT_DWELL][PKG_B].max, 90u);
+  EXPECT_EQ(stats.latency_ns[LAT_LOAD_TO_DELIVERY][PKG_B].max, 5u);
+  EXPECT_EQ(stats.latency_ns[LAT_END_TO_END][PKG_B].max, 105u);
+  EXPECT_EQ(stats.latency_ns[LAT_BELT_DWELL][PKG_A].count, 0u);
+
+  static Histogram total;
+  stats_stage_total(&stats, LAT_END_TO_END, &total);
+  EXPECT_EQ(total.count, 1u);
+  EXPECT_EQ(total.max, 105u);
+}
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <string.h>
+
+extern "C" {
+  #include "../src/common/mailbox.h"
+}
+
+class MailboxTest : public ::testing::Test {
+protected:
+  Mailbox mb;
+
+  void SetUp() override {
+    memset(&mb, 0, sizeof(mb)); // Zeroed mailbox is empty
+  }
+};
+
+TEST_F(MailboxTest, EmptyMailboxHasNoCommand) {
+  Command cmd;
+  EXPECT_EQ(mailbox_take(&mb, &cmd), 0);
+}
+
+TEST_F(MailboxTest, CommandsKeepOrderAndArguments) {
+  EXPECT_EQ(mailbox_post(&mb, CMD_EXPRESS_LOAD, 2, 7), 1u);
+  EXPECT_EQ(mailbox_post(&mb, CMD_FORCE_DEPART, 1, 0), 2u);
+
+  Command cmd;
+  ASSERT_EQ(mailbox_take(&mb, &cmd), 1);
+  EXPECT_EQ(cmd.seq, 1u);
+  EXPECT_EQ(cmd.type, (uint32_t)CMD_EXPRESS_LOAD);
+  EXPECT_EQ(cmd.dock, 2);
+  EXPECT_EQ(cmd.count, 7);
+  EXPECT_GT(cmd.t_post_ns, 0u);
+  mailbox_done(&mb, &cmd);
+  EXPECT_EQ(mb.done, 1u);
+
+  ASSERT_EQ(mailbox_take(&mb, &cmd), 1);
+  EXPECT_EQ(cmd.seq, 2u);
+  EXPECT_EQ(cmd.type, (uint32_t)CMD_FORCE_DEPART);
+  EXPECT_EQ(mailbox_take(&mb, &cmd), 0);
+}
+
+TEST_F(MailboxTest, FullMailboxRejectsPost) {
+  for (int i = 0; i < MAILBOX_SLOTS; ++i) {
+    ASSERT_EQ(mailbox_post(&mb, CMD_EXPRESS_LOAD, 0, i), (uint64_t)i + 1);
+  }
+  EXPECT_EQ(mailbox_post(&mb, CMD_EXPRESS_LOAD, 0, 0), 0u);
+  EXPECT_EQ(mb.full, 1u);
+
+  // A taken command frees its slot for the next lap
+  Command cmd;
+  ASSERT_EQ(mailbox_take(&mb, &cmd), 1);
+  EXPECT_EQ(mailbox_post(&mb, CMD_EXPRESS_LOAD, 0, 99), (uint64_t)MAILBOX_SLOTS + 1);
+}
+
+TEST_F(MailboxTest, WrapsAroundManyLaps) {
+  Command cmd;
+  for (int i = 0; i < MAILBOX_SLOTS * 5 + 3; ++i) {
+    ASSERT_EQ(mailbox_post(&mb, CMD_FORCE_DEPART, 0, i), (uint64_t)i + 1);
+    ASSERT_EQ(mailbox_take(&mb, &cmd), 1);
+    EXPECT_EQ(cmd.count, i);
+  }
+  EXPECT_EQ(mailbox_take(&mb, &cmd), 0);
+}
+
+static void *post_commands(void *arg) {
+  Mailbox *mb = (Mailbox *)arg;
+  for (int i = 0; i < 1000; ++i) {
+    while (mailbox_post(mb, CMD_EXPRESS_LOAD, 0, 1) == 0) sched_yield(); // Full, receiver catches up
+  }
+  return NULL;
+}
+
+TEST_F(MailboxTest, ConcurrentSendersLoseNothing) {
+  pthread_t senders[4];
+  for (pthread_t &t : senders) pthread_create(&t, NULL, post_commands, &mb);
+
+  // Receiver sleeps on the doorbell whenever the mailbox is empty
+  uint64_t taken = 0, last_seq = 0;
+  while (taken < 4000) {
+    unsigned int bell = mailbox_doorbell(&mb);
+    Command cmd;
+    if (!mailbox_take(&mb, &cmd)) {
+      mailbox_wait(&mb, bell);
+      continue;
+    }
+    EXPECT_EQ(cmd.seq, last_seq + 1);
+    last_seq = cmd.seq;
+    ++taken;
+  }
+
+  for (pthread_t &t : senders) pthread_join(t, NULL);
+  EXPECT_EQ(taken, 4000u);
+}
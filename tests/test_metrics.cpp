@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+extern "C" {
+  #include "../src/common/metrics.h"
+}
+
+class MetricsTest : public ::testing::Test {
+protected:
+  MetricsBlock *m;
+
+  void SetUp() override {
+    m = (MetricsBlock *)aligned_alloc(CACHE_LINE_SIZE, metrics_segment_size(3));
+    ASSERT_NE(m, nullptr);
+    metrics_init(m, 3, 2, 4);
+  }
+
+  void TearDown() override {
+    free(m);
+  }
+
+  std::string Export(const SharedState *shm = nullptr) {
+    FILE *f = tmpfile();
+    metrics_write_prometheus(f, m, shm);
+    long size = ftell(f);
+    rewind(f);
+    std::string text(size, '\0');
+    EXPECT_EQ(fread(&text[0], 1, size, f), (size_t)size);
+    fclose(f);
+    return text;
+  }
+};
+
+TEST_F(MetricsTest, EntriesStartOnOwnCacheLine) {
+  EXPECT_EQ(sizeof(WorkerMetrics) % CACHE_LINE_SIZE, 0u);
+  EXPECT_EQ(sizeof(TruckMetrics) % CACHE_LINE_SIZE, 0u);
+  EXPECT_EQ(sizeof(DockMetrics) % CACHE_LINE_SIZE, 0u);
+
+  for (int t = 1; t <= 3; ++t) {
+    EXPECT_EQ((uintptr_t)metrics_truck(m, t) % CACHE_LINE_SIZE, 0u);
+  }
+  EXPECT_EQ((uintptr_t)metrics_worker(m, 2) % CACHE_LINE_SIZE, 0u);
+  EXPECT_EQ((uintptr_t)metrics_dock(m, 1) % CACHE_LINE_SIZE, 0u);
+}
+
+TEST_F(MetricsTest, ScratchEntriesWhenOffOrOutOfRange) {
+  WorkerMetrics *scratch = metrics_worker(nullptr, 1);
+  ASSERT_NE(scratch, nullptr);
+  metrics_add(&scratch->pushed, 5); // Must not crash or land in the segment
+
+  EXPECT_NE(metrics_truck(m, 4), &m->truck[0]);
+  EXPECT_EQ(metrics_truck(m, 1), &m->truck[0]);
+  EXPECT_EQ(m->workers[0].pushed, 0u);
+}
+
+TEST_F(MetricsTest, ExportsCountersInPrometheusFormat) {
+  metrics_add(&metrics_worker(m, 2)->pushed, 7);
+  metrics_add(&metrics_worker(m, 1)->push_wait_ns, 1500000000);
+  metrics_add(&metrics_truck(m, 3)->deliveries, 4);
+  metrics_add(&metrics_dock(m, 1)->express_loaded, 2);
+
+  std::string text = Export();
+
+  EXPECT_NE(text.find("# TYPE warehouse_worker_packages_pushed_total counter\n"), std::string::npos);
+  EXPECT_NE(text.find("warehouse_worker_packages_pushed_total{worker=\"P2\"} 7\n"), std::string::npos);
+  EXPECT_NE(text.find("warehouse_worker_push_wait_seconds_total{worker=\"P1\"} 1.500000000\n"), std::string::npos);
+  EXPECT_NE(text.find("warehouse_truck_deliveries_total{truck=\"3\"} 4\n"), std::string::npos);
+  EXPECT_NE(text.find("warehouse_dock_express_loaded_total{dock=\"2\"} 2\n"), std::string::npos);
+  EXPECT_EQ(text.find("{dock=\"3\"}"), std::string::npos); // Only D docks are exported
+  EXPECT_EQ(text.find("{worker=\"P5\"}"), std::string::npos); // Only workers in use are exported
+  EXPECT_EQ(text.find("warehouse_belt_packages"), std::string::npos); // No gauges without the main segment
+}
+
+TEST_F(MetricsTest, ExportsBeltGauges) {
+  static SharedState shm;
+  memset(&shm, 0, sizeof(shm));
+  shm.current_count = 3;
+  shm.max_items_K = 10;
+  shm.current_belt_weight = 12500;
+  shm.belt_lanes = 2;
+  shm.lanes[1].count = 3;
+  shm.docks[0].truck_docked = 1;
+
+  std::string text = Export(&shm);
+
+  EXPECT_NE(text.find("warehouse_belt_packages 3\n"), std::string::npos);
+  EXPECT_NE(text.find("warehouse_belt_weight_kg 12.500\n"), std::string::npos);
+  EXPECT_NE(text.find("warehouse_belt_lane_packages{lane=\"1\"} 0\n"), std::string::npos);
+  EXPECT_NE(text.find("warehouse_belt_lane_packages{lane=\"2\"} 3\n"), std::string::npos);
+  EXPECT_NE(text.find("warehouse_dock_occupied{dock=\"1\"} 1\n"), std::string::npos);
+}
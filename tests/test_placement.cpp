@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+  #include "../src/common/placement.h"
+}
+
+static std::string Format(const CpuMask &m) {
+  char buf[CPU_MASK_TEXT_MAX];
+  cpu_mask_format(&m, buf, sizeof(buf));
+  return buf;
+}
+
+static CpuMask Mask(const char *text) {
+  CpuMask m;
+  EXPECT_EQ(cpu_mask_parse(text, &m), 0) << text;
+  return m;
+}
+
+TEST(PlacementTest, CpuListsRoundTrip) {
+  CpuMask m = Mask("0-3,8,10-11");
+  EXPECT_EQ(cpu_mask_count(&m), 7);
+  EXPECT_EQ(cpu_mask_first(&m), 0);
+  EXPECT_TRUE(cpu_mask_isset(&m, 8));
+  EXPECT_FALSE(cpu_mask_isset(&m, 9));
+  EXPECT_EQ(Format(m), "0-3,8,10-11");
+
+  EXPECT_EQ(Format(Mask("1023")), "1023");
+  EXPECT_EQ(Format(Mask("5\n")), "5"); // As read from sysfs
+
+  CpuMask empty;
+  cpu_mask_zero(&empty);
+  EXPECT_EQ(Format(empty), "-");
+  EXPECT_EQ(cpu_mask_first(&empty), -1);
+}
+
+TEST(PlacementTest, RejectsInvalidCpuLists) {
+  CpuMask m;
+  const char *bad[] = {"", "a", "3-1", "1,", "1024", "0-1024", "-1", "1;2"};
+  for (const char *text : bad) EXPECT_EQ(cpu_mask_parse(text, &m), -1) << text;
+}
+
+TEST(PlacementTest, ParsesOptions) {
+  Placement p;
+  placement_init(&p);
+  EXPECT_EQ(p.layout, PLACE_NONE);
+  EXPECT_EQ(p.mem_node, -1);
+
+  EXPECT_EQ(placement_parse_option("trucks=4-7", &p), 0);
+  EXPECT_EQ(p.layout, PLACE_MANUAL);
+  EXPECT_EQ(Format(p.cpus[PIN_TRUCKS]), "4-7");
+
+  EXPECT_EQ(placement_parse_option("spread", &p), 0);
+  EXPECT_EQ(p.layout, PLACE_SPREAD);
+  EXPECT_EQ(placement_parse_option("mem=1", &p), 0);
+  EXPECT_EQ(p.mem_node, 1);
+  EXPECT_EQ(p.layout, PLACE_SPREAD); // A set given later keeps the layout
+
+  const char *bad[] = {"l4", "cpus=0", "workers=", "workers", "mem=-1", "mem=63", "mem=x"};
+  for (const char *text : bad) EXPECT_EQ(placement_parse_option(text, &p), -1) << text;
+}
+
+/**
+ * Fake sysfs CPU tree: two L3 domains of four CPUs on two nodes.
+ */
+class PlacementTopologyTest : public ::testing::Test {
+protected:
+  char root[64];
+
+  void Write(const std::string &path, const char *text) {
+    FILE *f = fopen((std::string(root) + "/" + path).c_str(), "w");
+    ASSERT_NE(f, nullptr) << path;
+    fputs(text, f);
+    fclose(f);
+  }
+
+  void Dir(const std::string &path) {
+    mkdir((std::string(root) + "/" + path).c_str(), 0700);
+  }
+
+  void SetUp() override {
+    snprintf(root, sizeof(root), "/tmp/placement_test_XXXXXX");
+    ASSERT_NE(mkdtemp(root), nullptr);
+
+    Write("online", "0-7\n");
+    for (int c = 0; c < 8; ++c) {
+      std::string cpu = "cpu" + std::to_string(c);
+      Dir(cpu);
+      Dir(cpu + "/node" + std::to_string(c / 4));
+      Dir(cpu + "/cache");
+      const char *levels[] = {"1", "1", "2", "3"};
+      for (int i = 0; i < 4; ++i) {
+	std::string index = cpu + "/cache/index" + std::to_string(i);
+	Dir(index);
+	Write(index + "/level", levels[i]);
+	Write(index + "/shared_cpu_list", i < 3 ? std::to_string(c).c_str() : (c < 4 ? "0-3\n" : "4-7\n"));
+      }
+    }
+  }
+
+  void TearDown() override {
+    std::string cmd = std::string("rm -rf ") + root;
+    ASSERT_EQ(system(cmd.c_str()), 0);
+  }
+
+  CpuMask All() { return Mask("0-1023"); }
+};
+
+TEST_F(PlacementTopologyTest, SharedL3SplitsOneDomain) {
+  Placement p;
+  placement_init(&p);
+  ASSERT_EQ(placement_parse_option("l3", &p), 0);
+
+  CpuMask all = All();
+  ASSERT_EQ(placement_resolve(&p, root, &all), 0);
+  EXPECT_EQ(p.l3_domains, 2);
+  EXPECT_EQ(Format(p.cpus[PIN_DISPATCHER]), "0-3");
+  EXPECT_EQ(Format(p.cpus[PIN_WORKERS]), "0-1");
+  EXPECT_EQ(Format(p.cpus[PIN_EXPRESS]), "0-1");
+  EXPECT_EQ(Format(p.cpus[PIN_TRUCKS]), "2-3");
+  EXPECT_EQ(p.mem_node, 0);
+}
+
+TEST_F(PlacementTopologyTest, SpreadPutsTrucksOnTheNextDomain) {
+  Placement p;
+  placement_init(&p);
+  ASSERT_EQ(placement_parse_option("spread", &p), 0);
+  ASSERT_EQ(placement_parse_option("workers=5", &p), 0); // Given by hand, wins
+
+  CpuMask all = All();
+  ASSERT_EQ(placement_resolve(&p, root, &all), 0);
+  EXPECT_EQ(Format(p.cpus[PIN_WORKERS]), "5");
+  EXPECT_EQ(Format(p.cpus[PIN_EXPRESS]), "0-3");
+  EXPECT_EQ(Format(p.cpus[PIN_TRUCKS]), "4-7");
+  EXPECT_EQ(p.mem_node, 1); // Node of the producers
+}
+
+TEST_F(PlacementTopologyTest, SetsAreCutToAllowedCpus) {
+  Placement p;
+  placement_init(&p);
+  ASSERT_EQ(placement_parse_option("l3", &p), 0);
+  ASSERT_EQ(placement_parse_option("mem=0", &p), 0);
+
+  // A run started with taskset -c 5-7 sees one partial domain
+  CpuMask allowed = Mask("5-7");
+  ASSERT_EQ(placement_resolve(&p, root, &allowed), 0);
+  EXPECT_EQ(p.l3_domains, 1);
+  EXPECT_EQ(Format(p.cpus[PIN_WORKERS]), "5-6");
+  EXPECT_EQ(Format(p.cpus[PIN_TRUCKS]), "7");
+  EXPECT_EQ(p.mem_node, 0); // Given by hand
+
+  Placement q;
+  placement_init(&q);
+  ASSERT_EQ(placement_parse_option("trucks=0-1", &q), 0);
+  EXPECT_EQ(placement_resolve(&q, root, &allowed), -1);
+  EXPECT_EQ(cpu_node_of(root, 6), 1);
+}
+
+TEST_F(PlacementTopologyTest, MissingCacheInformationIsOneDomain) {
+  std::string cmd = std::string("rm -rf ") + root + "/cpu*/cache";
+  ASSERT_EQ(system(cmd.c_str()), 0);
+
+  Placement p;
+  placement_init(&p);
+  ASSERT_EQ(placement_parse_option("spread", &p), 0);
+  CpuMask all = All();
+  ASSERT_EQ(placement_resolve(&p, root, &all), 0);
+  EXPECT_EQ(p.l3_domains, 1);
+  EXPECT_EQ(Format(p.cpus[PIN_WORKERS]), "0-3");
+  EXPECT_EQ(Format(p.cpus[PIN_TRUCKS]), "4-7");
+}
+
+TEST(PlacementTest, PinsToAnAllowedCpu) {
+  CpuMask allowed;
+  ASSERT_EQ(placement_allowed(&allowed), 0);
+  ASSERT_GT(cpu_mask_count(&allowed), 0);
+
+  CpuMask one;
+  cpu_mask_zero(&one);
+  cpu_mask_set(&one, cpu_mask_first(&allowed));
+  EXPECT_EQ(placement_pin(&one), 0);
+
+  CpuMask now;
+  ASSERT_EQ(placement_allowed(&now), 0);
+  EXPECT_EQ(Format(now), Format(one));
+  EXPECT_EQ(placement_pin(&allowed), 0);
+}
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <time.h>
+
+extern "C" {
+  #include "../src/common/common.h"
+  #include "../src/common/sem_wrapper.h"
+}
+
+class PrivateSemTest : public ::testing::Test {
+protected:
+  int semid;
+
+  void SetUp() override {
+    semid = sem_create_private(SEM_NUM);
+    ASSERT_LT(semid, 0) << "Private sets must have negative ids";
+  }
+
+  void TearDown() override {
+    sem_set(semid, 0, IPC_RMID, 0);
+  }
+};
+
+struct Waiter {
+  int semid;
+  int op;
+  volatile int done;
+};
+
+static void *take(void *arg) {
+  Waiter *w = (Waiter *)arg;
+  sem_count_op(w->semid, SEM_EMPTY, w->op);
+  __atomic_store_n(&w->done, 1, __ATOMIC_SEQ_CST);
+  return NULL;
+}
+
+static void sleep_ms(long ms) {
+  struct timespec ts = {0, ms * 1000000L};
+  nanosleep(&ts, NULL);
+}
+
+TEST_F(PrivateSemTest, StartsAtZeroAndSetsValues) {
+  for (int i = 0; i < SEM_NUM; ++i) EXPECT_EQ(sem_get(semid, i), 0);
+
+  sem_set(semid, SEM_MUTEX, SETVAL, 1);
+  sem_set(semid, SEM_DOCK, SETVAL, 4);
+
+  EXPECT_EQ(sem_get(semid, SEM_MUTEX), 1);
+  EXPECT_EQ(sem_get(semid, SEM_DOCK), 4);
+  EXPECT_EQ(sem_get(semid, SEM_FULL), 0);
+}
+
+TEST_F(PrivateSemTest, PAndVChangeValue) {
+  sem_set(semid, SEM_MUTEX, SETVAL, 1);
+
+  SEM_P(semid, SEM_MUTEX);
+  EXPECT_EQ(sem_get(semid, SEM_MUTEX), 0);
+  SEM_V(semid, SEM_MUTEX);
+  EXPECT_EQ(sem_get(semid, SEM_MUTEX), 1);
+
+  sem_count_op(semid, SEM_FULL, 5);
+  sem_count_op(semid, SEM_FULL, -3);
+  EXPECT_EQ(sem_get(semid, SEM_FULL), 2);
+}
+
+TEST_F(PrivateSemTest, TryNeverBlocks) {
+  sem_set(semid, SEM_FULL, SETVAL, 2);
+
+  EXPECT_EQ(sem_count_try(semid, SEM_FULL, -3), 0);
+  EXPECT_EQ(sem_get(semid, SEM_FULL), 2) << "Failed try must not change the value";
+
+  EXPECT_EQ(sem_count_try(semid, SEM_FULL, -2), 1);
+  EXPECT_EQ(sem_get(semid, SEM_FULL), 0);
+}
+
+TEST_F(PrivateSemTest, WaiterBlocksUntilWholeAmountIsAvailable) {
+  Waiter w = {semid, -3, 0};
+  pthread_t t;
+  ASSERT_EQ(pthread_create(&t, NULL, take, &w), 0);
+
+  sem_count_op(semid, SEM_EMPTY, 2);
+  sleep_ms(50);
+  EXPECT_EQ(__atomic_load_n(&w.done, __ATOMIC_SEQ_CST), 0) << "2 units must not satisfy a batch of 3";
+
+  sem_count_op(semid, SEM_EMPTY, 1);
+  pthread_join(t, NULL);
+
+  EXPECT_EQ(w.done, 1);
+  EXPECT_EQ(sem_get(semid, SEM_EMPTY), 0);
+}
+
+TEST_F(PrivateSemTest, SingleReleaseWakesEverySatisfiedWaiter) {
+  Waiter w[3] = {{semid, -1, 0}, {semid, -1, 0}, {semid, -1, 0}};
+  pthread_t t[3];
+  for (int i = 0; i < 3; ++i) ASSERT_EQ(pthread_create(&t[i], NULL, take, &w[i]), 0);
+
+  sleep_ms(20);
+  sem_count_op(semid, SEM_EMPTY, 3);
+  for (int i = 0; i < 3; ++i) pthread_join(t[i], NULL);
+
+  EXPECT_EQ(sem_get(semid, SEM_EMPTY), 0);
+}
+
+TEST(PrivateSemSets, IdsAreReusedAfterRemoval) {
+  int a = sem_create_private(SEM_NUM);
+  int b = sem_create_private(SEM_NUM);
+  EXPECT_NE(a, b);
+
+  sem_set(a, 0, IPC_RMID, 0);
+  int c = sem_create_private(SEM_NUM);
+  EXPECT_EQ(c, a);
+
+  sem_set(b, 0, IPC_RMID, 0);
+  sem_set(c, 0, IPC_RMID, 0);
+}
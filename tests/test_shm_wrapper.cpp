@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/shm.h>
+
+extern "C" {
+  #include "../src/common/common.h"
+  #include "../src/common/shm_wrapper.h"
+}
+
+// Own key, the simulation may be running next to the tests
+#define TEST_KEY_ID 72
+
+TEST(ShmWrapperTest, CreateGrantsOnlyRequestedOptions) {
+  size_t size = 3 * 4096 + 100;
+  int granted = -1;
+  char *block = (char *)create_memory_block(KEY_PATH, TEST_KEY_ID, size, 0, &granted);
+  EXPECT_EQ(granted, 0);
+  memset(block, 0x5a, size);
+  detach_memory_block(block);
+  destroy_memory_block(KEY_PATH, TEST_KEY_ID);
+}
+
+TEST(ShmWrapperTest, HugeAndLockedBlockFallsBackAndStaysUsable) {
+  size_t size = 3 * 4096 + 100;
+  int granted = -1;
+  char *block = (char *)create_memory_block(KEY_PATH, TEST_KEY_ID, size, SHM_BLOCK_HUGE|SHM_BLOCK_LOCK, &granted);
+  EXPECT_EQ(granted & ~(SHM_BLOCK_HUGE|SHM_BLOCK_LOCK), 0);
+
+  // Same segment seen through a second attach, whatever pages back it
+  memset(block, 0x5a, size);
+  char *again = (char *)attach_memory_block(KEY_PATH, TEST_KEY_ID, size);
+  EXPECT_EQ(again[0], 0x5a);
+  EXPECT_EQ(again[size - 1], 0x5a);
+
+  detach_memory_block(again);
+  detach_memory_block(block);
+  destroy_memory_block(KEY_PATH, TEST_KEY_ID);
+}
+
+// A normal page segment left by an earlier run must not pass for a huge page one
+TEST(ShmWrapperTest, HugeBlockReplacesStaleSegment) {
+  size_t size = huge_page_size();
+  key_t key = ftok(KEY_PATH, TEST_KEY_ID);
+  int stale = shmget(key, size, 0600|IPC_CREAT);
+  ASSERT_NE(stale, -1);
+
+  int granted = -1;
+  char *block = (char *)create_memory_block(KEY_PATH, TEST_KEY_ID, size, SHM_BLOCK_HUGE, &granted);
+  int current = shmget(key, 0, 0600);
+  EXPECT_NE(current, stale);
+
+  struct shmid_ds ds;
+  EXPECT_EQ(shmctl(stale, IPC_STAT, &ds), -1); // Removed
+  ASSERT_EQ(shmctl(current, IPC_STAT, &ds), 0);
+  EXPECT_GE(ds.shm_segsz, size);
+
+  detach_memory_block(block);
+  destroy_memory_block(KEY_PATH, TEST_KEY_ID);
+}
+
+TEST(ShmWrapperTest, PrivateBlockIsZeroedAndAligned) {
+  size_t size = 5 * 4096;
+  int granted = -1;
+  char *block = (char *)alloc_memory_block(size, SHM_BLOCK_HUGE|SHM_BLOCK_LOCK, &granted);
+  EXPECT_EQ(granted & ~(SHM_BLOCK_HUGE|SHM_BLOCK_LOCK), 0);
+  EXPECT_EQ((uintptr_t)block % huge_page_size(), 0u);
+  for (size_t i = 0; i < size; ++i) ASSERT_EQ(block[i], 0) << i;
+  if (granted & SHM_BLOCK_LOCK) munlock(block, size);
+  free(block);
+
+  block = (char *)alloc_memory_block(size, 0, &granted);
+  EXPECT_EQ(granted, 0);
+  EXPECT_EQ((uintptr_t)block % CACHE_LINE_SIZE, 0u);
+  free(block);
+}
+
+TEST(ShmWrapperTest, HugePageSizeIsAPowerOfTwo) {
+  size_t page = huge_page_size();
+  EXPECT_GE(page, 4096u);
+  EXPECT_EQ(page & (page - 1), 0u);
+}
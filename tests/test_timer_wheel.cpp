@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+  #include "../src/common/timer_wheel.h"
+}
+
+static std::vector<uint64_t> Deadlines(TimerNode *list) {
+  std::vector<uint64_t> out;
+  for (TimerNode *t = list; t; t = t->next) out.push_back(t->deadline_ns);
+  return out;
+}
+
+TEST(TimerWheelTest, ExpiresDueTimersInTickOrder) {
+  TimerWheel w;
+  timer_wheel_init(&w, 1000, 10);
+
+  TimerNode t[4];
+  timer_wheel_add(&w, &t[0], 1300);
+  timer_wheel_add(&w, &t[1], 1050);
+  timer_wheel_add(&w, &t[2], 1120);
+  timer_wheel_add(&w, &t[3], 2000);
+  EXPECT_EQ(w.pending, 4);
+
+  EXPECT_EQ(timer_wheel_expire(&w, 1049), nullptr);
+  EXPECT_EQ(Deadlines(timer_wheel_expire(&w, 1305)), (std::vector<uint64_t>{1050, 1120, 1300}));
+  EXPECT_EQ(t[1].prev, nullptr); // Idle again
+  EXPECT_EQ(w.pending, 1);
+
+  EXPECT_EQ(Deadlines(timer_wheel_expire(&w, 5000)), (std::vector<uint64_t>{2000}));
+  EXPECT_EQ(w.pending, 0);
+}
+
+TEST(TimerWheelTest, FarDeadlinesCascadeDownInTime) {
+  TimerWheel w;
+  timer_wheel_init(&w, 0, 1);
+
+  // One timer per level and one beyond the span of the wheel
+  uint64_t deadlines[] = {40, 3000, 200000, 10000000, 50000000};
+  TimerNode t[5];
+  for (int i = 0; i < 5; ++i) timer_wheel_add(&w, &t[i], deadlines[i]);
+  for (int l = 0; l < TIMER_WHEEL_LEVELS; ++l) EXPECT_NE(w.occupied[l], 0u) << l;
+
+  for (uint64_t d : deadlines) {
+    EXPECT_LE(timer_wheel_next_ns(&w), d);
+    EXPECT_EQ(timer_wheel_expire(&w, d - 1), nullptr) << d;
+    EXPECT_EQ(Deadlines(timer_wheel_expire(&w, d)), (std::vector<uint64_t>{d}));
+  }
+  EXPECT_EQ(w.pending, 0);
+  EXPECT_EQ(timer_wheel_next_ns(&w), UINT64_MAX);
+}
+
+TEST(TimerWheelTest, CancelAndOverdueDeadlines) {
+  TimerWheel w;
+  timer_wheel_init(&w, 100, 1);
+
+  TimerNode a, b, far, late;
+  timer_wheel_add(&w, &a, 110);
+  timer_wheel_add(&w, &b, 110);
+  timer_wheel_add(&w, &far, 100000);
+  timer_wheel_cancel(&w, &a);
+  timer_wheel_cancel(&w, &a); // Idle, nothing happens
+  timer_wheel_cancel(&w, &far);
+  EXPECT_EQ(w.pending, 1);
+  EXPECT_EQ(w.occupied[2], 0u); // Emptied slot is no longer marked
+
+  timer_wheel_add(&w, &late, 50); // In the past, due at once
+  EXPECT_EQ(timer_wheel_next_ns(&w), 100u);
+  EXPECT_EQ(Deadlines(timer_wheel_expire(&w, 100)), (std::vector<uint64_t>{50}));
+
+  timer_wheel_cancel(&w, &b);
+  EXPECT_EQ(w.pending, 0);
+  EXPECT_EQ(timer_wheel_expire(&w, 200000), nullptr);
+}
+
+TEST(TimerWheelTest, NextDeadlineBoundsSleep) {
+  TimerWheel w;
+  timer_wheel_init(&w, 0, 1000);
+  EXPECT_EQ(timer_wheel_next_ns(&w), UINT64_MAX);
+
+  // Level 0 wraps into its next turn
+  timer_wheel_expire(&w, 60 * 1000);
+  TimerNode t, u;
+  timer_wheel_add(&w, &t, 100 * 1000 + 10);
+  EXPECT_EQ(timer_wheel_next_ns(&w), 100u * 1000);
+
+  timer_wheel_add(&w, &u, 80 * 1000);
+  EXPECT_EQ(timer_wheel_next_ns(&w), 80u * 1000);
+
+  // A higher level reports its cascade, early but never late
+  timer_wheel_cancel(&w, &u);
+  timer_wheel_add(&w, &u, 5000 * 1000);
+  timer_wheel_cancel(&w, &t);
+  EXPECT_EQ(timer_wheel_next_ns(&w), 4096u * 1000); // Level 2
+  EXPECT_EQ(timer_wheel_expire(&w, 4096 * 1000), nullptr);
+  EXPECT_EQ(timer_wheel_next_ns(&w), 4992u * 1000); // Level 1
+  EXPECT_EQ(timer_wheel_expire(&w, 4992 * 1000), nullptr);
+  EXPECT_EQ(timer_wheel_next_ns(&w), 5000u * 1000);
+}
+
+TEST(TimerWheelTest, MatchesSortedReference) {
+  TimerWheel w;
+  timer_wheel_init(&w, 0, 1);
+  srand(7);
+
+  const int count = 2000;
+  std::vector<TimerNode> timers(count);
+  std::vector<uint64_t> due; // Deadlines still scheduled
+  uint64_t now = 0;
+
+  for (int i = 0; i < count; ++i) {
+    // Mix of near and far deadlines, some added while time moves on
+    uint64_t span = (uint64_t)1 << (rand() % 22);
+    uint64_t deadline = now + (uint64_t)rand() % span;
+    timer_wheel_add(&w, &timers[i], deadline);
+    due.push_back(deadline);
+
+    if (i % 10 == 9) {
+      now += (uint64_t)rand() % 50000;
+      std::vector<uint64_t> got = Deadlines(timer_wheel_expire(&w, now));
+      std::vector<uint64_t> want;
+      for (uint64_t d : due) if (d <= now) want.push_back(d);
+      due.erase(std::remove_if(due.begin(), due.end(), [&](uint64_t d) { return d <= now; }), due.end());
+
+      // Overdue timers share the first tick with the ones due then
+      std::sort(got.begin(), got.end());
+      std::sort(want.begin(), want.end());
+      ASSERT_EQ(got, want) << "at " << now;
+      if (!due.empty()) EXPECT_LE(timer_wheel_next_ns(&w), *std::min_element(due.begin(), due.end()));
+    }
+  }
+  EXPECT_EQ(w.pending, (long)due.size());
+}
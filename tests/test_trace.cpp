@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string>
+
+extern "C" {
+  #include "../src/common/trace.h"
+}
+
+class TraceTest : public ::testing::Test {
+protected:
+  TraceHeader *hdr;
+
+  void SetUp() override {
+    // 2 trucks, 4 events per ring to force wrap-around
+    hdr = (TraceHeader *)malloc(trace_segment_size(trace_ring_count(3, 2), 4));
+    ASSERT_NE(hdr, nullptr);
+    trace_init(hdr, trace_ring_count(3, 2), 4, 3);
+  }
+
+  void TearDown() override {
+    free(hdr);
+  }
+
+  std::string ExportJson() {
+    char *buf = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&buf, &size);
+    trace_export_json(out, hdr);
+    fclose(out);
+    std::string json(buf, size);
+    free(buf);
+    return json;
+  }
+};
+
+TEST_F(TraceTest, RingsAreAssignedByRole) {
+  EXPECT_EQ(trace_claim(hdr, TRACE_ROLE_DISPATCHER, 0), trace_ring(hdr, 0));
+  EXPECT_EQ(trace_claim(hdr, TRACE_ROLE_WORKER, 2), trace_ring(hdr, 2));
+  EXPECT_EQ(trace_claim(hdr, TRACE_ROLE_EXPRESS, 4), trace_ring(hdr, 4));
+  EXPECT_EQ(trace_claim(hdr, TRACE_ROLE_TRUCK, 2), trace_ring(hdr, 6));
+  EXPECT_EQ(trace_claim(hdr, TRACE_ROLE_TRUCK, 3), nullptr); // Only 2 trucks
+}
+
+TEST(TraceLayoutTest, TruckRingsFollowAllWorkers) {
+  // 6 standard workers (--workers=2), express worker is P7
+  int rings = trace_ring_count(6, 2);
+  EXPECT_EQ(rings, 10);
+
+  TraceHeader *hdr = (TraceHeader *)malloc(trace_segment_size(rings, 4));
+  ASSERT_NE(hdr, nullptr);
+  trace_init(hdr, rings, 4, 6);
+
+  EXPECT_EQ(trace_claim(hdr, TRACE_ROLE_WORKER, 6), trace_ring(hdr, 6));
+  EXPECT_EQ(trace_claim(hdr, TRACE_ROLE_EXPRESS, 7), trace_ring(hdr, 7));
+  EXPECT_EQ(trace_claim(hdr, TRACE_ROLE_TRUCK, 1), trace_ring(hdr, 8));
+  EXPECT_EQ(trace_claim(hdr, TRACE_ROLE_TRUCK, 2), trace_ring(hdr, 9));
+  free(hdr);
+}
+
+TEST_F(TraceTest, RecordsEventsWithDuration) {
+  TraceRing *ring = trace_claim(hdr, TRACE_ROLE_TRUCK, 1);
+
+  uint64_t start = trace_now();
+  trace_event(ring, TRACE_POP, start, 3);
+  trace_event(ring, TRACE_FORCE_DEPART, 0, 1);
+
+  ASSERT_EQ(ring->head, 2u);
+  EXPECT_EQ(ring->events[0].type, TRACE_POP);
+  EXPECT_EQ(ring->events[0].role, TRACE_ROLE_TRUCK);
+  EXPECT_EQ(ring->events[0].actor, 1);
+  EXPECT_EQ(ring->events[0].payload, 3u);
+  EXPECT_EQ(ring->events[0].ts_ns, start);
+  EXPECT_GE(ring->events[0].ts_ns, hdr->t0_ns);
+  EXPECT_EQ(ring->events[1].dur_ns, 0u); // Instant event
+
+  trace_event(NULL, TRACE_PUSH, 0, 1); // Tracing off, nothing happens
+}
+
+TEST_F(TraceTest, FullRingKeepsNewestEvents) {
+  TraceRing *ring = trace_claim(hdr, TRACE_ROLE_WORKER, 1);
+
+  for (uint32_t i = 0; i < 10; ++i) trace_event(ring, TRACE_PUSH, 0, i);
+
+  EXPECT_EQ(ring->head, 10u);
+  std::string json = ExportJson();
+
+  // Events 6..9 survived, older ones were overwritten
+  EXPECT_EQ(json.find("\"packages\":5}"), std::string::npos);
+  for (int i = 6; i < 10; ++i) {
+    EXPECT_NE(json.find("\"packages\":" + std::to_string(i) + "}"), std::string::npos);
+  }
+}
+
+TEST_F(TraceTest, ExportDrawsDockOccupancy) {
+  TraceRing *ring = trace_claim(hdr, TRACE_ROLE_TRUCK, 2);
+
+  uint64_t docked = trace_now();
+  trace_event(ring, TRACE_DOCK, 0, 1);
+  trace_event(ring, TRACE_UNDOCK, docked, 1);
+
+  std::string json = ExportJson();
+  EXPECT_NE(json.find("\"traceEvents\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"Truck 2\""), std::string::npos); // Truck track
+  EXPECT_NE(json.find("\"name\":\"Dock 2\""), std::string::npos);  // Dock track
+  EXPECT_NE(json.find("\"name\":\"docked\""), std::string::npos);
+}
+
+// A fleet writes the events of all trucks to one ring, ids beyond 16 bits keep their track
+TEST_F(TraceTest, FleetEventsKeepLargeTruckIds) {
+  TraceRing *ring = trace_claim(hdr, TRACE_ROLE_TRUCK, 1);
+
+  uint64_t docked = trace_now();
+  trace_event_actor(ring, 70000, TRACE_DOCK, 0, 0);
+  trace_event_actor(ring, 70000, TRACE_UNDOCK, docked, 0);
+  EXPECT_EQ(ring->events[0].actor, 70000u);
+
+  std::string json = ExportJson();
+  EXPECT_NE(json.find("\"name\":\"docked\",\"ph\":\"X\",\"pid\":4,\"tid\":70000"), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"Truck 70000\""), std::string::npos); // Dock track
+  EXPECT_EQ(json.find("\"tid\":4464,"), std::string::npos);            // 70000 wrapped to 16 bits
+}
@@ -1,17 +1,26 @@
 #include <gtest/gtest.h>
+#include <sched.h>
 #include <signal.h>
 #include <sys/ipc.h>
 #include <sys/sem.h>
 #include <sys/shm.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/wait.h>
 
+#include <iostream>
+#include <thread>
 #include <vector>
 
 extern "C" {
+  #include "../src/common/belt.h"
   #include "../src/common/common.h"
+  #include "../src/common/log.h"
+  #include "../src/common/sem_wrapper.h"
   #include "../src/common/utils.h"
+  #include "../src/role.h"
+  #include "../src/truck_fleet.h"
 
   union semun {
     int val;
@@ -36,21 +45,23 @@ protected:
     key_t key_sem = ftok(KEY_PATH, KEY_ID_SEM);
     
     // Shared Memory Attachment
-    shmid = shmget(key_shm, sizeof(SharedState), 0600|IPC_CREAT);
+    shmid = shmget(key_shm, shared_state_size(100), 0600|IPC_CREAT);
     ASSERT_NE(shmid, -1) << "Failed to create SHM";
     shm = (SharedState *)shmat(shmid, (void *)0, 0);
     ASSERT_NE(shm, (void *)-1) << "Failed to attach SHM";
 
     // Set shm
     memset(shm, 0, sizeof(SharedState));
+    delay_defaults(shm->delays);
     shm->max_items_K = 100;
-    shm->max_belt_weight_M = 1000.0;
-    shm->current_truck_load = 0.0;
-    shm->truck_docked = 0;
+    shm->max_belt_weight_M = 1000000;
+    shm->docks[0].current_truck_load = 0;
+    shm->docks[0].truck_docked = 0;
+    shm->docks_D = 1;
     shm->shutdown = 0;
 
-    shm->truck_capacity_W = 1000.0; 
-    shm->truck_volume_V = 1000.0;
+    shm->truck_capacity_W = 1000000;
+    shm->truck_volume_V = 1000000000;
     
     // Init Semaphores
     semid = semget(key_sem, 4, 0600|IPC_CREAT);
@@ -69,7 +80,8 @@ protected:
     // Belt empty by default
     arg.val = shm->max_items_K;
     semctl(semid, SEM_EMPTY, SETVAL, arg);
-    
+
+    belt_init(shm);
   }
 
   void TearDown() override {
@@ -107,27 +119,41 @@ protected:
     usleep(100000);
   }
 
-  void PlacePkgsOnBelt(int count, double preset_w = 0, double preset_v = 0, PackageType preset_type = PKG_END) {
-    shm->max_belt_weight_M += count * 25.0;
+  void PlacePkgsOnBelt(int count, int preset_w = 0, int preset_v = 0, PackageType preset_type = PKG_END) {
+    shm->max_belt_weight_M += count * 25000;
     
     Package pkg;
     for (int i = 0; i < count; ++i) {
       pkg.id = current_belt_item_id;
 
       pkg.type = preset_type == PKG_END ? get_rand_package_type() : preset_type;
-      pkg.weight = preset_w ? preset_w : generate_weight(pkg.type);
-      pkg.volume = preset_v ? preset_v : get_volume(pkg.type);
+      pkg.weight_g = preset_w ? preset_w : generate_weight_g(pkg.type);
+      pkg.volume_cm3 = preset_v ? preset_v : get_volume_cm3(pkg.type);
+      current_belt_item_id++;
+
+      ASSERT_EQ(belt_push(shm, semid, &pkg), BELT_OK);
+    }
+  }
+
+  static long long NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+  }
 
-      shm->belt[current_belt_item_id++] = pkg;
+  // Times a process gave up the CPU on its own (sleeps, waits), -1 if unknown
+  static long VoluntarySwitches(pid_t pid) {
+    std::string path = "/proc/" + std::to_string(pid) + "/status";
+    FILE *f = fopen(path.c_str(), "r");
+    if (!f) return -1;
 
-      shm->current_belt_weight += pkg.weight;
-      shm->current_count++;
+    long n = -1;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+      if (sscanf(line, "voluntary_ctxt_switches: %ld", &n) == 1) break;
     }
-    shm->tail = shm->current_count % shm->max_items_K;
-    
-    union semun arg;
-    arg.val = shm->current_count;
-    semctl(semid, SEM_FULL, SETVAL, arg);
+    fclose(f);
+    return n;
   }
 };
 
@@ -135,19 +161,19 @@ protected:
 TEST_F(TruckTest, LoadingAllPackages) {
   PlacePkgsOnBelt(5);
 
-  ASSERT_GT(shm->current_belt_weight, 0.0);
-  double initial_belt_weight = shm->current_belt_weight;
+  ASSERT_GT(shm->current_belt_weight, 0);
+  int64_t initial_belt_weight = shm->current_belt_weight;
 
   RunTruckProcess(1);
   sleep(3);
 
-  EXPECT_DOUBLE_EQ(initial_belt_weight, shm->current_truck_load);
+  EXPECT_EQ(initial_belt_weight, shm->docks[0].current_truck_load);
 }
 
 TEST_F(TruckTest, PkgLoadingAndDeparture) {
   int count = 2;
-  double weight = 20.0;
-  double weight_sum = count * weight;
+  int weight = 20000;
+  int64_t weight_sum = count * weight;
 
   // Set truck capacity
   shm->truck_capacity_W = weight;
@@ -165,20 +191,20 @@ TEST_F(TruckTest, PkgLoadingAndDeparture) {
   // About 5.5s for each package
   sleep(20);
   
-  EXPECT_DOUBLE_EQ(shm->current_truck_load, 0.0);
-  EXPECT_DOUBLE_EQ(shm->current_truck_vol, 0.0);
+  EXPECT_EQ(shm->docks[0].current_truck_load, 0);
+  EXPECT_EQ(shm->docks[0].current_truck_vol, 0);
 
-  EXPECT_DOUBLE_EQ(shm->current_belt_weight, 0.0);
+  EXPECT_EQ(shm->current_belt_weight, 0);
 }
 
 TEST_F(TruckTest, RespectsVolumeLimits) {
-  shm->truck_capacity_W = 1000.0;
-  shm->truck_volume_V = 10.0;
+  shm->truck_capacity_W = 1000000;
+  shm->truck_volume_V = 10000000;
 
   int count = 2;
-  double weight = 10.0;
-  double volume = 6.0;
-  double weight_sum = count * weight;
+  int weight = 10000;
+  int volume = 6000000;
+  int64_t weight_sum = count * weight;
   
   PlacePkgsOnBelt(count, weight, volume, PKG_C);
   ASSERT_EQ(weight_sum, shm->current_belt_weight);
@@ -186,16 +212,16 @@ TEST_F(TruckTest, RespectsVolumeLimits) {
   RunTruckProcess(1);
   sleep(2); // Loading package
 
-  EXPECT_DOUBLE_EQ(shm->current_truck_load, 10.0);
-  EXPECT_DOUBLE_EQ(shm->current_truck_vol, 6.0);
+  EXPECT_EQ(shm->docks[0].current_truck_load, 10000);
+  EXPECT_EQ(shm->docks[0].current_truck_vol, 6000000);
 
   // One package left on belt
-  EXPECT_DOUBLE_EQ(shm->current_belt_weight, 10.0);
+  EXPECT_EQ(shm->current_belt_weight, 10000);
 }
 
 
-TEST_F(TruckTest, ForcedDepartureBySignal) {
-  shm->truck_docked = 0;
+TEST_F(TruckTest, ForcedDepartureByCommand) {
+  shm->docks[0].truck_docked = 0;
 
   int count = 10;
   PlacePkgsOnBelt(count);
@@ -203,31 +229,33 @@ TEST_F(TruckTest, ForcedDepartureBySignal) {
   RunTruckProcess(1);
   usleep(200000); // Loads 1-3 packages
 
-  pid_t current_t_pid = truck_pids.at(0);
-  
-  ASSERT_GT(current_t_pid, 0);
-  // Sends signal
-  kill(current_t_pid, SIGUSR1);
+  ASSERT_EQ(shm->docks[0].truck_docked, 1);
+  // Posts command to the dock
+  ASSERT_EQ(mailbox_post(&shm->dock_mail[0], CMD_FORCE_DEPART, 0, 0), 1u);
 
   sleep(1); // Wait for action
 
   // Few packages must be loaded
-  EXPECT_GT(shm->current_truck_load, 0.0);
+  EXPECT_GT(shm->docks[0].current_truck_load, 0);
 
   // Truck can't load all packages
-  EXPECT_LT(shm->current_truck_load, shm->current_belt_weight + shm->current_truck_load);
+  EXPECT_LT(shm->docks[0].current_truck_load, shm->current_belt_weight + shm->docks[0].current_truck_load);
 
   // Truck should be delivering
-  EXPECT_EQ(shm->truck_docked, 0);
+  EXPECT_EQ(shm->docks[0].truck_docked, 0);
+
+  // Command was executed once and counted
+  EXPECT_EQ(shm->dock_mail[0].done, 1u);
+  EXPECT_EQ(shm->stats.forced_departures, 1);
 }
 
 
 TEST_F(TruckTest, SkipOversizedPackage) {
-  shm->truck_capacity_W = 10.0;
-  shm->truck_volume_V = 100.0;
+  shm->truck_capacity_W = 10000;
+  shm->truck_volume_V = 100000000;
 
   int count = 1;
-  double weight = 20.0;
+  int weight = 20000;
 
   PlacePkgsOnBelt(count, weight);
 
@@ -235,25 +263,25 @@ TEST_F(TruckTest, SkipOversizedPackage) {
   usleep(400000); // Loading package
 
   // Truck should be empty
-  EXPECT_DOUBLE_EQ(shm->current_truck_load, 0.0);
-  EXPECT_DOUBLE_EQ(shm->current_truck_vol, 0.0);
+  EXPECT_EQ(shm->docks[0].current_truck_load, 0);
+  EXPECT_EQ(shm->docks[0].current_truck_vol, 0);
 
   // Package wasn't loaded, should be still on belt
-  EXPECT_DOUBLE_EQ(shm->current_belt_weight, weight);
+  EXPECT_EQ(shm->current_belt_weight, weight);
   EXPECT_EQ(shm->current_count, 1);
 }
 
 // Testing consistency of package loading
 // Next arriving truck should load first package from belt
 TEST_F(TruckTest, NextTruckLoadsFirstItem) {
-  shm->truck_capacity_W = 10.0;
-  shm->truck_volume_V = 100.0;
+  shm->truck_capacity_W = 10000;
+  shm->truck_volume_V = 100000000;
 
   // Placing two different packages to distinguish trucks
-  PlacePkgsOnBelt(1, 10.0);
-  PlacePkgsOnBelt(1, 7.0);
+  PlacePkgsOnBelt(1, 10000);
+  PlacePkgsOnBelt(1, 7000);
   // This Package should not be loaded
-  PlacePkgsOnBelt(1, 100.0);
+  PlacePkgsOnBelt(1, 100000);
   
   RunTruckProcess(1);
 
@@ -262,7 +290,182 @@ TEST_F(TruckTest, NextTruckLoadsFirstItem) {
 
   sleep(2); // Waits for last truck to load package
 
-  EXPECT_DOUBLE_EQ(shm->current_truck_load, 7.0);
-  EXPECT_DOUBLE_EQ(shm->current_belt_weight, 100.0);
+  EXPECT_EQ(shm->docks[0].current_truck_load, 7000);
+  EXPECT_EQ(shm->current_belt_weight, 100000);
   EXPECT_EQ(shm->current_count, 1);
 }
+
+// Package landing on an empty belt must be loaded right away,
+// docked truck sleeps on the belt doorbell instead of polling every 50ms
+TEST_F(TruckTest, PackageArrivalWakesSleepingTruck) {
+  RunTruckProcess(1);
+  pid_t truck = truck_pids.back();
+
+  for (int i = 0; i < 3; ++i) {
+    // Wait until docked truck sleeps on empty belt
+    for (int t = 0; t < 2000 && __atomic_load_n(&shm->belt_pop_waiters, __ATOMIC_SEQ_CST) == 0; ++t) {
+      usleep(1000);
+    }
+    ASSERT_EQ(shm->belt_pop_waiters, 1u);
+
+    // Asleep, not polling: no wake-up over three old poll periods of an empty belt
+    long switches = VoluntarySwitches(truck);
+    ASSERT_GE(switches, 0);
+    usleep(150000);
+    EXPECT_EQ(VoluntarySwitches(truck), switches) << "truck woke up without a package";
+    EXPECT_EQ(shm->belt_pop_waiters, 1u);
+
+    int64_t load_before = shm->docks[0].current_truck_load;
+    int64_t load_now = load_before;
+    Package pkg = {i, PKG_A, 1000, get_volume_cm3(PKG_A)};
+
+    long long start = NowNs();
+    ASSERT_EQ(belt_push(shm, semid, &pkg), BELT_OK);
+
+    // The push wakes the truck, it leaves the wait and loads within one old poll period.
+    // Yielding so truck can run on a single core
+    while (load_now == load_before && NowNs() - start < 50000000LL) {
+      sched_yield();
+      load_now = __atomic_load_n(&shm->docks[0].current_truck_load, __ATOMIC_SEQ_CST);
+    }
+    EXPECT_NE(load_now, load_before) << "Package was not loaded within 50ms";
+    EXPECT_EQ(shm->belt_pop_waiters, 0u); // Loading, not back on the doorbell yet
+  }
+}
+
+// Two docks, two trucks loading from one belt at the same time
+TEST_F(TruckTest, TwoDocksLoadConcurrently) {
+  union semun arg;
+  arg.val = 2;
+  semctl(semid, SEM_DOCK, SETVAL, arg);
+  shm->docks_D = 2;
+
+  RunTruckProcess(1);
+  RunTruckProcess(2);
+
+  EXPECT_EQ(shm->docks[0].truck_docked, 1);
+  EXPECT_EQ(shm->docks[1].truck_docked, 1);
+  EXPECT_NE(shm->docks[0].current_truck_pid, shm->docks[1].current_truck_pid);
+
+  int count = 6;
+  int weight = 10000;
+  PlacePkgsOnBelt(count, weight, 0, PKG_C);
+  sleep(2);
+
+  // Belt emptied, load split between docks
+  EXPECT_EQ(shm->current_belt_weight, 0);
+  EXPECT_EQ(shm->docks[0].current_truck_load + shm->docks[1].current_truck_load, count * weight);
+}
+
+static const int FLEET_K = 1000;
+static const int FLEET_DOCKS = 2;
+
+/**
+ * Truck fleet (--fleet) in threads mode: private state and semaphores, the
+ * fleet runs in a thread of the test.
+ */
+class FleetTest : public ::testing::Test {
+protected:
+  SharedState *shm;
+  int semid;
+
+  void SetUp() override {
+    size_t size = shared_state_size(FLEET_K);
+    ASSERT_EQ(posix_memalign((void **)&shm, CACHE_LINE_SIZE, size), 0);
+    memset(shm, 0, size);
+    delay_defaults(shm->delays);
+    shm->segment_size = size;
+    shm->max_items_K = FLEET_K;
+    shm->max_belt_weight_M = UNITS_MAX;
+    shm->truck_capacity_W = 20000; // 20 packages of 1 kg per departure
+    shm->truck_volume_V = UNITS_MAX;
+    shm->docks_D = FLEET_DOCKS;
+    shm->log_level = LOG_LEVEL_ERROR;
+    shm->no_sleep = 1;
+    belt_init(shm);
+
+    semid = sem_create_private(belt_sem_count(shm->belt_lanes));
+    sem_set(semid, SEM_MUTEX, SETVAL, 1);
+#ifndef BELT_LOCKFREE
+    sem_set(semid, SEM_EMPTY, SETVAL, FLEET_K);
+#endif
+    sem_set(semid, SEM_FULL, SETVAL, 0);
+    sem_set(semid, SEM_DOCK, SETVAL, FLEET_DOCKS);
+  }
+
+  void TearDown() override {
+    sem_set(semid, 0, IPC_RMID, 0);
+    free(shm);
+  }
+
+  void FillBelt() {
+    for (int i = 0; i < FLEET_K; ++i) {
+      Package pkg = {i, PKG_A, 1000, get_volume_cm3(PKG_A)};
+      ASSERT_EQ(belt_push(shm, semid, &pkg), BELT_OK);
+    }
+  }
+
+  // Every package loaded and delivered, trucks left their docks
+  void ExpectAllDelivered() {
+    EXPECT_EQ(shm->stats.loaded, FLEET_K);
+    EXPECT_EQ(shm->current_belt_weight, 0);
+    EXPECT_EQ(shm->stats.latency_ns[LAT_LOAD_TO_DELIVERY][PKG_A].count, (uint64_t)FLEET_K);
+    EXPECT_EQ(shm->stats.delivered_weight, (int64_t)FLEET_K * 1000);
+    EXPECT_GE(shm->stats.deliveries, FLEET_K / 20);
+
+    for (int d = 0; d < FLEET_DOCKS; ++d) EXPECT_EQ(shm->docks[d].truck_docked, 0) << "dock " << d;
+    EXPECT_EQ(sem_get(semid, SEM_DOCK), FLEET_DOCKS);
+  }
+
+  static long long NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+  }
+};
+
+// Every package of a full belt is loaded and delivered, trucks cycle through the docks
+TEST_F(FleetTest, LoadsAndDeliversWholeBelt) {
+  FillBelt();
+
+  RoleEnv env = {shm, semid, NULL, NULL, NULL};
+  std::thread fleet([&env] { fleet_run(&env, 1, 4); });
+
+  long long start = NowNs();
+  while (__atomic_load_n(&shm->stats.loaded, __ATOMIC_SEQ_CST) < FLEET_K && NowNs() - start < 10000000000LL) {
+    usleep(1000);
+  }
+
+  // Docked trucks leave and deliver, queued ones stop, then the fleet ends
+  __atomic_store_n(&shm->shutdown, 1, __ATOMIC_SEQ_CST);
+  belt_kick(shm);
+  fleet.join();
+
+  ExpectAllDelivered();
+}
+
+// No simulated delays: every waiting state ends in its round, no truck waits for a timer tick
+TEST_F(FleetTest, ZeroDelaysSetNoTimers) {
+  FillBelt();
+
+  RoleEnv env = {shm, semid, NULL, NULL, NULL};
+  Fleet f;
+  fleet_init(&f, &env, 1, 4);
+
+  for (int round = 0; shm->stats.loaded < FLEET_K; ++round) {
+    ASSERT_LT(round, 10 * FLEET_K) << "fleet stopped loading";
+    fleet_round(&f, monotonic_ns(), 0);
+    ASSERT_EQ(timer_wheel_next_ns(&f.wheel), UINT64_MAX) << "timer set in round " << round;
+  }
+
+  // Docked trucks leave and deliver at once, queued ones stop
+  shm->shutdown = 1;
+  for (int round = 0; f.active > 0; ++round) {
+    ASSERT_LT(round, 10) << "fleet did not drain";
+    fleet_round(&f, monotonic_ns(), 1);
+    ASSERT_EQ(timer_wheel_next_ns(&f.wheel), UINT64_MAX);
+  }
+  fleet_free(&f);
+
+  ExpectAllDelivered();
+}
@@ -7,12 +7,28 @@ extern "C" {
 
 // Test example
 TEST(UtilsTest, GeneratedWeightIsWithinBounds) {
-  double weight = generate_weight(PKG_C);
-  EXPECT_GE(weight, 0.1);  // Greater or Equal
-  EXPECT_LE(weight, 25.0); // Less or Equal
+  int weight = generate_weight_g(PKG_C);
+  EXPECT_GE(weight, 100);   // Greater or Equal
+  EXPECT_LE(weight, 25000); // Less or Equal
 }
 
 TEST(UtilsTest, VolumeZeroForUnknownType) {
-  double vol = get_volume((PackageType)999); 
-  EXPECT_EQ(vol, 0.0);
+  int vol = get_volume_cm3((PackageType)999);
+  EXPECT_EQ(vol, 0);
+}
+
+TEST(UtilsTest, UnitConversionsRoundAndSaturate) {
+  EXPECT_EQ(kg_to_g(12.3456), 12346);
+  EXPECT_EQ(kg_to_g(-1.0), 0);
+  EXPECT_EQ(kg_to_g(1e300), UNITS_MAX);
+  EXPECT_EQ(m3_to_cm3(0.0195), 19500);
+  EXPECT_DOUBLE_EQ(g_to_kg(12500), 12.5);
+  EXPECT_DOUBLE_EQ(cm3_to_m3(99712), 0.099712);
+}
+
+TEST(UtilsTest, WeightSumIsExact) {
+  // 0.1 kg added ten times is not 1.0 kg in floating point, 100 g is 1000 g
+  Package pkgs[10] = {};
+  for (Package &p : pkgs) p.weight_g = 100;
+  EXPECT_EQ(package_weight_sum(pkgs, 10), 1000);
 }
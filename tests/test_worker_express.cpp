@@ -38,10 +38,11 @@ protected:
 
     // Initial state
     memset(shm, 0, sizeof(SharedState));
-    shm->truck_capacity_W = 1000.0;
-    shm->truck_volume_V = 1000.0;
-    shm->current_truck_load = 0.0;
-    shm->truck_docked = 0;
+    shm->truck_capacity_W = 1000000;
+    shm->truck_volume_V = 1000000000;
+    shm->docks[0].current_truck_load = 0;
+    shm->docks[0].truck_docked = 0;
+    shm->docks_D = 1;
     shm->shutdown = 0;
 
     // Init Sem
@@ -82,39 +83,55 @@ protected:
 };
 
 // TEST 1: worker shouldn't load if truck is not docked
-TEST_F(WorkerExpressTest, IgnoresSignalWhenNoTruck) {
-  shm->truck_docked = 0;
+TEST_F(WorkerExpressTest, IgnoresCommandWhenNoTruck) {
+  shm->docks[0].truck_docked = 0;
 
   RunWorkerProcess();
 
-  kill(worker_pid, SIGUSR1);
+  mailbox_post(&shm->express_mail, CMD_EXPRESS_LOAD, 0, 0);
   usleep(100000);
 
-  EXPECT_DOUBLE_EQ(shm->current_truck_load, 0.0);
+  EXPECT_EQ(shm->docks[0].current_truck_load, 0);
 }
 
 // TEST 2: worker should load packages (Truck docked)
 TEST_F(WorkerExpressTest, LoadsPackagesWhenTruckDocked) {
-  shm->truck_docked = 1;
+  shm->docks[0].truck_docked = 1;
 
   RunWorkerProcess();
 
-  kill(worker_pid, SIGUSR1);
+  mailbox_post(&shm->express_mail, CMD_EXPRESS_LOAD, 0, 0);
   usleep(200000);
 
-  EXPECT_GT(shm->current_truck_load, 0.0);
-  EXPECT_GT(shm->current_truck_vol, 0.0);
+  EXPECT_GT(shm->docks[0].current_truck_load, 0);
+  EXPECT_GT(shm->docks[0].current_truck_vol, 0);
 }
 
 // TEST 3: load limits
 TEST_F(WorkerExpressTest, SkipPackagesIfLimitReached) {
-  shm->truck_docked = 1;
-  shm->truck_capacity_W = 1.0;
+  shm->docks[0].truck_docked = 1;
+  shm->truck_capacity_W = 1000;
   
   RunWorkerProcess();
 
-  kill(worker_pid, SIGUSR1);
+  mailbox_post(&shm->express_mail, CMD_EXPRESS_LOAD, 0, 0);
   usleep(200000);
 
-  EXPECT_LE(shm->current_truck_load, shm->truck_capacity_W);
+  EXPECT_LE(shm->docks[0].current_truck_load, shm->truck_capacity_W);
+}
+
+// TEST 4: every command is executed, none merge, with the requested count
+TEST_F(WorkerExpressTest, ExecutesEveryCommandWithItsCount) {
+  shm->docks[0].truck_docked = 1;
+
+  RunWorkerProcess();
+
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(mailbox_post(&shm->express_mail, CMD_EXPRESS_LOAD, 0, 2), (uint64_t)i + 1);
+  }
+  usleep(200000);
+
+  EXPECT_EQ(shm->express_mail.done, 3u);
+  EXPECT_EQ(shm->stats.express_loaded, 6);
+  EXPECT_EQ(shm->stats.command_ns[CMD_EXPRESS_LOAD].count, 3u);
 }
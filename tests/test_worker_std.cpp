@@ -8,6 +8,7 @@
 #include <fstream>
 
 extern "C" {
+  #include "../src/common/belt.h"
   #include "../src/common/common.h"
 
   union semun {
@@ -30,7 +31,7 @@ protected:
     key_t key_sem = ftok(KEY_PATH, KEY_ID_SEM);
 
     // Shared Memory Attachment
-    shmid = shmget(key_shm, sizeof(SharedState), 0600|IPC_CREAT);
+    shmid = shmget(key_shm, shared_state_size(5), 0600|IPC_CREAT);
     ASSERT_NE(shmid, -1) << "Failed to create SHM";
 
     shm = (SharedState *)shmat(shmid, (void *)0, 0);
@@ -38,10 +39,10 @@ protected:
 
     // Initial State
     memset(shm, 0, sizeof(SharedState));
+    delay_defaults(shm->delays);
     shm->max_items_K = 5; // 5 slots empty by default
-    shm->max_belt_weight_M = 200.0;
+    shm->max_belt_weight_M = 200000;
     shm->shutdown = 0;
-    shm->tail = 0;
 
     // Create Semaphores
     semid = semget(key_sem, 3, 0600|IPC_CREAT);
@@ -62,6 +63,8 @@ protected:
     union semun arg_full;
     arg_full.val = 0;
     semctl(semid, SEM_FULL, SETVAL, arg_full); 
+
+    belt_init(shm);
   }
 
   void TearDown() {
@@ -96,12 +99,12 @@ TEST_F(WorkerStandardTest, PlacesPackagesIfSpaceEmpty) {
   RunWorkerProcess();
   usleep(500000);
   
-  EXPECT_GT(shm->current_belt_weight, 0.0);
+  EXPECT_GT(shm->current_belt_weight, 0);
 }
 
 // TEST 2: belts weight limit is reached, worker can't place next package
 TEST_F(WorkerStandardTest, BeltsWeightLimitReachedCantPlace) {
-  shm->max_belt_weight_M = 0.0;
+  shm->max_belt_weight_M = 0;
   
   RunWorkerProcess();
   usleep(500000);
@@ -111,12 +114,22 @@ TEST_F(WorkerStandardTest, BeltsWeightLimitReachedCantPlace) {
 
 // TEST 3: worker cant place new packages if belt is full
 TEST_F(WorkerStandardTest, BlockIfBeltIsFull) {
+#ifdef BELT_LOCKFREE
+  // Lock-free ring does not use SEM_EMPTY, occupy every slot instead
+  Package pkg = {0, PKG_A, 1000, 19000};
+  for (int i = 0; i < shm->max_items_K; ++i) {
+    ASSERT_EQ(belt_push(shm, semid, &pkg), BELT_OK);
+  }
+  int full_count = shm->max_items_K;
+#else
   union semun arg;
   arg.val = 0;
   semctl(semid, SEM_EMPTY, SETVAL, arg);
 
   shm->current_count = 0;
+  int full_count = 0;
+#endif
   
   RunWorkerProcess();
-  EXPECT_EQ(shm->current_count, 0);
+  EXPECT_EQ(shm->current_count, full_count);
 }
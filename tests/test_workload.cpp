@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+  #include "../src/common/workload.h"
+}
+
+class WorkloadTest : public ::testing::Test {
+protected:
+  std::string path;
+
+  void SetUp() override {
+    char tmpl[] = "/tmp/workload_test_XXXXXX";
+    int fd = mkstemp(tmpl);
+    ASSERT_NE(fd, -1);
+    close(fd);
+    path = tmpl;
+  }
+
+  void TearDown() override {
+    unlink(path.c_str());
+  }
+
+  off_t FileSize() {
+    struct stat st;
+    stat(path.c_str(), &st);
+    return st.st_size;
+  }
+
+  static Package Pkg(PackageType type, int weight_g, uint64_t t_gen_ns) {
+    Package p = {};
+    p.type = type;
+    p.weight_g = weight_g;
+    p.volume_cm3 = 500000;
+    p.t_gen_ns = t_gen_ns;
+    return p;
+  }
+};
+
+TEST(WorkloadLayoutTest, RecordsAreFixedSize) {
+  EXPECT_EQ(sizeof(WorkloadHeader), 64u);
+  EXPECT_EQ(sizeof(WorkloadRecord), 32u);
+  EXPECT_EQ(workload_file_size(10), 64u + 10 * 32u);
+}
+
+TEST_F(WorkloadTest, RecordingSurvivesRemap) {
+  WorkloadHeader *hdr = workload_create(path.c_str(), 16, 2, 0);
+  ASSERT_NE(hdr, nullptr);
+
+  Package pkgs[2] = {Pkg(PKG_A, 3000, hdr->t0_ns + 100), Pkg(PKG_C, 20000, hdr->t0_ns + 200)};
+  workload_record(hdr, 2, pkgs, 2);
+  EXPECT_EQ(workload_finish(hdr, path.c_str()), 2);
+  EXPECT_EQ(FileSize(), (off_t)workload_file_size(2)); // Cut to the records written
+
+  hdr = workload_map(path.c_str(), 0);
+  ASSERT_NE(hdr, nullptr);
+  EXPECT_EQ(hdr->count, 2u);
+  EXPECT_EQ(hdr->duration_ns, 200u);
+
+  const WorkloadRecord *rec = workload_records(hdr);
+  EXPECT_EQ(rec[0].t_ns, 100u);
+  EXPECT_EQ(rec[0].worker, 2);
+  EXPECT_EQ(rec[0].type, PKG_A);
+  EXPECT_EQ(rec[0].weight_g, 3000);
+  EXPECT_EQ(rec[1].type, PKG_C);
+  EXPECT_EQ(rec[1].volume_cm3, 500000);
+  workload_unmap(hdr);
+}
+
+TEST_F(WorkloadTest, FullFileCountsDropped) {
+  WorkloadHeader *hdr = workload_create(path.c_str(), 3, 1, 0);
+  ASSERT_NE(hdr, nullptr);
+
+  Package pkgs[2] = {Pkg(PKG_A, 1000, hdr->t0_ns), Pkg(PKG_B, 2000, hdr->t0_ns)};
+  workload_record(hdr, 1, pkgs, 2);
+  workload_record(hdr, 1, pkgs, 2);
+  workload_record(hdr, 1, pkgs, 2);
+  EXPECT_EQ(hdr->dropped, 3u);
+  EXPECT_EQ(workload_finish(hdr, path.c_str()), 3);
+}
+
+TEST_F(WorkloadTest, RejectsForeignFiles) {
+  FILE *f = fopen(path.c_str(), "w");
+  ASSERT_NE(f, nullptr);
+  fputs("not a workload file, but long enough to hold a header of 64 bytes......", f);
+  fclose(f);
+
+  EXPECT_EQ(workload_map(path.c_str(), 0), nullptr);
+  EXPECT_EQ(workload_map("/nonexistent/workload.bin", 0), nullptr);
+}
+
+TEST_F(WorkloadTest, CursorFollowsOneWorkerAndWraps) {
+  WorkloadHeader *hdr = workload_create(path.c_str(), 8, 2, 0);
+  ASSERT_NE(hdr, nullptr);
+
+  Package w1[2] = {Pkg(PKG_A, 1000, hdr->t0_ns + 10), Pkg(PKG_A, 2000, hdr->t0_ns + 30)};
+  Package w2[1] = {Pkg(PKG_B, 5000, hdr->t0_ns + 20)};
+  workload_record(hdr, 1, w1, 1);
+  workload_record(hdr, 2, w2, 1);
+  workload_record(hdr, 1, w1 + 1, 1);
+  workload_finish(hdr, path.c_str());
+
+  hdr = workload_map(path.c_str(), 0);
+  ASSERT_NE(hdr, nullptr);
+
+  WorkloadCursor cursor;
+  Package p;
+  workload_cursor_init(hdr, &cursor, 1);
+  ASSERT_EQ(workload_next(hdr, &cursor, &p), 1);
+  EXPECT_EQ(p.weight_g, 1000);
+  EXPECT_EQ(p.t_gen_ns, 10u);
+  ASSERT_EQ(workload_next(hdr, &cursor, &p), 1);
+  EXPECT_EQ(p.weight_g, 2000);
+  EXPECT_EQ(p.t_gen_ns, 30u);
+
+  // Second lap, arrival times continue after the file duration
+  ASSERT_EQ(workload_next(hdr, &cursor, &p), 1);
+  EXPECT_EQ(p.weight_g, 1000);
+  EXPECT_EQ(p.t_gen_ns, 40u);
+
+  // Worker 4 of a run with more workers follows recorded worker 2
+  workload_cursor_init(hdr, &cursor, 4);
+  ASSERT_EQ(workload_next(hdr, &cursor, &p), 1);
+  EXPECT_EQ(p.type, PKG_B);
+  workload_unmap(hdr);
+}
+
+TEST_F(WorkloadTest, CursorSkipsUnwrittenRecords) {
+  WorkloadHeader *hdr = workload_create(path.c_str(), 4, 1, 0);
+  ASSERT_NE(hdr, nullptr);
+
+  // A writer killed after claiming leaves a zeroed record behind
+  hdr->count = 1;
+  Package pkg = Pkg(PKG_C, 7000, hdr->t0_ns + 5);
+  workload_record(hdr, 1, &pkg, 1);
+  workload_finish(hdr, path.c_str());
+
+  hdr = workload_map(path.c_str(), 0);
+  ASSERT_NE(hdr, nullptr);
+  WorkloadCursor cursor;
+  Package p;
+  workload_cursor_init(hdr, &cursor, 1);
+  ASSERT_EQ(workload_next(hdr, &cursor, &p), 1);
+  EXPECT_EQ(p.weight_g, 7000);
+  workload_unmap(hdr);
+}
+
+TEST_F(WorkloadTest, CursorWithoutRecordsReturnsZero) {
+  WorkloadHeader *hdr = workload_create(path.c_str(), 4, 1, 0);
+  ASSERT_NE(hdr, nullptr);
+
+  WorkloadCursor cursor;
+  Package p;
+  workload_cursor_init(hdr, &cursor, 1);
+  EXPECT_EQ(workload_next(hdr, &cursor, &p), 0);
+  workload_unmap(hdr);
+}
+
+TEST_F(WorkloadTest, GeneratorIsDeterministicPerRecord) {
+  WorkloadHeader *hdr = workload_create(path.c_str(), 600, 3, 1);
+  ASSERT_NE(hdr, nullptr);
+
+  // Filled in two pieces, compared with one piece
+  workload_generate(hdr, 0, 250, 42, 1000);
+  workload_generate(hdr, 250, 350, 42, 1000);
+
+  WorkloadRecord *whole = (WorkloadRecord *)malloc(sizeof(WorkloadRecord) * 600);
+  WorkloadHeader *copy = (WorkloadHeader *)malloc(workload_file_size(600));
+  *copy = *hdr;
+  workload_generate(copy, 0, 600, 42, 1000);
+  memcpy(whole, workload_records(copy), sizeof(WorkloadRecord) * 600);
+  EXPECT_EQ(memcmp(whole, workload_records(hdr), sizeof(WorkloadRecord) * 600), 0);
+
+  const WorkloadRecord *rec = workload_records(hdr);
+  uint64_t last[4] = {0, 0, 0, 0};
+  int types[PKG_END] = {0, 0, 0};
+  for (int i = 0; i < 600; ++i) {
+    EXPECT_EQ(rec[i].worker, i % 3 + 1);
+    EXPECT_GE(rec[i].t_ns, last[rec[i].worker]); // Arrivals of a worker never go back
+    EXPECT_GT(rec[i].weight_g, 0);
+    EXPECT_LE(rec[i].weight_g, 25000);
+    if (rec[i].type == PKG_A) EXPECT_LE(rec[i].weight_g, 10000);
+    last[rec[i].worker] = rec[i].t_ns;
+    ++types[rec[i].type];
+  }
+  for (int t = 0; t < PKG_END; ++t) EXPECT_GT(types[t], 100);
+
+  // Another seed gives another workload
+  workload_generate(copy, 0, 600, 43, 1000);
+  EXPECT_NE(memcmp(whole, workload_records(copy), sizeof(WorkloadRecord) * 600), 0);
+
+  free(copy);
+  free(whole);
+  workload_unmap(hdr);
+}